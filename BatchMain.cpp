@@ -0,0 +1,128 @@
+#include "BatchScript.hpp"
+#include "TextFile.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+// hoodrd-batch: runs an edit script over many files with the editor's own
+// loading, buffer and saving code, several files at once
+
+struct FileReport {
+    std::string path;
+    bool ok = false;
+    BatchResult result = {};
+    double loadMs = 0;
+    double editMs = 0;
+    double saveMs = 0;
+};
+
+using Clock = std::chrono::steady_clock;
+
+static double millisecondsSince(Clock::time_point& start) {
+    Clock::time_point now = Clock::now();
+    double elapsed = std::chrono::duration<double, std::milli>(now - start).count();
+    start = now;
+    return elapsed;
+}
+
+static void processFile(const BatchScript& script, bool dryRun, unsigned lineThreads, FileReport& report) {
+    Clock::time_point start = Clock::now();
+    std::vector<std::string> lines;
+    if (!TextFile::readLines(report.path, lines)) return;
+    TextBuffer buffer;
+    buffer.assign(std::move(lines));
+    report.loadMs = millisecondsSince(start);
+
+    report.result = script.run(buffer, lineThreads);
+    report.editMs = millisecondsSince(start);
+
+    // Files the script did not touch are left alone
+    if (report.result.changed && !dryRun && !TextFile::writeLines(report.path, buffer)) return;
+    report.saveMs = millisecondsSince(start);
+    report.ok = true;
+}
+
+static int usage() {
+    fprintf(stderr,
+            "usage: hoodrd-batch [-j threads] [-n] script file...\n"
+            "  -j threads  files worked on at once (default: one per core)\n"
+            "  -n          run the script but save nothing\n"
+            "  file        a path, or - to read paths from stdin, one per line\n");
+    return 2;
+}
+
+int main(int argc, char** argv) {
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    bool dryRun = false;
+    std::string scriptPath;
+    std::vector<FileReport> reports;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "-j" && i + 1 < argc) {
+            threads = static_cast<unsigned>(std::max(1, atoi(argv[++i])));
+        } else if (arg == "-n") {
+            dryRun = true;
+        } else if (scriptPath.empty()) {
+            scriptPath = arg;
+        } else if (arg == "-") {
+            for (std::string path; std::getline(std::cin, path);) {
+                if (!path.empty()) reports.push_back({ path });
+            }
+        } else {
+            reports.push_back({ arg });
+        }
+    }
+    if (scriptPath.empty() || reports.empty()) return usage();
+
+    std::ifstream scriptFile(scriptPath, std::ios::binary);
+    if (!scriptFile.is_open()) {
+        fprintf(stderr, "hoodrd-batch: cannot open %s\n", scriptPath.c_str());
+        return 2;
+    }
+    std::string scriptText((std::istreambuf_iterator<char>(scriptFile)), std::istreambuf_iterator<char>());
+    BatchScript script;
+    std::string error;
+    if (!script.parse(scriptText, error)) {
+        fprintf(stderr, "hoodrd-batch: %s: %s\n", scriptPath.c_str(), error.c_str());
+        return 2;
+    }
+
+    // Each worker takes the next file until none are left
+    Clock::time_point start = Clock::now();
+    std::atomic<size_t> next{ 0 };
+    std::vector<std::thread> workers;
+    threads = static_cast<unsigned>(std::min<size_t>(threads, reports.size()));
+    // Cores left over with fewer files than threads go to sorting and
+    // filtering within each file
+    unsigned lineThreads = std::max(1u, std::thread::hardware_concurrency() / threads);
+    for (unsigned t = 0; t < threads; t++) {
+        workers.emplace_back([&] {
+            for (size_t i; (i = next++) < reports.size();) {
+                processFile(script, dryRun, lineThreads, reports[i]);
+            }
+        });
+    }
+    for (auto& worker : workers) worker.join();
+    double totalMs = millisecondsSince(start);
+
+    size_t failed = 0;
+    for (const auto& report : reports) {
+        if (!report.ok) {
+            printf("%s: cannot read or write\n", report.path.c_str());
+            failed++;
+            continue;
+        }
+        printf("%s: %zu replaced, %zu found, load %.2f ms, edit %.2f ms, save %.2f ms\n", report.path.c_str(),
+               report.result.replaced, report.result.found, report.loadMs, report.editMs, report.saveMs);
+    }
+    printf("%zu files, %zu failed, %.1f ms on %u threads\n", reports.size(), failed, totalMs, threads);
+    return failed > 0 ? 1 : 0;
+}
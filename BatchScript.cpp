@@ -0,0 +1,167 @@
+#include "BatchScript.hpp"
+#include "LineTransform.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <sstream>
+
+// Reads `delim`-separated parts with escapes, starting after the opening one
+static bool readParts(const std::string& args, size_t count, std::vector<std::string>& parts) {
+    if (args.empty()) return false;
+    char delim = args[0];
+    std::string part;
+    for (size_t i = 1; i < args.length(); i++) {
+        char c = args[i];
+        if (c == '\\' && i + 1 < args.length()) {
+            char next = args[++i];
+            part += next == 'n' ? '\n' : next == 't' ? '\t' : next;
+        } else if (c == delim) {
+            parts.push_back(part);
+            part.clear();
+            if (parts.size() == count) return args.find_first_not_of(" \t", i + 1) == std::string::npos;
+        } else {
+            part += c;
+        }
+    }
+    return false;
+}
+
+static bool readLine(const std::string& word, size_t& line) {
+    if (word == "$") {
+        line = SIZE_MAX;
+        return true;
+    }
+    char* end = nullptr;
+    unsigned long long value = strtoull(word.c_str(), &end, 10);
+    if (word.empty() || *end != '\0' || value == 0) return false;
+    line = static_cast<size_t>(value);
+    return true;
+}
+
+bool BatchScript::parse(const std::string& script, std::string& error) {
+    commands.clear();
+    std::istringstream input(script);
+    std::string line;
+    for (size_t number = 1; std::getline(input, line); number++) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        size_t start = line.find_first_not_of(" \t");
+        if (start == std::string::npos || line[start] == '#') continue;
+        size_t space = line.find_first_of(" \t", start);
+        std::string name = line.substr(start, space == std::string::npos ? std::string::npos : space - start);
+        size_t argsStart = space == std::string::npos ? line.length() : line.find_first_not_of(" \t", space);
+        std::string args = argsStart == std::string::npos ? "" : line.substr(argsStart);
+
+        BatchCommand command;
+        std::vector<std::string> parts;
+        bool ok = false;
+        if (name == "replace" || name == "find" || name == "keep" || name == "drop") {
+            command.kind = name == "replace" ? BatchCommand::Replace
+                         : name == "find"    ? BatchCommand::Find
+                         : name == "keep"    ? BatchCommand::Keep
+                                             : BatchCommand::Drop;
+            ok = readParts(args, command.kind == BatchCommand::Replace ? 2 : 1, parts) &&
+                 !parts[0].empty() && parts[0].find('\n') == std::string::npos;
+            if (ok) {
+                command.pattern = parts[0];
+                if (parts.size() > 1) command.text = parts[1];
+            }
+        } else if (name == "insert") {
+            command.kind = BatchCommand::Insert;
+            size_t split = args.find_first_of(" \t");
+            ok = readLine(args.substr(0, split), command.first);
+            if (ok && split != std::string::npos) command.text = args.substr(split + 1);
+        } else if (name == "delete") {
+            command.kind = BatchCommand::Delete;
+            std::istringstream words(args);
+            std::string first, last, extra;
+            words >> first >> last >> extra;
+            ok = readLine(first, command.first) && extra.empty() &&
+                 (last.empty() ? (command.last = command.first, true) : readLine(last, command.last)) &&
+                 command.first <= command.last;
+        } else if (name == "sort" || name == "unique") {
+            command.kind = name == "sort" ? BatchCommand::Sort : BatchCommand::Unique;
+            ok = args.empty();
+        }
+        if (!ok) {
+            error = "line " + std::to_string(number) + ": cannot read \"" + line + "\"";
+            return false;
+        }
+        commands.push_back(std::move(command));
+    }
+    return true;
+}
+
+BatchResult BatchScript::run(TextBuffer& buffer, unsigned threads) const {
+    BatchResult result;
+    for (const auto& command : commands) {
+        switch (command.kind) {
+            case BatchCommand::Replace:
+            case BatchCommand::Find: {
+                // Every match in one batch, so the buffer is rebuilt at most once
+                std::vector<TextEdit> edits;
+                size_t found = 0;
+                for (size_t i = 0; i < buffer.lineCount(); i++) {
+                    const TextLine& line = buffer.line(i);
+                    for (size_t pos = line.find(command.pattern); pos != std::string::npos;
+                         pos = line.find(command.pattern, pos + command.pattern.length())) {
+                        found++;
+                        if (command.kind == BatchCommand::Replace) {
+                            edits.push_back({ { i, pos }, { i, pos + command.pattern.length() }, command.text });
+                        }
+                    }
+                }
+                if (command.kind == BatchCommand::Find) {
+                    result.found += found;
+                } else if (!edits.empty()) {
+                    buffer.apply(edits);
+                    result.replaced += edits.size();
+                    result.changed = true;
+                }
+                break;
+            }
+            case BatchCommand::Insert:
+                if (command.first > buffer.lineCount()) {
+                    buffer.insert(buffer.end(), "\n" + command.text);
+                } else {
+                    buffer.insert({ command.first - 1, 0 }, command.text + "\n");
+                }
+                result.changed = true;
+                break;
+            case BatchCommand::Delete: {
+                // `$` is the last line; numbers past it delete nothing
+                if (command.first != SIZE_MAX && command.first > buffer.lineCount()) break;
+                size_t first = std::min(command.first, buffer.lineCount()) - 1;
+                size_t last = std::min(command.last, buffer.lineCount()) - 1;
+                if (last + 1 < buffer.lineCount()) {
+                    buffer.erase({ first, 0 }, { last + 1, 0 });
+                } else if (first > 0) {
+                    // Through the end: the line break before the range goes too
+                    buffer.erase({ first - 1, buffer.line(first - 1).length() }, buffer.end());
+                } else {
+                    buffer.erase({ 0, 0 }, buffer.end());
+                }
+                result.changed = true;
+                break;
+            }
+            case BatchCommand::Sort:
+            case BatchCommand::Unique:
+            case BatchCommand::Keep:
+            case BatchCommand::Drop: {
+                static const LineTransform::Kind kinds[] = { LineTransform::Sort, LineTransform::RemoveDuplicates,
+                                                             LineTransform::KeepMatching, LineTransform::DropMatching };
+                LineTransform::Spec spec;
+                spec.kind = kinds[command.kind - BatchCommand::Sort];
+                spec.pattern = command.pattern;
+                std::vector<std::string> scratch;
+                LineTransform::Result transformed;
+                LineTransform::run(spec, buffer.flatLines(scratch), threads, transformed);
+                if (!transformed.hunks.empty()) {
+                    buffer.apply(buffer.diffEdits(transformed.lines, transformed.hunks));
+                    result.changed = true;
+                }
+                break;
+            }
+        }
+    }
+    return result;
+}
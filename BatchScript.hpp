@@ -0,0 +1,45 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstddef>
+#include "TextBuffer.hpp"
+
+// One step of a batch script
+struct BatchCommand {
+    enum Kind { Replace, Find, Insert, Delete, Sort, Unique, Keep, Drop };
+    Kind kind = Find;
+    std::string pattern; // Replace, Find, Keep and Drop; never spans lines
+    std::string text;    // Replacement, or the inserted line
+    size_t first = 0;    // Insert and Delete, 1-based; SIZE_MAX is the end
+    size_t last = 0;
+};
+
+struct BatchResult {
+    size_t replaced = 0;
+    size_t found = 0;
+    bool changed = false;
+};
+
+// A list of edits run against each document in turn:
+//
+//   # comment
+//   replace /from/to/   every occurrence; any character can delimit
+//   find /text/         counts occurrences
+//   insert 3 text       a line before line 3, or `$` for after the last
+//   delete 3 [7]        line 3, or lines 3 to 7
+//   sort                every line, in byte order
+//   unique              drops repeats of earlier lines
+//   keep /text/         only the lines containing text
+//   drop /text/         all but the lines containing text
+//
+// Patterns and replacements take \n, \t, \\ and an escaped delimiter.
+class BatchScript {
+public:
+    // Stops at the first bad line and describes it in `error`
+    bool parse(const std::string& script, std::string& error);
+    // `threads` share the whole-document commands (sort, unique, keep, drop)
+    BatchResult run(TextBuffer& buffer, unsigned threads = 1) const;
+
+private:
+    std::vector<BatchCommand> commands;
+};
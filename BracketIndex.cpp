@@ -0,0 +1,370 @@
+#include "BracketIndex.hpp"
+#include "MemoryStats.hpp"
+#include <algorithm>
+
+static int openKind(char c) {
+    switch (c) {
+        case '(': return 0;
+        case '[': return 1;
+        case '{': return 2;
+        default: return -1;
+    }
+}
+
+static int closeKind(char c) {
+    switch (c) {
+        case ')': return 0;
+        case ']': return 1;
+        case '}': return 2;
+        default: return -1;
+    }
+}
+
+// `a` followed by `b`
+static BracketCount combine(const BracketCount& a, const BracketCount& b) {
+    BracketCount result;
+    result.close = a.close + (b.close > a.open ? b.close - a.open : 0);
+    result.open = b.open + (a.open > b.close ? a.open - b.close : 0);
+    return result;
+}
+
+// Steps `need` towards zero over a line, forwards or backwards from `col`
+static bool stepForward(const std::string& text, size_t col, int kind, uint32_t& need, size_t& found) {
+    for (size_t i = col; i < text.length(); i++) {
+        if (openKind(text[i]) == kind) {
+            need++;
+        } else if (closeKind(text[i]) == kind && --need == 0) {
+            found = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool stepBackward(const std::string& text, size_t col, int kind, uint32_t& need, size_t& found) {
+    for (size_t i = std::min(col, text.length()); i-- > 0;) {
+        if (closeKind(text[i]) == kind) {
+            need++;
+        } else if (openKind(text[i]) == kind && --need == 0) {
+            found = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+BracketIndex::BracketIndex(const TextBuffer& buffer) : buffer(buffer) {
+    MemoryStats::Scope scope(MemoryStats::Brackets);
+    root = build(buffer.lineCount());
+    rescan(root, 0);
+}
+
+bool BracketIndex::matchingPair(TextPos pos, TextPos& open, TextPos& close) const {
+    const std::string& text = buffer.line(pos.line).scannable();
+    size_t cols[] = { pos.col, pos.col - 1 };
+    for (size_t i = 0; i < (pos.col > 0 ? 2u : 1u); i++) {
+        size_t col = cols[i];
+        if (col >= text.length()) continue;
+        int kind = openKind(text[col]);
+        if (kind >= 0) {
+            open = { pos.line, col };
+            if (searchForward(kind, { pos.line, col + 1 }, 1, close)) return true;
+            continue;
+        }
+        kind = closeKind(text[col]);
+        if (kind >= 0) {
+            close = { pos.line, col };
+            if (searchBackward(kind, close, 1, open)) return true;
+        }
+    }
+    return false;
+}
+
+bool BracketIndex::enclosingPair(TextPos pos, TextPos& open, TextPos& close) const {
+    // Each kind's nearest unclosed open before `pos`; the latest one is innermost
+    bool found = false;
+    for (int kind = 0; kind < KINDS; kind++) {
+        TextPos kindOpen, kindClose;
+        if (searchBackward(kind, pos, 1, kindOpen) && (!found || open < kindOpen) &&
+            searchForward(kind, pos, 1, kindClose)) {
+            open = kindOpen;
+            close = kindClose;
+            found = true;
+        }
+    }
+    return found;
+}
+
+bool BracketIndex::searchForward(int kind, TextPos from, uint32_t need, TextPos& found) const {
+    size_t col;
+    if (stepForward(buffer.line(from.line).scannable(), from.col, kind, need, col)) {
+        found = { from.line, col };
+        return true;
+    }
+
+    // The rest of this chunk, then straight to the chunk that closes enough
+    size_t start = 0;
+    Index t = chunkAt(from.line, start);
+    size_t line = from.line + 1;
+    size_t end = start + nodes[t].lines;
+    for (;;) {
+        for (; line < end; line++) {
+            if (stepForward(buffer.line(line).scannable(), 0, kind, need, col)) {
+                found = { line, col };
+                return true;
+            }
+        }
+        t = findForward(root, 0, end, kind, need, start);
+        if (t == NIL) return false;
+        line = start;
+        end = start + nodes[t].lines;
+    }
+}
+
+bool BracketIndex::searchBackward(int kind, TextPos from, uint32_t need, TextPos& found) const {
+    size_t col;
+    if (stepBackward(buffer.line(from.line).scannable(), from.col, kind, need, col)) {
+        found = { from.line, col };
+        return true;
+    }
+
+    // The start of this chunk, then straight to the chunk that opens enough
+    size_t start = 0;
+    chunkAt(from.line, start);
+    for (size_t line = from.line; line-- > start;) {
+        if (stepBackward(buffer.line(line).scannable(), std::string::npos, kind, need, col)) {
+            found = { line, col };
+            return true;
+        }
+    }
+    for (;;) {
+        size_t end = start;
+        Index t = findBackward(root, 0, end, kind, need, start);
+        if (t == NIL) return false;
+        for (size_t line = start + nodes[t].lines; line-- > start;) {
+            if (stepBackward(buffer.line(line).scannable(), std::string::npos, kind, need, col)) {
+                found = { line, col };
+                return true;
+            }
+        }
+    }
+}
+
+BracketIndex::Index BracketIndex::findForward(Index t, size_t base, size_t line, int kind,
+                                              uint32_t& need, size_t& start) const {
+    if (t == NIL) return NIL;
+    const Node& n = nodes[t];
+    if (base + n.totalLines <= line) return NIL;
+    if (base >= line && n.total[kind].close < need) {
+        need = need - n.total[kind].close + n.total[kind].open;
+        return NIL;
+    }
+    Index found = findForward(n.left, base, line, kind, need, start);
+    if (found != NIL) return found;
+    size_t nodeStart = base + (n.left == NIL ? 0 : nodes[n.left].totalLines);
+    if (nodeStart >= line) {
+        if (n.own[kind].close >= need) {
+            start = nodeStart;
+            return t;
+        }
+        need = need - n.own[kind].close + n.own[kind].open;
+    }
+    return findForward(n.right, nodeStart + n.lines, line, kind, need, start);
+}
+
+BracketIndex::Index BracketIndex::findBackward(Index t, size_t base, size_t line, int kind,
+                                               uint32_t& need, size_t& start) const {
+    if (t == NIL || base >= line) return NIL;
+    const Node& n = nodes[t];
+    if (base + n.totalLines <= line && n.total[kind].open < need) {
+        need = need - n.total[kind].open + n.total[kind].close;
+        return NIL;
+    }
+    size_t nodeStart = base + (n.left == NIL ? 0 : nodes[n.left].totalLines);
+    Index found = findBackward(n.right, nodeStart + n.lines, line, kind, need, start);
+    if (found != NIL) return found;
+    if (nodeStart + n.lines <= line) {
+        if (n.own[kind].open >= need) {
+            start = nodeStart;
+            return t;
+        }
+        need = need - n.own[kind].open + n.own[kind].close;
+    }
+    return findBackward(n.left, base, line, kind, need, start);
+}
+
+BracketIndex::Index BracketIndex::chunkAt(size_t line, size_t& start) const {
+    size_t base = 0;
+    Index t = root;
+    while (t != NIL) {
+        const Node& n = nodes[t];
+        size_t leftLines = n.left == NIL ? 0 : nodes[n.left].totalLines;
+        if (line < base + leftLines) {
+            t = n.left;
+        } else if (line < base + leftLines + n.lines || n.right == NIL) {
+            start = base + leftLines;
+            return t;
+        } else {
+            base += leftLines + n.lines;
+            t = n.right;
+        }
+    }
+    return NIL;
+}
+
+size_t BracketIndex::memoryUsage() const {
+    return MemoryStats::heapBytes(nodes) + MemoryStats::heapBytes(freeNodes);
+}
+
+void BracketIndex::linesChanged(const std::vector<LineChange>& changes) {
+    MemoryStats::Scope scope(MemoryStats::Brackets);
+    for (const auto& change : changes) {
+        changeLines(change);
+    }
+    // The buffer is final only once the whole batch is in
+    rescan(root, 0);
+}
+
+void BracketIndex::changeLines(const LineChange& change) {
+    // Replace the chunks holding the changed lines with fresh ones
+    size_t start;
+    if (chunkAt(change.first, start) == NIL) return;
+    Index a, rest, m, c;
+    split(root, start, 0, a, rest);
+    split(rest, change.first + change.removed + 1, start, m, c);
+    size_t lines = nodes[m].totalLines - change.removed + change.inserted;
+    release(m);
+
+    // Fold a small chunk into the next so deletes do not leave slivers
+    if (lines < CHUNK_LINES / 2 && c != NIL) {
+        Index next;
+        c = popFirst(c, next);
+        lines += nodes[next].lines;
+        release(next);
+    }
+    root = merge(merge(a, build(lines)), c);
+}
+
+BracketIndex::Index BracketIndex::build(size_t lines) {
+    // Chunks of CHUNK_LINES, letting one grow to twice that before it splits
+    Index t = NIL;
+    while (lines > 2 * CHUNK_LINES) {
+        t = merge(t, create(CHUNK_LINES));
+        lines -= CHUNK_LINES;
+    }
+    return merge(t, create(lines));
+}
+
+void BracketIndex::rescan(Index t, size_t base) {
+    if (t == NIL || !nodes[t].anyDirty) return;
+    Node& n = nodes[t];
+    rescan(n.left, base);
+    size_t start = base + (n.left == NIL ? 0 : nodes[n.left].totalLines);
+    if (n.dirty) {
+        BracketCount counts[KINDS];
+        for (size_t line = start; line < start + n.lines; line++) {
+            for (char c : buffer.line(line).scannable()) {
+                int kind = openKind(c);
+                if (kind >= 0) {
+                    counts[kind].open++;
+                } else if ((kind = closeKind(c)) >= 0) {
+                    if (counts[kind].open > 0) {
+                        counts[kind].open--;
+                    } else {
+                        counts[kind].close++;
+                    }
+                }
+            }
+        }
+        std::copy(counts, counts + KINDS, n.own);
+        n.dirty = false;
+    }
+    rescan(n.right, start + n.lines);
+    update(t);
+}
+
+BracketIndex::Index BracketIndex::create(size_t lines) {
+    Index t;
+    if (!freeNodes.empty()) {
+        t = freeNodes.back();
+        freeNodes.pop_back();
+        nodes[t] = Node();
+    } else {
+        t = static_cast<Index>(nodes.size());
+        nodes.emplace_back();
+    }
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    Node& n = nodes[t];
+    n.lines = lines;
+    n.priority = seed;
+    n.dirty = true;
+    update(t);
+    return t;
+}
+
+void BracketIndex::release(Index t) {
+    if (t == NIL) return;
+    release(nodes[t].left);
+    release(nodes[t].right);
+    freeNodes.push_back(t);
+}
+
+void BracketIndex::update(Index t) {
+    Node& n = nodes[t];
+    const Node* l = n.left == NIL ? nullptr : &nodes[n.left];
+    const Node* r = n.right == NIL ? nullptr : &nodes[n.right];
+    n.totalLines = n.lines + (l ? l->totalLines : 0) + (r ? r->totalLines : 0);
+    n.anyDirty = n.dirty || (l && l->anyDirty) || (r && r->anyDirty);
+    for (int kind = 0; kind < KINDS; kind++) {
+        BracketCount total = n.own[kind];
+        if (l) total = combine(l->total[kind], total);
+        if (r) total = combine(total, r->total[kind]);
+        n.total[kind] = total;
+    }
+}
+
+BracketIndex::Index BracketIndex::merge(Index l, Index r) {
+    if (l == NIL) return r;
+    if (r == NIL) return l;
+    if (nodes[l].priority > nodes[r].priority) {
+        nodes[l].right = merge(nodes[l].right, r);
+        update(l);
+        return l;
+    }
+    nodes[r].left = merge(l, nodes[r].left);
+    update(r);
+    return r;
+}
+
+void BracketIndex::split(Index t, size_t line, size_t base, Index& l, Index& r) {
+    if (t == NIL) {
+        l = r = NIL;
+        return;
+    }
+    Node& n = nodes[t];
+    size_t start = base + (n.left == NIL ? 0 : nodes[n.left].totalLines);
+    if (start < line) {
+        split(n.right, line, start + n.lines, n.right, r);
+        l = t;
+    } else {
+        split(n.left, line, base, l, n.left);
+        r = t;
+    }
+    update(t);
+}
+
+BracketIndex::Index BracketIndex::popFirst(Index t, Index& first) {
+    Node& n = nodes[t];
+    if (n.left == NIL) {
+        first = t;
+        Index rest = n.right;
+        n.right = NIL;
+        update(t);
+        return rest;
+    }
+    n.left = popFirst(n.left, first);
+    update(t);
+    return t;
+}
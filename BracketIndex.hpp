@@ -0,0 +1,75 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "TextBuffer.hpp"
+
+// Unmatched brackets of one kind in a stretch of text: closes that pair
+// with something before it and opens that pair with something after it
+struct BracketCount {
+    uint32_t close = 0;
+    uint32_t open = 0;
+};
+
+// Bracket summaries for (), [] and {} over chunks of lines, held in a
+// treap ordered by position with totals per subtree. Finding the partner
+// of a bracket walks down the totals instead of over the text, so it costs
+// O(log n) plus a scan of the chunks at either end. An edit only reshapes
+// and rescans the chunks it touched. Brackets in strings and comments
+// count like any other.
+class BracketIndex : public TextBufferListener {
+public:
+    explicit BracketIndex(const TextBuffer& buffer);
+
+    // The bracket pair next to `pos`, checking the character after it first
+    bool matchingPair(TextPos pos, TextPos& open, TextPos& close) const;
+    // The innermost pair of any kind around `pos`
+    bool enclosingPair(TextPos pos, TextPos& open, TextPos& close) const;
+    size_t memoryUsage() const;
+
+    void linesChanged(const std::vector<LineChange>& changes) override;
+
+private:
+    static constexpr int KINDS = 3;
+    static constexpr size_t CHUNK_LINES = 64;
+    using Index = uint32_t;
+    static constexpr Index NIL = UINT32_MAX;
+
+    struct Node {
+        size_t lines = 0;      // Lines in this chunk
+        size_t totalLines = 0; // Lines in the subtree
+        BracketCount own[KINDS];
+        BracketCount total[KINDS];
+        uint32_t priority = 0;
+        bool dirty = false;    // Needs rescanning
+        bool anyDirty = false; // Somewhere in the subtree does
+        Index left = NIL;
+        Index right = NIL;
+    };
+
+    // Searches from `from` (exclusive) for the bracket that takes the
+    // count of unmatched ones of `kind` down to zero
+    bool searchForward(int kind, TextPos from, uint32_t need, TextPos& found) const;
+    bool searchBackward(int kind, TextPos from, uint32_t need, TextPos& found) const;
+    // First chunk starting at or after `line` (last one ending at or before
+    // it, for the backward walk) that holds the match
+    Index findForward(Index t, size_t base, size_t line, int kind, uint32_t& need, size_t& start) const;
+    Index findBackward(Index t, size_t base, size_t line, int kind, uint32_t& need, size_t& start) const;
+    Index chunkAt(size_t line, size_t& start) const;
+
+    Index create(size_t lines);
+    void release(Index t);
+    void update(Index t);
+    Index merge(Index l, Index r);
+    Index popFirst(Index t, Index& first);
+    Index build(size_t lines);
+    void split(Index t, size_t line, size_t base, Index& l, Index& r); // `l` gets chunks starting before `line`
+    void changeLines(const LineChange& change);
+    void rescan(Index t, size_t base);
+
+    const TextBuffer& buffer;
+    std::vector<Node> nodes;
+    std::vector<Index> freeNodes;
+    Index root = NIL;
+    uint32_t seed = 2463534242u;
+};
@@ -0,0 +1,240 @@
+#include "CompressedFile.hpp"
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <zlib.h>
+#include <zstd.h>
+
+static constexpr size_t INPUT_SIZE = 256 * 1024;
+
+class PlainReader : public FileReader {
+public:
+    explicit PlainReader(std::ifstream&& file) : file(std::move(file)) {}
+
+    bool read(std::string& out) override {
+        size_t start = out.size();
+        out.resize(start + BLOCK_SIZE);
+        file.read(&out[start], BLOCK_SIZE);
+        out.resize(start + static_cast<size_t>(file.gcount()));
+        if (file.bad()) error = true;
+        return out.size() > start;
+    }
+
+    bool seek(uint64_t offset) override {
+        file.clear();
+        file.seekg(static_cast<std::streamoff>(offset));
+        return !file.fail();
+    }
+
+private:
+    std::ifstream file;
+};
+
+class GzipReader : public FileReader {
+public:
+    explicit GzipReader(std::ifstream&& file) : file(std::move(file)), input(INPUT_SIZE) {
+        format = Compression::Gzip;
+        // 15 + 32 takes gzip and zlib headers alike
+        if (inflateInit2(&stream, 15 + 32) != Z_OK) error = true;
+    }
+    ~GzipReader() override { inflateEnd(&stream); }
+
+    bool read(std::string& out) override {
+        if (error) return false;
+        size_t start = out.size();
+        out.resize(start + BLOCK_SIZE);
+        stream.next_out = reinterpret_cast<Bytef*>(&out[start]);
+        stream.avail_out = static_cast<uInt>(BLOCK_SIZE);
+        while (stream.avail_out > 0) {
+            if (stream.avail_in == 0 && !eof) fill();
+            if (stream.avail_in == 0 && eof && !inMember) break;
+
+            uInt inBefore = stream.avail_in;
+            uInt outBefore = stream.avail_out;
+            int result = inflate(&stream, Z_NO_FLUSH);
+            if (result == Z_STREAM_END) {
+                // Another member may follow, as in files saved in blocks
+                inflateReset(&stream);
+                inMember = false;
+            } else if (result == Z_OK || result == Z_BUF_ERROR) {
+                inMember = true;
+                if (eof && stream.avail_in == inBefore && stream.avail_out == outBefore) {
+                    error = true; // Cut off in the middle of a member
+                    break;
+                }
+            } else {
+                error = true;
+                break;
+            }
+        }
+        out.resize(start + BLOCK_SIZE - stream.avail_out);
+        return out.size() > start;
+    }
+
+private:
+    void fill() {
+        file.read(input.data(), static_cast<std::streamsize>(input.size()));
+        stream.next_in = reinterpret_cast<Bytef*>(input.data());
+        stream.avail_in = static_cast<uInt>(file.gcount());
+        if (stream.avail_in == 0) eof = true;
+    }
+
+    std::ifstream file;
+    std::vector<char> input;
+    z_stream stream = {};
+    bool eof = false;
+    bool inMember = false;
+};
+
+class ZstdReader : public FileReader {
+public:
+    explicit ZstdReader(std::ifstream&& file)
+        : file(std::move(file)), input(ZSTD_DStreamInSize()), context(ZSTD_createDCtx()) {
+        format = Compression::Zstd;
+        if (!context) error = true;
+    }
+    ~ZstdReader() override { ZSTD_freeDCtx(context); }
+
+    bool read(std::string& out) override {
+        if (error) return false;
+        size_t start = out.size();
+        out.resize(start + BLOCK_SIZE);
+        ZSTD_outBuffer output = { &out[start], BLOCK_SIZE, 0 };
+        while (output.pos < output.size) {
+            if (in.pos == in.size && !eof) fill();
+            if (in.pos == in.size && eof && frameDone) break;
+
+            size_t inBefore = in.pos;
+            size_t outBefore = output.pos;
+            size_t result = ZSTD_decompressStream(context, &output, &in);
+            if (ZSTD_isError(result)) {
+                error = true;
+                break;
+            }
+            // 0 once a frame is complete; frames saved in blocks follow on
+            frameDone = result == 0;
+            if (eof && in.pos == inBefore && output.pos == outBefore) {
+                error = !frameDone;
+                break;
+            }
+        }
+        out.resize(start + output.pos);
+        return out.size() > start;
+    }
+
+private:
+    void fill() {
+        file.read(input.data(), static_cast<std::streamsize>(input.size()));
+        in = { input.data(), static_cast<size_t>(file.gcount()), 0 };
+        if (in.size == 0) eof = true;
+    }
+
+    std::ifstream file;
+    std::vector<char> input;
+    ZSTD_DCtx* context;
+    ZSTD_inBuffer in = { nullptr, 0, 0 };
+    bool eof = false;
+    bool frameDone = true;
+};
+
+static bool compressBlock(Compression compression, const std::string& in, std::string& out) {
+    if (compression == Compression::Zstd) {
+        out.resize(ZSTD_compressBound(in.size()));
+        size_t written = ZSTD_compress(&out[0], out.size(), in.data(), in.size(), ZSTD_CLEVEL_DEFAULT);
+        if (ZSTD_isError(written)) return false;
+        out.resize(written);
+        return true;
+    }
+
+    // Each block is a whole gzip member with its own header and checksum
+    z_stream stream = {};
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    out.resize(deflateBound(&stream, static_cast<uLong>(in.size())));
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+    stream.avail_in = static_cast<uInt>(in.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    stream.avail_out = static_cast<uInt>(out.size());
+    int result = deflate(&stream, Z_FINISH);
+    out.resize(out.size() - stream.avail_out);
+    deflateEnd(&stream);
+    return result == Z_STREAM_END;
+}
+
+std::unique_ptr<FileReader> FileReader::open(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) return nullptr;
+
+    unsigned char magic[4] = {};
+    file.read(reinterpret_cast<char*>(magic), sizeof(magic));
+    file.clear();
+    file.seekg(0);
+    if (magic[0] == 0x1f && magic[1] == 0x8b) return std::make_unique<GzipReader>(std::move(file));
+    if (magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd) {
+        return std::make_unique<ZstdReader>(std::move(file));
+    }
+    return std::make_unique<PlainReader>(std::move(file));
+}
+
+FileWriter::FileWriter(const std::string& path, Compression compression)
+    : file(path, std::ios::binary), compression(compression),
+      threads(std::max(1u, std::thread::hardware_concurrency())) {
+}
+
+Compression FileWriter::compressionFor(const std::string& path) {
+    auto endsWith = [&](const char* suffix) {
+        size_t length = strlen(suffix);
+        return path.size() >= length && path.compare(path.size() - length, length, suffix) == 0;
+    };
+    if (endsWith(".gz")) return Compression::Gzip;
+    if (endsWith(".zst")) return Compression::Zstd;
+    return Compression::None;
+}
+
+void FileWriter::write(const char* data, size_t length) {
+    if (compression == Compression::None) {
+        file.write(data, static_cast<std::streamsize>(length));
+        return;
+    }
+    while (length > 0) {
+        if (used == 0 || blocks[used - 1].size() == BLOCK_SIZE) {
+            if (used == threads) flushBlocks();
+            if (used == blocks.size()) {
+                blocks.emplace_back();
+                blocks.back().reserve(BLOCK_SIZE);
+            }
+            used++;
+        }
+        std::string& block = blocks[used - 1];
+        size_t count = std::min(length, BLOCK_SIZE - block.size());
+        block.append(data, count);
+        data += count;
+        length -= count;
+    }
+}
+
+bool FileWriter::finish() {
+    if (used > 0) flushBlocks();
+    file.close();
+    return !error && !file.fail();
+}
+
+void FileWriter::flushBlocks() {
+    // One block stays on this thread, the rest get one each
+    compressed.resize(std::max(compressed.size(), used));
+    std::vector<char> ok(used);
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < used; i++) {
+        workers.emplace_back([this, i, &ok] { ok[i] = compressBlock(compression, blocks[i], compressed[i]); });
+    }
+    ok[0] = compressBlock(compression, blocks[0], compressed[0]);
+    for (auto& worker : workers) worker.join();
+
+    for (size_t i = 0; i < used; i++) {
+        if (!ok[i]) error = true;
+        file.write(compressed[i].data(), static_cast<std::streamsize>(compressed[i].size()));
+        blocks[i].clear();
+    }
+    used = 0;
+}
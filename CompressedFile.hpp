@@ -0,0 +1,66 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// How a file's bytes are stored. Opening goes by the first bytes, so a
+// misnamed file still reads; saving goes by the name.
+enum class Compression { None, Gzip, Zstd };
+
+// The decompressed bytes of a file, a block at a time
+class FileReader {
+public:
+    // Null if the file cannot be opened
+    static std::unique_ptr<FileReader> open(const std::string& path);
+    virtual ~FileReader() = default;
+
+    // Appends the next block to `out`; false at the end of the file or at
+    // damaged data, which failed() tells apart
+    virtual bool read(std::string& out) = 0;
+    // Moves to a byte offset in the file; only uncompressed files can
+    virtual bool seek(uint64_t) { return false; }
+    bool failed() const { return error; }
+    Compression compression() const { return format; }
+
+protected:
+    static constexpr size_t BLOCK_SIZE = 1024 * 1024;
+    Compression format = Compression::None;
+    bool error = false;
+};
+
+// Writes a file as plain text, gzip or zstd. Compressed output is cut into
+// blocks that are compressed on several threads at once and written as
+// back-to-back gzip members or zstd frames, which the usual tools and
+// FileReader read as one stream.
+class FileWriter {
+public:
+    FileWriter(const std::string& path, Compression compression);
+    FileWriter(const FileWriter&) = delete;
+    FileWriter& operator=(const FileWriter&) = delete;
+
+    // .gz and .zst are compressed, anything else is not
+    static Compression compressionFor(const std::string& path);
+
+    bool isOpen() const { return file.is_open(); }
+    void write(const char* data, size_t length);
+    // Writes out what is still held back; false if anything failed
+    bool finish();
+
+private:
+    static constexpr size_t BLOCK_SIZE = 4 * 1024 * 1024;
+
+    void flushBlocks();
+
+    std::ofstream file;
+    Compression compression;
+    unsigned threads;
+    // Filled one after another, then compressed together; kept allocated
+    // from one round to the next
+    std::vector<std::string> blocks;
+    std::vector<std::string> compressed;
+    size_t used = 0;
+    bool error = false;
+};
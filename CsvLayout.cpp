@@ -0,0 +1,140 @@
+#include "CsvLayout.hpp"
+#include "MemoryStats.hpp"
+#include <algorithm>
+#include <cctype>
+
+char CsvLayout::delimiterFor(const std::string& filename) {
+    size_t dot = filename.find_last_of('.');
+    if (dot == std::string::npos) return 0;
+    std::string extension = filename.substr(dot + 1);
+    for (auto& c : extension) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    if (extension == "csv") return ',';
+    if (extension == "tsv" || extension == "tab") return '\t';
+    return 0;
+}
+
+char CsvLayout::detectDelimiter(const std::string& line) {
+    static const char candidates[] = { ',', '\t', ';', '|' };
+    char best = 0;
+    size_t bestCount = 0;
+    for (char candidate : candidates) {
+        size_t count = std::count(line.begin(), line.end(), candidate);
+        if (count > bestCount) {
+            best = candidate;
+            bestCount = count;
+        }
+    }
+    return best;
+}
+
+std::vector<size_t> CsvLayout::fieldStarts(const std::string& line, char delimiter) {
+    std::vector<size_t> starts = { 0 };
+    bool quoted = false;
+    for (size_t i = 0; i < line.length(); i++) {
+        if (line[i] == '"') {
+            quoted = !quoted;
+        } else if (line[i] == delimiter && !quoted) {
+            starts.push_back(i + 1);
+        }
+    }
+    return starts;
+}
+
+void CsvLayout::enable(char delimiter, const TextBuffer& buffer, const GlyphTable& glyphs) {
+    MemoryStats::Scope scope(MemoryStats::Columns);
+    columns.delimiter = delimiter;
+    widths.clear();
+    size_t count = buffer.lineCount();
+    size_t step = std::max<size_t>(1, count / SAMPLE_LINES);
+    for (size_t i = 0; i < count; i += step) {
+        const TextLine& line = buffer.line(i);
+        if (!line.chunked()) measure(line.scannable(), glyphs);
+    }
+    updateStops(glyphs);
+    rescan(buffer);
+}
+
+void CsvLayout::disable() {
+    columns = ColumnStops();
+    widths.clear();
+    scanned = scanEnd = 0;
+}
+
+void CsvLayout::rescan(const TextBuffer& buffer) {
+    scanned = 0;
+    scanEnd = buffer.lineCount();
+}
+
+long long CsvLayout::width() const {
+    if (columns.starts.empty()) return 0;
+    return columns.starts.back() + widths.back();
+}
+
+size_t CsvLayout::memoryUsage() const {
+    return MemoryStats::heapBytes(widths) + MemoryStats::heapBytes(columns.starts);
+}
+
+bool CsvLayout::include(const TextLine& line, const GlyphTable& glyphs) {
+    MemoryStats::Scope scope(MemoryStats::Columns);
+    if (!enabled() || line.chunked() || !measure(line.scannable(), glyphs)) return false;
+    updateStops(glyphs);
+    return true;
+}
+
+void CsvLayout::refine(const TextBuffer& buffer, const GlyphTable& glyphs, std::chrono::milliseconds budget) {
+    MemoryStats::Scope scope(MemoryStats::Columns);
+    auto deadline = std::chrono::steady_clock::now() + budget;
+    scanEnd = std::min(scanEnd, buffer.lineCount());
+    bool grew = false;
+    while (scanned < scanEnd) {
+        size_t end = std::min(scanEnd, scanned + SCAN_STEP);
+        for (; scanned < end; scanned++) {
+            const TextLine& line = buffer.line(scanned);
+            if (!line.chunked()) grew |= measure(line.scannable(), glyphs);
+        }
+        if (std::chrono::steady_clock::now() >= deadline) break;
+    }
+    if (grew) updateStops(glyphs);
+}
+
+bool CsvLayout::measure(const std::string& line, const GlyphTable& glyphs) {
+    int32_t limit = MAX_COLUMN_CHARS * glyphs.average;
+    bool grew = false;
+    size_t field = 0;
+    int32_t width = 0;
+    bool quoted = false;
+    auto finish = [&] {
+        if (field >= MAX_COLUMNS) return;
+        if (field >= widths.size()) widths.resize(field + 1, 0);
+        width = std::min(width, limit);
+        if (width > widths[field]) {
+            widths[field] = width;
+            grew = true;
+        }
+    };
+    for (char c : line) {
+        if (c == '"') {
+            quoted = !quoted;
+        } else if (c == columns.delimiter && !quoted) {
+            finish();
+            field++;
+            width = 0;
+            continue;
+        }
+        width = glyphs.next(width, static_cast<unsigned char>(c));
+    }
+    finish();
+    return grew;
+}
+
+void CsvLayout::updateStops(const GlyphTable& glyphs) {
+    // Room for the delimiter itself, which for a tab is up to a tab stop
+    unsigned char delimiter = static_cast<unsigned char>(columns.delimiter);
+    int32_t gap = (delimiter == '\t' ? glyphs.tabWidth : glyphs.advance[delimiter]) + GAP_CHARS * glyphs.average;
+    columns.starts.resize(widths.size());
+    int32_t x = 0;
+    for (size_t i = 0; i < widths.size(); i++) {
+        columns.starts[i] = x;
+        x += widths[i] + gap;
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "LayoutCache.hpp"
+
+// Column stops for delimited text such as CSV and TSV, found without
+// reading every line first. A sample spread over the file gives widths at
+// once, rows are measured as they come on screen, and a scan of the rest
+// refines them a slice at a time. Widths only grow, so columns never jump
+// back under the reader.
+class CsvLayout {
+public:
+    // Comma for .csv, tab for .tsv and .tab, otherwise 0
+    static char delimiterFor(const std::string& filename);
+    // Whichever of , tab ; | the line has most of, or 0 for none
+    static char detectDelimiter(const std::string& line);
+    // Column each field of a line starts at, quoted delimiters skipped
+    static std::vector<size_t> fieldStarts(const std::string& line, char delimiter);
+
+    // Starts over with widths from a sample of the buffer's lines
+    void enable(char delimiter, const TextBuffer& buffer, const GlyphTable& glyphs);
+    void disable();
+    bool enabled() const { return columns.delimiter != 0; }
+    char delimiter() const { return columns.delimiter; }
+    const ColumnStops& stops() const { return columns; }
+    // Right edge of the last column
+    long long width() const;
+    size_t memoryUsage() const;
+
+    // Widens columns to fit a line; true if any grew
+    bool include(const TextLine& line, const GlyphTable& glyphs);
+    // Scans on from where the last slice stopped for up to `budget`
+    void refine(const TextBuffer& buffer, const GlyphTable& glyphs, std::chrono::milliseconds budget);
+    bool scanning() const { return enabled() && scanned < scanEnd; }
+    // Scans every line again, as when more of the file has been read
+    void rescan(const TextBuffer& buffer);
+
+private:
+    bool measure(const std::string& line, const GlyphTable& glyphs);
+    void updateStops(const GlyphTable& glyphs);
+
+    ColumnStops columns;
+    std::vector<int32_t> widths;
+    size_t scanned = 0;
+    size_t scanEnd = 0;
+
+    // Lines measured up front, spread evenly over the file
+    static constexpr size_t SAMPLE_LINES = 1000;
+    // Lines between looks at the clock while scanning
+    static constexpr size_t SCAN_STEP = 256;
+    // A longer field overflows into the next column rather than widen it
+    static constexpr int MAX_COLUMN_CHARS = 60;
+    static constexpr size_t MAX_COLUMNS = 1024;
+    // Space between the widest field of a column and the next one
+    static constexpr int GAP_CHARS = 2;
+};
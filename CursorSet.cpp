@@ -0,0 +1,144 @@
+#include "CursorSet.hpp"
+
+CursorSet::CursorSet() : selections(1) {
+}
+
+void CursorSet::set(const Selection& selection) {
+    selections.assign(1, selection);
+    primaryIndex = 0;
+}
+
+void CursorSet::set(std::vector<Selection> newSelections, size_t primary) {
+    if (newSelections.empty()) newSelections.emplace_back();
+    selections = std::move(newSelections);
+    primaryIndex = std::min(primary, selections.size() - 1);
+    normalize();
+}
+
+void CursorSet::add(const Selection& selection) {
+    selections.push_back(selection);
+    primaryIndex = selections.size() - 1;
+    normalize();
+}
+
+void CursorSet::keepPrimary() {
+    set(primary());
+}
+
+void CursorSet::collapse() {
+    for (auto& selection : selections) selection.anchor = selection.caret;
+    normalize();
+}
+
+void CursorSet::selectionsInLines(size_t first, size_t last, size_t& begin, size_t& end) const {
+    // Selections never overlap, so their ends are sorted as well
+    begin = std::lower_bound(selections.begin(), selections.end(), first,
+                             [](const Selection& s, size_t line) { return s.end().line < line; }) -
+            selections.begin();
+    end = std::lower_bound(selections.begin() + begin, selections.end(), last,
+                           [](const Selection& s, size_t line) { return s.start().line < line; }) -
+          selections.begin();
+}
+
+std::vector<TextEdit> CursorSet::replaceSelections(TextBuffer& buffer, const std::string& text) {
+    std::vector<TextEdit> edits;
+    edits.reserve(selections.size());
+    for (const auto& selection : selections) {
+        edits.push_back({ selection.start(), selection.end(), text });
+    }
+    return applyEdits(buffer, edits);
+}
+
+std::vector<TextEdit> CursorSet::replaceSelections(TextBuffer& buffer, const std::vector<std::string>& texts) {
+    std::vector<TextEdit> edits;
+    edits.reserve(selections.size());
+    for (size_t i = 0; i < selections.size(); i++) {
+        edits.push_back({ selections[i].start(), selections[i].end(), i < texts.size() ? texts[i] : std::string() });
+    }
+    return applyEdits(buffer, edits);
+}
+
+std::vector<TextEdit> CursorSet::deleteBackward(TextBuffer& buffer) {
+    std::vector<TextEdit> edits;
+    edits.reserve(selections.size());
+    for (const auto& selection : selections) {
+        TextPos from = selection.start();
+        if (selection.empty()) {
+            if (from.col > 0) {
+                from.col--;
+            } else if (from.line > 0) {
+                from.line--;
+                from.col = buffer.line(from.line).length();
+            }
+        }
+        edits.push_back({ from, selection.end(), std::string() });
+    }
+    return applyEdits(buffer, edits);
+}
+
+std::vector<TextEdit> CursorSet::deleteForward(TextBuffer& buffer) {
+    std::vector<TextEdit> edits;
+    edits.reserve(selections.size());
+    for (const auto& selection : selections) {
+        TextPos to = selection.end();
+        if (selection.empty()) {
+            if (to.col < buffer.line(to.line).length()) {
+                to.col++;
+            } else if (to.line + 1 < buffer.lineCount()) {
+                to.line++;
+                to.col = 0;
+            }
+        }
+        edits.push_back({ selection.start(), to, std::string() });
+    }
+    return applyEdits(buffer, edits);
+}
+
+std::vector<TextEdit> CursorSet::applyEdits(TextBuffer& buffer, const std::vector<TextEdit>& edits) {
+    bool changes = std::any_of(edits.begin(), edits.end(), [](const TextEdit& edit) {
+        return edit.from != edit.to || !edit.text.empty();
+    });
+    std::vector<TextEdit> undo;
+    if (!changes) return undo;
+
+    // Edits follow the selection order, so the returned ends line up with
+    // the selections and no other offset fix-up is needed
+    std::vector<TextPos> ends = buffer.apply(edits, &undo);
+    for (size_t i = 0; i < selections.size(); i++) {
+        selections[i] = { ends[i], ends[i] };
+    }
+    normalize();
+    return undo;
+}
+
+void CursorSet::normalize() {
+    Selection primarySelection = selections[primaryIndex];
+    auto byStart = [](const Selection& a, const Selection& b) { return a.start() < b.start(); };
+    if (!std::is_sorted(selections.begin(), selections.end(), byStart)) {
+        std::sort(selections.begin(), selections.end(), byStart);
+    }
+
+    // Merge selections that overlap, or carets that sit on another selection's edge
+    size_t kept = 0;
+    for (size_t i = 1; i < selections.size(); i++) {
+        Selection& last = selections[kept];
+        const Selection& next = selections[i];
+        bool touching = next.start() == last.end() && (last.empty() || next.empty());
+        if (next.start() < last.end() || touching) {
+            TextPos end = std::max(last.end(), next.end());
+            if (last.caret < last.anchor) {
+                last.anchor = end;
+            } else {
+                last.caret = end;
+            }
+        } else {
+            selections[++kept] = next;
+        }
+    }
+    selections.resize(kept + 1);
+
+    // The primary is whichever selection now holds its caret
+    auto it = std::lower_bound(selections.begin(), selections.end(), primarySelection.caret,
+                               [](const Selection& s, const TextPos& pos) { return s.end() < pos; });
+    primaryIndex = it == selections.end() ? selections.size() - 1 : it - selections.begin();
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <algorithm>
+#include "TextBuffer.hpp"
+
+// A caret plus the other end of its selection; empty when they are equal
+struct Selection {
+    TextPos anchor;
+    TextPos caret;
+
+    TextPos start() const { return std::min(anchor, caret); }
+    TextPos end() const { return std::max(anchor, caret); }
+    bool empty() const { return anchor == caret; }
+};
+
+// Every caret in the editor, kept sorted by position with overlapping
+// selections merged. Edits build one batch for all carets so the buffer is
+// walked once and carets are fixed up from the batch result in order.
+class CursorSet {
+public:
+    CursorSet();
+
+    const std::vector<Selection>& all() const { return selections; }
+    size_t count() const { return selections.size(); }
+    const Selection& primary() const { return selections[primaryIndex]; }
+    size_t primaryPosition() const { return primaryIndex; }
+
+    void set(const Selection& selection);
+    void set(std::vector<Selection> newSelections, size_t primary);
+    void add(const Selection& selection); // Becomes the primary
+    void keepPrimary();
+    void collapse();
+
+    // Moves every caret; without `extend` the selections collapse onto them
+    template <typename Move>
+    void moveCarets(Move move, bool extend) {
+        for (auto& selection : selections) {
+            selection.caret = move(selection.caret);
+            if (!extend) selection.anchor = selection.caret;
+        }
+        normalize();
+    }
+
+    // Index range of the selections touching lines [first, last)
+    void selectionsInLines(size_t first, size_t last, size_t& begin, size_t& end) const;
+
+    // Batched edits; each returns the edits that undo it
+    std::vector<TextEdit> replaceSelections(TextBuffer& buffer, const std::string& text);
+    std::vector<TextEdit> replaceSelections(TextBuffer& buffer, const std::vector<std::string>& texts);
+    std::vector<TextEdit> deleteBackward(TextBuffer& buffer);
+    std::vector<TextEdit> deleteForward(TextBuffer& buffer);
+
+private:
+    // Applies one edit per selection and leaves each caret after its text
+    std::vector<TextEdit> applyEdits(TextBuffer& buffer, const std::vector<TextEdit>& edits);
+    void normalize();
+
+    std::vector<Selection> selections;
+    size_t primaryIndex = 0;
+};
@@ -0,0 +1,351 @@
+#include "DiffView.hpp"
+#include "Settings.hpp"
+#include "TextFile.hpp"
+#include <algorithm>
+#include <climits>
+#include <filesystem>
+
+// The columns [first, first + count) of a line, tabs expanded to spaces
+static std::string visibleText(const std::string& line, size_t first, size_t count, size_t tabSize) {
+    std::string text;
+    size_t col = 0;
+    for (char c : line) {
+        if (col >= first + count) break;
+        size_t width = c == '\t' ? tabSize - col % tabSize : 1;
+        for (size_t i = 0; i < width; i++, col++) {
+            if (col >= first && col < first + count) text += c == '\t' ? ' ' : c;
+        }
+    }
+    return text;
+}
+
+// Where a scroll bar message asks to go
+static long long scrollTarget(HWND hwnd, int bar, WPARAM wParam, long long pos, long long page) {
+    switch (LOWORD(wParam)) {
+        case SB_LINEUP: return pos - 1;
+        case SB_LINEDOWN: return pos + 1;
+        case SB_PAGEUP: return pos - page;
+        case SB_PAGEDOWN: return pos + page;
+        case SB_TOP: return 0;
+        case SB_BOTTOM: return LLONG_MAX / 2;
+        case SB_THUMBTRACK:
+        case SB_THUMBPOSITION: {
+            SCROLLINFO si = { sizeof(SCROLLINFO) };
+            si.fMask = SIF_TRACKPOS;
+            GetScrollInfo(hwnd, bar, &si);
+            return si.nTrackPos;
+        }
+    }
+    return pos;
+}
+
+void DiffView::Open(HWND owner, const std::string& path, std::vector<std::string>&& document) {
+    HINSTANCE hInstance = GetModuleHandle(NULL);
+    WNDCLASSEXW wc = {};
+    wc.cbSize = sizeof(WNDCLASSEXW);
+    wc.lpfnWndProc = WindowProc;
+    wc.hInstance = hInstance;
+    wc.lpszClassName = CLASS_NAME;
+    wc.hCursor = LoadCursor(nullptr, IDC_ARROW);
+    wc.style = CS_HREDRAW | CS_VREDRAW;
+    // Fails harmlessly once the class is registered
+    RegisterClassExW(&wc);
+
+    HWND hwnd = CreateWindowExW(0, CLASS_NAME, L"Compare", WS_OVERLAPPEDWINDOW | WS_VSCROLL | WS_HSCROLL,
+                                CW_USEDEFAULT, CW_USEDEFAULT, 1280, 768, owner, nullptr, hInstance, nullptr);
+    if (hwnd == nullptr) return;
+    DiffView* view = new DiffView(hwnd, path, std::move(document));
+    SetWindowLongPtr(hwnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(view));
+    ShowWindow(hwnd, SW_SHOW);
+}
+
+DiffView::DiffView(HWND hwnd, const std::string& path, std::vector<std::string>&& document)
+    : hwnd(hwnd), path(path), right(std::move(document)) {
+    // The document shows on its own until the diff lines the file up with it
+    blocks.push_back({ 0, 0, 0, 0, right.size(), false });
+    for (const auto& line : right) longestLine = std::max(longestLine, line.length());
+
+    RECT rect;
+    GetClientRect(hwnd, &rect);
+    clientWidth = rect.right - rect.left;
+    clientHeight = rect.bottom - rect.top;
+    LoadFont();
+    std::wstring title = L"Compare: " + std::filesystem::path(path).wstring() + L" - reading...";
+    SetWindowTextW(hwnd, title.c_str());
+
+    worker = std::thread(&DiffView::Compare, this);
+}
+
+DiffView::~DiffView() {
+    cancelled = true;
+    if (worker.joinable()) worker.join();
+}
+
+LRESULT CALLBACK DiffView::WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    DiffView* view = reinterpret_cast<DiffView*>(GetWindowLongPtr(hwnd, GWLP_USERDATA));
+
+    if (view) {
+        return view->HandleMessage(uMsg, wParam, lParam);
+    }
+
+    return DefWindowProc(hwnd, uMsg, wParam, lParam);
+}
+
+LRESULT DiffView::HandleMessage(UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    switch (uMsg) {
+        case WM_NCDESTROY:
+            SetWindowLongPtr(hwnd, GWLP_USERDATA, 0);
+            delete this;
+            return 0;
+
+        case WM_PAINT: {
+            PAINTSTRUCT ps;
+            HDC hdc = BeginPaint(hwnd, &ps);
+            Paint(hdc);
+            EndPaint(hwnd, &ps);
+            return 0;
+        }
+
+        case WM_ERASEBKGND:
+            // Painting covers the whole client area
+            return 1;
+
+        case WM_DIFF_READY:
+            TakeDiff();
+            return 0;
+
+        case WM_SIZE:
+            clientWidth = LOWORD(lParam);
+            clientHeight = HIWORD(lParam);
+            ScrollTo(topRow, leftCol);
+            UpdateScrollBars();
+            return 0;
+
+        case WM_KEYDOWN:
+            HandleKeyDown(wParam);
+            return 0;
+
+        case WM_MOUSEWHEEL:
+            ScrollTo(static_cast<long long>(topRow) - GET_WHEEL_DELTA_WPARAM(wParam) / WHEEL_DELTA * WHEEL_ROWS,
+                     leftCol);
+            return 0;
+
+        case WM_VSCROLL:
+            ScrollTo(scrollTarget(hwnd, SB_VERT, wParam, topRow, PageRows()), leftCol);
+            return 0;
+
+        case WM_HSCROLL:
+            ScrollTo(topRow, scrollTarget(hwnd, SB_HORZ, wParam, leftCol, SCROLL_COLS * 8));
+            return 0;
+    }
+
+    return DefWindowProc(hwnd, uMsg, wParam, lParam);
+}
+
+void DiffView::Compare() {
+    // On the worker thread; `right` is only read from here on
+    if (TextFile::readLines(path, fileLines)) {
+        if (cancelled) return;
+        hunks = LineDiff::compute(fileLines, right, &cancelled);
+        if (cancelled) return;
+    } else {
+        readFailed = true;
+    }
+    ready = true;
+    PostMessage(hwnd, WM_DIFF_READY, 0, 0);
+}
+
+void DiffView::TakeDiff() {
+    if (!ready) return;
+    worker.join();
+    std::wstring title = L"Compare: " + std::filesystem::path(path).wstring();
+    if (readFailed) {
+        title += L" - cannot be read";
+        SetWindowTextW(hwnd, title.c_str());
+        return;
+    }
+    SetWindowTextW(hwnd, title.c_str());
+    left = std::move(fileLines);
+    for (const auto& line : left) longestLine = std::max(longestLine, line.length());
+
+    // Unchanged lines between hunks one to a row, and each hunk as many
+    // rows as its longer side
+    blocks.clear();
+    size_t row = 0, leftLine = 0, rightLine = 0;
+    auto add = [&](size_t leftCount, size_t rightCount, bool changed) {
+        if (leftCount == 0 && rightCount == 0) return;
+        blocks.push_back({ row, leftLine, rightLine, leftCount, rightCount, changed });
+        row += std::max(leftCount, rightCount);
+        leftLine += leftCount;
+        rightLine += rightCount;
+    };
+    for (const auto& hunk : hunks) {
+        add(hunk.oldStart - leftLine, hunk.newStart - rightLine, false);
+        add(hunk.oldCount, hunk.newCount, true);
+    }
+    add(left.size() - leftLine, right.size() - rightLine, false);
+
+    // Keep the document line that was at the top there
+    auto it = std::upper_bound(blocks.begin(), blocks.end(), topRow,
+                               [](size_t line, const Block& block) { return line < block.right; });
+    if (it != blocks.begin()) {
+        const Block& block = *(it - 1);
+        topRow = block.row + std::min(topRow - block.right, block.rightCount);
+    }
+    ScrollTo(topRow, leftCol);
+    UpdateScrollBars();
+    InvalidateRect(hwnd, NULL, FALSE);
+}
+
+void DiffView::LoadFont() {
+    Settings& settings = Settings::getInstance();
+
+    HDC hdc = GetDC(hwnd);
+    LOGFONTW lf = { 0 };
+    lf.lfHeight = -MulDiv(settings.fontSize, GetDeviceCaps(hdc, LOGPIXELSY), 72);
+    lf.lfWeight = settings.fontBold ? FW_BOLD : FW_NORMAL;
+    wcscpy_s(lf.lfFaceName, settings.fontName.c_str());
+    hFont = gdi.font(lf);
+
+    HFONT hOldFont = (HFONT)SelectObject(hdc, hFont);
+    TEXTMETRICW tm;
+    GetTextMetricsW(hdc, &tm);
+    charWidth = std::max<int>(tm.tmAveCharWidth, 1);
+    charHeight = std::max<int>(tm.tmHeight + tm.tmExternalLeading, 1);
+    SelectObject(hdc, hOldFont);
+    ReleaseDC(hwnd, hdc);
+}
+
+size_t DiffView::RowCount() const {
+    if (blocks.empty()) return 0;
+    return blocks.back().row + std::max(blocks.back().leftCount, blocks.back().rightCount);
+}
+
+const DiffView::Block& DiffView::BlockAt(size_t row) const {
+    auto it = std::upper_bound(blocks.begin(), blocks.end(), row,
+                               [](size_t r, const Block& block) { return r < block.row; });
+    return *(it - 1);
+}
+
+int DiffView::PageRows() const {
+    return std::max(clientHeight / charHeight, 1);
+}
+
+void DiffView::Paint(HDC hdc) {
+    const Theme& theme = Settings::getInstance().currentTheme;
+    HDC memDC = gdi.backBuffer(hwnd, clientWidth, clientHeight);
+    RECT rect = { 0, 0, clientWidth, clientHeight };
+    FillRect(memDC, &rect, gdi.brush(theme.background));
+    HFONT hOldFont = (HFONT)SelectObject(memDC, hFont);
+    SetBkMode(memDC, TRANSPARENT);
+
+    // Lines present on one side only are added or removed; the other side
+    // shows a gap
+    int half = clientWidth / 2;
+    size_t rows = RowCount();
+    for (size_t row = topRow; row < rows && (row - topRow) * charHeight < static_cast<size_t>(clientHeight); row++) {
+        int y = static_cast<int>(row - topRow) * charHeight;
+        const Block& block = BlockAt(row);
+        size_t within = row - block.row;
+        bool hasLeft = within < block.leftCount;
+        bool hasRight = within < block.rightCount;
+        COLORREF leftFill = theme.background, rightFill = theme.background;
+        if (block.changed) {
+            leftFill = !hasLeft ? theme.statusBar : hasRight ? theme.changed : theme.removed;
+            rightFill = !hasRight ? theme.statusBar : hasLeft ? theme.changed : theme.added;
+        }
+        PaintCell(memDC, 0, half - 1, y, left, block.left + within, hasLeft, leftFill);
+        PaintCell(memDC, half + 1, clientWidth - half - 1, y, right, block.right + within, hasRight, rightFill);
+    }
+
+    RECT divider = { half - 1, 0, half + 1, clientHeight };
+    FillRect(memDC, &divider, gdi.brush(theme.lineNumber));
+    SelectObject(memDC, hOldFont);
+    BitBlt(hdc, 0, 0, clientWidth, clientHeight, memDC, 0, 0, SRCCOPY);
+}
+
+void DiffView::PaintCell(HDC memDC, int x, int width, int y, const std::vector<std::string>& lines, size_t line,
+                         bool present, COLORREF fill) {
+    const Theme& theme = Settings::getInstance().currentTheme;
+    RECT cell = { x, y, x + width, y + charHeight };
+    if (fill != theme.background) FillRect(memDC, &cell, gdi.brush(fill));
+    if (!present) return;
+
+    // Line number, right-aligned in a gutter wide enough for either side
+    size_t digits = std::to_string(std::max(left.size(), right.size())).length();
+    int gutter = static_cast<int>(digits + 1) * charWidth;
+    std::string number = std::to_string(line + 1);
+    SetTextColor(memDC, theme.lineNumber);
+    ExtTextOutA(memDC, x + gutter - charWidth / 2 - static_cast<int>(number.length()) * charWidth, y, ETO_CLIPPED,
+                &cell, number.data(), static_cast<UINT>(number.length()), NULL);
+
+    RECT textRect = { x + gutter, y, x + width, y + charHeight };
+    size_t columns = static_cast<size_t>(std::max(width - gutter, 0) / charWidth + 1);
+    size_t tabSize = static_cast<size_t>(std::max(Settings::getInstance().tabSize, 1));
+    std::string text = visibleText(lines[line], leftCol, columns, tabSize);
+    SetTextColor(memDC, theme.text);
+    ExtTextOutA(memDC, x + gutter, y, ETO_CLIPPED, &textRect, text.data(), static_cast<UINT>(text.length()), NULL);
+}
+
+void DiffView::HandleKeyDown(WPARAM wParam) {
+    bool ctrl = (GetKeyState(VK_CONTROL) & 0x8000) != 0;
+    long long row = static_cast<long long>(topRow);
+    long long col = static_cast<long long>(leftCol);
+    switch (wParam) {
+        case VK_UP: ScrollTo(row - 1, col); break;
+        case VK_DOWN: ScrollTo(row + 1, col); break;
+        case VK_PRIOR: ScrollTo(row - PageRows(), col); break;
+        case VK_NEXT: ScrollTo(row + PageRows(), col); break;
+        case VK_LEFT: ScrollTo(row, col - SCROLL_COLS); break;
+        case VK_RIGHT: ScrollTo(row, col + SCROLL_COLS); break;
+        case VK_HOME: ScrollTo(ctrl ? 0 : row, 0); break;
+        case VK_END: ScrollTo(ctrl ? LLONG_MAX / 2 : row, col); break;
+        case VK_F7: JumpToChange((GetKeyState(VK_SHIFT) & 0x8000) == 0); break;
+        case VK_ESCAPE: DestroyWindow(hwnd); break;
+    }
+}
+
+void DiffView::JumpToChange(bool forward) {
+    // Measured from just below the context left above the current change
+    size_t from = topRow + CONTEXT_ROWS;
+    const Block* target = nullptr;
+    for (const auto& block : blocks) {
+        if (!block.changed) continue;
+        if (forward && block.row > from) {
+            target = &block;
+            break;
+        }
+        if (!forward && block.row < from) target = &block;
+    }
+    if (!target) {
+        MessageBeep(MB_OK);
+        return;
+    }
+    ScrollTo(target->row > CONTEXT_ROWS ? target->row - CONTEXT_ROWS : 0, leftCol);
+}
+
+void DiffView::ScrollTo(long long row, long long col) {
+    long long maxRow = std::max<long long>(static_cast<long long>(RowCount()) - PageRows(), 0);
+    row = std::max(0LL, std::min(row, maxRow));
+    col = std::max(0LL, std::min(col, static_cast<long long>(longestLine)));
+    if (static_cast<size_t>(row) == topRow && static_cast<size_t>(col) == leftCol) return;
+    topRow = static_cast<size_t>(row);
+    leftCol = static_cast<size_t>(col);
+    UpdateScrollBars();
+    InvalidateRect(hwnd, NULL, FALSE);
+}
+
+void DiffView::UpdateScrollBars() {
+    SCROLLINFO si = { sizeof(SCROLLINFO) };
+    si.fMask = SIF_RANGE | SIF_PAGE | SIF_POS;
+    si.nMin = 0;
+    si.nMax = static_cast<int>(std::min<size_t>(RowCount(), INT_MAX));
+    si.nPage = PageRows();
+    si.nPos = static_cast<int>(topRow);
+    SetScrollInfo(hwnd, SB_VERT, &si, TRUE);
+
+    si.nMax = static_cast<int>(std::min<size_t>(longestLine, INT_MAX));
+    si.nPage = std::max(clientWidth / 2 / charWidth, 1);
+    si.nPos = static_cast<int>(leftCol);
+    SetScrollInfo(hwnd, SB_HORZ, &si, TRUE);
+}
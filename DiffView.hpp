@@ -0,0 +1,83 @@
+#pragma once
+#include <windows.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "GdiCache.hpp"
+#include "LineDiff.hpp"
+
+// Posted to a diff window once its worker has read the other file and
+// diffed it
+constexpr UINT WM_DIFF_READY = WM_APP + 4;
+
+// A file and a copy of the document side by side in a window of their
+// own, the file on the left, scrolled together with changed lines lined up
+// and coloured. The file is read and diffed on a worker thread, so the
+// document shows at once and lines up with the file when the diff is in.
+class DiffView {
+public:
+    // The window deletes itself when closed
+    static void Open(HWND owner, const std::string& path, std::vector<std::string>&& document);
+    static LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
+
+private:
+    // A run of rows: unchanged lines side by side, or a hunk with the
+    // shorter side padded out
+    struct Block {
+        size_t row = 0;
+        size_t left = 0;
+        size_t right = 0;
+        size_t leftCount = 0;
+        size_t rightCount = 0;
+        bool changed = false;
+    };
+
+    DiffView(HWND hwnd, const std::string& path, std::vector<std::string>&& document);
+    ~DiffView();
+    LRESULT HandleMessage(UINT uMsg, WPARAM wParam, LPARAM lParam);
+    void Compare();
+    void TakeDiff();
+    void LoadFont();
+    void Paint(HDC hdc);
+    void PaintCell(HDC memDC, int x, int width, int y, const std::vector<std::string>& lines, size_t line,
+                   bool present, COLORREF fill);
+    void HandleKeyDown(WPARAM wParam);
+    void ScrollTo(long long row, long long col);
+    void JumpToChange(bool forward);
+    void UpdateScrollBars();
+    size_t RowCount() const;
+    const Block& BlockAt(size_t row) const;
+    int PageRows() const;
+
+    HWND hwnd;
+    std::string path;
+    std::vector<std::string> left;
+    std::vector<std::string> right;
+    std::vector<Block> blocks;
+    size_t longestLine = 0;
+
+    // Filled in by the worker before it sets `ready`
+    std::thread worker;
+    std::atomic<bool> ready{ false };
+    // Set when the window goes before the worker is done
+    std::atomic<bool> cancelled{ false };
+    bool readFailed = false;
+    std::vector<std::string> fileLines;
+    std::vector<DiffHunk> hunks;
+
+    GdiCache gdi;
+    HFONT hFont = nullptr;
+    int charWidth = 0;
+    int charHeight = 0;
+    int clientWidth = 0;
+    int clientHeight = 0;
+    size_t topRow = 0;
+    size_t leftCol = 0;
+
+    static constexpr const wchar_t* CLASS_NAME = L"HoodRDDiffView";
+    static constexpr int WHEEL_ROWS = 3;
+    static constexpr int SCROLL_COLS = 4;
+    // Unchanged rows kept above a change jumped to
+    static constexpr size_t CONTEXT_ROWS = 3;
+};
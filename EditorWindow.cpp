@@ -1,10 +1,21 @@
 #include "EditorWindow.hpp"
 #include "resource.h"
+#include "DiffView.hpp"
+#include "HexView.hpp"
+#include <windowsx.h>
 #include <commctrl.h>
+#include <commdlg.h>
+#include <string>
 
-EditorWindow::EditorWindow(HWND hwnd) : hwnd(hwnd) {
+EditorWindow::EditorWindow(HWND hwnd) : hwnd(hwnd), fonts(std::make_unique<GdiFontSource>()) {
+    // Font names are slow to list on some machines; start before anyone asks
+    fonts.refresh();
     editor = std::make_unique<TextEditor>(hwnd);
     CreateMenus();
+
+    // Poll the open file and the settings so external changes show up
+    // without refocusing
+    SetTimer(hwnd, FILE_WATCH_TIMER, 2000, NULL);
 }
 
 void EditorWindow::CreateMenus() {
@@ -16,6 +27,7 @@ void EditorWindow::CreateMenus() {
     // File menu
     AppendMenuW(hFileMenu, MF_STRING, IDM_FILE_NEW, L"&New");
     AppendMenuW(hFileMenu, MF_STRING, IDM_FILE_OPEN, L"&Open...");
+    AppendMenuW(hFileMenu, MF_STRING, IDM_FILE_OPEN_HEX, L"Open in &Hex View...");
     AppendMenuW(hFileMenu, MF_STRING, IDM_FILE_SAVE, L"&Save");
     AppendMenuW(hFileMenu, MF_STRING, IDM_FILE_SAVE_AS, L"Save &As...");
     AppendMenuW(hFileMenu, MF_SEPARATOR, 0, NULL);
@@ -28,8 +40,23 @@ void EditorWindow::CreateMenus() {
     AppendMenuW(hEditMenu, MF_STRING, IDM_EDIT_CUT, L"Cu&t");
     AppendMenuW(hEditMenu, MF_STRING, IDM_EDIT_COPY, L"&Copy");
     AppendMenuW(hEditMenu, MF_STRING, IDM_EDIT_PASTE, L"&Paste");
+    AppendMenuW(hEditMenu, MF_SEPARATOR, 0, NULL);
+    AppendMenuW(hEditMenu, MF_STRING, IDM_EDIT_SORT_LINES, L"&Sort Lines");
+    AppendMenuW(hEditMenu, MF_STRING, IDM_EDIT_SORT_BY_COLUMN, L"Sort by C&olumn");
+    AppendMenuW(hEditMenu, MF_STRING, IDM_EDIT_REMOVE_DUPLICATES, L"Remove &Duplicate Lines");
+    AppendMenuW(hEditMenu, MF_STRING, IDM_EDIT_KEEP_MATCHING, L"&Keep Lines Containing Selection");
+    AppendMenuW(hEditMenu, MF_STRING, IDM_EDIT_DROP_MATCHING, L"Remove &Lines Containing Selection");
 
     // View menu
+    AppendMenuW(hViewMenu, MF_STRING, IDM_VIEW_FOLD_ALL, L"&Fold All");
+    AppendMenuW(hViewMenu, MF_STRING, IDM_VIEW_UNFOLD_ALL, L"&Unfold All");
+    AppendMenuW(hViewMenu, MF_STRING, IDM_VIEW_ALIGN_COLUMNS, L"&Align Columns");
+    AppendMenuW(hViewMenu, MF_STRING, IDM_VIEW_MINIMAP, L"&Minimap");
+    AppendMenuW(hViewMenu, MF_SEPARATOR, 0, NULL);
+    AppendMenuW(hViewMenu, MF_STRING, IDM_VIEW_COMPARE_SAVED, L"Compare with Sa&ved");
+    AppendMenuW(hViewMenu, MF_STRING, IDM_VIEW_COMPARE_FILE, L"Compare with F&ile...");
+    AppendMenuW(hViewMenu, MF_SEPARATOR, 0, NULL);
+    AppendMenuW(hViewMenu, MF_STRING, IDM_VIEW_MEMORY_USAGE, L"Memory Us&age...");
     AppendMenuW(hViewMenu, MF_STRING, IDM_VIEW_SETTINGS, L"&Settings...");
 
     // Add menus to menu bar
@@ -59,7 +86,7 @@ EditorWindow* EditorWindow::Create(HINSTANCE hInstance, int nCmdShow) {
     HWND hwnd = CreateWindowExW(
         0,                          // Optional window styles
         CLASS_NAME,                 // Window class
-        L"Hood RD Editor",         // Window text
+        TITLE,                      // Window text
         WS_OVERLAPPEDWINDOW | WS_VSCROLL | WS_HSCROLL, // Window style
 
         // Size and position
@@ -96,6 +123,8 @@ LRESULT CALLBACK EditorWindow::WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, L
 LRESULT EditorWindow::HandleMessage(UINT uMsg, WPARAM wParam, LPARAM lParam) {
     switch (uMsg) {
         case WM_DESTROY:
+            KillTimer(hwnd, FILE_WATCH_TIMER);
+            KillTimer(hwnd, TextEditor::COLUMN_TIMER);
             PostQuitMessage(0);
             return 0;
 
@@ -107,6 +136,20 @@ LRESULT EditorWindow::HandleMessage(UINT uMsg, WPARAM wParam, LPARAM lParam) {
             return 0;
         }
 
+        case WM_FRAME_READY:
+            // Nothing to erase: the frame covers the whole client area
+            InvalidateRect(hwnd, NULL, FALSE);
+            return 0;
+
+        case WM_LINES_LOADED:
+            editor->takeLoadedLines();
+            return 0;
+
+        case WM_TRANSFORM_PROGRESS:
+            editor->takeTransformedLines();
+            ShowProgress();
+            return 0;
+
         case WM_SIZE: {
             int width = LOWORD(lParam);
             int height = HIWORD(lParam);
@@ -122,17 +165,149 @@ LRESULT EditorWindow::HandleMessage(UINT uMsg, WPARAM wParam, LPARAM lParam) {
             editor->handleKeyDown(wParam);
             return 0;
 
+        case WM_LBUTTONDOWN:
+            SetFocus(hwnd);
+            editor->handleMouseDown(GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam), (wParam & MK_SHIFT) != 0);
+            return 0;
+
+        case WM_SYSKEYDOWN:
+            if (editor->handleSysKeyDown(wParam)) return 0;
+            break;
+
         case WM_CLOSE:
             if (editor->queryClose()) {
+                Session session;
+                session.file = editor->fileName();
+                session.view = editor->viewState();
+                session.save();
                 DestroyWindow(hwnd);
             }
             return 0;
 
+        case WM_ACTIVATEAPP:
+            if (wParam) {
+                editor->checkExternalChanges();
+            }
+            return 0;
+
+        case WM_FONTCHANGE:
+            fonts.refresh();
+            return 0;
+
+        case WM_TIMER:
+            if (wParam == FILE_WATCH_TIMER) {
+                editor->checkExternalChanges();
+                // Settings edited outside the dialog apply as well
+                if (unsigned changed = Settings::getInstance().reloadIfChanged()) {
+                    editor->applySettings(changed);
+                }
+            } else if (wParam == TextEditor::COLUMN_TIMER) {
+                editor->refineColumns();
+            }
+            return 0;
+
+        case WM_INITMENUPOPUP:
+            CheckMenuItem((HMENU)wParam, IDM_VIEW_ALIGN_COLUMNS,
+                          MF_BYCOMMAND | (editor->aligningColumns() ? MF_CHECKED : MF_UNCHECKED));
+            CheckMenuItem((HMENU)wParam, IDM_VIEW_MINIMAP,
+                          MF_BYCOMMAND | (Settings::getInstance().showMinimap ? MF_CHECKED : MF_UNCHECKED));
+            return 0;
+
         case WM_COMMAND:
             switch (LOWORD(wParam)) {
+                case IDM_FILE_OPEN:
+                    ShowOpenDialog();
+                    return 0;
+
+                case IDM_FILE_OPEN_HEX:
+                    ShowHexDialog();
+                    return 0;
+
+                case IDM_FILE_SAVE:
+                    editor->saveFile();
+                    return 0;
+
+                case IDM_FILE_EXIT:
+                    SendMessage(hwnd, WM_CLOSE, 0, 0);
+                    return 0;
+
+                case IDM_EDIT_UNDO:
+                    editor->undo();
+                    return 0;
+
+                case IDM_EDIT_REDO:
+                    editor->redo();
+                    return 0;
+
+                case IDM_EDIT_CUT:
+                    editor->cut();
+                    return 0;
+
+                case IDM_EDIT_COPY:
+                    editor->copy();
+                    return 0;
+
+                case IDM_EDIT_PASTE:
+                    editor->paste();
+                    return 0;
+
+                case IDM_EDIT_SORT_LINES:
+                    editor->transformLines(LineTransform::Sort);
+                    return 0;
+
+                case IDM_EDIT_SORT_BY_COLUMN:
+                    editor->transformLines(LineTransform::SortByField);
+                    return 0;
+
+                case IDM_EDIT_REMOVE_DUPLICATES:
+                    editor->transformLines(LineTransform::RemoveDuplicates);
+                    return 0;
+
+                case IDM_EDIT_KEEP_MATCHING:
+                    editor->transformLines(LineTransform::KeepMatching);
+                    return 0;
+
+                case IDM_EDIT_DROP_MATCHING:
+                    editor->transformLines(LineTransform::DropMatching);
+                    return 0;
+
+                case IDM_VIEW_FOLD_ALL:
+                    editor->foldAll();
+                    return 0;
+
+                case IDM_VIEW_UNFOLD_ALL:
+                    editor->unfoldAll();
+                    return 0;
+
+                case IDM_VIEW_ALIGN_COLUMNS:
+                    editor->alignColumns(!editor->aligningColumns());
+                    return 0;
+
+                case IDM_VIEW_MINIMAP: {
+                    Settings& settings = Settings::getInstance();
+                    settings.showMinimap = !settings.showMinimap;
+                    if (!settings.save()) {
+                        MessageBoxW(hwnd, L"The settings could not be saved.", L"Minimap", MB_OK | MB_ICONERROR);
+                    }
+                    editor->applySettings(Settings::EDITOR_CHANGED);
+                    return 0;
+                }
+
+                case IDM_VIEW_COMPARE_SAVED:
+                    if (!editor->fileName().empty()) CompareWith(editor->fileName());
+                    return 0;
+
+                case IDM_VIEW_COMPARE_FILE:
+                    ShowCompareDialog();
+                    return 0;
+
+                case IDM_VIEW_MEMORY_USAGE:
+                    ShowMemoryUsage();
+                    return 0;
+
                 case IDM_VIEW_SETTINGS:
-                    if (SettingsDialog::Show(hwnd) == IDOK) {
-                        editor->applySettings();
+                    if (SettingsDialog::Show(hwnd, fonts) == IDOK) {
+                        editor->applySettings(Settings::ALL_CHANGED);
                     }
                     return 0;
             }
@@ -151,6 +326,86 @@ void EditorWindow::Show(int nCmdShow) {
     ShowWindow(hwnd, nCmdShow);
 }
 
+void EditorWindow::OpenFile(const std::string& fname) {
+    // Binary files would only be garbage as lines of text
+    if (HexDocument::looksBinary(fname) && HexView::Open(hwnd, fname)) return;
+    editor->loadFile(fname);
+    editor->awaitFirstLines();
+}
+
+void EditorWindow::ShowProgress() {
+    // Long line commands show how far they have got in the title bar
+    int percent = editor->transformProgress();
+    if (percent < 0) {
+        SetWindowTextW(hwnd, TITLE);
+    } else {
+        std::wstring title = std::wstring(TITLE) + L" - working, " + std::to_wstring(percent) + L"% (Esc to cancel)";
+        SetWindowTextW(hwnd, title.c_str());
+    }
+}
+
+void EditorWindow::RestoreSession() {
+    Session session;
+    if (!session.load() || session.file.empty()) return;
+    editor->loadFile(session.file, &session.view);
+    editor->awaitFirstLines();
+}
+
+// An existing file picked in the open dialog
+static bool askForFile(HWND owner, std::string& chosen) {
+    char path[MAX_PATH] = "";
+    OPENFILENAMEA ofn = { sizeof(OPENFILENAMEA) };
+    ofn.hwndOwner = owner;
+    ofn.lpstrFilter = "All Files (*.*)\0*.*\0";
+    ofn.lpstrFile = path;
+    ofn.nMaxFile = MAX_PATH;
+    ofn.Flags = OFN_FILEMUSTEXIST | OFN_PATHMUSTEXIST;
+    if (!GetOpenFileNameA(&ofn)) return false;
+    chosen = path;
+    return true;
+}
+
+void EditorWindow::ShowOpenDialog() {
+    if (!editor->queryClose()) return;
+
+    std::string path;
+    if (askForFile(hwnd, path)) {
+        OpenFile(path);
+    }
+}
+
+void EditorWindow::ShowHexDialog() {
+    std::string path;
+    if (askForFile(hwnd, path) && !HexView::Open(hwnd, path)) {
+        MessageBoxW(hwnd, L"The file cannot be opened.", L"Hex View", MB_OK | MB_ICONERROR);
+    }
+}
+
+void EditorWindow::ShowCompareDialog() {
+    std::string path;
+    if (askForFile(hwnd, path)) {
+        CompareWith(path);
+    }
+}
+
+void EditorWindow::CompareWith(const std::string& path) {
+    if (editor->loading()) {
+        MessageBoxW(hwnd, L"The file is still being read.", L"Compare", MB_OK | MB_ICONINFORMATION);
+        return;
+    }
+    DiffView::Open(hwnd, path, editor->documentLines());
+}
+
+void EditorWindow::ShowMemoryUsage() {
+    MemoryStats stats = editor->memoryStats();
+    std::string message = stats.text();
+    if (!MemoryStats::counting()) message += "\nAllocations are only counted in debug builds.\n";
+    message += "\nCopy the report to the clipboard as JSON?";
+    if (MessageBoxA(hwnd, message.c_str(), "Memory Usage", MB_YESNO | MB_ICONINFORMATION) == IDYES) {
+        TextEditor::copyToClipboard(hwnd, stats.json());
+    }
+}
+
 bool EditorWindow::ProcessMessages() {
     MSG msg = {};
     while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
@@ -3,6 +3,7 @@
 #include <memory>
 #include "TextEditor.hpp"
 #include "SettingsDialog.hpp"
+#include "Session.hpp"
 
 class EditorWindow {
 public:
@@ -11,15 +12,27 @@ public:
 
     bool ProcessMessages();
     void Show(int nCmdShow);
+    void OpenFile(const std::string& fname);
+    // Reopens the document open when the editor last closed
+    void RestoreSession();
 
 private:
     EditorWindow(HWND hwnd);
     LRESULT HandleMessage(UINT uMsg, WPARAM wParam, LPARAM lParam);
     void CreateMenus();
+    void ShowOpenDialog();
+    void ShowHexDialog();
+    void ShowProgress();
+    void ShowCompareDialog();
+    void ShowMemoryUsage();
+    void CompareWith(const std::string& path);
 
     HWND hwnd;
     std::unique_ptr<TextEditor> editor;
+    FontCatalog fonts;
     HMENU hMenu;
 
     static constexpr const wchar_t* CLASS_NAME = L"HoodRDEditorWindow";
+    static constexpr const wchar_t* TITLE = L"Hood RD Editor";
+    static constexpr UINT_PTR FILE_WATCH_TIMER = 1;
 };
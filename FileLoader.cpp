@@ -0,0 +1,116 @@
+#include "FileLoader.hpp"
+#include "TextFile.hpp"
+#include "MemoryStats.hpp"
+#include <iterator>
+
+FileLoader::FileLoader(HWND hwnd) : hwnd(hwnd) {
+}
+
+FileLoader::~FileLoader() {
+    cancel();
+}
+
+bool FileLoader::start(const std::string& path, const LineIndex* saved) {
+    std::unique_ptr<FileReader> reader = FileReader::open(path);
+    if (!reader) return false;
+
+    // Starting at the checkpoint before the old top line covers it and the
+    // screens below
+    size_t focusLine = SIZE_MAX;
+    uint64_t focusOffset = 0;
+    if (saved && saved->topLine > 0) {
+        size_t checkpoint = static_cast<size_t>(saved->topLine / LineIndex::CHECKPOINT_LINES);
+        if (checkpoint < saved->checkpoints.size()) {
+            focusLine = checkpoint * LineIndex::CHECKPOINT_LINES;
+            focusOffset = saved->checkpoints[checkpoint];
+        }
+    }
+
+    cancel();
+    busy = true;
+    worker = std::thread(&FileLoader::run, this, path, std::move(reader), focusLine, focusOffset);
+    return true;
+}
+
+void FileLoader::cancel() {
+    stopping = true;
+    if (worker.joinable()) worker.join();
+    stopping = false;
+    busy = false;
+    // A message posted for the abandoned load may still arrive; it finds
+    // nothing to take
+    pending = Update();
+    notified = false;
+}
+
+FileLoader::Update FileLoader::take() {
+    std::lock_guard<std::mutex> lock(mutex);
+    Update update = std::move(pending);
+    pending = Update();
+    notified = false;
+    if (update.done) busy = false;
+    return update;
+}
+
+bool FileLoader::wait(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mutex);
+    return arrived.wait_for(lock, timeout, [this] { return !pending.runs.empty() || pending.done; });
+}
+
+void FileLoader::run(std::string path, std::unique_ptr<FileReader> reader, size_t focusLine, uint64_t focusOffset) {
+    // The lines read here become the buffer's text
+    MemoryStats::Scope scope(MemoryStats::Text);
+    if (focusLine != SIZE_MAX) {
+        std::unique_ptr<FileReader> focus = FileReader::open(path);
+        if (focus && focus->seek(focusOffset)) {
+            size_t line = focusLine;
+            TextFile::streamLines(*focus, [&](std::vector<std::string>&& lines) {
+                if (stopping) return false;
+                size_t count = lines.size();
+                deliver(line, std::move(lines));
+                line += count;
+                return line < focusLine + FOCUS_LINES;
+            });
+        }
+    }
+
+    // Then the whole file in order, which also finds everything for a
+    // fresh index
+    LineIndex index;
+    index.identify(path);
+    size_t line = 0;
+    bool ok = TextFile::streamLines(*reader, [&](std::vector<std::string>&& lines) {
+        if (stopping) return false;
+        size_t count = lines.size();
+        deliver(line, std::move(lines));
+        line += count;
+        return true;
+    }, &index);
+    if (stopping) return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.done = true;
+    pending.failed = !ok;
+    pending.index = std::move(index);
+    notify();
+}
+
+void FileLoader::deliver(size_t first, std::vector<std::string>&& lines) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!pending.runs.empty() && pending.runs.back().first + pending.runs.back().lines.size() == first) {
+        auto& run = pending.runs.back().lines;
+        run.insert(run.end(), std::make_move_iterator(lines.begin()), std::make_move_iterator(lines.end()));
+    } else {
+        pending.runs.push_back({ first, std::move(lines) });
+    }
+    notify();
+}
+
+void FileLoader::notify() {
+    arrived.notify_all();
+    // One message until the UI thread takes what is there, however many
+    // blocks arrive meanwhile
+    if (notified) return;
+    notified = true;
+    PostMessage(hwnd, WM_LINES_LOADED, 0, 0);
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <windows.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "CompressedFile.hpp"
+#include "LineIndex.hpp"
+
+// Posted to the editor window when more lines of the file being opened
+// are ready to take
+constexpr UINT WM_LINES_LOADED = WM_APP + 2;
+
+// Reads, and decompresses if need be, a file on a worker thread, passing
+// its lines to the UI thread as they come so the top of a large or
+// compressed file shows long before the rest has been read. Given the
+// file's saved index, the lines around where the view was come first.
+class FileLoader {
+public:
+    // Consecutive lines of the file starting at line `first`
+    struct Run {
+        size_t first = 0;
+        std::vector<std::string> lines;
+    };
+
+    struct Update {
+        std::vector<Run> runs;
+        bool done = false;   // Nothing more will come
+        bool failed = false; // The file turned out damaged part way through
+        LineIndex index;     // Once done, what reading the file found
+    };
+
+    explicit FileLoader(HWND hwnd);
+    ~FileLoader();
+    FileLoader(const FileLoader&) = delete;
+    FileLoader& operator=(const FileLoader&) = delete;
+
+    // Abandons any load in progress; false if the file cannot be opened
+    bool start(const std::string& path, const LineIndex* saved = nullptr);
+    void cancel();
+    // Until the last update has been taken
+    bool loading() const { return busy; }
+    // Everything read since the last call
+    Update take();
+    // Blocks until there is something to take, for at most `timeout`
+    bool wait(std::chrono::milliseconds timeout);
+
+private:
+    // Lines read ahead from where the view was
+    static constexpr size_t FOCUS_LINES = 8 * LineIndex::CHECKPOINT_LINES;
+
+    void run(std::string path, std::unique_ptr<FileReader> reader, size_t focusLine, uint64_t focusOffset);
+    void deliver(size_t first, std::vector<std::string>&& lines);
+    void notify();
+
+    HWND hwnd;
+    std::thread worker;
+    std::atomic<bool> stopping{ false };
+    bool busy = false;
+
+    // Shared with the worker
+    std::mutex mutex;
+    std::condition_variable arrived;
+    Update pending;
+    bool notified = false;
+};
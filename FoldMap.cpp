@@ -0,0 +1,655 @@
+#include "FoldMap.hpp"
+#include "MemoryStats.hpp"
+#include <algorithm>
+#include <iterator>
+
+size_t FoldMap::visibleCount(size_t lineCount) const {
+    return lineCount - hiddenOf(root);
+}
+
+size_t FoldMap::lineToRow(size_t line) const {
+    size_t base = 0;
+    size_t hidden = 0;
+    Index t = root;
+    while (t != NIL) {
+        const Node& n = nodes[t];
+        size_t leftSpan = spanOf(n.left);
+        if (line < base + leftSpan) {
+            t = n.left;
+            continue;
+        }
+        size_t header = base + leftSpan + n.lead - 1;
+        size_t before = hidden + hiddenOf(n.left);
+        if (line <= header) return line - before;
+        if (line <= header + n.hidden) return header - before;
+        base = header + n.hidden + 1;
+        hidden = before + n.hidden;
+        t = n.right;
+    }
+    return line - hidden;
+}
+
+size_t FoldMap::rowToLine(size_t row) const {
+    size_t rows = 0;
+    size_t hidden = 0;
+    Index t = root;
+    while (t != NIL) {
+        const Node& n = nodes[t];
+        size_t leftVisible = spanOf(n.left) - hiddenOf(n.left);
+        if (row < rows + leftVisible) {
+            t = n.left;
+            continue;
+        }
+        size_t headerRow = rows + leftVisible + n.lead - 1;
+        if (row <= headerRow) return row + hidden + hiddenOf(n.left);
+        rows = headerRow + 1;
+        hidden += hiddenOf(n.left) + n.hidden;
+        t = n.right;
+    }
+    return row + hidden;
+}
+
+bool FoldMap::find(size_t line, size_t& header, size_t& end) const {
+    size_t base = 0;
+    Index t = root;
+    while (t != NIL) {
+        const Node& n = nodes[t];
+        size_t leftSpan = spanOf(n.left);
+        if (line < base + leftSpan) {
+            t = n.left;
+            continue;
+        }
+        size_t start = base + leftSpan + n.lead - 1;
+        if (line < start) return false;
+        if (line <= start + n.hidden) {
+            header = start;
+            end = start + n.hidden;
+            return true;
+        }
+        base = start + n.hidden + 1;
+        t = n.right;
+    }
+    return false;
+}
+
+bool FoldMap::isHidden(size_t line) const {
+    size_t header, end;
+    return find(line, header, end) && line > header;
+}
+
+bool FoldMap::isFolded(size_t line) const {
+    size_t header, end;
+    return find(line, header, end) && line == header;
+}
+
+bool FoldMap::fold(size_t header, size_t end) {
+    if (end <= header) return false;
+    MemoryStats::Scope scope(MemoryStats::Folds);
+
+    Index a, b, m, c;
+    split(root, header, 0, a, b);
+    size_t base = spanOf(a);
+    if (base > header) { // Starts inside a collapsed fold
+        root = merge(a, b);
+        return false;
+    }
+    split(b, end + 1, base, m, c);
+    size_t cBase = base + spanOf(m);
+    bool crosses = cBase > end + 1;
+    bool same = m != NIL && nodes[m].left == NIL && nodes[m].right == NIL &&
+                nodes[m].lead == header - base + 1 && nodes[m].hidden == end - header;
+    if (crosses || same) {
+        root = merge(a, merge(m, c));
+        return false;
+    }
+
+    // Folds already collapsed inside this one are kept with it
+    std::vector<FoldRange> inner;
+    collect(m, base, header, inner);
+    release(m);
+    Index t = create(header - base + 1, end - header);
+    nodes[t].inner = std::move(inner);
+
+    // The next fold's distance is now measured from this one's end
+    addToFirstLead(c, cBase, end + 1);
+    root = merge(merge(a, t), c);
+    return true;
+}
+
+bool FoldMap::unfold(size_t line) {
+    Index a, c, x;
+    split(root, line + 1, 0, a, c);
+    if (a == NIL) {
+        root = c;
+        return false;
+    }
+    a = popLast(a, x);
+    size_t base = spanOf(a);
+    size_t header = base + nodes[x].lead - 1;
+    size_t end = header + nodes[x].hidden;
+    if (end < line) {
+        root = merge(merge(a, x), c);
+        return false;
+    }
+
+    // Bring back the folds that were collapsed inside it
+    std::vector<FoldRange> inner = std::move(nodes[x].inner);
+    release(x);
+    Index m = NIL;
+    size_t next = base;
+    for (auto& range : inner) {
+        size_t innerHeader = header + range.header;
+        size_t innerEnd = header + range.end;
+        Index n = create(innerHeader - next + 1, innerEnd - innerHeader);
+        nodes[n].inner = std::move(range.inner);
+        m = merge(m, n);
+        next = innerEnd + 1;
+    }
+    addToFirstLead(c, end + 1, next);
+    root = merge(merge(a, m), c);
+    return true;
+}
+
+void FoldMap::clear() {
+    nodes.clear();
+    freeNodes.clear();
+    root = NIL;
+}
+
+std::vector<FoldRange> FoldMap::collapsed() const {
+    std::vector<FoldRange> ranges;
+    collect(root, 0, 0, ranges);
+    return ranges;
+}
+
+// Heap bytes behind nested folds
+static size_t innerBytes(const std::vector<FoldRange>& folds) {
+    size_t bytes = MemoryStats::heapBytes(folds);
+    for (const FoldRange& fold : folds) bytes += innerBytes(fold.inner);
+    return bytes;
+}
+
+size_t FoldMap::memoryUsage() const {
+    size_t bytes = MemoryStats::heapBytes(nodes) + MemoryStats::heapBytes(freeNodes);
+    for (const Node& node : nodes) bytes += innerBytes(node.inner);
+    return bytes;
+}
+
+void FoldMap::linesChanged(const std::vector<LineChange>& changes) {
+    if (root == NIL) return;
+    MemoryStats::Scope scope(MemoryStats::Folds);
+    for (const auto& change : changes) {
+        changeLines(change);
+    }
+}
+
+void FoldMap::changeLines(const LineChange& change) {
+    size_t first = change.first;
+    if (change.removed == 0 && change.inserted == 0) {
+        // Editing within a header line leaves its fold alone
+        while (isHidden(first)) unfold(first);
+        return;
+    }
+
+    // Drop the folds the edit reaches into: one that hides its first line
+    // and every one with a header among the replaced lines
+    Index a, b, m, c, dropped;
+    split(root, first, 0, a, b);
+    size_t oldBase = spanOf(a);
+    if (oldBase > first) {
+        a = popLast(a, dropped);
+        release(dropped);
+    }
+    split(b, first + change.removed + 1, oldBase, m, c);
+    size_t oldCBase = oldBase + spanOf(m);
+    release(m);
+
+    // Only the first fold after the edit stores a distance that changes
+    addToFirstLead(c, oldCBase + change.inserted, spanOf(a) + change.removed);
+    root = merge(a, c);
+}
+
+FoldMap::Index FoldMap::create(size_t lead, size_t hidden) {
+    Index t;
+    if (!freeNodes.empty()) {
+        t = freeNodes.back();
+        freeNodes.pop_back();
+        nodes[t] = Node();
+    } else {
+        t = static_cast<Index>(nodes.size());
+        nodes.emplace_back();
+    }
+    // xorshift32; only needs to be unpredictable enough to keep the treap balanced
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    Node& n = nodes[t];
+    n.lead = lead;
+    n.hidden = hidden;
+    n.priority = seed;
+    update(t);
+    return t;
+}
+
+void FoldMap::release(Index t) {
+    if (t == NIL) return;
+    release(nodes[t].left);
+    release(nodes[t].right);
+    std::vector<FoldRange>().swap(nodes[t].inner);
+    freeNodes.push_back(t);
+}
+
+void FoldMap::update(Index t) {
+    Node& n = nodes[t];
+    n.span = n.lead + n.hidden + spanOf(n.left) + spanOf(n.right);
+    n.hiddenTotal = n.hidden + hiddenOf(n.left) + hiddenOf(n.right);
+}
+
+FoldMap::Index FoldMap::merge(Index l, Index r) {
+    if (l == NIL) return r;
+    if (r == NIL) return l;
+    if (nodes[l].priority > nodes[r].priority) {
+        nodes[l].right = merge(nodes[l].right, r);
+        update(l);
+        return l;
+    }
+    nodes[r].left = merge(l, nodes[r].left);
+    update(r);
+    return r;
+}
+
+void FoldMap::split(Index t, size_t line, size_t base, Index& l, Index& r) {
+    if (t == NIL) {
+        l = r = NIL;
+        return;
+    }
+    Node& n = nodes[t];
+    size_t header = base + spanOf(n.left) + n.lead - 1;
+    if (header < line) {
+        split(n.right, line, header + n.hidden + 1, n.right, r);
+        l = t;
+    } else {
+        split(n.left, line, base, l, n.left);
+        r = t;
+    }
+    update(t);
+}
+
+FoldMap::Index FoldMap::popLast(Index t, Index& last) {
+    Node& n = nodes[t];
+    if (n.right == NIL) {
+        last = t;
+        Index rest = n.left;
+        n.left = NIL;
+        update(t);
+        return rest;
+    }
+    n.right = popLast(n.right, last);
+    update(t);
+    return t;
+}
+
+void FoldMap::addToFirstLead(Index t, size_t add, size_t subtract) {
+    if (t == NIL) return;
+    Node& n = nodes[t];
+    if (n.left == NIL) {
+        n.lead = n.lead + add - subtract;
+    } else {
+        addToFirstLead(n.left, add, subtract);
+    }
+    update(t);
+}
+
+void FoldMap::collect(Index t, size_t base, size_t origin, std::vector<FoldRange>& out) const {
+    if (t == NIL) return;
+    const Node& n = nodes[t];
+    collect(n.left, base, origin, out);
+    size_t header = base + spanOf(n.left) + n.lead - 1;
+    out.push_back({ header - origin, header + n.hidden - origin, n.inner });
+    collect(n.right, header + n.hidden + 1, origin, out);
+}
+
+void FoldRegions::Shape::add(const Shape& next) {
+    indent = std::min(indent, next.indent);
+    // Closes in `next` match the opens left here first
+    uint32_t matched = std::min(open, next.close);
+    close += next.close - matched;
+    open = open - matched + next.open;
+}
+
+FoldRegions::FoldRegions(const TextBuffer& buffer) : buffer(buffer) {
+    MemoryStats::Scope scope(MemoryStats::Folds);
+    rebuild();
+}
+
+void FoldRegions::setTabSize(size_t size) {
+    size = std::max<size_t>(size, 1);
+    if (size == tabSize) return;
+    MemoryStats::Scope scope(MemoryStats::Folds);
+    tabSize = size;
+    rebuild();
+}
+
+void FoldRegions::rebuild() {
+    size_t count = buffer.lineCount();
+    size_t total = std::max<size_t>(1, (count + BLOCK_LINES - 1) / BLOCK_LINES);
+    blocks.assign(total, Block());
+    stale.assign(total, 0);
+    staleBlocks.clear();
+    spliced = false;
+    size_t start = 0;
+    for (size_t i = 0; i < total; i++) {
+        blocks[i].lines = std::min(BLOCK_LINES, count - start);
+        summarize(i, start);
+        start += blocks[i].lines;
+    }
+    rebuildTree();
+}
+
+void FoldRegions::rebuildTree() {
+    capacity = 1;
+    while (capacity < blocks.size()) capacity *= 2;
+    tree.assign(2 * capacity, Node());
+    for (size_t i = 0; i < blocks.size(); i++) tree[capacity + i] = { blocks[i].lines, blocks[i].total };
+    for (size_t node = capacity - 1; node >= 1; node--) {
+        tree[node] = tree[2 * node];
+        tree[node].lines += tree[2 * node + 1].lines;
+        tree[node].total.add(tree[2 * node + 1].total);
+    }
+}
+
+void FoldRegions::updateAncestors(size_t block) {
+    size_t node = capacity + block;
+    tree[node] = { blocks[block].lines, blocks[block].total };
+    while (node > 1) {
+        node /= 2;
+        tree[node] = tree[2 * node];
+        tree[node].lines += tree[2 * node + 1].lines;
+        tree[node].total.add(tree[2 * node + 1].total);
+    }
+}
+
+size_t FoldRegions::blockAt(size_t line, size_t& start) const {
+    if (line >= tree[1].lines) {
+        start = tree[1].lines - blocks.back().lines;
+        return blocks.size() - 1;
+    }
+    size_t node = 1;
+    start = 0;
+    while (node < capacity) {
+        size_t left = 2 * node;
+        if (line < tree[left].lines) {
+            node = left;
+        } else {
+            line -= tree[left].lines;
+            start += tree[left].lines;
+            node = left + 1;
+        }
+    }
+    return node - capacity;
+}
+
+size_t FoldRegions::firstLineOf(size_t block) const {
+    size_t start = 0;
+    for (size_t node = capacity + block; node > 1; node /= 2) {
+        if (node % 2 == 1) start += tree[node - 1].lines;
+    }
+    return start;
+}
+
+size_t FoldRegions::memoryUsage() const {
+    size_t bytes = MemoryStats::heapBytes(blocks) + MemoryStats::heapBytes(tree) + MemoryStats::heapBytes(stale) +
+                   MemoryStats::heapBytes(staleBlocks);
+    for (const Block& block : blocks) bytes += MemoryStats::heapBytes(block.shapes);
+    return bytes;
+}
+
+void FoldRegions::linesChanged(const std::vector<LineChange>& changes) {
+    MemoryStats::Scope scope(MemoryStats::Folds);
+    if (changes.size() > MAX_INCREMENTAL_CHANGES) {
+        rebuild();
+        return;
+    }
+    // Line counts first, text once the whole batch is in
+    for (const auto& change : changes) apply(change);
+    if (spliced) {
+        size_t start = 0;
+        for (size_t i = 0; i < blocks.size(); i++) {
+            if (stale[i]) summarize(i, start);
+            start += blocks[i].lines;
+        }
+        rebuildTree();
+    } else {
+        for (size_t block : staleBlocks) {
+            summarize(block, firstLineOf(block));
+            updateAncestors(block);
+        }
+    }
+    staleBlocks.clear();
+    spliced = false;
+}
+
+void FoldRegions::apply(const LineChange& change) {
+    // Old lines [first, first + removed] are now [first, first + inserted]
+    size_t start, lastStart;
+    size_t first = blockAt(change.first, start);
+    size_t last = blockAt(change.first + change.removed, lastStart);
+    size_t lines = lastStart + blocks[last].lines - start - change.removed + change.inserted;
+    if (first == last && lines <= MAX_BLOCK_LINES) {
+        blocks[first].lines = lines;
+        updateAncestors(first);
+        if (!stale[first]) {
+            stale[first] = 1;
+            staleBlocks.push_back(first);
+        }
+        return;
+    }
+
+    // The blocks touched are joined and cut again evenly
+    size_t pieces = std::max<size_t>(1, (lines + BLOCK_LINES - 1) / BLOCK_LINES);
+    std::vector<Block> replacement(pieces);
+    for (size_t i = 0; i < pieces; i++) {
+        replacement[i].lines = lines * (i + 1) / pieces - lines * i / pieces;
+    }
+    blocks.erase(blocks.begin() + first, blocks.begin() + last + 1);
+    blocks.insert(blocks.begin() + first, std::make_move_iterator(replacement.begin()),
+                  std::make_move_iterator(replacement.end()));
+    stale.erase(stale.begin() + first, stale.begin() + last + 1);
+    stale.insert(stale.begin() + first, pieces, 1);
+    spliced = true;
+    rebuildTree();
+}
+
+void FoldRegions::summarize(size_t index, size_t start) {
+    Block& block = blocks[index];
+    block.total = Shape();
+    block.shapes.assign(block.lines, Shape());
+    for (size_t i = 0; i < block.lines && start + i < buffer.lineCount(); i++) {
+        // Chunked lines come back empty and count as blank
+        Shape& shape = block.shapes[i];
+        const std::string& text = buffer.line(start + i).scannable();
+        uint32_t indent = 0;
+        size_t pos = 0;
+        for (; pos < text.size() && (text[pos] == ' ' || text[pos] == '\t'); pos++) {
+            indent += text[pos] == '\t' ? static_cast<uint32_t>(tabSize - indent % tabSize) : 1;
+        }
+        if (pos < text.size()) shape.indent = indent;
+        for (; pos < text.size(); pos++) {
+            if (text[pos] == '{') {
+                shape.open++;
+            } else if (text[pos] == '}') {
+                if (shape.open > 0) {
+                    shape.open--;
+                } else {
+                    shape.close++;
+                }
+            }
+        }
+        block.total.add(shape);
+    }
+    stale[index] = 0;
+}
+
+const FoldRegions::Shape& FoldRegions::shapeOf(size_t line) const {
+    size_t start;
+    size_t block = blockAt(line, start);
+    return blocks[block].shapes[line - start];
+}
+
+template <typename Holds, typename Pass>
+size_t FoldRegions::forward(size_t after, Holds holds, Pass pass) const {
+    size_t line = after + 1;
+    if (line >= tree[1].lines) return NONE;
+    size_t start;
+    size_t block = blockAt(line, start);
+    for (size_t i = line - start; i < blocks[block].shapes.size(); i++) {
+        if (holds(blocks[block].shapes[i])) return start + i;
+        pass(blocks[block].shapes[i]);
+    }
+
+    // Up until a right sibling holds, then down to its leftmost block that does
+    size_t node = capacity + block;
+    for (; node > 1; node /= 2) {
+        if (node % 2 == 1) continue;
+        if (holds(tree[node + 1].total)) break;
+        pass(tree[node + 1].total);
+    }
+    if (node == 1) return NONE;
+    node++;
+    while (node < capacity) {
+        if (holds(tree[2 * node].total)) {
+            node = 2 * node;
+        } else {
+            pass(tree[2 * node].total);
+            node = 2 * node + 1;
+        }
+    }
+    block = node - capacity;
+    start = firstLineOf(block);
+    for (size_t i = 0; i < blocks[block].shapes.size(); i++) {
+        if (holds(blocks[block].shapes[i])) return start + i;
+        pass(blocks[block].shapes[i]);
+    }
+    return NONE;
+}
+
+template <typename Holds, typename Pass>
+size_t FoldRegions::backward(size_t before, Holds holds, Pass pass) const {
+    before = std::min(before, tree[1].lines);
+    if (before == 0) return NONE;
+    size_t start;
+    size_t block = blockAt(before - 1, start);
+    for (size_t i = before - start; i-- > 0;) {
+        if (holds(blocks[block].shapes[i])) return start + i;
+        pass(blocks[block].shapes[i]);
+    }
+
+    size_t node = capacity + block;
+    for (; node > 1; node /= 2) {
+        if (node % 2 == 0) continue;
+        if (holds(tree[node - 1].total)) break;
+        pass(tree[node - 1].total);
+    }
+    if (node == 1) return NONE;
+    node--;
+    while (node < capacity) {
+        if (holds(tree[2 * node + 1].total)) {
+            node = 2 * node + 1;
+        } else {
+            pass(tree[2 * node + 1].total);
+            node = 2 * node;
+        }
+    }
+    block = node - capacity;
+    start = firstLineOf(block);
+    for (size_t i = blocks[block].shapes.size(); i-- > 0;) {
+        if (holds(blocks[block].shapes[i])) return start + i;
+        pass(blocks[block].shapes[i]);
+    }
+    return NONE;
+}
+
+size_t FoldRegions::closing(size_t line) const {
+    uint32_t need = shapeOf(line).open;
+    if (need == 0) return NONE;
+    return forward(line, [&](const Shape& shape) { return shape.close >= need; },
+                   [&](const Shape& shape) { need = need - shape.close + shape.open; });
+}
+
+bool FoldRegions::isHeader(size_t line) const {
+    size_t end;
+    return find(line, end);
+}
+
+bool FoldRegions::find(size_t line, size_t& end) const {
+    if (line >= tree[1].lines) return false;
+
+    // Up to the line that closes the braces left open, keeping it visible
+    size_t close = closing(line);
+    if (close != NONE && close - 1 > line) {
+        end = close - 1;
+        return true;
+    }
+
+    // Over the following lines indented deeper, ignoring trailing blanks
+    uint32_t indent = shapeOf(line).indent;
+    if (indent == Shape::BLANK) return false;
+    auto nonBlank = [](const Shape& shape) { return shape.indent != Shape::BLANK; };
+    auto skip = [](const Shape&) {};
+    size_t next = forward(line, nonBlank, skip);
+    if (next == NONE || shapeOf(next).indent <= indent) return false;
+    size_t outside = forward(next, [&](const Shape& shape) { return shape.indent <= indent; }, skip);
+    end = backward(outside == NONE ? tree[1].lines : outside, nonBlank, skip);
+    return true;
+}
+
+bool FoldRegions::enclosing(size_t line, size_t from, size_t& header, size_t& end) const {
+    if (line >= tree[1].lines) return false;
+    size_t top = std::min(from, line);
+
+    // A region around `line` starts either on a line whose braces are
+    // still open after it, or on one indented less than every line since.
+    // Both kinds are found nearest first walking back down the tree, and
+    // there are only ever a few of them to try.
+    uint32_t need = 0;
+    size_t braceBefore = line + 1;
+    auto nextBrace = [&]() {
+        for (;;) {
+            size_t found = backward(braceBefore, [&](const Shape& shape) { return shape.open > need; },
+                                    [&](const Shape& shape) { need = shape.close + need - shape.open; });
+            if (found == NONE) return NONE;
+            const Shape& shape = shapeOf(found);
+            need = shape.close;
+            braceBefore = found;
+            if (found <= top) return found;
+        }
+    };
+    uint32_t least = Shape::BLANK;
+    size_t indentBefore = line + 1;
+    auto nextIndent = [&]() {
+        for (;;) {
+            size_t found = backward(indentBefore, [&](const Shape& shape) { return shape.indent < least; },
+                                    [&](const Shape& shape) { least = std::min(least, shape.indent); });
+            if (found == NONE) return NONE;
+            least = shapeOf(found).indent;
+            indentBefore = found;
+            if (found <= top) return found;
+        }
+    };
+
+    size_t brace = nextBrace();
+    size_t indent = nextIndent();
+    while (brace != NONE || indent != NONE) {
+        size_t candidate = brace == NONE ? indent : indent == NONE ? brace : std::max(brace, indent);
+        if (find(candidate, end) && end >= line) {
+            header = candidate;
+            return true;
+        }
+        if (candidate == brace) {
+            // Braces that never close rule out every line above that leaves some open too
+            brace = closing(candidate) == NONE ? NONE : nextBrace();
+        }
+        if (candidate == indent) indent = nextIndent();
+    }
+    return false;
+}
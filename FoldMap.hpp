@@ -0,0 +1,151 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "TextBuffer.hpp"
+
+// A collapsed fold: lines header+1 .. end are hidden behind the header
+struct FoldRange {
+    size_t header = 0;
+    size_t end = 0;
+    std::vector<FoldRange> inner; // Folds collapsed inside this one, relative to `header`
+};
+
+// Maps between document lines and on-screen rows with some lines folded
+// away. Collapsed folds live in a treap ordered by position where every
+// node stores its distance from the previous fold rather than its line, so
+// inserting or removing lines only touches one node. Subtree totals of
+// lines and hidden lines make lookups, folding and unfolding O(log n).
+class FoldMap : public TextBufferListener {
+public:
+    size_t visibleCount(size_t lineCount) const;
+    size_t lineToRow(size_t line) const; // Hidden lines map to their header's row
+    size_t rowToLine(size_t row) const;
+
+    // The collapsed fold hiding or headed by `line`
+    bool find(size_t line, size_t& header, size_t& end) const;
+    bool isHidden(size_t line) const;
+    bool isFolded(size_t header) const;
+
+    // Fails if the range crosses a collapsed fold or starts inside one.
+    // Collapsed folds inside it come back when it is unfolded.
+    bool fold(size_t header, size_t end);
+    bool unfold(size_t line);
+    void clear();
+    // Every collapsed fold, outermost ones in order with inner ones nested
+    std::vector<FoldRange> collapsed() const;
+    size_t memoryUsage() const;
+
+    // Shifts folds with the text and opens any that an edit reaches into
+    void linesChanged(const std::vector<LineChange>& changes) override;
+
+private:
+    using Index = uint32_t;
+    static constexpr Index NIL = UINT32_MAX;
+
+    struct Node {
+        size_t lead = 0;        // header - end of the previous fold
+        size_t hidden = 0;      // end - header
+        size_t span = 0;        // Subtree total of lead + hidden
+        size_t hiddenTotal = 0; // Subtree total of hidden
+        uint32_t priority = 0;
+        Index left = NIL;
+        Index right = NIL;
+        std::vector<FoldRange> inner;
+    };
+
+    size_t spanOf(Index t) const { return t == NIL ? 0 : nodes[t].span; }
+    size_t hiddenOf(Index t) const { return t == NIL ? 0 : nodes[t].hiddenTotal; }
+    Index create(size_t lead, size_t hidden);
+    void release(Index t);
+    void update(Index t);
+    Index merge(Index l, Index r);
+    // `base` is the first line the subtree covers; `l` gets the folds with
+    // headers before `line`
+    void split(Index t, size_t line, size_t base, Index& l, Index& r);
+    Index popLast(Index t, Index& last);
+    void addToFirstLead(Index t, size_t add, size_t subtract);
+    void collect(Index t, size_t base, size_t origin, std::vector<FoldRange>& out) const;
+    void changeLines(const LineChange& change);
+
+    std::vector<Node> nodes;
+    std::vector<Index> freeNodes;
+    Index root = NIL;
+    uint32_t seed = 2463534242u;
+};
+
+// Foldable regions: a line leaving a '{' open folds up to the line before
+// the one that closes it, otherwise a line followed by deeper indented
+// lines folds over them. Every line's indentation and unmatched braces are
+// kept in blocks of about BLOCK_LINES under a segment tree of their sums,
+// so where a region ends, or which one surrounds a line, is found walking
+// down the tree instead of along the text. An edit reads again only the
+// blocks it touched.
+class FoldRegions : public TextBufferListener {
+public:
+    static constexpr size_t BLOCK_LINES = 64;
+
+    explicit FoldRegions(const TextBuffer& buffer);
+    // Tabs run to the next multiple of the tab size; a new size reads every line again
+    void setTabSize(size_t tabSize);
+
+    bool isHeader(size_t line) const;
+    bool find(size_t line, size_t& end) const;
+    // Innermost region with a header at or above `from` that covers `line`
+    bool enclosing(size_t line, size_t from, size_t& header, size_t& end) const;
+    size_t memoryUsage() const;
+
+    void linesChanged(const std::vector<LineChange>& changes) override;
+
+private:
+    static constexpr size_t MAX_BLOCK_LINES = 2 * BLOCK_LINES;
+    static constexpr size_t MAX_INCREMENTAL_CHANGES = 1024;
+    static constexpr size_t NONE = SIZE_MAX;
+
+    // Indentation and unmatched braces of a run of lines
+    struct Shape {
+        static constexpr uint32_t BLANK = UINT32_MAX;
+        uint32_t indent = BLANK; // Least indentation of a non-blank line
+        uint32_t close = 0;      // '}' matching a '{' before the run
+        uint32_t open = 0;       // '{' matched after it
+        void add(const Shape& next);
+    };
+    struct Block {
+        size_t lines = 0;
+        Shape total;
+        std::vector<Shape> shapes; // One per line
+    };
+    struct Node {
+        size_t lines = 0;
+        Shape total;
+    };
+
+    void rebuild();
+    void rebuildTree();
+    void updateAncestors(size_t block);
+    size_t blockAt(size_t line, size_t& start) const;
+    size_t firstLineOf(size_t block) const;
+    void apply(const LineChange& change);
+    void summarize(size_t block, size_t start);
+    const Shape& shapeOf(size_t line) const;
+
+    // The first line after `after` (last before `before`) for which
+    // holds(shape) is true, calling pass(shape) on the lines and runs of
+    // lines stepped over on the way; NONE if there is none
+    template <typename Holds, typename Pass>
+    size_t forward(size_t after, Holds holds, Pass pass) const;
+    template <typename Holds, typename Pass>
+    size_t backward(size_t before, Holds holds, Pass pass) const;
+    // The line closing the braces `line` leaves open
+    size_t closing(size_t line) const;
+
+    const TextBuffer& buffer;
+    size_t tabSize = 4;
+    std::vector<Block> blocks;
+    // Node 1 is the root and block i is node `capacity + i`
+    std::vector<Node> tree;
+    size_t capacity = 1;
+    std::vector<char> stale;
+    std::vector<size_t> staleBlocks;
+    bool spliced = false;
+};
@@ -0,0 +1,50 @@
+#include "FontCatalog.hpp"
+
+FontCatalog::FontCatalog(std::unique_ptr<FontSource> source) : source(std::move(source)) {
+}
+
+FontCatalog::~FontCatalog() {
+    stop();
+}
+
+void FontCatalog::refresh() {
+    stop();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        names.clear();
+        known.clear();
+        stamp++;
+        complete = false;
+    }
+    cancelled = false;
+    worker = std::thread([this] {
+        // Faces come once per character set, so only the first of each counts
+        source->enumerate([this](const std::wstring& name) {
+            if (cancelled) return false;
+            std::lock_guard<std::mutex> lock(mutex);
+            if (known.insert(name).second) names.push_back(name);
+            return true;
+        });
+        std::lock_guard<std::mutex> lock(mutex);
+        complete = !cancelled;
+    });
+}
+
+FontCatalog::Update FontCatalog::fetch(Cursor& cursor) const {
+    Update update;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (cursor.stamp != stamp) {
+        cursor.stamp = stamp;
+        cursor.seen = 0;
+        update.restarted = true;
+    }
+    update.added.assign(names.begin() + cursor.seen, names.end());
+    cursor.seen = names.size();
+    update.complete = complete;
+    return update;
+}
+
+void FontCatalog::stop() {
+    cancelled = true;
+    if (worker.joinable()) worker.join();
+}
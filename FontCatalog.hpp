@@ -0,0 +1,57 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+// Where font names come from, so the catalog does not depend on GDI
+class FontSource {
+public:
+    virtual ~FontSource() = default;
+    // Calls `found` once per face name; stops early when it returns false
+    virtual void enumerate(const std::function<bool(const std::wstring&)>& found) = 0;
+};
+
+// Installed font names, enumerated once on a background thread and kept.
+// Readers pick up what has been found so far, a little at a time, and a
+// stamp tells them when a refresh has started the list over.
+class FontCatalog {
+public:
+    // How far one reader has got
+    struct Cursor {
+        uint64_t stamp = 0;
+        size_t seen = 0;
+    };
+    struct Update {
+        bool restarted = false; // Drop what was read before; `added` starts over
+        bool complete = false;  // Nothing more is coming until the next refresh
+        std::vector<std::wstring> added;
+    };
+
+    explicit FontCatalog(std::unique_ptr<FontSource> source);
+    ~FontCatalog();
+    FontCatalog(const FontCatalog&) = delete;
+    FontCatalog& operator=(const FontCatalog&) = delete;
+
+    // Starts over in the background, abandoning a run still in progress
+    void refresh();
+    Update fetch(Cursor& cursor) const;
+
+private:
+    void stop();
+
+    std::unique_ptr<FontSource> source;
+    std::thread worker;
+    std::atomic<bool> cancelled{ false };
+
+    mutable std::mutex mutex;
+    std::vector<std::wstring> names;
+    std::unordered_set<std::wstring> known;
+    uint64_t stamp = 0;
+    bool complete = false;
+};
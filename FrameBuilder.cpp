@@ -0,0 +1,240 @@
+#include "FrameBuilder.hpp"
+#include "MemoryStats.hpp"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <iterator>
+
+static LONG clampToLong(long long value) {
+    return static_cast<LONG>(std::max<long long>(std::min<long long>(value, LONG_MAX / 2), LONG_MIN / 2));
+}
+
+// `amount` of the way from `from` to `to`
+static COLORREF mix(COLORREF from, COLORREF to, float amount) {
+    auto channel = [&](int shift) {
+        int a = (from >> shift) & 0xff;
+        int b = (to >> shift) & 0xff;
+        return static_cast<COLORREF>(a + (b - a) * amount) << shift;
+    };
+    return channel(0) | channel(8) | channel(16);
+}
+
+bool RowSnapshot::operator==(const RowSnapshot& other) const {
+    auto sameSpans = [](const std::vector<Span>& a, const std::vector<Span>& b) {
+        return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const Span& x, const Span& y) {
+            return x.from == y.from && x.to == y.to && x.lineBreak == y.lineBreak;
+        });
+    };
+    return line == other.line && row == other.row && firstCol == other.firstCol && length == other.length &&
+           chunked == other.chunked && folded == other.folded && foldable == other.foldable &&
+           carets == other.carets && brackets == other.brackets && sameSpans(selections, other.selections) &&
+           text == other.text;
+}
+
+bool FrameRequest::operator==(const FrameRequest& other) const {
+    return clientWidth == other.clientWidth && clientHeight == other.clientHeight &&
+           charWidth == other.charWidth && charHeight == other.charHeight &&
+           gutterWidth == other.gutterWidth && scrollX == other.scrollX && scrollY == other.scrollY &&
+           memcmp(&theme, &other.theme, sizeof(Theme)) == 0 &&
+           memcmp(&glyphs, &other.glyphs, sizeof(GlyphTable)) == 0 && columns == other.columns &&
+           minimapWidth == other.minimapWidth && minimapViewTop == other.minimapViewTop &&
+           minimapViewBottom == other.minimapViewBottom && minimapCaret == other.minimapCaret &&
+           minimap == other.minimap && status == other.status && rows == other.rows;
+}
+
+FrameBuilder::FrameBuilder(HWND hwnd) : hwnd(hwnd) {
+    worker = std::thread(&FrameBuilder::run, this);
+}
+
+FrameBuilder::~FrameBuilder() {
+    stopping = true;
+    { std::lock_guard<std::mutex> lock(wakeMutex); }
+    wake.notify_one();
+    worker.join();
+    delete pending.exchange(nullptr);
+    delete ready.exchange(nullptr);
+}
+
+void FrameBuilder::request(FrameRequest&& request) {
+    delete pending.exchange(new FrameRequest(std::move(request)));
+    // Taking the lock only orders this against the worker going to sleep
+    { std::lock_guard<std::mutex> lock(wakeMutex); }
+    wake.notify_one();
+}
+
+std::unique_ptr<Frame> FrameBuilder::take() {
+    return std::unique_ptr<Frame>(ready.exchange(nullptr));
+}
+
+void FrameBuilder::run() {
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            wake.wait(lock, [this] { return stopping || pending.load() != nullptr; });
+        }
+        if (stopping) return;
+
+        std::unique_ptr<FrameRequest> request(pending.exchange(nullptr));
+        if (!request) continue;
+        // A frame nobody picked up yet is stale now
+        delete ready.exchange(build(*request).release());
+        PostMessage(hwnd, WM_FRAME_READY, 0, 0);
+    }
+}
+
+const std::vector<int32_t>& FrameBuilder::offsetsOf(const RowSnapshot& row, const GlyphTable& glyphs,
+                                                    const ColumnStops& columns) {
+    LineLayout& layout = layouts[row.line];
+    auto previous = previousLayouts.find(row.line);
+    if (previous != previousLayouts.end() && previous->second.text == row.text) {
+        layout = std::move(previous->second);
+        return layout.offsets;
+    }
+
+    layout.text = row.text;
+    layout.offsets.resize(row.text.length() + 1);
+    glyphs.measure(row.text.data(), row.text.length(), columns, layout.offsets.data());
+    return layout.offsets;
+}
+
+std::unique_ptr<Frame> FrameBuilder::build(const FrameRequest& request) {
+    MemoryStats::Scope scope(MemoryStats::Frames);
+    // Lines carry over from the last frame only while the font and
+    // column stops stay
+    const GlyphTable& glyphs = request.glyphs;
+    if (memcmp(&layoutGlyphs, &glyphs, sizeof(GlyphTable)) != 0 || layoutColumns != request.columns) {
+        layouts.clear();
+        layoutGlyphs = glyphs;
+        layoutColumns = request.columns;
+    }
+    previousLayouts.swap(layouts);
+    layouts.clear();
+
+    const Theme& theme = request.theme;
+    auto frame = std::make_unique<Frame>();
+    frame->background = theme.background;
+    std::vector<FrameItem>& items = frame->items;
+    auto fill = [&](FrameItem::Kind kind, LONG left, LONG top, LONG right, LONG bottom, COLORREF color) {
+        FrameItem item;
+        item.kind = kind;
+        item.rect = { left, top, right, bottom };
+        item.color = color;
+        items.push_back(std::move(item));
+    };
+    auto text = [&](LONG left, LONG top, COLORREF color, std::string content) -> FrameItem& {
+        FrameItem item;
+        item.kind = FrameItem::Text;
+        item.rect = { left, top, left, top };
+        item.color = color;
+        item.text = std::move(content);
+        items.push_back(std::move(item));
+        return items.back();
+    };
+
+    int height = request.charHeight;
+    int gutter = request.gutterWidth;
+    if (gutter > 0) {
+        for (const RowSnapshot& row : request.rows) {
+            LONG top = clampToLong(static_cast<long long>(row.row) * height - request.scrollY);
+            text(5, top, theme.lineNumber, std::to_string(row.line + 1));
+            // Fold markers: "+" for a collapsed fold, "-" where one could start
+            if (row.folded || row.foldable) {
+                text(gutter - request.charWidth - 4, top, theme.lineNumber, row.folded ? "+" : "-");
+            }
+        }
+        fill(FrameItem::Fill, gutter - 2, 0, gutter - 1, request.clientHeight, theme.lineNumber);
+    }
+
+    // Per row: selections, the visible part of the text, bracket outlines, carets
+    std::vector<FrameItem> carets;
+    for (const RowSnapshot& row : request.rows) {
+        const std::vector<int32_t>* offsets = row.chunked ? nullptr : &offsetsOf(row, glyphs, request.columns);
+        auto x = [&](size_t col) {
+            long long pos = offsets ? (*offsets)[std::min(col, offsets->size() - 1)]
+                                    : static_cast<long long>(col) * glyphs.average;
+            return clampToLong(pos - request.scrollX + gutter);
+        };
+        LONG top = clampToLong(static_cast<long long>(row.row) * height - request.scrollY);
+
+        for (const auto& span : row.selections) {
+            // Show the selected line break as a little extra width
+            LONG lineBreak = span.lineBreak ? request.charWidth / 2 : 0;
+            fill(FrameItem::Fill, x(span.from), top, x(span.to) + lineBreak, top + height, theme.selection);
+        }
+
+        size_t first, last;
+        if (offsets) {
+            // Only the columns on screen, so a huge line costs no more than a short one
+            auto column = [&](long long pos) {
+                size_t col = std::upper_bound(offsets->begin(), offsets->end(), pos) - offsets->begin();
+                return std::min(col == 0 ? 0 : col - 1, row.text.length());
+            };
+            first = column(request.scrollX);
+            last = std::min(column(request.scrollX + request.clientWidth) + 1, row.text.length());
+        } else {
+            first = row.firstCol;
+            last = row.firstCol + row.text.length();
+        }
+        if (first < last) {
+            FrameItem& run = text(x(first), top, theme.text, row.text.substr(first - row.firstCol, last - first));
+            std::replace(run.text.begin(), run.text.end(), '\t', ' ');
+            run.advances.reserve(last - first);
+            for (size_t col = first; col < last; col++) {
+                run.advances.push_back(offsets ? (*offsets)[col + 1] - (*offsets)[col] : glyphs.average);
+            }
+        }
+        if (row.folded) {
+            text(x(row.length) + request.charWidth, top, theme.lineNumber, "...");
+        }
+
+        for (size_t col : row.brackets) {
+            fill(FrameItem::Outline, x(col), top, x(col + 1), top + height, theme.lineNumber);
+        }
+        for (size_t col : row.carets) {
+            LONG left = x(col);
+            FrameItem caret;
+            caret.rect = { left, top, left + 2, top + height };
+            caret.color = theme.cursor;
+            carets.push_back(std::move(caret));
+        }
+    }
+    // Carets go over everything on any row
+    std::move(carets.begin(), carets.end(), std::back_inserter(items));
+
+    if (request.minimapWidth > 0) {
+        LONG left = request.clientWidth - request.minimapWidth;
+        fill(FrameItem::Fill, left, 0, request.clientWidth, request.clientHeight, theme.background);
+        fill(FrameItem::Fill, left, 0, left + 1, request.clientHeight, theme.lineNumber);
+        fill(FrameItem::Fill, left + 1, request.minimapViewTop, request.clientWidth, request.minimapViewBottom,
+             theme.selection);
+        // Neighbouring pixel rows that look the same are drawn as one bar
+        const COLORREF kindColors[MinimapSummary::KIND_COUNT] = { theme.text, theme.number, theme.symbol };
+        LONG barLeft = left + MINIMAP_MARGIN;
+        int barWidth = request.minimapWidth - 2 * MINIMAP_MARGIN;
+        const auto& rows = request.minimap;
+        for (size_t y = 0, next; y < rows.size(); y = next) {
+            for (next = y + 1; next < rows.size() && rows[next] == rows[y]; next++) {}
+            LONG width = static_cast<LONG>(rows[y].density * barWidth + 0.5f);
+            if (width <= 0) continue;
+            COLORREF color = mix(theme.background, kindColors[rows[y].kind], MINIMAP_INK);
+            fill(FrameItem::Fill, barLeft, static_cast<LONG>(y), barLeft + width, static_cast<LONG>(next), color);
+        }
+        if (request.minimapCaret >= 0) {
+            fill(FrameItem::Fill, left + 1, request.minimapCaret, request.clientWidth, request.minimapCaret + 1,
+                 theme.cursor);
+        }
+    }
+
+    fill(FrameItem::Fill, 0, request.clientHeight - height, request.clientWidth, request.clientHeight, theme.statusBar);
+    text(0, request.clientHeight - height, theme.statusText, request.status);
+
+    size_t bytes = 0;
+    for (const auto* kept : { &layouts, &previousLayouts }) {
+        for (const auto& entry : *kept) {
+            bytes += sizeof(entry) + MemoryStats::heapBytes(entry.second.text) +
+                     MemoryStats::heapBytes(entry.second.offsets);
+        }
+    }
+    keptBytes = bytes;
+    return frame;
+}
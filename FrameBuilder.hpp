@@ -0,0 +1,132 @@
+#pragma once
+#include <windows.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "Settings.hpp"
+#include "LayoutCache.hpp"
+#include "MinimapSummary.hpp"
+
+// Posted to the editor window when a newer frame is ready to paint
+constexpr UINT WM_FRAME_READY = WM_APP + 1;
+
+// Everything on one visible row, copied out of the document
+struct RowSnapshot {
+    struct Span {
+        size_t from;
+        size_t to;
+        bool lineBreak; // The selection carries on past the end of the line
+    };
+
+    size_t line = 0;
+    size_t row = 0;
+    // The whole line, or for a chunked one only the columns on screen
+    // starting at firstCol
+    std::string text;
+    size_t firstCol = 0;
+    size_t length = 0;
+    bool chunked = false;
+    bool folded = false;
+    bool foldable = false;
+    std::vector<Span> selections;
+    std::vector<size_t> carets;
+    std::vector<size_t> brackets;
+
+    bool operator==(const RowSnapshot& other) const;
+};
+
+// An immutable copy of what the next frame shows
+struct FrameRequest {
+    int clientWidth = 0;
+    int clientHeight = 0;
+    int charWidth = 0;
+    int charHeight = 0;
+    int gutterWidth = 0; // 0 when line numbers are hidden
+    long long scrollX = 0;
+    long long scrollY = 0;
+    Theme theme = Theme::Light();
+    GlyphTable glyphs;
+    ColumnStops columns;
+    std::vector<RowSnapshot> rows;
+    std::string status;
+    // Down the right edge, 0 wide when hidden: one row per pixel, the
+    // lines on screen as a band and the caret's line
+    int minimapWidth = 0;
+    std::vector<MinimapSummary::Row> minimap;
+    int minimapViewTop = 0;
+    int minimapViewBottom = 0;
+    int minimapCaret = -1;
+
+    bool operator==(const FrameRequest& other) const;
+};
+
+// One drawing step of a finished frame, in painting order
+struct FrameItem {
+    enum Kind { Fill, Outline, Text };
+    Kind kind = Fill;
+    RECT rect = {};              // Text only uses left and top
+    COLORREF color = 0;
+    std::string text;
+    std::vector<int> advances;   // Per glyph, or empty for the font's own
+};
+
+struct Frame {
+    COLORREF background = 0;
+    std::vector<FrameItem> items;
+};
+
+// Lays frames out on a worker thread. The UI thread hands over the newest
+// request and picks up the newest frame through atomic pointer swaps, so
+// neither ever waits for the other to finish; a request that is replaced
+// before the worker gets to it is simply dropped.
+class FrameBuilder {
+public:
+    explicit FrameBuilder(HWND hwnd);
+    ~FrameBuilder();
+    FrameBuilder(const FrameBuilder&) = delete;
+    FrameBuilder& operator=(const FrameBuilder&) = delete;
+
+    void request(FrameRequest&& request);
+    // The newest finished frame, or null if none came since the last call
+    std::unique_ptr<Frame> take();
+    // Bytes of line layouts the worker kept after its last frame
+    size_t memoryUsage() const { return keptBytes; }
+
+private:
+    // Pixels left clear either side of the minimap's bars, and how far
+    // their colour goes from the background towards the full one
+    static constexpr int MINIMAP_MARGIN = 4;
+    static constexpr float MINIMAP_INK = 0.6f;
+
+    // Column offsets of a line as last laid out, reused while its text and
+    // the font stay the same
+    struct LineLayout {
+        std::string text;
+        std::vector<int32_t> offsets;
+    };
+
+    void run();
+    std::unique_ptr<Frame> build(const FrameRequest& request);
+    const std::vector<int32_t>& offsetsOf(const RowSnapshot& row, const GlyphTable& glyphs,
+                                          const ColumnStops& columns);
+
+    HWND hwnd;
+    std::atomic<FrameRequest*> pending{ nullptr };
+    std::atomic<Frame*> ready{ nullptr };
+    std::atomic<bool> stopping{ false };
+    std::atomic<size_t> keptBytes{ 0 };
+    std::mutex wakeMutex;
+    std::condition_variable wake;
+    std::thread worker;
+
+    // Only touched by the worker
+    std::unordered_map<size_t, LineLayout> layouts;
+    std::unordered_map<size_t, LineLayout> previousLayouts;
+    GlyphTable layoutGlyphs;
+    ColumnStops layoutColumns;
+};
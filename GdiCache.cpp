@@ -0,0 +1,56 @@
+#include "GdiCache.hpp"
+#include <algorithm>
+
+GdiCache::~GdiCache() {
+    if (memDC) {
+        SelectObject(memDC, oldBitmap);
+        DeleteDC(memDC);
+    }
+    if (memBitmap) DeleteObject(memBitmap);
+    for (auto& entry : brushes) DeleteObject(entry.second);
+    for (auto& entry : fonts) DeleteObject(entry.second);
+}
+
+HBRUSH GdiCache::brush(COLORREF color) {
+    HBRUSH& cached = brushes[color];
+    if (!cached) {
+        cached = CreateSolidBrush(color);
+        created++;
+    }
+    return cached;
+}
+
+HFONT GdiCache::font(const LOGFONTW& lf) {
+    HFONT& cached = fonts[FontKey(lf.lfFaceName, lf.lfHeight, lf.lfWeight)];
+    if (!cached) {
+        cached = CreateFontIndirectW(&lf);
+        created++;
+    }
+    return cached;
+}
+
+HDC GdiCache::backBuffer(HWND hwnd, int width, int height) {
+    if (memDC && width <= bufferWidth && height <= bufferHeight) return memDC;
+
+    HDC hdc = GetDC(hwnd);
+    if (!memDC) {
+        memDC = CreateCompatibleDC(hdc);
+        created++;
+    }
+    if (width > bufferWidth) bufferWidth = std::max(width, bufferWidth + bufferWidth / 2);
+    if (height > bufferHeight) bufferHeight = std::max(height, bufferHeight + bufferHeight / 2);
+    bufferWidth = std::max(bufferWidth, 1);
+    bufferHeight = std::max(bufferHeight, 1);
+    HBITMAP bitmap = CreateCompatibleBitmap(hdc, bufferWidth, bufferHeight);
+    created++;
+    ReleaseDC(hwnd, hdc);
+
+    HBITMAP previous = (HBITMAP)SelectObject(memDC, bitmap);
+    if (memBitmap) {
+        DeleteObject(memBitmap);
+    } else {
+        oldBitmap = previous;
+    }
+    memBitmap = bitmap;
+    return memDC;
+}
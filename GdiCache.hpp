@@ -0,0 +1,42 @@
+#pragma once
+#include <windows.h>
+#include <map>
+#include <string>
+#include <tuple>
+#include <cstddef>
+
+// GDI objects the renderer keeps across frames: brushes by colour, fonts
+// by face, height and weight, and one back buffer. Once a theme and font
+// have been drawn a frame creates nothing; creations() counts every
+// object made, and TextEditor::render reports any made during a frame in
+// debug builds.
+class GdiCache {
+public:
+    GdiCache() = default;
+    ~GdiCache();
+    GdiCache(const GdiCache&) = delete;
+    GdiCache& operator=(const GdiCache&) = delete;
+
+    HBRUSH brush(COLORREF color);
+    HFONT font(const LOGFONTW& lf);
+
+    // A memory DC with a bitmap of at least width x height. It grows by
+    // half again when it has to, so dragging a window edge reuses it.
+    HDC backBuffer(HWND hwnd, int width, int height);
+
+    size_t creations() const { return created; }
+    // The back buffer's pixels, taken as 32 bits each
+    size_t backBufferBytes() const { return static_cast<size_t>(bufferWidth) * bufferHeight * 4; }
+
+private:
+    using FontKey = std::tuple<std::wstring, LONG, LONG>;
+
+    std::map<COLORREF, HBRUSH> brushes;
+    std::map<FontKey, HFONT> fonts;
+    HDC memDC = nullptr;
+    HBITMAP memBitmap = nullptr;
+    HBITMAP oldBitmap = nullptr;
+    int bufferWidth = 0;
+    int bufferHeight = 0;
+    size_t created = 0;
+};
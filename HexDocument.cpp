@@ -0,0 +1,145 @@
+#include "HexDocument.hpp"
+#include "CompressedFile.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+bool HexDocument::looksBinary(const std::string& path) {
+    std::unique_ptr<FileReader> reader = FileReader::open(path);
+    if (!reader || reader->compression() != Compression::None) return false;
+    std::string start;
+    reader->read(start);
+    return memchr(start.data(), 0, std::min(start.length(), SNIFF_BYTES)) != nullptr;
+}
+
+void HexDocument::encodeRow(const uint8_t* bytes, char* digits) {
+#if defined(__SSE2__) || defined(_M_X64)
+    // Both nibbles of all 16 bytes at once: 0-9 and A-F are two runs of
+    // ASCII, so a digit is '0' plus the nibble, plus the gap to 'A' above 9
+    __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes));
+    __m128i mask = _mm_set1_epi8(0x0f);
+    __m128i nibbles[2] = { _mm_and_si128(_mm_srli_epi16(value, 4), mask), _mm_and_si128(value, mask) };
+    for (auto& nibble : nibbles) {
+        __m128i letter = _mm_and_si128(_mm_cmpgt_epi8(nibble, _mm_set1_epi8(9)), _mm_set1_epi8('A' - '0' - 10));
+        nibble = _mm_add_epi8(_mm_add_epi8(nibble, _mm_set1_epi8('0')), letter);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(digits), _mm_unpacklo_epi8(nibbles[0], nibbles[1]));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(digits + 16), _mm_unpackhi_epi8(nibbles[0], nibbles[1]));
+#else
+    encodeRowScalar(bytes, digits);
+#endif
+}
+
+void HexDocument::encodeRowScalar(const uint8_t* bytes, char* digits) {
+    static const char hex[] = "0123456789ABCDEF";
+    for (size_t i = 0; i < ROW_BYTES; i++) {
+        digits[2 * i] = hex[bytes[i] >> 4];
+        digits[2 * i + 1] = hex[bytes[i] & 0x0f];
+    }
+}
+
+bool HexDocument::open(const std::string& path) {
+    patches.clear();
+    undoLog.clear();
+    if (!file.open(path)) return false;
+    filePath = path;
+    return true;
+}
+
+size_t HexDocument::read(uint64_t offset, size_t count, uint8_t* out) const {
+    if (offset >= size()) return 0;
+    count = static_cast<size_t>(std::min<uint64_t>(count, size() - offset));
+    memcpy(out, file.data() + offset, count);
+    for (auto it = patches.lower_bound(offset); it != patches.end() && it->first < offset + count; ++it) {
+        out[it->first - offset] = it->second;
+    }
+    return count;
+}
+
+void HexDocument::overwrite(uint64_t offset, uint8_t value) {
+    if (offset >= size()) return;
+    auto it = patches.find(offset);
+    undoLog.push_back({ offset, it == patches.end() ? -1 : it->second });
+    // A byte put back as it was on disk needs no patch
+    if (static_cast<uint8_t>(file.data()[offset]) == value) {
+        patches.erase(offset);
+    } else {
+        patches[offset] = value;
+    }
+}
+
+bool HexDocument::undo(uint64_t& offset) {
+    if (undoLog.empty()) return false;
+    auto last = undoLog.back();
+    undoLog.pop_back();
+    offset = last.first;
+    if (last.second < 0) {
+        patches.erase(offset);
+    } else {
+        patches[offset] = static_cast<uint8_t>(last.second);
+    }
+    return true;
+}
+
+bool HexDocument::save() {
+    if (patches.empty()) return true;
+    std::fstream out(filePath, std::ios::in | std::ios::out | std::ios::binary);
+    if (!out) return false;
+    // One write per run of neighbouring patches
+    std::vector<char> run;
+    for (auto it = patches.begin(); it != patches.end();) {
+        uint64_t start = it->first;
+        run.clear();
+        for (; it != patches.end() && it->first == start + run.size(); ++it) run.push_back(static_cast<char>(it->second));
+        out.seekp(static_cast<std::streamoff>(start));
+        out.write(run.data(), static_cast<std::streamsize>(run.size()));
+    }
+    out.close();
+    if (out.fail()) return false;
+    // The mapping sees the written bytes now
+    patches.clear();
+    undoLog.clear();
+    return true;
+}
+
+uint64_t HexDocument::find(const std::string& needle, uint64_t from, bool forward,
+                           const std::atomic<bool>* cancelled) const {
+    if (needle.empty() || needle.length() > size()) return npos;
+    // Blocks overlap by the needle's length less one, so no match is cut
+    uint64_t lastStart = size() - needle.length();
+    std::vector<char> block(SEARCH_BLOCK + needle.length() - 1);
+    std::boyer_moore_horspool_searcher<std::string::const_iterator> searcher(needle.begin(), needle.end());
+    auto searchBlock = [&](uint64_t start, uint64_t end, bool last) {
+        size_t count = read(start, static_cast<size_t>(end - start) + needle.length() - 1,
+                            reinterpret_cast<uint8_t*>(block.data()));
+        uint64_t found = npos;
+        for (auto it = block.begin(); (it = std::search(it, block.begin() + count, searcher)) != block.begin() + count;
+             ++it) {
+            found = start + (it - block.begin());
+            if (!last) break;
+        }
+        return found;
+    };
+
+    if (forward) {
+        for (uint64_t start = from; start <= lastStart; start += SEARCH_BLOCK) {
+            if (cancelled && *cancelled) return npos;
+            uint64_t end = std::min<uint64_t>(start + SEARCH_BLOCK, lastStart + 1);
+            uint64_t found = searchBlock(start, end, false);
+            if (found != npos) return found;
+        }
+    } else {
+        for (uint64_t end = std::min(from, lastStart + 1); end > 0;) {
+            if (cancelled && *cancelled) return npos;
+            uint64_t start = end > SEARCH_BLOCK ? end - SEARCH_BLOCK : 0;
+            uint64_t found = searchBlock(start, end, true);
+            if (found != npos) return found;
+            end = start;
+        }
+    }
+    return npos;
+}
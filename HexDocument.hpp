@@ -0,0 +1,59 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "MappedFile.hpp"
+
+// A file of any size mapped read-only, with overwritten bytes kept as
+// patches over the mapping. Opening costs nothing up front and memory
+// grows only with the bytes changed; saving writes just those back in
+// place.
+class HexDocument {
+public:
+    static constexpr uint64_t npos = UINT64_MAX;
+    static constexpr size_t ROW_BYTES = 16;
+
+    // A NUL byte near the start; compressed files are read as text
+    static bool looksBinary(const std::string& path);
+    // Hex digits of ROW_BYTES bytes, two per byte in upper case, into
+    // 2 * ROW_BYTES chars
+    static void encodeRow(const uint8_t* bytes, char* digits);
+    // The same a byte at a time, for builds without SSE2
+    static void encodeRowScalar(const uint8_t* bytes, char* digits);
+
+    bool open(const std::string& path);
+    const std::string& path() const { return filePath; }
+    uint64_t size() const { return file.size(); }
+
+    // Copies up to `count` bytes at `offset` with patches applied; returns
+    // how many there were
+    size_t read(uint64_t offset, size_t count, uint8_t* out) const;
+    bool patched(uint64_t offset) const { return patches.count(offset) != 0; }
+    bool modified() const { return !patches.empty(); }
+
+    // The file itself only changes on save
+    void overwrite(uint64_t offset, uint8_t value);
+    // Takes back the last overwrite; false if there is none
+    bool undo(uint64_t& offset);
+    bool save();
+
+    // Where `needle` next starts at or after `from`, or last starts before
+    // it, or npos. Reads patches, so nothing may be overwritten meanwhile.
+    uint64_t find(const std::string& needle, uint64_t from, bool forward,
+                  const std::atomic<bool>* cancelled = nullptr) const;
+
+private:
+    // Bytes read at a time while searching
+    static constexpr size_t SEARCH_BLOCK = 1024 * 1024;
+    static constexpr size_t SNIFF_BYTES = 8192;
+
+    std::string filePath;
+    MappedFile file;
+    std::map<uint64_t, uint8_t> patches;
+    // Each overwrite with the patch it replaced, -1 for none
+    std::vector<std::pair<uint64_t, int>> undoLog;
+};
@@ -0,0 +1,519 @@
+#include "HexView.hpp"
+#include "Settings.hpp"
+#include <windowsx.h>
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstdio>
+#include <filesystem>
+
+// "quoted text" as it is, otherwise hex digits two to a byte with any
+// spaces between; empty if neither
+static std::string parseNeedle(const std::string& query) {
+    if (query.size() >= 2 && query.front() == '"') {
+        size_t end = query.back() == '"' ? query.size() - 1 : query.size();
+        return query.substr(1, end - 1);
+    }
+    std::string bytes;
+    int high = -1;
+    for (char c : query) {
+        if (c == ' ') continue;
+        if (!isxdigit(static_cast<unsigned char>(c))) return std::string();
+        int digit = isdigit(static_cast<unsigned char>(c)) ? c - '0' : (toupper(c) - 'A' + 10);
+        if (high < 0) {
+            high = digit;
+        } else {
+            bytes += static_cast<char>(high << 4 | digit);
+            high = -1;
+        }
+    }
+    return high < 0 ? bytes : std::string();
+}
+
+bool HexView::Open(HWND owner, const std::string& path) {
+    HINSTANCE hInstance = GetModuleHandle(NULL);
+    WNDCLASSEXW wc = {};
+    wc.cbSize = sizeof(WNDCLASSEXW);
+    wc.lpfnWndProc = WindowProc;
+    wc.hInstance = hInstance;
+    wc.lpszClassName = CLASS_NAME;
+    wc.hCursor = LoadCursor(nullptr, IDC_ARROW);
+    wc.style = CS_HREDRAW | CS_VREDRAW;
+    // Fails harmlessly once the class is registered
+    RegisterClassExW(&wc);
+
+    HWND hwnd = CreateWindowExW(0, CLASS_NAME, L"Hex", WS_OVERLAPPEDWINDOW | WS_VSCROLL, CW_USEDEFAULT,
+                                CW_USEDEFAULT, 1024, 768, owner, nullptr, hInstance, nullptr);
+    if (hwnd == nullptr) return false;
+    HexView* view = new HexView(hwnd);
+    if (!view->document.open(path)) {
+        delete view;
+        DestroyWindow(hwnd);
+        return false;
+    }
+    view->offsetDigits = view->document.size() > UINT32_MAX ? 16 : 8;
+    SetWindowLongPtr(hwnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(view));
+    view->UpdateTitle();
+    view->UpdateScrollBars();
+    ShowWindow(hwnd, SW_SHOW);
+    return true;
+}
+
+HexView::HexView(HWND hwnd) : hwnd(hwnd) {
+    RECT rect;
+    GetClientRect(hwnd, &rect);
+    clientWidth = rect.right - rect.left;
+    clientHeight = rect.bottom - rect.top;
+    LoadFont();
+}
+
+HexView::~HexView() {
+    CancelSearch();
+}
+
+LRESULT CALLBACK HexView::WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    HexView* view = reinterpret_cast<HexView*>(GetWindowLongPtr(hwnd, GWLP_USERDATA));
+
+    if (view) {
+        return view->HandleMessage(uMsg, wParam, lParam);
+    }
+
+    return DefWindowProc(hwnd, uMsg, wParam, lParam);
+}
+
+LRESULT HexView::HandleMessage(UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    switch (uMsg) {
+        case WM_CLOSE:
+            if (QueryClose()) DestroyWindow(hwnd);
+            return 0;
+
+        case WM_NCDESTROY:
+            SetWindowLongPtr(hwnd, GWLP_USERDATA, 0);
+            delete this;
+            return 0;
+
+        case WM_PAINT: {
+            PAINTSTRUCT ps;
+            HDC hdc = BeginPaint(hwnd, &ps);
+            Paint(hdc);
+            EndPaint(hwnd, &ps);
+            return 0;
+        }
+
+        case WM_ERASEBKGND:
+            // Painting covers the whole client area
+            return 1;
+
+        case WM_HEX_FOUND:
+            TakeSearch();
+            return 0;
+
+        case WM_SIZE:
+            clientWidth = LOWORD(lParam);
+            clientHeight = HIWORD(lParam);
+            ScrollTo(static_cast<long long>(topRow));
+            UpdateScrollBars();
+            return 0;
+
+        case WM_KEYDOWN:
+            HandleKeyDown(wParam);
+            return 0;
+
+        case WM_CHAR:
+            HandleChar(wParam);
+            return 0;
+
+        case WM_LBUTTONDOWN:
+            HandleClick(GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam));
+            return 0;
+
+        case WM_MOUSEWHEEL:
+            ScrollTo(static_cast<long long>(topRow) - GET_WHEEL_DELTA_WPARAM(wParam) / WHEEL_DELTA * WHEEL_ROWS);
+            return 0;
+
+        case WM_VSCROLL: {
+            long long row = static_cast<long long>(topRow);
+            switch (LOWORD(wParam)) {
+                case SB_LINEUP: row--; break;
+                case SB_LINEDOWN: row++; break;
+                case SB_PAGEUP: row -= PageRows(); break;
+                case SB_PAGEDOWN: row += PageRows(); break;
+                case SB_TOP: row = 0; break;
+                case SB_BOTTOM: row = LLONG_MAX / 2; break;
+                case SB_THUMBTRACK:
+                case SB_THUMBPOSITION: {
+                    SCROLLINFO si = { sizeof(SCROLLINFO) };
+                    si.fMask = SIF_TRACKPOS;
+                    GetScrollInfo(hwnd, SB_VERT, &si);
+                    row = static_cast<long long>(si.nTrackPos) << scrollShift;
+                    break;
+                }
+            }
+            ScrollTo(row);
+            return 0;
+        }
+    }
+
+    return DefWindowProc(hwnd, uMsg, wParam, lParam);
+}
+
+void HexView::LoadFont() {
+    Settings& settings = Settings::getInstance();
+
+    HDC hdc = GetDC(hwnd);
+    LOGFONTW lf = { 0 };
+    lf.lfHeight = -MulDiv(settings.fontSize, GetDeviceCaps(hdc, LOGPIXELSY), 72);
+    lf.lfWeight = settings.fontBold ? FW_BOLD : FW_NORMAL;
+    wcscpy_s(lf.lfFaceName, settings.fontName.c_str());
+    hFont = gdi.font(lf);
+
+    HFONT hOldFont = (HFONT)SelectObject(hdc, hFont);
+    TEXTMETRICW tm;
+    GetTextMetricsW(hdc, &tm);
+    charWidth = std::max<int>(tm.tmAveCharWidth, 1);
+    charHeight = std::max<int>(tm.tmHeight + tm.tmExternalLeading, 1);
+    SelectObject(hdc, hOldFont);
+    ReleaseDC(hwnd, hdc);
+}
+
+uint64_t HexView::RowCount() const {
+    return (document.size() + HexDocument::ROW_BYTES - 1) / HexDocument::ROW_BYTES;
+}
+
+int HexView::PageRows() const {
+    // Less the status line
+    return std::max(clientHeight / charHeight - 1, 1);
+}
+
+int HexView::HexX() const {
+    return charWidth / 2 + (offsetDigits + 2) * charWidth;
+}
+
+int HexView::AsciiX() const {
+    return HexX() + static_cast<int>(3 * HexDocument::ROW_BYTES + 2) * charWidth;
+}
+
+void HexView::Paint(HDC hdc) {
+    const Theme& theme = Settings::getInstance().currentTheme;
+    const size_t ROW = HexDocument::ROW_BYTES;
+    HDC memDC = gdi.backBuffer(hwnd, clientWidth, clientHeight);
+    RECT rect = { 0, 0, clientWidth, clientHeight };
+    FillRect(memDC, &rect, gdi.brush(theme.background));
+    HFONT hOldFont = (HFONT)SelectObject(memDC, hFont);
+    SetBkMode(memDC, TRANSPARENT);
+
+    // Every cell is placed by its advance, so any font lines up. Hex digits
+    // come in pairs with a space after each and an extra one mid-row.
+    std::vector<INT> hexAdvances(2 * ROW), cellAdvances(ROW, charWidth);
+    for (size_t i = 0; i < 2 * ROW; i++) {
+        hexAdvances[i] = i % 2 == 0 ? charWidth : i == ROW - 1 ? 3 * charWidth : 2 * charWidth;
+    }
+    auto hexLeft = [&](size_t i) { return HexX() + static_cast<int>(3 * i + (i >= ROW / 2)) * charWidth; };
+
+    // Only the rows on screen are read and formatted
+    uint64_t first = topRow * ROW;
+    size_t rows = static_cast<size_t>(std::min<uint64_t>(PageRows() + 1, RowCount() - std::min(topRow, RowCount())));
+    std::vector<uint8_t> bytes(rows * ROW + ROW, 0);
+    size_t count = document.read(first, rows * ROW, bytes.data());
+    char digits[2 * ROW];
+    char ascii[ROW];
+    char offset[24];
+    for (size_t r = 0; r < rows; r++) {
+        int y = static_cast<int>(r) * charHeight;
+        size_t inRow = std::min(ROW, count - r * ROW);
+        const uint8_t* row = &bytes[r * ROW];
+
+        for (size_t i = 0; i < inRow; i++) {
+            uint64_t at = first + r * ROW + i;
+            bool isCursor = at == cursor;
+            if (!isCursor && !document.patched(at)) continue;
+            COLORREF fill = isCursor ? theme.selection : theme.changed;
+            RECT hexCell = { hexLeft(i), y, hexLeft(i) + 2 * charWidth, y + charHeight };
+            RECT asciiCell = { AsciiX() + static_cast<int>(i) * charWidth, y,
+                               AsciiX() + static_cast<int>(i + 1) * charWidth, y + charHeight };
+            FillRect(memDC, &hexCell, gdi.brush(fill));
+            FillRect(memDC, &asciiCell, gdi.brush(fill));
+            if (!isCursor) continue;
+            // The digit or character being typed over is underlined
+            RECT caret = asciiPane ? asciiCell : hexCell;
+            if (!asciiPane && lowNibble) caret.left += charWidth;
+            if (!asciiPane) caret.right = caret.left + charWidth;
+            caret.top = caret.bottom - 2;
+            FillRect(memDC, &caret, gdi.brush(theme.cursor));
+        }
+
+        snprintf(offset, sizeof(offset), "%0*llX", offsetDigits,
+                 static_cast<unsigned long long>(first + r * ROW));
+        SetTextColor(memDC, theme.lineNumber);
+        ExtTextOutA(memDC, charWidth / 2, y, 0, NULL, offset, offsetDigits, NULL);
+
+        HexDocument::encodeRow(row, digits);
+        for (size_t i = 0; i < inRow; i++) ascii[i] = row[i] >= 32 && row[i] < 127 ? static_cast<char>(row[i]) : '.';
+        SetTextColor(memDC, theme.text);
+        ExtTextOutA(memDC, HexX(), y, 0, NULL, digits, static_cast<UINT>(2 * inRow), hexAdvances.data());
+        ExtTextOutA(memDC, AsciiX(), y, 0, NULL, ascii, static_cast<UINT>(inRow), cellAdvances.data());
+    }
+
+    // Status line: where the cursor is, or the search being typed
+    RECT status = { 0, clientHeight - charHeight, clientWidth, clientHeight };
+    FillRect(memDC, &status, gdi.brush(theme.statusBar));
+    std::string text;
+    if (typingQuery) {
+        text = " Find hex bytes or \"text\": " + query + "_";
+    } else {
+        char position[96];
+        snprintf(position, sizeof(position), " Offset: %llX of %llX", static_cast<unsigned long long>(cursor),
+                 static_cast<unsigned long long>(document.size()));
+        text = position;
+        text += asciiPane ? " | ASCII" : " | Hex";
+        if (searcher.joinable()) text += " | Searching... (Esc to stop)";
+        if (document.modified()) text += " | Modified (Ctrl+S saves)";
+    }
+    SetTextColor(memDC, theme.statusText);
+    ExtTextOutA(memDC, 0, status.top, ETO_CLIPPED, &status, text.data(), static_cast<UINT>(text.length()), NULL);
+
+    SelectObject(memDC, hOldFont);
+    BitBlt(hdc, 0, 0, clientWidth, clientHeight, memDC, 0, 0, SRCCOPY);
+}
+
+void HexView::HandleKeyDown(WPARAM wParam) {
+    bool ctrl = (GetKeyState(VK_CONTROL) & 0x8000) != 0;
+    bool shift = (GetKeyState(VK_SHIFT) & 0x8000) != 0;
+    long long at = static_cast<long long>(cursor);
+    long long row = static_cast<long long>(HexDocument::ROW_BYTES);
+    if (typingQuery) {
+        if (wParam == VK_ESCAPE) {
+            typingQuery = false;
+            InvalidateRect(hwnd, NULL, FALSE);
+        }
+        return;
+    }
+    switch (wParam) {
+        case VK_LEFT:
+            // A digit at a time in the hex pane
+            if (!asciiPane && lowNibble) {
+                lowNibble = false;
+                InvalidateRect(hwnd, NULL, FALSE);
+            } else if (at > 0) {
+                lowNibble = !asciiPane;
+                MoveCursor(at - 1);
+            }
+            break;
+        case VK_RIGHT:
+            if (!asciiPane && !lowNibble) {
+                lowNibble = true;
+                InvalidateRect(hwnd, NULL, FALSE);
+            } else {
+                lowNibble = false;
+                MoveCursor(at + 1);
+            }
+            break;
+        case VK_UP: MoveCursor(at - row); break;
+        case VK_DOWN: MoveCursor(at + row); break;
+        case VK_PRIOR: MoveCursor(at - row * PageRows()); break;
+        case VK_NEXT: MoveCursor(at + row * PageRows()); break;
+        case VK_HOME: MoveCursor(ctrl ? 0 : at - at % row); break;
+        case VK_END: MoveCursor(ctrl ? LLONG_MAX / 2 : at - at % row + row - 1); break;
+        case VK_TAB:
+            asciiPane = !asciiPane;
+            lowNibble = false;
+            InvalidateRect(hwnd, NULL, FALSE);
+            break;
+        case VK_F3:
+            if (!needle.empty()) StartSearch(!shift);
+            break;
+        case 'F':
+            if (ctrl && !searcher.joinable()) {
+                typingQuery = true;
+                query.clear();
+                InvalidateRect(hwnd, NULL, FALSE);
+            }
+            break;
+        case 'S':
+            if (ctrl) Save();
+            break;
+        case 'Z': {
+            uint64_t undone;
+            if (ctrl && !searcher.joinable() && document.undo(undone)) {
+                lowNibble = false;
+                MoveCursor(static_cast<long long>(undone));
+                UpdateTitle();
+                InvalidateRect(hwnd, NULL, FALSE);
+            }
+            break;
+        }
+        case VK_ESCAPE:
+            if (searcher.joinable()) {
+                CancelSearch();
+                InvalidateRect(hwnd, NULL, FALSE);
+            } else {
+                SendMessage(hwnd, WM_CLOSE, 0, 0);
+            }
+            break;
+    }
+}
+
+void HexView::HandleChar(WPARAM wParam) {
+    if (typingQuery) {
+        if (wParam == VK_RETURN) {
+            typingQuery = false;
+            std::string parsed = parseNeedle(query);
+            if (parsed.empty()) {
+                MessageBeep(MB_OK);
+            } else {
+                needle = parsed;
+                StartSearch(true);
+            }
+        } else if (wParam == VK_BACK) {
+            if (!query.empty()) query.pop_back();
+        } else if (wParam >= 32 && wParam < 127) {
+            query += static_cast<char>(wParam);
+        }
+        InvalidateRect(hwnd, NULL, FALSE);
+        return;
+    }
+    if (wParam < 32 || wParam >= 127) return;
+    if (asciiPane) {
+        Overwrite(static_cast<uint8_t>(wParam));
+        return;
+    }
+    if (!isxdigit(static_cast<int>(wParam))) return;
+    int digit = isdigit(static_cast<int>(wParam)) ? static_cast<int>(wParam) - '0'
+                                                  : toupper(static_cast<int>(wParam)) - 'A' + 10;
+    uint8_t byte = 0;
+    if (document.read(cursor, 1, &byte) == 0) return;
+    Overwrite(static_cast<uint8_t>(lowNibble ? (byte & 0xf0) | digit : (byte & 0x0f) | digit << 4));
+}
+
+void HexView::HandleClick(int x, int y) {
+    const long long ROW = static_cast<long long>(HexDocument::ROW_BYTES);
+    if (y >= clientHeight - charHeight) return;
+    long long row = static_cast<long long>(topRow) + y / charHeight;
+    long long byte;
+    if (x >= AsciiX()) {
+        byte = std::min<long long>((x - AsciiX()) / charWidth, ROW - 1);
+        asciiPane = true;
+        lowNibble = false;
+    } else {
+        // Three columns a byte, with the gap mid-row
+        long long column = std::max(0, x - HexX()) / charWidth;
+        if (column >= 3 * ROW / 2) column--;
+        byte = std::min(column / 3, ROW - 1);
+        asciiPane = false;
+        lowNibble = column % 3 == 1;
+    }
+    MoveCursor(row * ROW + byte);
+    InvalidateRect(hwnd, NULL, FALSE);
+}
+
+void HexView::Overwrite(uint8_t value) {
+    // The search reads the patches
+    if (searcher.joinable() || document.size() == 0) {
+        MessageBeep(MB_OK);
+        return;
+    }
+    document.overwrite(cursor, value);
+    if (!asciiPane && !lowNibble) {
+        lowNibble = true;
+    } else {
+        lowNibble = false;
+        MoveCursor(static_cast<long long>(cursor) + 1);
+    }
+    UpdateTitle();
+    InvalidateRect(hwnd, NULL, FALSE);
+}
+
+void HexView::StartSearch(bool forward) {
+    if (searcher.joinable()) return;
+    // From just past the cursor either way, so repeating finds the next one
+    uint64_t from = forward ? cursor + 1 : cursor;
+    searchCancelled = false;
+    searchDone = false;
+    searcher = std::thread([this, from, forward] {
+        found = document.find(needle, from, forward, &searchCancelled);
+        searchDone = true;
+        PostMessage(hwnd, WM_HEX_FOUND, 0, 0);
+    });
+    InvalidateRect(hwnd, NULL, FALSE);
+}
+
+void HexView::TakeSearch() {
+    if (!searchDone) return;
+    searcher.join();
+    searchDone = false;
+    if (found == HexDocument::npos) {
+        MessageBeep(MB_OK);
+    } else {
+        asciiPane = false;
+        lowNibble = false;
+        MoveCursor(static_cast<long long>(found));
+    }
+    InvalidateRect(hwnd, NULL, FALSE);
+}
+
+void HexView::CancelSearch() {
+    searchCancelled = true;
+    if (searcher.joinable()) searcher.join();
+    searchDone = false;
+}
+
+bool HexView::Save() {
+    CancelSearch();
+    if (!document.save()) {
+        MessageBoxW(hwnd, L"The changes could not be written to the file.", L"Save", MB_OK | MB_ICONERROR);
+        return false;
+    }
+    UpdateTitle();
+    InvalidateRect(hwnd, NULL, FALSE);
+    return true;
+}
+
+bool HexView::QueryClose() {
+    if (!document.modified()) return true;
+    switch (MessageBoxW(hwnd, L"Save the changed bytes?", L"Hex", MB_YESNOCANCEL | MB_ICONQUESTION)) {
+        case IDYES: return Save();
+        case IDNO: return true;
+        default: return false;
+    }
+}
+
+void HexView::MoveCursor(long long offset) {
+    long long last = std::max<long long>(static_cast<long long>(document.size()) - 1, 0);
+    cursor = static_cast<uint64_t>(std::max(0LL, std::min(offset, last)));
+    // Keep the cursor's row on screen
+    long long row = static_cast<long long>(cursor / HexDocument::ROW_BYTES);
+    long long top = static_cast<long long>(topRow);
+    if (row < top) {
+        ScrollTo(row);
+    } else if (row >= top + PageRows()) {
+        ScrollTo(row - PageRows() + 1);
+    }
+    InvalidateRect(hwnd, NULL, FALSE);
+}
+
+void HexView::ScrollTo(long long row) {
+    long long maxRow = std::max<long long>(static_cast<long long>(RowCount()) - PageRows(), 0);
+    row = std::max(0LL, std::min(row, maxRow));
+    if (static_cast<uint64_t>(row) == topRow) return;
+    topRow = static_cast<uint64_t>(row);
+    UpdateScrollBars();
+    InvalidateRect(hwnd, NULL, FALSE);
+}
+
+void HexView::UpdateScrollBars() {
+    scrollShift = 0;
+    while ((RowCount() >> scrollShift) > INT_MAX) scrollShift++;
+    SCROLLINFO si = { sizeof(SCROLLINFO) };
+    si.fMask = SIF_RANGE | SIF_PAGE | SIF_POS;
+    si.nMin = 0;
+    si.nMax = static_cast<int>(RowCount() >> scrollShift);
+    si.nPage = std::max(PageRows() >> scrollShift, 1);
+    si.nPos = static_cast<int>(topRow >> scrollShift);
+    SetScrollInfo(hwnd, SB_VERT, &si, TRUE);
+}
+
+void HexView::UpdateTitle() {
+    std::wstring title = L"Hex: " + std::filesystem::path(document.path()).wstring();
+    if (document.modified()) title += L" *";
+    SetWindowTextW(hwnd, title.c_str());
+}
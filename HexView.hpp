@@ -0,0 +1,80 @@
+#pragma once
+#include <windows.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "GdiCache.hpp"
+#include "HexDocument.hpp"
+
+// Posted to a hex window once its worker has finished a search
+constexpr UINT WM_HEX_FOUND = WM_APP + 5;
+
+// Offsets, hex and ASCII of a mapped file in a window of its own. Only the
+// rows on screen are ever read and formatted, so any size opens at once.
+// Typing overwrites bytes, kept as patches until saved. Ctrl+F searches
+// for hex bytes or "quoted text" on a worker thread.
+class HexView {
+public:
+    // False if the file cannot be mapped; the window deletes itself when
+    // closed
+    static bool Open(HWND owner, const std::string& path);
+    static LRESULT CALLBACK WindowProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
+
+private:
+    HexView(HWND hwnd);
+    ~HexView();
+    LRESULT HandleMessage(UINT uMsg, WPARAM wParam, LPARAM lParam);
+    void LoadFont();
+    void Paint(HDC hdc);
+    void HandleKeyDown(WPARAM wParam);
+    void HandleChar(WPARAM wParam);
+    void HandleClick(int x, int y);
+    void StartSearch(bool forward);
+    void TakeSearch();
+    void CancelSearch();
+    void Overwrite(uint8_t value);
+    bool Save();
+    bool QueryClose();
+    void MoveCursor(long long offset);
+    void ScrollTo(long long row);
+    void UpdateScrollBars();
+    void UpdateTitle();
+    uint64_t RowCount() const;
+    int PageRows() const;
+    int HexX() const;
+    int AsciiX() const;
+
+    HWND hwnd;
+    HexDocument document;
+
+    // Byte under the cursor, and in the hex pane which of its digits
+    uint64_t cursor = 0;
+    bool lowNibble = false;
+    bool asciiPane = false;
+
+    // What Ctrl+F is typing, shown in the status line until Enter
+    bool typingQuery = false;
+    std::string query;
+    std::string needle;
+
+    // The document is read-only while a search runs over it
+    std::thread searcher;
+    std::atomic<bool> searchDone{ false };
+    std::atomic<bool> searchCancelled{ false };
+    uint64_t found = HexDocument::npos;
+
+    GdiCache gdi;
+    HFONT hFont = nullptr;
+    int charWidth = 0;
+    int charHeight = 0;
+    int clientWidth = 0;
+    int clientHeight = 0;
+    int offsetDigits = 8;
+    uint64_t topRow = 0;
+    // Scroll bars only take an int; rows are divided down to fit
+    int scrollShift = 0;
+
+    static constexpr const wchar_t* CLASS_NAME = L"HoodRDHexView";
+    static constexpr int WHEEL_ROWS = 3;
+};
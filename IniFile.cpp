@@ -0,0 +1,220 @@
+#include "IniFile.hpp"
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <cwchar>
+#include <cwctype>
+
+static void appendCodePoint(std::wstring& out, char32_t c) {
+    if (sizeof(wchar_t) == 2 && c >= 0x10000) {
+        c -= 0x10000;
+        out += static_cast<wchar_t>(0xD800 + (c >> 10));
+        out += static_cast<wchar_t>(0xDC00 + (c & 0x3FF));
+    } else {
+        out += static_cast<wchar_t>(c);
+    }
+}
+
+// Invalid bytes come through as U+FFFD rather than stopping the parse
+static std::wstring fromUtf8(const std::string& bytes, size_t start) {
+    std::wstring out;
+    out.reserve(bytes.length() - start);
+    for (size_t i = start; i < bytes.length();) {
+        unsigned char lead = static_cast<unsigned char>(bytes[i]);
+        size_t extra = lead < 0x80 ? 0 : (lead >> 5) == 0x6 ? 1 : (lead >> 4) == 0xE ? 2 : (lead >> 3) == 0x1E ? 3 : 4;
+        bool valid = extra < 4 && i + extra < bytes.length();
+        char32_t c = extra == 0 ? lead : lead & (0x3F >> extra);
+        for (size_t k = 1; valid && k <= extra; k++) {
+            unsigned char next = static_cast<unsigned char>(bytes[i + k]);
+            valid = (next & 0xC0) == 0x80;
+            c = (c << 6) | (next & 0x3F);
+        }
+        if (valid) {
+            appendCodePoint(out, c);
+            i += extra + 1;
+        } else {
+            out += L'\xFFFD';
+            i++;
+        }
+    }
+    return out;
+}
+
+static std::wstring fromUtf16(const std::string& bytes, size_t start) {
+    std::wstring out;
+    out.reserve((bytes.length() - start) / 2);
+    for (size_t i = start; i + 1 < bytes.length(); i += 2) {
+        char32_t unit = static_cast<unsigned char>(bytes[i]) | (static_cast<unsigned char>(bytes[i + 1]) << 8);
+        if (unit >= 0xD800 && unit < 0xDC00 && i + 3 < bytes.length()) {
+            char32_t low = static_cast<unsigned char>(bytes[i + 2]) | (static_cast<unsigned char>(bytes[i + 3]) << 8);
+            if (low >= 0xDC00 && low < 0xE000) {
+                appendCodePoint(out, 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00));
+                i += 2;
+                continue;
+            }
+        }
+        appendCodePoint(out, unit);
+    }
+    return out;
+}
+
+static void appendUtf8(std::string& out, const std::wstring& text) {
+    for (size_t i = 0; i < text.length(); i++) {
+        char32_t c = static_cast<char32_t>(text[i]);
+        if (sizeof(wchar_t) == 2 && c >= 0xD800 && c < 0xDC00 && i + 1 < text.length()) {
+            c = 0x10000 + ((c - 0xD800) << 10) + (static_cast<char32_t>(text[++i]) - 0xDC00);
+        }
+        if (c < 0x80) {
+            out += static_cast<char>(c);
+        } else if (c < 0x800) {
+            out += static_cast<char>(0xC0 | (c >> 6));
+            out += static_cast<char>(0x80 | (c & 0x3F));
+        } else if (c < 0x10000) {
+            out += static_cast<char>(0xE0 | (c >> 12));
+            out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (c & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (c >> 18));
+            out += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (c & 0x3F));
+        }
+    }
+}
+
+static std::wstring trim(const std::wstring& text) {
+    size_t begin = 0;
+    size_t end = text.length();
+    while (begin < end && std::iswspace(text[begin])) begin++;
+    while (end > begin && std::iswspace(text[end - 1])) end--;
+    return text.substr(begin, end - begin);
+}
+
+// Section and key names match regardless of case, as in the profile API
+static bool sameName(const std::wstring& a, const std::wstring& b) {
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](wchar_t x, wchar_t y) {
+        return std::towlower(x) == std::towlower(y);
+    });
+}
+
+bool IniFile::load(const std::filesystem::path& path) {
+    sections.clear();
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) return !std::filesystem::exists(path);
+    std::string bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    parse(bytes);
+    return true;
+}
+
+bool IniFile::save(const std::filesystem::path& path) const {
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+
+    std::filesystem::path temp = path;
+    temp += L".tmp";
+    {
+        std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) return false;
+        std::string bytes = serialize();
+        file.write(bytes.data(), static_cast<std::streamsize>(bytes.length()));
+        if (!file.flush()) return false;
+    }
+    std::filesystem::rename(temp, path, ec);
+    if (!ec) return true;
+    std::error_code ignored;
+    std::filesystem::remove(temp, ignored);
+    return false;
+}
+
+void IniFile::parse(const std::string& bytes) {
+    sections.clear();
+    std::wstring text;
+    if (bytes.compare(0, 2, "\xFF\xFE") == 0) {
+        text = fromUtf16(bytes, 2);
+    } else {
+        text = fromUtf8(bytes, bytes.compare(0, 3, "\xEF\xBB\xBF") == 0 ? 3 : 0);
+    }
+
+    Section* current = nullptr;
+    size_t pos = 0;
+    while (pos < text.length()) {
+        size_t end = text.find(L'\n', pos);
+        if (end == std::wstring::npos) end = text.length();
+        std::wstring line = trim(text.substr(pos, end - pos));
+        pos = end + 1;
+
+        if (line.empty() || line[0] == L';' || line[0] == L'#') continue;
+        if (line[0] == L'[') {
+            size_t close = line.find(L']');
+            std::wstring name = trim(line.substr(1, close == std::wstring::npos ? std::wstring::npos : close - 1));
+            auto found = std::find_if(sections.begin(), sections.end(),
+                                      [&](const Section& section) { return sameName(section.name, name); });
+            if (found == sections.end()) {
+                sections.push_back({ name, {} });
+                current = &sections.back();
+            } else {
+                current = &*found;
+            }
+            continue;
+        }
+        size_t equals = line.find(L'=');
+        if (!current || equals == std::wstring::npos) continue;
+        std::wstring key = trim(line.substr(0, equals));
+        std::wstring value = trim(line.substr(equals + 1));
+        // Like the profile API, a quoted value loses its quotes
+        if (value.length() >= 2 && value.front() == L'"' && value.back() == L'"') {
+            value = value.substr(1, value.length() - 2);
+        }
+        set(current->name, key, value);
+    }
+}
+
+std::string IniFile::serialize() const {
+    std::string out;
+    for (const auto& section : sections) {
+        if (!out.empty()) out += "\r\n";
+        out += "[";
+        appendUtf8(out, section.name);
+        out += "]\r\n";
+        for (const auto& entry : section.entries) {
+            appendUtf8(out, entry.key);
+            out += "=";
+            appendUtf8(out, entry.value);
+            out += "\r\n";
+        }
+    }
+    return out;
+}
+
+const std::wstring* IniFile::find(const std::wstring& section, const std::wstring& key) const {
+    for (const auto& candidate : sections) {
+        if (!sameName(candidate.name, section)) continue;
+        for (const auto& entry : candidate.entries) {
+            if (sameName(entry.key, key)) return &entry.value;
+        }
+    }
+    return nullptr;
+}
+
+void IniFile::set(const std::wstring& section, const std::wstring& key, const std::wstring& value) {
+    auto found = std::find_if(sections.begin(), sections.end(),
+                              [&](const Section& candidate) { return sameName(candidate.name, section); });
+    if (found == sections.end()) {
+        sections.push_back({ section, {} });
+        found = sections.end() - 1;
+    }
+    for (auto& entry : found->entries) {
+        if (sameName(entry.key, key)) {
+            entry.value = value;
+            return;
+        }
+    }
+    found->entries.push_back({ key, value });
+}
+
+int IniFile::toInt(const std::wstring& text, int fallback, int low, int high) {
+    wchar_t* end = nullptr;
+    long long value = wcstoll(text.c_str(), &end, 10);
+    if (end == text.c_str()) value = fallback;
+    return static_cast<int>(std::clamp<long long>(value, low, high));
+}
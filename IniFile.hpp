@@ -0,0 +1,41 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <filesystem>
+
+// An INI file read into memory in one go and written back in one go. It
+// reads UTF-8 (with or without a BOM) and UTF-16LE with a BOM, the form
+// the Windows profile API writes, and always writes UTF-8. Sections and
+// keys keep their order and unknown ones are kept; comments are not.
+// Nothing here depends on Windows.
+class IniFile {
+public:
+    // A missing file loads as an empty one
+    bool load(const std::filesystem::path& path);
+    // Writes a temporary file next to `path` and renames it over, so a
+    // crash or a reader never sees half a file
+    bool save(const std::filesystem::path& path) const;
+
+    void parse(const std::string& bytes);
+    std::string serialize() const;
+
+    // Null when the key is not there
+    const std::wstring* find(const std::wstring& section, const std::wstring& key) const;
+    void set(const std::wstring& section, const std::wstring& key, const std::wstring& value);
+
+    // A value as a whole number kept within [low, high], or `fallback` if
+    // it does not start with one
+    static int toInt(const std::wstring& text, int fallback, int low, int high);
+
+private:
+    struct Entry {
+        std::wstring key;
+        std::wstring value;
+    };
+    struct Section {
+        std::wstring name;
+        std::vector<Entry> entries;
+    };
+
+    std::vector<Section> sections;
+};
@@ -0,0 +1,152 @@
+#include "LayoutCache.hpp"
+#include "MemoryStats.hpp"
+#include <algorithm>
+#include <iterator>
+
+void GlyphTable::measure(const char* text, size_t length, const ColumnStops& columns, int32_t* offsets) const {
+    int32_t pos = 0;
+    offsets[0] = 0;
+    size_t field = 0;
+    bool quoted = false;
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        pos = next(pos, c);
+        if (columns.delimiter) {
+            if (c == '"') {
+                quoted = !quoted;
+            } else if (c == static_cast<unsigned char>(columns.delimiter) && !quoted &&
+                       ++field < columns.starts.size()) {
+                pos = std::max(pos, columns.starts[field]);
+            }
+        }
+        offsets[i + 1] = pos;
+    }
+}
+
+LayoutCache::LayoutCache(const TextBuffer& buffer) : buffer(buffer), entries(buffer.lineCount()) {
+}
+
+void LayoutCache::reset(const GlyphMetrics& metrics, int tabSize) {
+    metrics.advances(glyphs.advance);
+
+    // Printable ASCII stands in for the glyphs of lines too long to measure
+    int total = 0;
+    for (int c = 32; c < 127; c++) total += glyphs.advance[c];
+    glyphs.average = std::max(total / 95, 1);
+    glyphs.tabWidth = std::max(std::max(tabSize, 1) * glyphs.advance[' '], 1);
+
+    entries.assign(buffer.lineCount(), Entry());
+    measuredColumns = 0;
+}
+
+void LayoutCache::setColumns(const ColumnStops& stops) {
+    if (stops == columns) return;
+    columns = stops;
+    entries.assign(buffer.lineCount(), Entry());
+    measuredColumns = 0;
+}
+
+long long LayoutCache::x(size_t line, size_t col) {
+    const TextLine& text = buffer.line(line);
+    col = std::min(col, text.length());
+    if (text.chunked()) return static_cast<long long>(col) * glyphs.average;
+    return measure(line)[col];
+}
+
+size_t LayoutCache::columnAt(size_t line, long long x) {
+    const TextLine& text = buffer.line(line);
+    if (x <= 0) return 0;
+    if (text.chunked()) return std::min(static_cast<size_t>(x / glyphs.average), text.length());
+
+    const std::vector<int32_t>& offsets = measure(line);
+    size_t col = std::upper_bound(offsets.begin(), offsets.end(), x) - offsets.begin();
+    return std::min(col - 1, text.length());
+}
+
+size_t LayoutCache::hitTest(size_t line, long long x) {
+    size_t col = columnAt(line, x);
+    if (col >= buffer.line(line).length()) return col;
+    // Past the middle of a glyph counts as after it
+    long long left = this->x(line, col);
+    long long right = this->x(line, col + 1);
+    return x - left > right - x ? col + 1 : col;
+}
+
+long long LayoutCache::width(size_t line) const {
+    const TextLine& text = buffer.line(line);
+    if (line < entries.size() && entries[line].measured && !text.chunked()) {
+        return entries[line].offsets.back();
+    }
+    return static_cast<long long>(text.length()) * glyphs.average;
+}
+
+size_t LayoutCache::memoryUsage() const {
+    size_t bytes = MemoryStats::heapBytes(entries) + MemoryStats::heapBytes(columns.starts);
+    for (const Entry& entry : entries) bytes += MemoryStats::heapBytes(entry.offsets);
+    return bytes;
+}
+
+void LayoutCache::linesChanged(const std::vector<LineChange>& changes) {
+    MemoryStats::Scope scope(MemoryStats::Layout);
+    if (changes.empty()) return;
+
+    // Typing, even at thousands of carets, keeps the line count: the
+    // changed lines are forgotten where they are
+    bool sameCount = std::all_of(changes.begin(), changes.end(),
+                                 [](const LineChange& change) { return change.removed == change.inserted; });
+    if (sameCount) {
+        for (const auto& change : changes) {
+            size_t last = std::min(change.first + change.removed + 1, entries.size());
+            for (size_t i = std::min(change.first, last); i < last; i++) forget(entries[i]);
+        }
+        return;
+    }
+
+    // Otherwise everything from the first change on is rebuilt once: kept
+    // entries move across and each change's lines give way to unmeasured ones
+    size_t start = std::min(changes.front().first, entries.size());
+    std::vector<Entry> tail;
+    tail.reserve(entries.size() - start);
+    size_t next = start; // First old entry not yet moved or dropped
+    for (const auto& change : changes) {
+        size_t at = change.first - std::min(change.first, start);
+        while (tail.size() < at && next < entries.size()) tail.push_back(std::move(entries[next++]));
+        at = std::min(at, tail.size());
+
+        // The replaced lines start with any an earlier change in the batch put there
+        size_t replaced = change.removed + 1;
+        size_t moved = std::min(tail.size() - at, replaced);
+        for (size_t i = at; i < at + moved; i++) forget(tail[i]);
+        tail.erase(tail.begin() + at, tail.begin() + at + moved);
+        size_t dropped = std::min(replaced - moved, entries.size() - next);
+        for (size_t i = next; i < next + dropped; i++) forget(entries[i]);
+        next += dropped;
+        tail.insert(tail.begin() + at, change.inserted + 1, Entry());
+    }
+    tail.insert(tail.end(), std::make_move_iterator(entries.begin() + next), std::make_move_iterator(entries.end()));
+    entries.resize(start);
+    entries.insert(entries.end(), std::make_move_iterator(tail.begin()), std::make_move_iterator(tail.end()));
+}
+
+void LayoutCache::forget(Entry& entry) {
+    measuredColumns -= entry.offsets.size();
+    entry = Entry();
+}
+
+const std::vector<int32_t>& LayoutCache::measure(size_t line) {
+    Entry& entry = entries[line];
+    if (entry.measured) return entry.offsets;
+    MemoryStats::Scope scope(MemoryStats::Layout);
+
+    const std::string& text = buffer.line(line).scannable();
+    if (measuredColumns + text.length() + 1 > MAX_MEASURED) {
+        for (auto& other : entries) other = Entry();
+        measuredColumns = 0;
+    }
+
+    entry.offsets.resize(text.length() + 1);
+    glyphs.measure(text.data(), text.length(), columns, entry.offsets.data());
+    entry.measured = true;
+    measuredColumns += entry.offsets.size();
+    return entry.offsets;
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "TextBuffer.hpp"
+
+// Where glyph widths come from, so the layout does not depend on GDI
+class GlyphMetrics {
+public:
+    virtual ~GlyphMetrics() = default;
+    // Advance width in pixels of each byte value 0-255
+    virtual void advances(int* widths) const = 0;
+};
+
+// Where the fields of delimited text start, for lining up columns. With
+// no delimiter lines lay out as they are.
+struct ColumnStops {
+    char delimiter = 0;
+    std::vector<int32_t> starts; // x of each field; starts[0] is 0
+
+    bool operator==(const ColumnStops& other) const {
+        return delimiter == other.delimiter && starts == other.starts;
+    }
+    bool operator!=(const ColumnStops& other) const { return !(*this == other); }
+};
+
+// Advances of one font with the tab size applied
+struct GlyphTable {
+    int advance[256] = {};
+    int average = 1;
+    int tabWidth = 1;
+
+    // Where the glyph for `c` starting at `x` ends; tabs run to the next stop
+    int32_t next(int32_t x, unsigned char c) const {
+        return c == '\t' ? (x / tabWidth + 1) * tabWidth : x + advance[c];
+    }
+
+    // Offsets of all length + 1 column boundaries of a line. With column
+    // stops, a delimiter outside quotes stretches to where the next field
+    // starts.
+    void measure(const char* text, size_t length, const ColumnStops& columns, int32_t* offsets) const;
+};
+
+// Pixel offsets of every column boundary in a line, measured on first use
+// and kept until the line changes. Mapping a column to x is a lookup and x
+// to a column a binary search. Chunked lines are laid out at a fixed
+// average advance instead, as measuring them would cost more than the text.
+class LayoutCache : public TextBufferListener {
+public:
+    explicit LayoutCache(const TextBuffer& buffer);
+
+    // New font or tab size: every line has to be measured again
+    void reset(const GlyphMetrics& metrics, int tabSize);
+    // Lines up delimited columns, or stops with empty stops
+    void setColumns(const ColumnStops& stops);
+
+    long long x(size_t line, size_t col);
+    // The column whose glyph covers `x`, and the boundary nearest to it
+    size_t columnAt(size_t line, long long x);
+    size_t hitTest(size_t line, long long x);
+    // Exact once the line has been measured, estimated from its length before
+    long long width(size_t line) const;
+    const GlyphTable& glyphTable() const { return glyphs; }
+    const ColumnStops& columnStops() const { return columns; }
+    size_t memoryUsage() const;
+
+    void linesChanged(const std::vector<LineChange>& changes) override;
+
+private:
+    // Measured columns kept at most before everything is dropped and the
+    // lines on screen measured again
+    static constexpr size_t MAX_MEASURED = 8 * 1024 * 1024;
+
+    struct Entry {
+        std::vector<int32_t> offsets; // length + 1 entries once measured
+        bool measured = false;
+    };
+
+    const std::vector<int32_t>& measure(size_t line);
+    void forget(Entry& entry);
+
+    const TextBuffer& buffer;
+    std::vector<Entry> entries;
+    GlyphTable glyphs;
+    ColumnStops columns;
+    size_t measuredColumns = 0;
+};
@@ -0,0 +1,376 @@
+#include "LineDiff.hpp"
+#include <string_view>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+using Index = std::ptrdiff_t;
+
+// Word-at-a-time hash; lines are hashed exactly once per diff
+uint64_t hashLine(std::string_view text) {
+    const uint64_t k = 0x9E3779B97F4A7C15ull;
+    uint64_t h = text.size() * k;
+    size_t i = 0;
+    for (; i + 8 <= text.size(); i += 8) {
+        uint64_t word;
+        memcpy(&word, text.data() + i, 8);
+        h = (h ^ word) * k;
+        h ^= h >> 29;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, text.data() + i, text.size() - i);
+    h = (h ^ tail) * k;
+    return h ^ (h >> 32);
+}
+
+// Assigns the same id to equal lines using an open-addressing table
+class LineInterner {
+public:
+    explicit LineInterner(size_t expected) {
+        size_t capacity = 16;
+        while (capacity < expected * 2) capacity <<= 1;
+        slots.assign(capacity, Slot());
+        mask = capacity - 1;
+    }
+
+    // The table is far bigger than the caches for large files; callers that
+    // know the next hashes fetch their slots early
+    void prefetch(uint64_t hash) const { __builtin_prefetch(&slots[hash & mask]); }
+
+    uint32_t intern(std::string_view line, uint64_t hash) {
+        uint32_t check = static_cast<uint32_t>(hash >> 32);
+        for (size_t slot = hash & mask;; slot = (slot + 1) & mask) {
+            Slot& entry = slots[slot];
+            if (entry.id == 0) {
+                samples.push_back(line);
+                entry.id = static_cast<uint32_t>(samples.size());
+                entry.check = check;
+                return entry.id - 1;
+            }
+            if (entry.check == check && samples[entry.id - 1] == line) return entry.id - 1;
+        }
+    }
+
+    size_t size() const { return samples.size(); }
+
+private:
+    // Id plus 1 (0 marks a free slot) and high hash bits to skip most compares
+    struct Slot {
+        uint32_t id = 0;
+        uint32_t check = 0;
+    };
+
+    std::vector<Slot> slots;
+    std::vector<std::string_view> samples;
+    size_t mask = 0;
+};
+
+// Lines of one side that can still match, as ids plus their document index
+struct Side {
+    std::vector<uint32_t> ids;
+    std::vector<size_t> index;
+};
+
+// Divide-and-conquer Myers diff over two id sequences in O(N + M) space
+class Myers {
+public:
+    Myers(const Side& a, const Side& b, std::vector<char>& changedA, std::vector<char>& changedB,
+          const std::atomic<bool>* cancelled)
+        : a(a), b(b), changedA(changedA), changedB(changedB), cancelled(cancelled) {
+        Index n = static_cast<Index>(a.ids.size());
+        Index m = static_cast<Index>(b.ids.size());
+        forward.resize(n + m + 3);
+        backward.resize(n + m + 3);
+        offset = m + 1;
+
+        // Beyond this many edit steps a split is good enough; keeps huge
+        // unrelated inputs from going quadratic
+        tooExpensive = std::max<Index>(256, static_cast<Index>(std::sqrt(static_cast<double>(n + m))));
+        budget = BUDGET_PER_LINE * (n + m);
+    }
+
+    // False if cancelled part way
+    bool run() {
+        struct Box { Index xoff, xlim, yoff, ylim; };
+        std::vector<Box> pending = { { 0, static_cast<Index>(a.ids.size()), 0, static_cast<Index>(b.ids.size()) } };
+
+        while (!pending.empty()) {
+            if (cancelled && *cancelled) return false;
+            Box box = pending.back();
+            pending.pop_back();
+
+            // Slide over matching lines at both ends
+            while (box.xoff < box.xlim && box.yoff < box.ylim && a.ids[box.xoff] == b.ids[box.yoff]) {
+                box.xoff++;
+                box.yoff++;
+            }
+            while (box.xoff < box.xlim && box.yoff < box.ylim && a.ids[box.xlim - 1] == b.ids[box.ylim - 1]) {
+                box.xlim--;
+                box.ylim--;
+            }
+
+            // Once the whole diff has cost too much, what is left is
+            // replaced wholesale
+            if (box.xoff == box.xlim || box.yoff == box.ylim || spent > budget) {
+                markChanged(box.xoff, box.xlim, box.yoff, box.ylim);
+                continue;
+            }
+
+            Index xmid, ymid;
+            split(box.xoff, box.xlim, box.yoff, box.ylim, xmid, ymid);
+            bool atStart = xmid == box.xoff && ymid == box.yoff;
+            bool atEnd = xmid == box.xlim && ymid == box.ylim;
+            if (atStart || atEnd) {
+                // Heuristic split made no progress; give up on this box
+                markChanged(box.xoff, box.xlim, box.yoff, box.ylim);
+                continue;
+            }
+            pending.push_back({ xmid, box.xlim, ymid, box.ylim });
+            pending.push_back({ box.xoff, xmid, box.yoff, ymid });
+        }
+        return true;
+    }
+
+private:
+    Index& fd(Index diagonal) { return forward[diagonal + offset]; }
+    Index& bd(Index diagonal) { return backward[diagonal + offset]; }
+
+    void markChanged(Index xoff, Index xlim, Index yoff, Index ylim) {
+        for (Index x = xoff; x < xlim; x++) changedA[a.index[x]] = 1;
+        for (Index y = yoff; y < ylim; y++) changedB[b.index[y]] = 1;
+    }
+
+    // Finds a point on an optimal (or, past the cost cap, a good) path
+    // through the box by searching from both corners at once
+    void split(Index xoff, Index xlim, Index yoff, Index ylim, Index& xmid, Index& ymid) {
+        const Index dmin = xoff - ylim;
+        const Index dmax = xlim - yoff;
+        const Index fmid = xoff - yoff;
+        const Index bmid = xlim - ylim;
+        Index fmin = fmid, fmax = fmid;
+        Index bmin = bmid, bmax = bmid;
+        const bool odd = ((fmid - bmid) & 1) != 0;
+
+        fd(fmid) = xoff;
+        bd(bmid) = xlim;
+
+        for (Index cost = 1;; cost++) {
+            // Extend the forward search by one edit step on every diagonal
+            if (fmin > dmin) fd(--fmin - 1) = -1;
+            else fmin++;
+            if (fmax < dmax) fd(++fmax + 1) = -1;
+            else fmax--;
+            for (Index d = fmax; d >= fmin; d -= 2) {
+                Index lo = fd(d - 1), hi = fd(d + 1);
+                Index x = lo < hi ? hi : lo + 1;
+                Index y = x - d;
+                while (x < xlim && y < ylim && a.ids[x] == b.ids[y]) {
+                    x++;
+                    y++;
+                }
+                fd(d) = x;
+                if (odd && bmin <= d && d <= bmax && bd(d) <= x) {
+                    xmid = x;
+                    ymid = y;
+                    return;
+                }
+            }
+
+            // And the backward search
+            if (bmin > dmin) bd(--bmin - 1) = PTRDIFF_MAX;
+            else bmin++;
+            if (bmax < dmax) bd(++bmax + 1) = PTRDIFF_MAX;
+            else bmax--;
+            for (Index d = bmax; d >= bmin; d -= 2) {
+                Index lo = bd(d - 1), hi = bd(d + 1);
+                Index x = lo < hi ? lo : hi - 1;
+                Index y = x - d;
+                while (xoff < x && yoff < y && a.ids[x - 1] == b.ids[y - 1]) {
+                    x--;
+                    y--;
+                }
+                bd(d) = x;
+                if (!odd && fmin <= d && d <= fmax && x <= fd(d)) {
+                    xmid = x;
+                    ymid = y;
+                    return;
+                }
+            }
+
+            spent += (fmax - fmin) / 2 + (bmax - bmin) / 2 + 2;
+            if (cancelled && *cancelled) {
+                // No progress, so run() stops at the next box
+                xmid = xoff;
+                ymid = yoff;
+                return;
+            }
+            if (cost < tooExpensive) continue;
+
+            // Too costly: split at whichever search got furthest
+            Index fxyBest = -1, fxBest = xoff;
+            for (Index d = fmax; d >= fmin; d -= 2) {
+                Index x = std::min(fd(d), xlim);
+                Index y = x - d;
+                if (ylim < y) {
+                    x = ylim + d;
+                    y = ylim;
+                }
+                if (fxyBest < x + y) {
+                    fxyBest = x + y;
+                    fxBest = x;
+                }
+            }
+            Index bxyBest = PTRDIFF_MAX, bxBest = xlim;
+            for (Index d = bmax; d >= bmin; d -= 2) {
+                Index x = std::max(xoff, bd(d));
+                Index y = x - d;
+                if (y < yoff) {
+                    x = yoff + d;
+                    y = yoff;
+                }
+                if (x + y < bxyBest) {
+                    bxyBest = x + y;
+                    bxBest = x;
+                }
+            }
+            if ((xlim + ylim) - bxyBest < fxyBest - (xoff + yoff)) {
+                xmid = fxBest;
+                ymid = fxyBest - fxBest;
+            } else {
+                xmid = bxBest;
+                ymid = bxyBest - bxBest;
+            }
+            return;
+        }
+    }
+
+    const Side& a;
+    const Side& b;
+    std::vector<char>& changedA;
+    std::vector<char>& changedB;
+    const std::atomic<bool>* cancelled;
+    std::vector<Index> forward;
+    std::vector<Index> backward;
+    Index offset = 0;
+    Index tooExpensive = 0;
+
+    // Diagonal steps allowed for the whole diff. The cap per split alone
+    // still lets large files of few distinct, reordered lines take many
+    // seconds.
+    static constexpr Index BUDGET_PER_LINE = 64;
+    Index budget = 0;
+    Index spent = 0;
+};
+
+} // namespace
+
+std::vector<DiffHunk> LineDiff::compute(const std::vector<std::string>& oldLines,
+                                        const std::vector<std::string>& newLines,
+                                        const std::atomic<bool>* cancelled) {
+    return compute(std::vector<std::string_view>(oldLines.begin(), oldLines.end()),
+                   std::vector<std::string_view>(newLines.begin(), newLines.end()), cancelled);
+}
+
+std::vector<DiffHunk> LineDiff::compute(const std::vector<std::string_view>& oldLines,
+                                        const std::vector<std::string_view>& newLines,
+                                        const std::atomic<bool>* cancelled) {
+    size_t n = oldLines.size();
+    size_t m = newLines.size();
+
+    // Common prefix and suffix never need hashing
+    size_t prefix = 0;
+    while (prefix < n && prefix < m && oldLines[prefix] == newLines[prefix]) prefix++;
+    size_t suffix = 0;
+    while (suffix < n - prefix && suffix < m - prefix &&
+           oldLines[n - 1 - suffix] == newLines[m - 1 - suffix]) {
+        suffix++;
+    }
+
+    // Hash every remaining line once, turning equal lines into equal ids
+    std::vector<uint32_t> oldIds(n - prefix - suffix);
+    std::vector<uint32_t> newIds(m - prefix - suffix);
+    std::vector<uint64_t> hashes(oldIds.size() + newIds.size());
+    for (size_t i = 0; i < oldIds.size(); i++) hashes[i] = hashLine(oldLines[prefix + i]);
+    for (size_t i = 0; i < newIds.size(); i++) hashes[oldIds.size() + i] = hashLine(newLines[prefix + i]);
+    LineInterner ids(hashes.size());
+    const size_t AHEAD = 16;
+    for (size_t i = 0; i < hashes.size(); i++) {
+        if (i + AHEAD < hashes.size()) ids.prefetch(hashes[i + AHEAD]);
+        if (i < oldIds.size()) {
+            oldIds[i] = ids.intern(oldLines[prefix + i], hashes[i]);
+        } else {
+            newIds[i - oldIds.size()] = ids.intern(newLines[prefix + i - oldIds.size()], hashes[i]);
+        }
+    }
+
+    if (cancelled && *cancelled) return std::vector<DiffHunk>();
+
+    // Lines that only occur on one side are changed whatever the diff says;
+    // dropping them up front keeps the search small for typical edits
+    std::vector<uint32_t> oldCount(ids.size()), newCount(ids.size());
+    for (uint32_t id : oldIds) oldCount[id]++;
+    for (uint32_t id : newIds) newCount[id]++;
+
+    std::vector<char> changedOld(n), changedNew(m);
+    Side a, b;
+    for (size_t i = 0; i < oldIds.size(); i++) {
+        if (newCount[oldIds[i]] == 0) {
+            changedOld[prefix + i] = 1;
+        } else {
+            a.ids.push_back(oldIds[i]);
+            a.index.push_back(prefix + i);
+        }
+    }
+    for (size_t i = 0; i < newIds.size(); i++) {
+        if (oldCount[newIds[i]] == 0) {
+            changedNew[prefix + i] = 1;
+        } else {
+            b.ids.push_back(newIds[i]);
+            b.index.push_back(prefix + i);
+        }
+    }
+
+    if (!Myers(a, b, changedOld, changedNew, cancelled).run()) return std::vector<DiffHunk>();
+
+    // Walk both documents in step, grouping changed lines into hunks
+    std::vector<DiffHunk> hunks;
+    size_t i = 0, j = 0;
+    while (i < n || j < m) {
+        if (i < n && j < m && !changedOld[i] && !changedNew[j]) {
+            i++;
+            j++;
+            continue;
+        }
+        DiffHunk hunk;
+        hunk.oldStart = i;
+        hunk.newStart = j;
+        while (i < n && changedOld[i]) i++;
+        while (j < m && changedNew[j]) j++;
+        if (i == hunk.oldStart && j == hunk.newStart) {
+            // Unbalanced unchanged lines; replace the rest wholesale
+            i = n;
+            j = m;
+        }
+        hunk.oldCount = i - hunk.oldStart;
+        hunk.newCount = j - hunk.newStart;
+        hunks.push_back(hunk);
+    }
+    return hunks;
+}
+
+size_t LineDiff::mapLine(const std::vector<DiffHunk>& hunks, size_t line) {
+    // Last hunk starting at or before the line
+    auto it = std::upper_bound(hunks.begin(), hunks.end(), line,
+                               [](size_t l, const DiffHunk& hunk) { return l < hunk.oldStart; });
+    if (it == hunks.begin()) return line;
+
+    const DiffHunk& hunk = *(it - 1);
+    if (line < hunk.oldStart + hunk.oldCount) {
+        size_t within = line - hunk.oldStart;
+        return hunk.newStart + std::min(within, hunk.newCount ? hunk.newCount - 1 : 0);
+    }
+    return line - (hunk.oldStart + hunk.oldCount) + (hunk.newStart + hunk.newCount);
+}
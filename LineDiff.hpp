@@ -0,0 +1,32 @@
+#pragma once
+#include <atomic>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstddef>
+
+// A run of lines in the old document replaced by a run in the new one
+struct DiffHunk {
+    size_t oldStart = 0;
+    size_t oldCount = 0;
+    size_t newStart = 0;
+    size_t newCount = 0;
+};
+
+class LineDiff {
+public:
+    // Hunks turning `oldLines` into `newLines`, ordered by position.
+    // Lines are hashed once and compared as ids; the diff itself is a
+    // linear-space Myers diff with cost caps for pathological inputs.
+    // Setting `cancelled` from another thread stops the diff early with
+    // no hunks.
+    static std::vector<DiffHunk> compute(const std::vector<std::string>& oldLines,
+                                         const std::vector<std::string>& newLines,
+                                         const std::atomic<bool>* cancelled = nullptr);
+    static std::vector<DiffHunk> compute(const std::vector<std::string_view>& oldLines,
+                                         const std::vector<std::string_view>& newLines,
+                                         const std::atomic<bool>* cancelled = nullptr);
+
+    // Where a line of the old document ends up in the new one
+    static size_t mapLine(const std::vector<DiffHunk>& hunks, size_t line);
+};
@@ -0,0 +1,181 @@
+#include "LineIndex.hpp"
+#include "MappedFile.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#ifdef _WIN32
+#include <shlobj.h>
+#endif
+
+// Sidecar layout: this header, then checkpointCount offsets
+struct SidecarHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t fileSize;
+    int64_t fileTime;
+    uint64_t contentHash;
+    uint64_t lineCount;
+    uint64_t longestLine;
+    uint64_t longestLength;
+    uint64_t topLine;
+    uint64_t caretLine;
+    uint64_t caretCol;
+    uint64_t checkpointLines;
+    uint64_t checkpointCount;
+};
+
+static constexpr char SIDECAR_MAGIC[4] = { 'H', 'R', 'D', 'X' };
+static constexpr uint32_t SIDECAR_VERSION = 1;
+
+// FNV-1a
+static uint64_t hashBytes(uint64_t hash, const char* data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static constexpr uint64_t HASH_SEED = 0xcbf29ce484222325ULL;
+
+bool LineIndex::identify(const std::string& path) {
+    std::error_code ec;
+    uintmax_t size = std::filesystem::file_size(path, ec);
+    if (ec) return false;
+    auto time = std::filesystem::last_write_time(path, ec);
+    if (ec) return false;
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) return false;
+
+    // A few blocks spread over the file catch most edits that keep the size
+    // and time, without reading a large file through
+    const size_t SAMPLES = 16;
+    const size_t SAMPLE_SIZE = 4096;
+    char sample[SAMPLE_SIZE];
+    uint64_t hash = hashBytes(HASH_SEED, reinterpret_cast<const char*>(&size), sizeof(size));
+    for (size_t i = 0; i < SAMPLES; i++) {
+        uintmax_t offset = size > SAMPLE_SIZE ? (size - SAMPLE_SIZE) * i / (SAMPLES - 1) : 0;
+        file.seekg(static_cast<std::streamoff>(offset));
+        file.read(sample, SAMPLE_SIZE);
+        hash = hashBytes(hash, sample, static_cast<size_t>(file.gcount()));
+        file.clear();
+        if (size <= SAMPLE_SIZE) break;
+    }
+
+    fileSize = size;
+    fileTime = static_cast<int64_t>(time.time_since_epoch().count());
+    contentHash = hash;
+    return true;
+}
+
+bool LineIndex::load(const std::string& path) {
+    LineIndex current;
+    if (!current.identify(path)) return false;
+    MappedFile sidecar;
+    if (!sidecar.open(sidecarPath(path)) || sidecar.size() < sizeof(SidecarHeader)) return false;
+
+    SidecarHeader header;
+    memcpy(&header, sidecar.data(), sizeof(header));
+    if (memcmp(header.magic, SIDECAR_MAGIC, sizeof(SIDECAR_MAGIC)) != 0 || header.version != SIDECAR_VERSION ||
+        header.checkpointLines != CHECKPOINT_LINES ||
+        sidecar.size() != sizeof(header) + header.checkpointCount * sizeof(uint64_t)) {
+        return false;
+    }
+    // Stale: the file was changed since the index was made
+    if (header.fileSize != current.fileSize || header.fileTime != current.fileTime ||
+        header.contentHash != current.contentHash) {
+        return false;
+    }
+    // Corrupt: the view is sized from these before anything is read
+    if (header.topLine >= header.lineCount || header.caretLine >= header.lineCount ||
+        header.longestLine >= header.lineCount) {
+        return false;
+    }
+    const char* offsets = sidecar.data() + sizeof(header);
+    if (header.checkpointCount > 0) {
+        // A plain file: every line but the last ends in a byte of its own,
+        // and each checkpoint starts after the one before
+        if (header.checkpointCount != (header.lineCount + CHECKPOINT_LINES - 1) / CHECKPOINT_LINES ||
+            header.lineCount > header.fileSize + 1) {
+            return false;
+        }
+        uint64_t previous = 0;
+        for (uint64_t i = 0; i < header.checkpointCount; i++) {
+            uint64_t offset;
+            memcpy(&offset, offsets + i * sizeof(offset), sizeof(offset));
+            if ((i == 0 ? offset != 0 : offset <= previous) || offset > header.fileSize) return false;
+            previous = offset;
+        }
+    }
+
+    *this = current;
+    lineCount = header.lineCount;
+    longestLine = header.longestLine;
+    longestLength = header.longestLength;
+    topLine = header.topLine;
+    caretLine = header.caretLine;
+    caretCol = header.caretCol;
+    checkpoints.resize(header.checkpointCount);
+    memcpy(checkpoints.data(), offsets, checkpoints.size() * sizeof(uint64_t));
+    return true;
+}
+
+bool LineIndex::save(const std::string& path) const {
+    SidecarHeader header = {};
+    memcpy(header.magic, SIDECAR_MAGIC, sizeof(SIDECAR_MAGIC));
+    header.version = SIDECAR_VERSION;
+    header.fileSize = fileSize;
+    header.fileTime = fileTime;
+    header.contentHash = contentHash;
+    header.lineCount = lineCount;
+    header.longestLine = longestLine;
+    header.longestLength = longestLength;
+    header.topLine = topLine;
+    header.caretLine = caretLine;
+    header.caretCol = caretCol;
+    header.checkpointLines = CHECKPOINT_LINES;
+    header.checkpointCount = checkpoints.size();
+
+    std::filesystem::path target = sidecarPath(path);
+    std::error_code ec;
+    std::filesystem::create_directories(target.parent_path(), ec);
+    std::filesystem::path temp = target;
+    temp += ".tmp";
+    {
+        std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) return false;
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(checkpoints.data()),
+                   static_cast<std::streamsize>(checkpoints.size() * sizeof(uint64_t)));
+        if (!file.flush()) return false;
+    }
+    std::filesystem::rename(temp, target, ec);
+    if (ec) std::filesystem::remove(temp, ec);
+    return !ec;
+}
+
+std::filesystem::path LineIndex::sidecarPath(const std::string& path) {
+    std::filesystem::path directory;
+#ifdef _WIN32
+    wchar_t localAppData[MAX_PATH];
+    if (SUCCEEDED(SHGetFolderPathW(NULL, CSIDL_LOCAL_APPDATA, NULL, 0, localAppData))) {
+        directory = std::filesystem::path(localAppData) / L"HoodRD" / L"index";
+    }
+#else
+    if (const char* cache = getenv("XDG_CACHE_HOME")) {
+        directory = std::filesystem::path(cache) / "hoodrd" / "index";
+    } else if (const char* home = getenv("HOME")) {
+        directory = std::filesystem::path(home) / ".cache" / "hoodrd" / "index";
+    }
+#endif
+    std::error_code ec;
+    if (directory.empty()) directory = std::filesystem::temp_directory_path(ec) / "hoodrd-index";
+
+    // One sidecar per document, named after a hash of its full path
+    std::string key = std::filesystem::absolute(path, ec).string();
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.idx",
+             static_cast<unsigned long long>(hashBytes(HASH_SEED, key.data(), key.size())));
+    return directory / name;
+}
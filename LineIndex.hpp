@@ -0,0 +1,57 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include "MemoryStats.hpp"
+
+// What reading a file once tells about it: how many lines it has, which is
+// longest and where every CHECKPOINT_LINES-th line starts. Kept per
+// document in a small sidecar file together with where the view was, so
+// reopening an unchanged file can size the view and go back to the old
+// position before anything is read.
+class LineIndex {
+public:
+    static constexpr size_t CHECKPOINT_LINES = 256;
+
+    uint64_t lineCount = 0;
+    uint64_t longestLine = 0;
+    uint64_t longestLength = 0;
+    // Byte offsets into the file; left empty for compressed files, which
+    // cannot be read from the middle
+    std::vector<uint64_t> checkpoints;
+
+    // Where the view was when the document was last closed
+    uint64_t topLine = 0;
+    uint64_t caretLine = 0;
+    uint64_t caretCol = 0;
+
+    // Counts the next line; `offset` is where it starts, or UINT64_MAX when
+    // offsets are not kept
+    void addLine(size_t length, uint64_t offset) {
+        if (offset != UINT64_MAX && lineCount % CHECKPOINT_LINES == 0) {
+            MemoryStats::Scope scope(MemoryStats::LineOffsets);
+            checkpoints.push_back(offset);
+        }
+        if (length > longestLength || lineCount == 0) {
+            longestLine = lineCount;
+            longestLength = length;
+        }
+        lineCount++;
+    }
+
+    // Notes the size, time and sampled contents the index describes
+    bool identify(const std::string& path);
+    // The sidecar of `path`, if there is one and the file has not changed
+    bool load(const std::string& path);
+    bool save(const std::string& path) const;
+    size_t memoryUsage() const { return MemoryStats::heapBytes(checkpoints); }
+
+private:
+    static std::filesystem::path sidecarPath(const std::string& path);
+
+    uint64_t fileSize = 0;
+    int64_t fileTime = 0;
+    uint64_t contentHash = 0;
+};
@@ -0,0 +1,290 @@
+#include "LineTransform.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <thread>
+#include <unordered_set>
+
+// Lines handled between looks at whether to stop
+static const size_t BLOCK_LINES = 64 * 1024;
+
+static bool cancelled(const TransformProgress* progress) {
+    return progress && progress->cancelled;
+}
+
+static void advance(TransformProgress* progress, size_t amount) {
+    if (!progress || progress->total == 0) return;
+    size_t done = progress->done += amount;
+    int percent = static_cast<int>(std::min<size_t>(done * 100 / progress->total, 100));
+    int last = progress->percent;
+    while (percent > last) {
+        if (progress->percent.compare_exchange_weak(last, percent)) {
+            if (progress->report) progress->report(percent);
+            return;
+        }
+    }
+}
+
+// Runs task(0) to task(count - 1) on up to `threads` threads, the calling
+// one included, each taking the next task until none are left
+static bool parallelFor(size_t count, unsigned threads, TransformProgress* progress,
+                        const std::function<void(size_t)>& task) {
+    std::atomic<size_t> next{ 0 };
+    auto work = [&] {
+        for (size_t i; (i = next++) < count;) {
+            if (cancelled(progress)) return;
+            task(i);
+        }
+    };
+    std::vector<std::thread> workers;
+    for (size_t t = 1; t < std::min<size_t>(threads, count); t++) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (auto& worker : workers) worker.join();
+    return !cancelled(progress);
+}
+
+// How many of the first `k` merged items come from `a`, taking from `a`
+// first on ties the way std::merge does
+template <typename T, typename Less>
+static size_t splitMerge(const T* a, size_t aCount, const T* b, size_t bCount, size_t k, Less less) {
+    size_t low = k > bCount ? k - bCount : 0;
+    size_t high = std::min(k, aCount);
+    while (low < high) {
+        size_t i = low + (high - low) / 2;
+        size_t j = k - i;
+        if (j > 0 && !less(b[j - 1], a[i])) {
+            low = i + 1;
+        } else {
+            high = i;
+        }
+    }
+    return low;
+}
+
+template <typename T, typename Less>
+static bool sortItems(const std::vector<T>& items, unsigned threads, std::vector<T>& sorted, Less less,
+                      TransformProgress* progress) {
+    // One run per thread sorted on its own, then neighbouring runs merged
+    // until one is left
+    size_t count = items.size();
+    size_t runs = std::max<size_t>(1, std::min<size_t>(threads, count / BLOCK_LINES));
+    std::vector<size_t> bounds;
+    for (size_t r = 0; r <= runs; r++) bounds.push_back(count * r / runs);
+    size_t rounds = 0;
+    while ((size_t(1) << rounds) < runs) rounds++;
+    if (progress) progress->total = count * (rounds + 1);
+
+    sorted = items;
+    bool ok = parallelFor(runs, threads, progress, [&](size_t r) {
+        std::sort(sorted.begin() + bounds[r], sorted.begin() + bounds[r + 1], less);
+        advance(progress, bounds[r + 1] - bounds[r]);
+    });
+    if (!ok) return false;
+
+    // Each merge is cut into pieces of its output so all threads keep
+    // working as the runs get fewer
+    struct Piece {
+        size_t a, aEnd, b, bEnd, out;
+    };
+    std::vector<T> merged(count);
+    while (bounds.size() > 2) {
+        size_t runCount = bounds.size() - 1;
+        size_t parts = std::max<size_t>(1, threads / (runCount / 2));
+        std::vector<Piece> pieces;
+        std::vector<size_t> nextBounds;
+        for (size_t r = 0; r < runCount; r += 2) {
+            size_t begin = bounds[r];
+            size_t middle = bounds[r + 1];
+            size_t end = r + 2 <= runCount ? bounds[r + 2] : middle;
+            nextBounds.push_back(begin);
+            size_t a = begin, b = middle;
+            for (size_t p = 1; p <= parts; p++) {
+                size_t k = (end - begin) * p / parts;
+                size_t i = splitMerge(&sorted[0] + begin, middle - begin, &sorted[0] + middle, end - middle, k, less);
+                pieces.push_back({ a, begin + i, b, middle + k - i, a + b - middle });
+                a = begin + i;
+                b = middle + k - i;
+            }
+        }
+        nextBounds.push_back(count);
+
+        ok = parallelFor(pieces.size(), threads, progress, [&](size_t p) {
+            const Piece& piece = pieces[p];
+            std::merge(sorted.begin() + piece.a, sorted.begin() + piece.aEnd, sorted.begin() + piece.b,
+                       sorted.begin() + piece.bEnd, merged.begin() + piece.out, less);
+            advance(progress, piece.aEnd - piece.a + piece.bEnd - piece.b);
+        });
+        if (!ok) return false;
+        sorted.swap(merged);
+        bounds = std::move(nextBounds);
+    }
+    return true;
+}
+
+// A line with its sort key parsed once up front, so comparing never
+// splits lines again
+struct KeyedLine {
+    std::string_view key;
+    double number;
+    bool numeric;
+    size_t index; // Equal keys keep their order
+};
+
+static bool sortByField(const std::vector<std::string_view>& lines, char delimiter, size_t field,
+                        unsigned threads, std::vector<std::string_view>& sorted, TransformProgress* progress) {
+    // The header stays where it is
+    size_t first = std::min<size_t>(1, lines.size());
+    size_t count = lines.size() - first;
+    size_t blocks = (count + BLOCK_LINES - 1) / BLOCK_LINES;
+    std::vector<KeyedLine> keyed(count);
+    bool ok = parallelFor(blocks, threads, progress, [&](size_t block) {
+        size_t end = std::min(count, (block + 1) * BLOCK_LINES);
+        std::string number;
+        for (size_t i = block * BLOCK_LINES; i < end; i++) {
+            KeyedLine& line = keyed[i];
+            line.key = LineTransform::field(lines[first + i], delimiter, field);
+            line.index = first + i;
+            // strtod wants a terminated string. NaN would break the order.
+            number.assign(line.key);
+            char* parsed = nullptr;
+            line.number = strtod(number.c_str(), &parsed);
+            line.numeric = parsed != number.c_str() && *parsed == 0 && line.number == line.number;
+        }
+    });
+    if (!ok) return false;
+
+    std::vector<KeyedLine> order;
+    auto less = [](const KeyedLine& a, const KeyedLine& b) {
+        if (a.numeric != b.numeric) return a.numeric;
+        if (a.numeric && a.number != b.number) return a.number < b.number;
+        if (!a.numeric && a.key != b.key) return a.key < b.key;
+        return a.index < b.index;
+    };
+    if (!sortItems(keyed, threads, order, less, progress)) return false;
+    sorted.resize(lines.size());
+    if (first) sorted[0] = lines[0];
+    for (size_t i = 0; i < count; i++) sorted[first + i] = lines[order[i].index];
+    return true;
+}
+
+static bool markDuplicates(const std::vector<std::string_view>& lines, unsigned threads, std::vector<char>& keep,
+                           TransformProgress* progress) {
+    size_t count = lines.size();
+    size_t blocks = (count + BLOCK_LINES - 1) / BLOCK_LINES;
+    if (progress) progress->total = count * 2;
+
+    std::vector<size_t> hashes(count);
+    bool ok = parallelFor(blocks, threads, progress, [&](size_t block) {
+        size_t end = std::min(count, (block + 1) * BLOCK_LINES);
+        for (size_t i = block * BLOCK_LINES; i < end; i++) {
+            hashes[i] = std::hash<std::string_view>()(lines[i]);
+        }
+        advance(progress, end - block * BLOCK_LINES);
+    });
+    if (!ok) return false;
+
+    // Each shard owns the lines whose hash falls in it, so shards need no
+    // locking and still meet their lines in order, keeping the first of each
+    size_t shards = threads;
+    return parallelFor(shards, threads, progress, [&](size_t shard) {
+        auto hash = [&](size_t i) { return hashes[i] / shards; };
+        auto equal = [&](size_t a, size_t b) { return lines[a] == lines[b]; };
+        std::unordered_set<size_t, decltype(hash), decltype(equal)> seen(count / shards + 1, hash, equal);
+        size_t owned = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (hashes[i] % shards != shard) continue;
+            keep[i] = seen.insert(i).second;
+            if (++owned % BLOCK_LINES == 0) {
+                if (cancelled(progress)) return;
+                advance(progress, BLOCK_LINES);
+            }
+        }
+        advance(progress, owned % BLOCK_LINES);
+    });
+}
+
+static bool markMatching(const std::vector<std::string_view>& lines, const std::string& pattern, bool wanted,
+                         unsigned threads, std::vector<char>& keep, TransformProgress* progress) {
+    size_t count = lines.size();
+    size_t blocks = (count + BLOCK_LINES - 1) / BLOCK_LINES;
+    if (progress) progress->total = count;
+    return parallelFor(blocks, threads, progress, [&](size_t block) {
+        size_t end = std::min(count, (block + 1) * BLOCK_LINES);
+        for (size_t i = block * BLOCK_LINES; i < end; i++) {
+            keep[i] = (lines[i].find(pattern) != std::string_view::npos) == wanted;
+        }
+        advance(progress, end - block * BLOCK_LINES);
+    });
+}
+
+// Each run of removed lines is a hunk with nothing in its place
+static std::vector<DiffHunk> removedRuns(const std::vector<char>& keep) {
+    std::vector<DiffHunk> hunks;
+    size_t kept = 0;
+    for (size_t i = 0; i < keep.size();) {
+        if (keep[i]) {
+            kept++;
+            i++;
+            continue;
+        }
+        size_t start = i;
+        while (i < keep.size() && !keep[i]) i++;
+        hunks.push_back({ start, i - start, kept, 0 });
+    }
+    return hunks;
+}
+
+std::string_view LineTransform::field(std::string_view line, char delimiter, size_t index) {
+    size_t start = 0;
+    bool quoted = false;
+    for (size_t i = 0; i <= line.length(); i++) {
+        if (i < line.length() && line[i] == '"') {
+            quoted = !quoted;
+        } else if (i == line.length() || (line[i] == delimiter && !quoted)) {
+            if (index-- == 0) {
+                std::string_view text = line.substr(start, i - start);
+                if (text.length() >= 2 && text.front() == '"' && text.back() == '"') {
+                    text = text.substr(1, text.length() - 2);
+                }
+                return text;
+            }
+            start = i + 1;
+        }
+    }
+    return std::string_view();
+}
+
+bool LineTransform::run(const Spec& spec, const std::vector<std::string_view>& lines, unsigned threads,
+                        Result& result, TransformProgress* progress) {
+    threads = std::max(1u, threads);
+    result = Result();
+
+    if (spec.kind == Sort || spec.kind == SortByField) {
+        std::vector<std::string_view> sorted;
+        bool ok = spec.kind == Sort
+                      ? sortItems(lines, threads, sorted, std::less<std::string_view>(), progress)
+                      : sortByField(lines, spec.delimiter, spec.field, threads, sorted, progress);
+        if (!ok) return false;
+        // Lines already in place at either end stay out of the hunk
+        size_t count = lines.size();
+        size_t head = 0;
+        while (head < count && sorted[head] == lines[head]) head++;
+        if (head < count) {
+            size_t tail = 0;
+            while (sorted[count - tail - 1] == lines[count - tail - 1]) tail++;
+            size_t changed = count - head - tail;
+            result.hunks.push_back({ head, changed, head, changed });
+        }
+        result.lines = std::move(sorted);
+        return true;
+    }
+
+    std::vector<char> keep(lines.size(), 1);
+    bool ok = spec.kind == RemoveDuplicates
+                  ? markDuplicates(lines, threads, keep, progress)
+                  : markMatching(lines, spec.pattern, spec.kind == KeepMatching, threads, keep, progress);
+    if (!ok) return false;
+    result.hunks = removedRuns(keep);
+    return true;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "LineDiff.hpp"
+
+// Shared with the thread running a transform, which may be asked to stop
+// and reports how far it has got
+struct TransformProgress {
+    std::atomic<bool> cancelled{ false };
+    // Called from whichever worker finishes the work that takes the total
+    // past another whole percent
+    std::function<void(int percent)> report;
+
+    // Used by the transform itself
+    std::atomic<size_t> done{ 0 };
+    std::atomic<int> percent{ 0 };
+    size_t total = 0;
+};
+
+// Whole-document line commands, spread over worker threads: a parallel
+// sort, by whole line or by one field of delimited lines, a hash-sharded
+// dedupe and a parallel filter. The result is the
+// hunks that turn the old lines into the new ones, so applying it is one
+// batch of edits and one undo step.
+class LineTransform {
+public:
+    enum Kind {
+        Sort,             // Byte order
+        RemoveDuplicates, // Keeps the first of each
+        KeepMatching,     // Lines containing the pattern
+        DropMatching,     // Lines not containing it
+        SortByField,      // Numbers before text, in value order
+    };
+
+    struct Spec {
+        Kind kind = Sort;
+        std::string pattern; // KeepMatching and DropMatching
+        // SortByField: the key is this field of lines split at `delimiter`
+        // outside double quotes. The first line stays first as the header.
+        char delimiter = ',';
+        size_t field = 0;
+    };
+
+    // `lines` point into the lines passed in, so they are only good until
+    // those change. Removed lines need no text, so only a sort fills it.
+    struct Result {
+        std::vector<std::string_view> lines;
+        std::vector<DiffHunk> hunks;
+    };
+
+    // False if cancelled part way
+    static bool run(const Spec& spec, const std::vector<std::string_view>& lines, unsigned threads,
+                    Result& result, TransformProgress* progress = nullptr);
+
+    // Field `index` of a delimited line without its quotes, empty past the
+    // last field
+    static std::string_view field(std::string_view line, char delimiter, size_t index);
+};
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <filesystem>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+// A whole file mapped read-only into memory
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // False if the file cannot be opened; an empty file maps to no data
+    bool open(const std::filesystem::path& path);
+    void close();
+
+    const char* data() const { return view; }
+    size_t size() const { return length; }
+
+private:
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+    const char* view = nullptr;
+    size_t length = 0;
+};
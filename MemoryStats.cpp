@@ -0,0 +1,123 @@
+#include "MemoryStats.hpp"
+#include <cstdio>
+#include <cstdlib>
+#ifndef NDEBUG
+#include <atomic>
+#include <new>
+#endif
+
+#ifndef NDEBUG
+static thread_local MemoryStats::Area currentArea = MemoryStats::Other;
+static std::atomic<uint64_t> allocationCounts[MemoryStats::AREA_COUNT];
+static std::atomic<uint64_t> allocationBytes[MemoryStats::AREA_COUNT];
+
+// Every other form of new and delete in the standard library comes down
+// to these, except the over-aligned ones, which are left uncounted
+void* operator new(size_t size) {
+    allocationCounts[currentArea].fetch_add(1, std::memory_order_relaxed);
+    allocationBytes[currentArea].fetch_add(size, std::memory_order_relaxed);
+    if (void* block = malloc(size ? size : 1)) return block;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* block) noexcept {
+    free(block);
+}
+
+void operator delete(void* block, size_t) noexcept {
+    free(block);
+}
+
+MemoryStats::Scope::Scope(Area area) : previous(currentArea) {
+    currentArea = area;
+}
+
+MemoryStats::Scope::~Scope() {
+    currentArea = previous;
+}
+#endif
+
+MemoryStats::MemoryStats() {
+#ifndef NDEBUG
+    for (int area = 0; area < AREA_COUNT; area++) {
+        entries[area].allocations = allocationCounts[area].load(std::memory_order_relaxed);
+        entries[area].allocatedBytes = allocationBytes[area].load(std::memory_order_relaxed);
+    }
+#endif
+}
+
+const char* MemoryStats::name(Area area) {
+    static const char* const names[AREA_COUNT] = {
+        "other", "text", "line offsets", "undo history", "layout cache", "brackets", "folds",
+        "minimap", "columns", "frames", "back buffer"
+    };
+    return names[area];
+}
+
+bool MemoryStats::counting() {
+#ifndef NDEBUG
+    return true;
+#else
+    return false;
+#endif
+}
+
+void MemoryStats::set(Area area, size_t bytes) {
+    entries[area].bytes = bytes;
+}
+
+size_t MemoryStats::totalBytes() const {
+    size_t total = 0;
+    for (const Entry& entry : entries) total += entry.bytes;
+    return total;
+}
+
+static std::string formatBytes(double bytes) {
+    static const char* const units[] = { "B", "KB", "MB", "GB" };
+    int unit = 0;
+    while (bytes >= 1024 && unit < 3) {
+        bytes /= 1024;
+        unit++;
+    }
+    char out[32];
+    snprintf(out, sizeof(out), unit == 0 ? "%.0f %s" : "%.1f %s", bytes, units[unit]);
+    return out;
+}
+
+std::string MemoryStats::text() const {
+    std::string out;
+    for (int area = 0; area < AREA_COUNT; area++) {
+        const Entry& entry = entries[area];
+        out += std::string(name(static_cast<Area>(area))) + ": " + formatBytes(static_cast<double>(entry.bytes));
+        if (counting()) {
+            out += ", " + std::to_string(entry.allocations) + " allocations of " +
+                   formatBytes(static_cast<double>(entry.allocatedBytes)) + " in all";
+        }
+        out += "\n";
+    }
+    out += "total: " + formatBytes(static_cast<double>(totalBytes())) + "\n";
+    return out;
+}
+
+std::string MemoryStats::json() const {
+    std::string out = "{\n  \"counting\": ";
+    out += counting() ? "true" : "false";
+    out += ",\n  \"totalBytes\": " + std::to_string(totalBytes()) + ",\n  \"areas\": {\n";
+    for (int area = 0; area < AREA_COUNT; area++) {
+        const Entry& entry = entries[area];
+        out += std::string("    \"") + name(static_cast<Area>(area)) + "\": { \"bytes\": " + std::to_string(entry.bytes) +
+               ", \"allocations\": " + std::to_string(entry.allocations) +
+               ", \"allocatedBytes\": " + std::to_string(entry.allocatedBytes) + " }";
+        out += area + 1 < AREA_COUNT ? ",\n" : "\n";
+    }
+    out += "  }\n}\n";
+    return out;
+}
+
+size_t MemoryStats::heapBytes(const std::string& text) {
+    // Short strings live inside the object itself
+    const char* data = text.data();
+    const char* object = reinterpret_cast<const char*>(&text);
+    if (data >= object && data < object + sizeof(text)) return 0;
+    return text.capacity() + 1;
+}
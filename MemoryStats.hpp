@@ -0,0 +1,69 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Where a document's memory goes. Each part of the editor reports the
+// bytes it holds through a memoryUsage() of its own; sizes are what the
+// containers have reserved, so slack counts but the allocator's overhead
+// does not. In debug builds every operator new is also counted against
+// the area whose Scope is open on the calling thread. Release builds
+// (NDEBUG) leave operator new alone and a Scope compiles to nothing.
+class MemoryStats {
+public:
+    enum Area {
+        Other, Text, LineOffsets, Undo, Layout, Brackets, Folds, Minimap, Columns, Frames, BackBuffer,
+        AREA_COUNT
+    };
+
+    // Allocations made while open are counted against `area`; scopes nest
+    class Scope {
+    public:
+#ifndef NDEBUG
+        explicit Scope(Area area);
+        ~Scope();
+#else
+        explicit Scope(Area) {}
+#endif
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+#ifndef NDEBUG
+        Area previous;
+#endif
+    };
+
+    struct Entry {
+        size_t bytes = 0;
+        // Allocations since the program started and their total size;
+        // both stay 0 in release builds
+        uint64_t allocations = 0;
+        uint64_t allocatedBytes = 0;
+    };
+
+    // Picks up the allocation counts so far; bytes are filled in by set
+    MemoryStats();
+
+    static const char* name(Area area);
+    static bool counting();
+
+    void set(Area area, size_t bytes);
+    const Entry& entry(Area area) const { return entries[area]; }
+    size_t totalBytes() const;
+
+    // A line per area for a person to read, and JSON for a script
+    std::string text() const;
+    std::string json() const;
+
+    // Heap bytes behind common containers, not counting the object itself
+    static size_t heapBytes(const std::string& text);
+    template <typename T>
+    static size_t heapBytes(const std::vector<T>& items) {
+        return items.capacity() * sizeof(T);
+    }
+
+private:
+    Entry entries[AREA_COUNT];
+};
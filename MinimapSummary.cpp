@@ -0,0 +1,235 @@
+#include "MinimapSummary.hpp"
+#include "MemoryStats.hpp"
+#include <algorithm>
+#include <cmath>
+
+// What kind each byte counts as, or KIND_COUNT for blanks
+static const struct KindTable {
+    unsigned char kinds[256];
+    KindTable() {
+        for (int c = 0; c < 256; c++) {
+            bool word = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || c >= 128;
+            kinds[c] = c <= ' ' || c == 127 ? MinimapSummary::KIND_COUNT
+                       : c >= '0' && c <= '9' ? MinimapSummary::Numbers
+                       : word                 ? MinimapSummary::Words
+                                              : MinimapSummary::Symbols;
+        }
+    }
+} kindTable;
+
+MinimapSummary::Kind MinimapSummary::Totals::dominant() const {
+    return static_cast<Kind>(std::max_element(kinds, kinds + KIND_COUNT) - kinds);
+}
+
+void MinimapSummary::Summary::add(const Summary& other) {
+    lines += other.lines;
+    chars += other.chars;
+    for (int k = 0; k < KIND_COUNT; k++) kinds[k] += other.kinds[k];
+}
+
+MinimapSummary::MinimapSummary(const TextBuffer& buffer) : buffer(buffer) {
+    MemoryStats::Scope scope(MemoryStats::Minimap);
+    rebuild();
+}
+
+void MinimapSummary::rebuild() {
+    size_t count = buffer.lineCount();
+    size_t blocks = std::max<size_t>(1, (count + BLOCK_LINES - 1) / BLOCK_LINES);
+    leaves.assign(blocks, Summary());
+    stale.assign(blocks, 0);
+    staleLeaves.clear();
+    spliced = false;
+    size_t start = 0;
+    for (size_t i = 0; i < blocks; i++) {
+        leaves[i].lines = std::min(BLOCK_LINES, count - start);
+        summarize(i, start);
+        start += leaves[i].lines;
+    }
+    rebuildTree();
+}
+
+void MinimapSummary::rebuildTree() {
+    capacity = 1;
+    while (capacity < leaves.size()) capacity *= 2;
+    tree.assign(2 * capacity, Summary());
+    std::copy(leaves.begin(), leaves.end(), tree.begin() + capacity);
+    for (size_t node = capacity - 1; node >= 1; node--) {
+        tree[node] = tree[2 * node];
+        tree[node].add(tree[2 * node + 1]);
+    }
+}
+
+void MinimapSummary::updateAncestors(size_t leaf) {
+    size_t node = capacity + leaf;
+    tree[node] = leaves[leaf];
+    while (node > 1) {
+        node /= 2;
+        tree[node] = tree[2 * node];
+        tree[node].add(tree[2 * node + 1]);
+    }
+}
+
+size_t MinimapSummary::leafAt(size_t line, size_t& start) const {
+    if (line >= tree[1].lines) {
+        start = tree[1].lines - leaves.back().lines;
+        return leaves.size() - 1;
+    }
+    size_t node = 1;
+    start = 0;
+    while (node < capacity) {
+        size_t left = 2 * node;
+        if (line < tree[left].lines) {
+            node = left;
+        } else {
+            line -= tree[left].lines;
+            start += tree[left].lines;
+            node = left + 1;
+        }
+    }
+    return node - capacity;
+}
+
+size_t MinimapSummary::firstLineOf(size_t leaf) const {
+    // Everything left of the path up from the leaf comes before it
+    size_t start = 0;
+    for (size_t node = capacity + leaf; node > 1; node /= 2) {
+        if (node % 2 == 1) start += tree[node - 1].lines;
+    }
+    return start;
+}
+
+size_t MinimapSummary::memoryUsage() const {
+    return MemoryStats::heapBytes(leaves) + MemoryStats::heapBytes(tree) + MemoryStats::heapBytes(stale) +
+           MemoryStats::heapBytes(staleLeaves);
+}
+
+void MinimapSummary::linesChanged(const std::vector<LineChange>& changes) {
+    MemoryStats::Scope scope(MemoryStats::Minimap);
+    if (changes.size() > MAX_INCREMENTAL_CHANGES) {
+        rebuild();
+        return;
+    }
+    for (const auto& change : changes) apply(change);
+
+    // Counts first, characters once the whole batch is in, so a block
+    // edited many times over is read once
+    if (spliced) {
+        size_t start = 0;
+        for (size_t i = 0; i < leaves.size(); i++) {
+            if (stale[i]) summarize(i, start);
+            start += leaves[i].lines;
+        }
+        rebuildTree();
+    } else {
+        for (size_t leaf : staleLeaves) {
+            summarize(leaf, firstLineOf(leaf));
+            updateAncestors(leaf);
+        }
+    }
+    staleLeaves.clear();
+    spliced = false;
+}
+
+void MinimapSummary::apply(const LineChange& change) {
+    // Old lines [first, first + removed] are now [first, first + inserted]
+    size_t start, lastStart;
+    size_t first = leafAt(change.first, start);
+    size_t last = leafAt(change.first + change.removed, lastStart);
+    size_t lines = lastStart + leaves[last].lines - start - change.removed + change.inserted;
+    if (first == last && lines <= MAX_BLOCK_LINES) {
+        leaves[first].lines = lines;
+        updateAncestors(first);
+        if (!stale[first]) {
+            stale[first] = 1;
+            staleLeaves.push_back(first);
+        }
+        return;
+    }
+
+    // The blocks touched are joined and cut again evenly
+    size_t pieces = std::max<size_t>(1, (lines + BLOCK_LINES - 1) / BLOCK_LINES);
+    std::vector<Summary> replacement(pieces);
+    for (size_t i = 0; i < pieces; i++) {
+        replacement[i].lines = lines * (i + 1) / pieces - lines * i / pieces;
+    }
+    leaves.erase(leaves.begin() + first, leaves.begin() + last + 1);
+    leaves.insert(leaves.begin() + first, replacement.begin(), replacement.end());
+    stale.erase(stale.begin() + first, stale.begin() + last + 1);
+    stale.insert(stale.begin() + first, pieces, 1);
+    spliced = true;
+    rebuildTree();
+}
+
+void MinimapSummary::summarize(size_t leaf, size_t start) {
+    Summary& summary = leaves[leaf];
+    summary.chars = 0;
+    std::fill(summary.kinds, summary.kinds + KIND_COUNT, 0);
+    size_t end = std::min<size_t>(start + summary.lines, buffer.lineCount());
+    for (size_t i = start; i < end; i++) {
+        const TextLine& line = buffer.line(i);
+        if (line.chunked()) {
+            // Too long to be worth reading; counted as words
+            summary.chars += line.length();
+            summary.kinds[Words] += line.length();
+            continue;
+        }
+        uint64_t counts[KIND_COUNT + 1] = {};
+        for (char c : line.scannable()) counts[kindTable.kinds[static_cast<unsigned char>(c)]]++;
+        for (int k = 0; k < KIND_COUNT; k++) {
+            summary.kinds[k] += counts[k];
+            summary.chars += counts[k];
+        }
+    }
+    stale[leaf] = 0;
+}
+
+MinimapSummary::Totals MinimapSummary::prefix(double line) const {
+    Totals totals;
+    auto add = [&](const Summary& summary, double share) {
+        totals.lines += summary.lines * share;
+        totals.chars += summary.chars * share;
+        for (int k = 0; k < KIND_COUNT; k++) totals.kinds[k] += summary.kinds[k] * share;
+    };
+    size_t node = 1;
+    while (node < capacity) {
+        size_t left = 2 * node;
+        if (line >= tree[left].lines) {
+            add(tree[left], 1);
+            line -= tree[left].lines;
+            node = left + 1;
+        } else {
+            node = left;
+        }
+    }
+    if (tree[node].lines > 0) add(tree[node], std::min(line / tree[node].lines, 1.0));
+    return totals;
+}
+
+static MinimapSummary::Totals difference(MinimapSummary::Totals totals, const MinimapSummary::Totals& before) {
+    totals.lines -= before.lines;
+    totals.chars -= before.chars;
+    for (int k = 0; k < MinimapSummary::KIND_COUNT; k++) totals.kinds[k] -= before.kinds[k];
+    return totals;
+}
+
+MinimapSummary::Totals MinimapSummary::sum(double first, double last) const {
+    return difference(prefix(last), prefix(first));
+}
+
+std::vector<MinimapSummary::Row> MinimapSummary::rows(int pixels) const {
+    // One walk down the tree per pixel row
+    std::vector<Row> result(std::max(pixels, 0));
+    double total = static_cast<double>(tree[1].lines);
+    Totals before;
+    for (size_t y = 0; y < result.size(); y++) {
+        Totals upTo = prefix(total * (y + 1) / result.size());
+        Totals totals = difference(upTo, before);
+        before = upTo;
+        if (totals.lines <= 0) continue;
+        // In steps, so that neighbouring rows alike come out equal
+        double density = std::min(totals.chars / totals.lines / FULL_COLUMNS, 1.0);
+        result[y].density = static_cast<float>(std::round(density * DENSITY_STEPS) / DENSITY_STEPS);
+        result[y].kind = totals.dominant();
+    }
+    return result;
+}
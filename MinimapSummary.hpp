@@ -0,0 +1,80 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "TextBuffer.hpp"
+
+// A downsampled overview of the buffer for the minimap. Lines are grouped
+// into blocks of about BLOCK_LINES, each summed up by its non-blank
+// characters and what kind most of them are, under a segment tree of
+// sums. An edit reads again only the blocks it touched and updates their
+// ancestors, and any run of lines sums in O(log blocks), so the minimap
+// costs the same per pixel row whatever the size of the file.
+class MinimapSummary : public TextBufferListener {
+public:
+    enum Kind { Words, Numbers, Symbols, KIND_COUNT };
+
+    // Sums over a run of lines, blocks cut part way counted in proportion
+    struct Totals {
+        double lines = 0;
+        double chars = 0;
+        double kinds[KIND_COUNT] = {};
+        Kind dominant() const;
+    };
+
+    // One pixel row of the minimap
+    struct Row {
+        float density = 0; // Non-blank characters per line over FULL_COLUMNS, at most 1
+        Kind kind = Words;
+
+        bool operator==(const Row& other) const { return density == other.density && kind == other.kind; }
+    };
+
+    static constexpr size_t BLOCK_LINES = 128;
+    // A line this long fills the minimap's width
+    static constexpr double FULL_COLUMNS = 100;
+    static constexpr int DENSITY_STEPS = 32;
+
+    explicit MinimapSummary(const TextBuffer& buffer);
+    void linesChanged(const std::vector<LineChange>& changes) override;
+
+    // Lines [first, last)
+    Totals sum(double first, double last) const;
+    // The whole buffer squeezed or stretched into `pixels` rows
+    std::vector<Row> rows(int pixels) const;
+    size_t blockCount() const { return leaves.size(); }
+    size_t memoryUsage() const;
+
+private:
+    // Above this a block is split; an edit that would have to split often
+    // builds everything again instead
+    static constexpr size_t MAX_BLOCK_LINES = 2 * BLOCK_LINES;
+    static constexpr size_t MAX_INCREMENTAL_CHANGES = 1024;
+
+    struct Summary {
+        uint64_t lines = 0;
+        uint64_t chars = 0;
+        uint64_t kinds[KIND_COUNT] = {};
+        void add(const Summary& other);
+    };
+
+    void rebuild();
+    void rebuildTree();
+    void updateAncestors(size_t leaf);
+    size_t leafAt(size_t line, size_t& start) const;
+    size_t firstLineOf(size_t leaf) const;
+    void apply(const LineChange& change);
+    void summarize(size_t leaf, size_t start);
+    Totals prefix(double line) const;
+
+    const TextBuffer& buffer;
+    // Blocks in order, and the tree over them: node 1 is the root and
+    // leaf i is node `capacity + i`
+    std::vector<Summary> leaves;
+    std::vector<Summary> tree;
+    size_t capacity = 1;
+    // Blocks whose line count is right but whose characters need reading
+    std::vector<char> stale;
+    std::vector<size_t> staleLeaves;
+    bool spliced = false;
+};
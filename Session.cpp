@@ -0,0 +1,114 @@
+#include "Session.hpp"
+#include "IniFile.hpp"
+#include <cstdlib>
+#include <cwchar>
+#ifdef _WIN32
+#include <windows.h>
+#include <shlobj.h>
+#endif
+
+static const wchar_t* SECTION = L"Session";
+
+// Reads an unsigned number and steps past it
+static size_t readNumber(const wchar_t*& text) {
+    wchar_t* end;
+    size_t value = static_cast<size_t>(wcstoull(text, &end, 10));
+    text = end;
+    return value;
+}
+
+// "line:col"
+static TextPos readPos(const wchar_t*& text) {
+    TextPos pos;
+    pos.line = readNumber(text);
+    if (*text == L':') pos.col = readNumber(++text);
+    return pos;
+}
+
+static std::wstring formatPos(TextPos pos) {
+    return std::to_wstring(pos.line) + L":" + std::to_wstring(pos.col);
+}
+
+bool Session::load() {
+    return load(path());
+}
+
+bool Session::save() const {
+    return save(path());
+}
+
+bool Session::load(const std::filesystem::path& from) {
+    IniFile ini;
+    if (!ini.load(from)) return false;
+    *this = Session();
+    auto value = [&](const wchar_t* key) {
+        const std::wstring* text = ini.find(SECTION, key);
+        return text ? *text : std::wstring();
+    };
+
+    file = std::filesystem::path(value(L"File")).string();
+    view.primary = static_cast<size_t>(wcstoull(value(L"Primary").c_str(), nullptr, 10));
+    view.topLine = static_cast<size_t>(wcstoull(value(L"TopLine").c_str(), nullptr, 10));
+    view.scrollX = wcstoll(value(L"ScrollX").c_str(), nullptr, 10);
+
+    // "anchor-caret;anchor-caret;..."
+    std::wstring selections = value(L"Selections");
+    for (const wchar_t* text = selections.c_str(); *text;) {
+        Selection selection;
+        selection.anchor = readPos(text);
+        selection.caret = *text == L'-' ? readPos(++text) : selection.anchor;
+        view.selections.push_back(selection);
+        if (*text != L';') break;
+        text++;
+    }
+
+    // "header-end;header-end;..."
+    std::wstring folds = value(L"Folds");
+    for (const wchar_t* text = folds.c_str(); *text;) {
+        size_t header = readNumber(text);
+        if (*text != L'-') break;
+        size_t end = readNumber(++text);
+        view.folds.push_back({ header, end });
+        if (*text != L';') break;
+        text++;
+    }
+    return true;
+}
+
+bool Session::save(const std::filesystem::path& to) const {
+    std::wstring selections;
+    for (const auto& selection : view.selections) {
+        if (!selections.empty()) selections += L';';
+        selections += formatPos(selection.anchor) + L"-" + formatPos(selection.caret);
+    }
+    std::wstring folds;
+    for (const auto& fold : view.folds) {
+        if (!folds.empty()) folds += L';';
+        folds += std::to_wstring(fold.first) + L"-" + std::to_wstring(fold.second);
+    }
+
+    IniFile ini;
+    ini.set(SECTION, L"File", std::filesystem::path(file).wstring());
+    ini.set(SECTION, L"Primary", std::to_wstring(view.primary));
+    ini.set(SECTION, L"TopLine", std::to_wstring(view.topLine));
+    ini.set(SECTION, L"ScrollX", std::to_wstring(view.scrollX));
+    ini.set(SECTION, L"Selections", selections);
+    ini.set(SECTION, L"Folds", folds);
+    return ini.save(to);
+}
+
+std::filesystem::path Session::path() {
+#ifdef _WIN32
+    wchar_t appDataPath[MAX_PATH];
+    if (SUCCEEDED(SHGetFolderPathW(NULL, CSIDL_APPDATA, NULL, 0, appDataPath))) {
+        return std::filesystem::path(appDataPath) / L"HoodRD" / L"session.ini";
+    }
+#else
+    if (const char* config = getenv("XDG_CONFIG_HOME")) {
+        return std::filesystem::path(config) / "hoodrd" / "session.ini";
+    } else if (const char* home = getenv("HOME")) {
+        return std::filesystem::path(home) / ".config" / "hoodrd" / "session.ini";
+    }
+#endif
+    return "session.ini";
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+#include "CursorSet.hpp"
+
+// Where the view of a document was: carets, scroll position and folds
+struct ViewState {
+    std::vector<Selection> selections;
+    size_t primary = 0;
+    size_t topLine = 0;
+    long long scrollX = 0;
+    // Collapsed folds as header and end lines, inner ones before the folds
+    // around them so folding them in order nests them again
+    std::vector<std::pair<size_t, size_t>> folds;
+};
+
+// The open document and its view, saved on exit and brought back on the
+// next start
+class Session {
+public:
+    std::string file;
+    ViewState view;
+
+    // From and to the per-user session file, or another one
+    bool load();
+    bool save() const;
+    bool load(const std::filesystem::path& from);
+    bool save(const std::filesystem::path& to) const;
+
+private:
+    static std::filesystem::path path();
+};
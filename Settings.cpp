@@ -2,30 +2,23 @@
 #include <shlobj.h>
 #include <filesystem>
 #include <algorithm>
+#include <variant>
+#include <cwchar>
 
 static int CALLBACK EnumFontProc(const LOGFONTW* lpelfe, const TEXTMETRICW* lpntme, DWORD FontType, LPARAM lParam) {
     if (FontType & TRUETYPE_FONTTYPE) { // Only TrueType fonts
-        auto fonts = reinterpret_cast<std::vector<std::wstring>*>(lParam);
-        fonts->push_back(lpelfe->lfFaceName);
+        auto found = reinterpret_cast<const std::function<bool(const std::wstring&)>*>(lParam);
+        return (*found)(lpelfe->lfFaceName) ? 1 : 0;
     }
     return 1;
 }
 
-std::vector<std::wstring> Settings::getAvailableFonts() const {
-    std::vector<std::wstring> fonts;
+void GdiFontSource::enumerate(const std::function<bool(const std::wstring&)>& found) {
     HDC hdc = GetDC(NULL);
     LOGFONTW lf = { 0 };
     lf.lfCharSet = DEFAULT_CHARSET;
-    
-    EnumFontFamiliesExW(hdc, &lf, EnumFontProc, reinterpret_cast<LPARAM>(&fonts), 0);
-    
+    EnumFontFamiliesExW(hdc, &lf, EnumFontProc, reinterpret_cast<LPARAM>(&found), 0);
     ReleaseDC(NULL, hdc);
-    
-    // Remove duplicates
-    std::sort(fonts.begin(), fonts.end());
-    fonts.erase(std::unique(fonts.begin(), fonts.end()), fonts.end());
-    
-    return fonts;
 }
 
 std::wstring Settings::getSettingsPath() const {
@@ -39,46 +32,106 @@ std::wstring Settings::getSettingsPath() const {
     return L"settings.ini"; // Fallback to current directory
 }
 
-void Settings::load() {
-    std::wstring settingsPath = getSettingsPath();
-    wchar_t buffer[256];
+// Every setting kept in the file, with its default and what it affects
+struct SettingField {
+    const wchar_t* section;
+    const wchar_t* key;
+    const wchar_t* fallback;
+    std::variant<std::wstring Settings::*, int Settings::*, bool Settings::*> member;
+    unsigned change;
+    // Numbers outside these are brought back inside; an external edit must
+    // not hand the editor a tab size of -1 or a zero point font
+    int low = 0;
+    int high = 0;
+};
 
-    // Font settings
-    GetPrivateProfileStringW(L"Font", L"Name", L"Consolas", buffer, 256, settingsPath.c_str());
-    fontName = buffer;
-    fontSize = GetPrivateProfileIntW(L"Font", L"Size", 14, settingsPath.c_str());
-    fontBold = GetPrivateProfileIntW(L"Font", L"Bold", 0, settingsPath.c_str()) != 0;
+static const SettingField settingFields[] = {
+    { L"Font", L"Name", L"Consolas", &Settings::fontName, Settings::FONT_CHANGED },
+    { L"Font", L"Size", L"14", &Settings::fontSize, Settings::FONT_CHANGED, 6, 72 },
+    { L"Font", L"Bold", L"0", &Settings::fontBold, Settings::FONT_CHANGED },
+    { L"Theme", L"DarkMode", L"0", &Settings::isDarkMode, Settings::THEME_CHANGED },
+    { L"Editor", L"ShowLineNumbers", L"1", &Settings::showLineNumbers, Settings::EDITOR_CHANGED },
+    { L"Editor", L"WordWrap", L"0", &Settings::wordWrap, Settings::EDITOR_CHANGED },
+    { L"Editor", L"ShowMinimap", L"1", &Settings::showMinimap, Settings::EDITOR_CHANGED },
+    { L"Editor", L"TabSize", L"4", &Settings::tabSize, Settings::EDITOR_CHANGED, 1, 16 },
+};
 
-    // Theme settings
-    isDarkMode = GetPrivateProfileIntW(L"Theme", L"DarkMode", 0, settingsPath.c_str()) != 0;
-    currentTheme = isDarkMode ? Theme::Dark() : Theme::Light();
+// Each returns whether the value actually changed
+static bool assign(std::wstring& target, const std::wstring& text, const SettingField&) {
+    if (target == text) return false;
+    target = text;
+    return true;
+}
+
+static bool assign(int& target, const std::wstring& text, const SettingField& field) {
+    int value = IniFile::toInt(text, IniFile::toInt(field.fallback, 0, field.low, field.high), field.low, field.high);
+    if (target == value) return false;
+    target = value;
+    return true;
+}
+
+static bool assign(bool& target, const std::wstring& text, const SettingField&) {
+    bool value = wcstol(text.c_str(), nullptr, 10) != 0;
+    if (target == value) return false;
+    target = value;
+    return true;
+}
+
+static std::wstring format(const std::wstring& value) { return value; }
+static std::wstring format(int value) { return std::to_wstring(value); }
+static std::wstring format(bool value) { return value ? L"1" : L"0"; }
 
-    // Editor settings
-    showLineNumbers = GetPrivateProfileIntW(L"Editor", L"ShowLineNumbers", 1, settingsPath.c_str()) != 0;
-    wordWrap = GetPrivateProfileIntW(L"Editor", L"WordWrap", 0, settingsPath.c_str()) != 0;
-    tabSize = GetPrivateProfileIntW(L"Editor", L"TabSize", 4, settingsPath.c_str());
+void Settings::load() {
+    // One read and one parse for the whole file
+    ini.load(getSettingsPath());
+    rememberFileState();
+    readFrom(ini);
+}
+
+bool Settings::save() {
+    for (const auto& field : settingFields) {
+        // Values set in the dialog go through the same limits as the file
+        std::visit([&](auto member) {
+            assign(this->*member, format(this->*member), field);
+            ini.set(field.section, field.key, format(this->*member));
+        }, field.member);
+    }
+    bool saved = ini.save(getSettingsPath());
+    rememberFileState();
+    return saved;
 }
 
-void Settings::save() {
-    std::wstring settingsPath = getSettingsPath();
-    
-    // Create directory if it doesn't exist
-    std::filesystem::path dirPath = std::filesystem::path(settingsPath).parent_path();
-    std::filesystem::create_directories(dirPath);
+unsigned Settings::reloadIfChanged() {
+    std::error_code ec;
+    std::filesystem::path path = getSettingsPath();
+    auto time = std::filesystem::last_write_time(path, ec);
+    if (ec) return 0;
+    uintmax_t size = std::filesystem::file_size(path, ec);
+    if (ec || (time == fileTime && size == fileSize)) return 0;
 
-    // Font settings
-    WritePrivateProfileStringW(L"Font", L"Name", fontName.c_str(), settingsPath.c_str());
-    wchar_t buffer[32];
-    _itow_s(fontSize, buffer, 10);
-    WritePrivateProfileStringW(L"Font", L"Size", buffer, settingsPath.c_str());
-    WritePrivateProfileStringW(L"Font", L"Bold", fontBold ? L"1" : L"0", settingsPath.c_str());
+    IniFile fresh;
+    if (!fresh.load(path)) return 0;
+    ini = std::move(fresh);
+    fileTime = time;
+    fileSize = size;
+    return readFrom(ini);
+}
 
-    // Theme settings
-    WritePrivateProfileStringW(L"Theme", L"DarkMode", isDarkMode ? L"1" : L"0", settingsPath.c_str());
+unsigned Settings::readFrom(const IniFile& file) {
+    unsigned changed = 0;
+    for (const auto& field : settingFields) {
+        const std::wstring* text = file.find(field.section, field.key);
+        std::wstring value = text ? *text : field.fallback;
+        bool differs = std::visit([&](auto member) { return assign(this->*member, value, field); }, field.member);
+        if (differs) changed |= field.change;
+    }
+    currentTheme = isDarkMode ? Theme::Dark() : Theme::Light();
+    return changed;
+}
 
-    // Editor settings
-    WritePrivateProfileStringW(L"Editor", L"ShowLineNumbers", showLineNumbers ? L"1" : L"0", settingsPath.c_str());
-    WritePrivateProfileStringW(L"Editor", L"WordWrap", wordWrap ? L"1" : L"0", settingsPath.c_str());
-    _itow_s(tabSize, buffer, 10);
-    WritePrivateProfileStringW(L"Editor", L"TabSize", buffer, settingsPath.c_str());
+void Settings::rememberFileState() {
+    std::error_code ec;
+    std::filesystem::path path = getSettingsPath();
+    fileTime = std::filesystem::last_write_time(path, ec);
+    fileSize = std::filesystem::file_size(path, ec);
 }
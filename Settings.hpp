@@ -3,6 +3,9 @@
 #include <windows.h>
 #include <vector>
 #include <fstream>
+#include <filesystem>
+#include "IniFile.hpp"
+#include "FontCatalog.hpp"
 
 struct Theme {
     COLORREF background;
@@ -12,6 +15,13 @@ struct Theme {
     COLORREF lineNumber;
     COLORREF statusBar;
     COLORREF statusText;
+    // Diff view: lines only on the right, only on the left, and on both
+    COLORREF added;
+    COLORREF removed;
+    COLORREF changed;
+    // Minimap: blocks mostly digits, and mostly punctuation
+    COLORREF number;
+    COLORREF symbol;
     
     static Theme Dark() {
         return {
@@ -21,7 +31,12 @@ struct Theme {
             RGB(60, 80, 100),   // selection
             RGB(100, 100, 100), // lineNumber
             RGB(45, 45, 45),    // statusBar
-            RGB(180, 180, 180)  // statusText
+            RGB(180, 180, 180), // statusText
+            RGB(35, 70, 40),    // added
+            RGB(80, 35, 35),    // removed
+            RGB(70, 65, 30),    // changed
+            RGB(110, 160, 200), // number
+            RGB(200, 150, 90)   // symbol
         };
     }
     
@@ -33,7 +48,12 @@ struct Theme {
             RGB(200, 220, 250), // selection
             RGB(120, 120, 120), // lineNumber
             RGB(240, 240, 240), // statusBar
-            RGB(60, 60, 60)     // statusText
+            RGB(60, 60, 60),    // statusText
+            RGB(215, 245, 215), // added
+            RGB(250, 215, 215), // removed
+            RGB(250, 240, 200), // changed
+            RGB(40, 90, 160),   // number
+            RGB(160, 100, 30)   // symbol
         };
     }
 };
@@ -45,8 +65,17 @@ public:
         return instance;
     }
 
+    // What a change touches, so the editor only redoes that
+    static constexpr unsigned FONT_CHANGED = 1;
+    static constexpr unsigned THEME_CHANGED = 2;
+    static constexpr unsigned EDITOR_CHANGED = 4;
+    static constexpr unsigned ALL_CHANGED = FONT_CHANGED | THEME_CHANGED | EDITOR_CHANGED;
+
     void load();
-    void save();
+    // False if the file could not be written
+    bool save();
+    // Reads the file again if something else wrote it, returning what changed
+    unsigned reloadIfChanged();
     
     // Font settings
     std::wstring fontName = L"Consolas";
@@ -60,10 +89,8 @@ public:
     // Editor settings
     bool showLineNumbers = true;
     bool wordWrap = false;
+    bool showMinimap = true;
     int tabSize = 4;
-    
-    // Available fonts
-    std::vector<std::wstring> getAvailableFonts() const;
 
 private:
     Settings() { load(); }
@@ -71,4 +98,16 @@ private:
     void operator=(const Settings&) = delete;
     
     std::wstring getSettingsPath() const;
+    unsigned readFrom(const IniFile& file);
+    void rememberFileState();
+
+    IniFile ini;
+    std::filesystem::file_time_type fileTime;
+    uintmax_t fileSize = 0;
+};
+
+// The TrueType fonts GDI knows about
+class GdiFontSource : public FontSource {
+public:
+    void enumerate(const std::function<bool(const std::wstring&)>& found) override;
 };
@@ -5,16 +5,27 @@
 
 #pragma comment(lib, "comctl32.lib")
 
-INT_PTR SettingsDialog::Show(HWND parent) {
-    return DialogBox(GetModuleHandle(NULL), MAKEINTRESOURCE(IDD_SETTINGS), parent, DialogProc);
+// How far the font combo has read the catalog
+static FontCatalog::Cursor fontCursor;
+
+INT_PTR SettingsDialog::Show(HWND parent, FontCatalog& fonts) {
+    return DialogBoxParam(GetModuleHandle(NULL), MAKEINTRESOURCE(IDD_SETTINGS), parent, DialogProc,
+                          reinterpret_cast<LPARAM>(&fonts));
 }
 
 INT_PTR CALLBACK SettingsDialog::DialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam) {
     switch (msg) {
         case WM_INITDIALOG:
+            SetWindowLongPtr(hwnd, DWLP_USER, lParam);
             InitDialog(hwnd);
             return TRUE;
 
+        case WM_TIMER:
+            if (wParam == FONT_LIST_TIMER) {
+                AddFonts(hwnd);
+            }
+            return TRUE;
+
         case WM_COMMAND:
             OnCommand(hwnd, LOWORD(wParam), (HWND)lParam, HIWORD(wParam));
             return TRUE;
@@ -35,15 +46,10 @@ void SettingsDialog::InitDialog(HWND hwnd) {
 
     Settings& settings = Settings::getInstance();
 
-    // Initialize font combo box
-    HWND hFontCombo = GetDlgItem(hwnd, IDC_FONT_COMBO);
-    auto fonts = settings.getAvailableFonts();
-    for (const auto& font : fonts) {
-        ComboBox_AddString(hFontCombo, font.c_str());
-        if (font == settings.fontName) {
-            ComboBox_SetCurSel(hFontCombo, ComboBox_GetCount(hFontCombo) - 1);
-        }
-    }
+    // Initialize font combo box with the fonts found so far; the rest
+    // come in on a timer while the catalog is still enumerating
+    fontCursor = FontCatalog::Cursor();
+    AddFonts(hwnd);
 
     // Initialize font size combo box
     HWND hSizeCombo = GetDlgItem(hwnd, IDC_SIZE_COMBO);
@@ -70,6 +76,36 @@ void SettingsDialog::InitDialog(HWND hwnd) {
     UpdatePreview(hwnd);
 }
 
+void SettingsDialog::AddFonts(HWND hwnd) {
+    auto& fonts = *reinterpret_cast<FontCatalog*>(GetWindowLongPtr(hwnd, DWLP_USER));
+    FontCatalog::Update update = fonts.fetch(fontCursor);
+    if (update.complete) {
+        KillTimer(hwnd, FONT_LIST_TIMER);
+    } else {
+        SetTimer(hwnd, FONT_LIST_TIMER, 100, NULL);
+    }
+    if (!update.restarted && update.added.empty()) return;
+
+    // Keep the chosen font chosen while names are sorted in around it
+    HWND hFontCombo = GetDlgItem(hwnd, IDC_FONT_COMBO);
+    std::wstring chosen = Settings::getInstance().fontName;
+    int index = ComboBox_GetCurSel(hFontCombo);
+    if (index != CB_ERR) {
+        wchar_t name[LF_FACESIZE];
+        ComboBox_GetLBText(hFontCombo, index, name);
+        chosen = name;
+    }
+
+    SetWindowRedraw(hFontCombo, FALSE);
+    if (update.restarted) ComboBox_ResetContent(hFontCombo);
+    for (const auto& font : update.added) {
+        ComboBox_AddString(hFontCombo, font.c_str());
+    }
+    SetWindowRedraw(hFontCombo, TRUE);
+    int found = ComboBox_FindStringExact(hFontCombo, -1, chosen.c_str());
+    if (found != CB_ERR && found != index) ComboBox_SetCurSel(hFontCombo, found);
+}
+
 void SettingsDialog::OnCommand(HWND hwnd, int id, HWND hwndCtl, UINT codeNotify) {
     switch (id) {
         case IDOK:
@@ -121,7 +157,9 @@ void SettingsDialog::ApplySettings(HWND hwnd) {
     settings.tabSize = GetDlgItemInt(hwnd, IDC_TAB_SIZE, NULL, FALSE);
 
     settings.currentTheme = settings.isDarkMode ? Theme::Dark() : Theme::Light();
-    settings.save();
+    if (!settings.save()) {
+        MessageBoxW(hwnd, L"The settings could not be saved.", L"Settings", MB_OK | MB_ICONERROR);
+    }
 }
 
 HFONT SettingsDialog::CreateGUIFont(const wchar_t* name, int size, bool bold) {
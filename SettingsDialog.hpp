@@ -1,17 +1,21 @@
 #pragma once
 #include <windows.h>
 #include "Settings.hpp"
+#include "FontCatalog.hpp"
 
 class SettingsDialog {
 public:
-    static INT_PTR Show(HWND parent);
+    static INT_PTR Show(HWND parent, FontCatalog& fonts);
 
 private:
     static INT_PTR CALLBACK DialogProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
     static void InitDialog(HWND hwnd);
     static void OnCommand(HWND hwnd, int id, HWND hwndCtl, UINT codeNotify);
     static void ApplySettings(HWND hwnd);
+    static void AddFonts(HWND hwnd);
     
     static HFONT CreateGUIFont(const wchar_t* name, int size, bool bold = false);
     static void UpdatePreview(HWND hwnd);
+
+    static constexpr UINT_PTR FONT_LIST_TIMER = 1;
 };
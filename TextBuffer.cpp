@@ -0,0 +1,335 @@
+#include "TextBuffer.hpp"
+#include "MemoryStats.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+TextBuffer::TextBuffer() : lines(1) {
+}
+
+// Appends text to `pending`, pushing a finished line to `out` at every line
+// break. A "\r" directly before a "\n" is dropped.
+static void appendLines(std::string& pending, std::vector<TextLine>& out, const char* text, size_t length) {
+    const char* end = text + length;
+    for (;;) {
+        const char* newline = static_cast<const char*>(memchr(text, '\n', end - text));
+        if (!newline) {
+            pending.append(text, end);
+            return;
+        }
+        size_t pieceLength = newline - text;
+        if (pieceLength > 0 && newline[-1] == '\r') pieceLength--;
+        pending.append(text, pieceLength);
+        out.emplace_back(std::move(pending));
+        pending.clear();
+        text = newline + 1;
+    }
+}
+
+std::vector<TextPos> TextBuffer::apply(const std::vector<TextEdit>& edits, std::vector<TextEdit>* undo) {
+    MemoryStats::Scope scope(MemoryStats::Text);
+    std::vector<TextPos> ends;
+    ends.reserve(edits.size());
+    if (undo) {
+        undo->clear();
+        undo->reserve(edits.size());
+    }
+    if (edits.empty()) return ends;
+
+    // Typing and deleting within lines is by far the common case and never
+    // needs to touch the line array itself
+    bool withinLines = std::all_of(edits.begin(), edits.end(), [](const TextEdit& edit) {
+        return edit.from.line == edit.to.line && edit.text.find('\n') == std::string::npos;
+    });
+    std::vector<LineChange> changes;
+    changes.reserve(edits.size());
+    if (withinLines) {
+        applyWithinLines(edits, ends, undo, changes);
+    } else {
+        applySpliced(edits, ends, undo, changes);
+    }
+    notify(changes);
+    return ends;
+}
+
+size_t TextBuffer::memoryUsage() const {
+    size_t bytes = MemoryStats::heapBytes(lines);
+    for (const TextLine& line : lines) bytes += line.memoryUsage();
+    return bytes;
+}
+
+void TextBuffer::addListener(TextBufferListener* listener) {
+    listeners.push_back(listener);
+}
+
+void TextBuffer::removeListener(TextBufferListener* listener) {
+    listeners.erase(std::remove(listeners.begin(), listeners.end(), listener), listeners.end());
+}
+
+void TextBuffer::notify(const std::vector<LineChange>& changes) {
+    for (auto* listener : listeners) {
+        listener->linesChanged(changes);
+    }
+}
+
+void TextBuffer::applyWithinLines(const std::vector<TextEdit>& edits, std::vector<TextPos>& ends,
+                                  std::vector<TextEdit>* undo, std::vector<LineChange>& changes) {
+    size_t i = 0;
+    while (i < edits.size()) {
+        size_t line = std::min(edits[i].from.line, lines.size() - 1);
+        size_t next = i;
+        while (next < edits.size() && std::min(edits[next].from.line, lines.size() - 1) == line) next++;
+        if (lines[line].chunked()) {
+            editChunkedLine(line, edits, i, next, ends, undo, changes);
+            i = next;
+            continue;
+        }
+
+        // Rebuild the line once for all the edits that land on it
+        const std::string& text = lines[line].scannable();
+        std::string result;
+        size_t copied = 0;
+        for (; i < next; i++) {
+            const TextEdit& edit = edits[i];
+            size_t from = std::max(copied, std::min(edit.from.col, text.length()));
+            size_t to = std::max(from, std::min(edit.to.col, text.length()));
+
+            result.append(text, copied, from - copied);
+            size_t start = result.length();
+            result += edit.text;
+            ends.push_back({ line, result.length() });
+            changes.push_back({ line, 0, 0 });
+            if (undo) {
+                undo->push_back({ { line, start }, { line, result.length() }, text.substr(from, to - from) });
+            }
+            copied = to;
+        }
+        result.append(text, copied, std::string::npos);
+        lines[line] = TextLine(std::move(result));
+    }
+}
+
+void TextBuffer::editChunkedLine(size_t line, const std::vector<TextEdit>& edits, size_t begin, size_t end,
+                                 std::vector<TextPos>& ends, std::vector<TextEdit>* undo,
+                                 std::vector<LineChange>& changes) {
+    // Work out where everything lands first, then edit the chunks from the
+    // last edit back so earlier columns stay put
+    TextLine& text = lines[line];
+    std::vector<std::pair<size_t, size_t>> ranges;
+    ranges.reserve(end - begin);
+    size_t copied = 0;
+    size_t added = 0;
+    size_t removed = 0;
+    for (size_t i = begin; i < end; i++) {
+        const TextEdit& edit = edits[i];
+        size_t from = std::max(copied, std::min(edit.from.col, text.length()));
+        size_t to = std::max(from, std::min(edit.to.col, text.length()));
+        size_t start = from + added - removed;
+        ends.push_back({ line, start + edit.text.length() });
+        changes.push_back({ line, 0, 0 });
+        if (undo) {
+            undo->push_back({ { line, start }, { line, start + edit.text.length() }, text.substr(from, to - from) });
+        }
+        ranges.emplace_back(from, to);
+        added += edit.text.length();
+        removed += to - from;
+        copied = to;
+    }
+    for (size_t i = end; i-- > begin;) {
+        const auto& range = ranges[i - begin];
+        text.replace(range.first, range.second - range.first, edits[i].text.data(), edits[i].text.length());
+    }
+}
+
+void TextBuffer::applySpliced(const std::vector<TextEdit>& edits, std::vector<TextPos>& ends,
+                              std::vector<TextEdit>* undo, std::vector<LineChange>& changes) {
+    // Rebuild everything from the first edited line down in a single pass,
+    // moving untouched lines rather than copying them
+    size_t firstLine = clamp(edits.front().from).line;
+    std::vector<TextLine> out;
+    out.reserve(lines.size() - firstLine);
+    std::string pending;
+    TextPos copied = { firstLine, 0 };
+
+    auto copyTo = [&](TextPos to) {
+        if (copied.line == to.line) {
+            lines[copied.line].appendTo(pending, copied.col, to.col - copied.col);
+        } else {
+            if (pending.empty() && copied.col == 0) {
+                out.push_back(std::move(lines[copied.line]));
+            } else {
+                lines[copied.line].appendTo(pending, copied.col, std::string::npos);
+                out.emplace_back(std::move(pending));
+                pending.clear();
+            }
+            for (size_t line = copied.line + 1; line < to.line; line++) {
+                out.push_back(std::move(lines[line]));
+            }
+            lines[to.line].appendTo(pending, 0, to.col);
+        }
+        copied = to;
+    };
+
+    for (const auto& edit : edits) {
+        TextPos from = std::max(copied, clamp(edit.from));
+        TextPos to = std::max(from, clamp(edit.to));
+        copyTo(from);
+
+        std::string removed;
+        if (undo) removed = text(from, to);
+
+        TextPos start = { firstLine + out.size(), pending.length() };
+        appendLines(pending, out, edit.text.data(), edit.text.size());
+        TextPos end = { firstLine + out.size(), pending.length() };
+        ends.push_back(end);
+        changes.push_back({ start.line, to.line - from.line, end.line - start.line });
+        if (undo) undo->push_back({ start, end, std::move(removed) });
+
+        // Skip the replaced text; the tail of its last line is copied later
+        copied = to;
+    }
+    copyTo(end());
+    out.emplace_back(std::move(pending));
+
+    lines.resize(firstLine);
+    lines.insert(lines.end(), std::make_move_iterator(out.begin()), std::make_move_iterator(out.end()));
+}
+
+TextPos TextBuffer::insert(TextPos at, const char* text, size_t length) {
+    return apply({ { at, at, std::string(text, length) } }).front();
+}
+
+void TextBuffer::erase(TextPos from, TextPos to) {
+    if (to < from) std::swap(from, to);
+    apply({ { from, to, std::string() } });
+}
+
+size_t TextBuffer::textLength(TextPos from, TextPos to, size_t newlineLength) const {
+    from = clamp(from);
+    to = clamp(to);
+    if (to < from) std::swap(from, to);
+    if (from.line == to.line) return to.col - from.col;
+
+    size_t length = lines[from.line].length() - from.col;
+    for (size_t i = from.line + 1; i < to.line; i++) length += lines[i].length();
+    length += to.col;
+    return length + (to.line - from.line) * newlineLength;
+}
+
+char* TextBuffer::copyText(TextPos from, TextPos to, char* out, const char* newline) const {
+    from = clamp(from);
+    to = clamp(to);
+    if (to < from) std::swap(from, to);
+    size_t newlineLength = strlen(newline);
+
+    for (size_t i = from.line; i <= to.line; i++) {
+        size_t start = i == from.line ? from.col : 0;
+        size_t stop = i == to.line ? to.col : lines[i].length();
+        out = lines[i].copyTo(out, start, stop - start);
+        if (i != to.line) {
+            memcpy(out, newline, newlineLength);
+            out += newlineLength;
+        }
+    }
+    return out;
+}
+
+std::string TextBuffer::text(TextPos from, TextPos to, const char* newline) const {
+    std::string result(textLength(from, to, strlen(newline)), '\0');
+    copyText(from, to, &result[0], newline);
+    return result;
+}
+
+TextPos TextBuffer::clamp(TextPos pos) const {
+    pos.line = std::min(pos.line, lines.size() - 1);
+    pos.col = std::min(pos.col, lines[pos.line].length());
+    return pos;
+}
+
+void TextBuffer::assign(std::vector<std::string>&& newLines) {
+    MemoryStats::Scope scope(MemoryStats::Text);
+    size_t oldCount = lines.size();
+    lines.clear();
+    lines.reserve(std::max<size_t>(newLines.size(), 1));
+    for (auto& line : newLines) {
+        lines.emplace_back(std::move(line));
+    }
+    newLines.clear();
+    if (lines.empty()) lines.emplace_back();
+    notify({ { 0, oldCount - 1, lines.size() - 1 } });
+}
+
+void TextBuffer::setLines(size_t first, std::vector<std::string>&& newLines) {
+    if (newLines.empty()) return;
+    MemoryStats::Scope scope(MemoryStats::Text);
+    size_t oldCount = lines.size();
+    size_t end = first + newLines.size();
+    if (end > lines.size()) lines.resize(end);
+    for (size_t i = 0; i < newLines.size(); i++) {
+        lines[first + i] = TextLine(std::move(newLines[i]));
+    }
+    newLines.clear();
+    if (first < oldCount) {
+        notify({ { first, std::min(end, oldCount) - first - 1, end - first - 1 } });
+    } else {
+        // Added after the last line, which is as if that line had grown
+        notify({ { oldCount - 1, 0, end - oldCount } });
+    }
+}
+
+std::vector<std::string_view> TextBuffer::flatLines(std::vector<std::string>& scratch) const {
+    size_t chunked = std::count_if(lines.begin(), lines.end(), [](const TextLine& line) { return line.chunked(); });
+    scratch.clear();
+    scratch.reserve(chunked);
+
+    std::vector<std::string_view> views;
+    views.reserve(lines.size());
+    for (const auto& line : lines) {
+        if (line.chunked()) {
+            scratch.push_back(line.str());
+            views.push_back(scratch.back());
+        } else {
+            views.push_back(line.scannable());
+        }
+    }
+    return views;
+}
+
+std::vector<TextEdit> TextBuffer::diffEdits(const std::vector<std::string_view>& newLines,
+                                            const std::vector<DiffHunk>& hunks) const {
+    std::vector<TextEdit> edits;
+    edits.reserve(hunks.size());
+    for (const auto& hunk : hunks) {
+        TextEdit edit;
+        size_t length = hunk.newCount;
+        for (size_t i = 0; i < hunk.newCount; i++) length += newLines[hunk.newStart + i].length();
+        edit.text.reserve(length);
+        size_t endLine = hunk.oldStart + hunk.oldCount;
+        if (endLine < lines.size()) {
+            // Whole lines, each replacement line keeping its line break
+            edit.from = { hunk.oldStart, 0 };
+            edit.to = { endLine, 0 };
+            for (size_t i = 0; i < hunk.newCount; i++) {
+                edit.text += newLines[hunk.newStart + i];
+                edit.text += '\n';
+            }
+        } else if (hunk.oldStart > 0) {
+            // Up to the end of the document: replace from the previous line break
+            edit.from = { hunk.oldStart - 1, lines[hunk.oldStart - 1].length() };
+            edit.to = end();
+            for (size_t i = 0; i < hunk.newCount; i++) {
+                edit.text += '\n';
+                edit.text += newLines[hunk.newStart + i];
+            }
+        } else {
+            edit.from = { 0, 0 };
+            edit.to = end();
+            for (size_t i = 0; i < hunk.newCount; i++) {
+                if (i > 0) edit.text += '\n';
+                edit.text += newLines[hunk.newStart + i];
+            }
+        }
+        edits.push_back(std::move(edit));
+    }
+    return edits;
+}
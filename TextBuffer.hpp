@@ -0,0 +1,105 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <cstddef>
+#include "LineDiff.hpp"
+#include "TextLine.hpp"
+
+// A position in the buffer; col is a byte offset into the line
+struct TextPos {
+    size_t line = 0;
+    size_t col = 0;
+
+    bool operator==(const TextPos& other) const { return line == other.line && col == other.col; }
+    bool operator!=(const TextPos& other) const { return !(*this == other); }
+    bool operator<(const TextPos& other) const {
+        return line < other.line || (line == other.line && col < other.col);
+    }
+};
+
+// Replace the text between `from` and `to` with `text`
+struct TextEdit {
+    TextPos from;
+    TextPos to;
+    std::string text;
+};
+
+// The lines one edit replaced: `removed` line breaks starting at line
+// `first` gave way to `inserted` new ones
+struct LineChange {
+    size_t first = 0;
+    size_t removed = 0;
+    size_t inserted = 0;
+};
+
+// For anything that keeps per-line state alongside the buffer
+class TextBufferListener {
+public:
+    virtual ~TextBufferListener() = default;
+
+    // One change per edit of a batch, in order, each numbered as if the
+    // ones before it had already been applied
+    virtual void linesChanged(const std::vector<LineChange>& changes) = 0;
+};
+
+// Line storage shared by the editor window and anything that edits text
+// without one. Always holds at least one (possibly empty) line.
+class TextBuffer {
+public:
+    TextBuffer();
+
+    size_t lineCount() const { return lines.size(); }
+    const TextLine& line(size_t index) const { return lines[index]; }
+    // Bytes held by the lines; walks every one of them
+    size_t memoryUsage() const;
+
+    // Applies a batch of edits sorted by position and not overlapping, in
+    // one pass over the affected lines. "\n" and "\r\n" in inserted text
+    // both end a line. Returns where each edit's inserted text ends and, if
+    // asked, the edits that would restore the previous text.
+    std::vector<TextPos> apply(const std::vector<TextEdit>& edits, std::vector<TextEdit>* undo = nullptr);
+
+    // Single-edit shorthands
+    TextPos insert(TextPos at, const char* text, size_t length);
+    TextPos insert(TextPos at, const std::string& text) { return insert(at, text.data(), text.size()); }
+    void erase(TextPos from, TextPos to);
+
+    // Copies a range out, ending lines with `newline`. textLength gives the
+    // exact size up front so callers can fill a preallocated block.
+    size_t textLength(TextPos from, TextPos to, size_t newlineLength) const;
+    char* copyText(TextPos from, TextPos to, char* out, const char* newline) const;
+    std::string text(TextPos from, TextPos to, const char* newline = "\n") const;
+
+    TextPos clamp(TextPos pos) const;
+    TextPos end() const { return { lines.size() - 1, lines.back().length() }; }
+
+    // Whole-document replacement
+    void assign(std::vector<std::string>&& newLines);
+    // Lines from `first` on replaced by `newLines`, growing the buffer if
+    // they run past its end; for filling in a file as it is read
+    void setLines(size_t first, std::vector<std::string>&& newLines);
+
+    // Every line as one contiguous view for whole-document work such as
+    // diffing; chunked lines are flattened into `scratch`
+    std::vector<std::string_view> flatLines(std::vector<std::string>& scratch) const;
+
+    // Edits that turn this buffer into `newLines`, one per diff hunk
+    std::vector<TextEdit> diffEdits(const std::vector<std::string_view>& newLines,
+                                    const std::vector<DiffHunk>& hunks) const;
+
+    void addListener(TextBufferListener* listener);
+    void removeListener(TextBufferListener* listener);
+
+private:
+    void applyWithinLines(const std::vector<TextEdit>& edits, std::vector<TextPos>& ends,
+                          std::vector<TextEdit>* undo, std::vector<LineChange>& changes);
+    void editChunkedLine(size_t line, const std::vector<TextEdit>& edits, size_t begin, size_t end,
+                         std::vector<TextPos>& ends, std::vector<TextEdit>* undo,
+                         std::vector<LineChange>& changes);
+    void applySpliced(const std::vector<TextEdit>& edits, std::vector<TextPos>& ends,
+                      std::vector<TextEdit>* undo, std::vector<LineChange>& changes);
+    void notify(const std::vector<LineChange>& changes);
+
+    std::vector<TextLine> lines;
+    std::vector<TextBufferListener*> listeners;
+};
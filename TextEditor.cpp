@@ -1,91 +1,219 @@
 #include "TextEditor.hpp"
-#include <fstream>
+#include "LineDiff.hpp"
+#include "TextFile.hpp"
 #include <algorithm>
 #include <cmath>
+#include <cstring>
+#include <climits>
 #include <string>
 
-TextEditor::TextEditor(HWND hwnd) : hwnd(hwnd), buffer(1, "") {
-    createFont();
-    createBuffers();
-}
+// Advances of the font selected into a device context, as GDI reports them
+class GdiGlyphMetrics : public GlyphMetrics {
+public:
+    explicit GdiGlyphMetrics(HDC hdc) : hdc(hdc) {}
+    void advances(int* widths) const override {
+        if (!GetCharWidth32A(hdc, 0, 255, widths)) std::fill(widths, widths + 256, 0);
+    }
 
-TextEditor::~TextEditor() {
-    destroyBuffers();
-    if (hFont) DeleteObject(hFont);
+private:
+    HDC hdc;
+};
+
+TextEditor::TextEditor(HWND hwnd) : hwnd(hwnd), regions(buffer), brackets(buffer), layout(buffer), minimap(buffer), loader(hwnd), transforms(hwnd), frames(hwnd) {
+    buffer.addListener(&folds);
+    buffer.addListener(&regions);
+    buffer.addListener(&brackets);
+    buffer.addListener(&layout);
+    buffer.addListener(&minimap);
+    createFont();
 }
 
 void TextEditor::createFont() {
     Settings& settings = Settings::getInstance();
     
+    HDC hdc = GetDC(hwnd);
     LOGFONTW lf = { 0 };
-    lf.lfHeight = -MulDiv(settings.fontSize, GetDeviceCaps(GetDC(hwnd), LOGPIXELSY), 72);
+    lf.lfHeight = -MulDiv(settings.fontSize, GetDeviceCaps(hdc, LOGPIXELSY), 72);
     lf.lfWeight = settings.fontBold ? FW_BOLD : FW_NORMAL;
     wcscpy_s(lf.lfFaceName, settings.fontName.c_str());
-    
-    if (hFont) DeleteObject(hFont);
-    hFont = CreateFontIndirectW(&lf);
-    
-    // Calculate metrics
-    HDC hdc = GetDC(hwnd);
-    HFONT hOldFont = (HFONT)SelectObject(hdc, hFont);
-    
-    TEXTMETRICW tm;
-    GetTextMetricsW(hdc, &tm);
-    charWidth = tm.tmAveCharWidth;
-    charHeight = tm.tmHeight + tm.tmExternalLeading;
-    
-    SelectObject(hdc, hOldFont);
+
+    // Metrics only need redoing when the font or tab size actually changed
+    HFONT font = gdi.font(lf);
+    if (font != hFont || settings.tabSize != layoutTabSize) {
+        hFont = font;
+        layoutTabSize = settings.tabSize;
+        HFONT hOldFont = (HFONT)SelectObject(hdc, hFont);
+
+        TEXTMETRICW tm;
+        GetTextMetricsW(hdc, &tm);
+        charWidth = tm.tmAveCharWidth;
+        charHeight = tm.tmHeight + tm.tmExternalLeading;
+        layout.reset(GdiGlyphMetrics(hdc), settings.tabSize);
+        regions.setTabSize(settings.tabSize);
+        // Column widths were in the old font's pixels
+        if (csv.enabled()) startColumns(csv.delimiter());
+
+        SelectObject(hdc, hOldFont);
+    }
     ReleaseDC(hwnd, hdc);
-    
+
     // Update line number width based on total lines
-    size_t maxLines = buffer.size();
+    size_t maxLines = buffer.lineCount();
     lineNumberWidth = (int)log10(maxLines + 1) + 1;
     lineNumberWidth = lineNumberWidth * charWidth + 10; // Add some padding
+    lineNumberWidth += charWidth + 4; // Fold markers
 }
 
-void TextEditor::createBuffers() {
-    HDC hdc = GetDC(hwnd);
-    memDC = CreateCompatibleDC(hdc);
-    memBitmap = CreateCompatibleBitmap(hdc, clientWidth, clientHeight);
-    oldBitmap = (HBITMAP)SelectObject(memDC, memBitmap);
-    ReleaseDC(hwnd, hdc);
+void TextEditor::resize(int width, int height) {
+    // The back buffer is grown by the next render if it has to be
+    clientWidth = width;
+    clientHeight = height;
+    updateScrollInfo();
+}
+
+TextEditor::~TextEditor() {
+    saveLineIndex();
 }
 
-void TextEditor::destroyBuffers() {
-    if (memDC) {
-        SelectObject(memDC, oldBitmap);
-        DeleteDC(memDC);
-        memDC = nullptr;
+void TextEditor::loadFile(const std::string& fname, const ViewState* view) {
+    transforms.cancel();
+    LineIndex saved;
+    bool known = saved.load(fname);
+
+    // Where to put the view back to: the session's, or else where the file
+    // was left last time
+    ViewState restored;
+    if (view) {
+        restored = *view;
+    } else if (known) {
+        TextPos caret = { static_cast<size_t>(saved.caretLine), static_cast<size_t>(saved.caretCol) };
+        restored.selections = { Selection{ caret, caret } };
+        restored.topLine = static_cast<size_t>(saved.topLine);
     }
-    if (memBitmap) {
-        DeleteObject(memBitmap);
-        memBitmap = nullptr;
+    saved.topLine = restored.topLine;
+
+    saveLineIndex();
+    if (!loader.start(fname, known ? &saved : nullptr)) return;
+    filename = fname;
+    indexValid = false;
+    pendingView = std::move(restored);
+
+    // The lines fill in as the loader reads them. A file seen before gets
+    // its full length and old position at once, as blank lines until then;
+    // carets and folds wait for the text.
+    buffer.assign(std::vector<std::string>(known ? saved.lineCount : 0));
+    if (char delimiter = CsvLayout::delimiterFor(fname)) {
+        startColumns(delimiter);
+    } else if (csv.enabled()) {
+        alignColumns(false);
+    }
+    TextPos caret;
+    if (!pendingView.selections.empty()) {
+        size_t primary = std::min(pendingView.primary, pendingView.selections.size() - 1);
+        caret = buffer.clamp({ pendingView.selections[primary].caret.line, 0 });
     }
+    cursors.set(Selection{ caret, caret });
+    loadCaret = caret;
+    history.clear();
+    blockSelecting = false;
+    scrollX = pendingView.scrollX;
+    scrollY = static_cast<long long>(std::min(pendingView.topLine, buffer.lineCount() - 1)) * charHeight;
+    loadingWidth = known ? static_cast<long long>(saved.longestLength) * layout.glyphTable().average : 0;
+    isModified = false;
+    updateScrollInfo();
+    InvalidateRect(hwnd, NULL, TRUE);
 }
 
-void TextEditor::resize(int width, int height) {
-    clientWidth = width;
-    clientHeight = height;
-    destroyBuffers();
-    createBuffers();
+void TextEditor::awaitFirstLines() {
+    if (loader.loading() && loader.wait(std::chrono::milliseconds(FIRST_LINES_WAIT_MS))) {
+        takeLoadedLines();
+    }
+}
+
+void TextEditor::takeLoadedLines() {
+    FileLoader::Update update = loader.take();
+    for (auto& run : update.runs) {
+        size_t first = run.first;
+        size_t count = run.lines.size();
+        buffer.setLines(first, std::move(run.lines));
+        for (size_t line = first; line < first + count; line++) {
+            loadingWidth = std::max(loadingWidth, layout.width(line));
+        }
+    }
+    if (update.done) {
+        loadingWidth = 0;
+        rememberDiskState();
+        if (csv.enabled()) {
+            csv.rescan(buffer);
+            SetTimer(hwnd, COLUMN_TIMER, COLUMN_TIMER_MS, NULL);
+        }
+        if (update.failed) {
+            MessageBoxW(hwnd, L"The file is damaged and could only be read in part.", L"Open File",
+                        MB_OK | MB_ICONWARNING);
+        } else {
+            // A saved index can only have been longer if the file changed
+            // while it was being read
+            size_t lines = std::max<size_t>(static_cast<size_t>(update.index.lineCount), 1);
+            if (buffer.lineCount() > lines) {
+                buffer.erase({ lines - 1, buffer.line(lines - 1).length() }, buffer.end());
+            }
+            restoreView();
+            index = std::move(update.index);
+            indexValid = true;
+            saveLineIndex();
+        }
+    }
     updateScrollInfo();
+    InvalidateRect(hwnd, NULL, FALSE);
 }
 
-void TextEditor::loadFile(const std::string& fname) {
-    filename = fname;
-    std::ifstream file(fname);
-    if (file.is_open()) {
-        buffer.clear();
-        std::string line;
-        while (std::getline(file, line)) {
-            buffer.push_back(line);
+void TextEditor::restoreView() {
+    // Unless the caret was moved while the file loaded
+    const Selection& primary = cursors.primary();
+    if (cursors.count() != 1 || !primary.empty() || primary.caret != loadCaret) return;
+
+    for (const auto& fold : pendingView.folds) {
+        if (fold.second < buffer.lineCount()) folds.fold(fold.first, fold.second);
+    }
+    if (!pendingView.selections.empty()) {
+        std::vector<Selection> selections;
+        for (const auto& selection : pendingView.selections) {
+            selections.push_back({ buffer.clamp(selection.anchor), buffer.clamp(selection.caret) });
         }
-        if (buffer.empty()) buffer.push_back("");
-        file.close();
-        isModified = false;
-        updateScrollInfo();
-        InvalidateRect(hwnd, NULL, TRUE);
+        size_t primaryIndex = std::min(pendingView.primary, selections.size() - 1);
+        cursors.set(std::move(selections), primaryIndex);
+    }
+    scrollX = pendingView.scrollX;
+    size_t top = std::min(pendingView.topLine, buffer.lineCount() - 1);
+    scrollY = static_cast<long long>(folds.lineToRow(top)) * charHeight;
+}
+
+// Inner folds first, so folding in order nests them again
+static void flattenFolds(const std::vector<FoldRange>& ranges, size_t origin,
+                         std::vector<std::pair<size_t, size_t>>& out) {
+    for (const auto& range : ranges) {
+        flattenFolds(range.inner, origin + range.header, out);
+        out.push_back({ origin + range.header, origin + range.end });
+    }
+}
+
+ViewState TextEditor::viewState() const {
+    ViewState view;
+    view.selections = cursors.all();
+    view.primary = cursors.primaryPosition();
+    view.topLine = folds.rowToLine(static_cast<size_t>(scrollY / std::max(charHeight, 1)));
+    view.scrollX = scrollX;
+    flattenFolds(folds.collapsed(), 0, view.folds);
+    return view;
+}
+
+std::vector<std::string> TextEditor::documentLines() const {
+    std::vector<std::string> lines;
+    lines.reserve(buffer.lineCount());
+    for (size_t i = 0; i < buffer.lineCount(); i++) {
+        lines.push_back(buffer.line(i).str());
     }
+    return lines;
 }
 
 void TextEditor::saveFile() {
@@ -93,231 +221,908 @@ void TextEditor::saveFile() {
         // TODO: Show file dialog
         return;
     }
-    std::ofstream file(filename);
-    if (file.is_open()) {
-        for (const auto& line : buffer) {
-            file << line << "\n";
-        }
-        file.close();
+    if (loader.loading()) {
+        // Saving now would cut the file off where reading has got to
+        MessageBoxW(hwnd, L"The file is still being read.", L"Save File", MB_OK | MB_ICONINFORMATION);
+        return;
+    }
+    LineIndex written;
+    if (TextFile::writeLines(filename, buffer, &written)) {
         isModified = false;
+        rememberDiskState();
+        indexValid = written.identify(filename);
+        index = std::move(written);
+    }
+}
+
+void TextEditor::saveLineIndex() {
+    // Only worth keeping while it still describes the file on disk
+    if (filename.empty() || !indexValid || loader.loading()) return;
+    const TextPos& caret = cursors.primary().caret;
+    index.topLine = folds.rowToLine(static_cast<size_t>(scrollY / std::max(charHeight, 1)));
+    index.caretLine = caret.line;
+    index.caretCol = caret.col;
+    index.save(filename);
+}
+
+void TextEditor::rememberDiskState() {
+    std::error_code ec;
+    diskTime = std::filesystem::last_write_time(filename, ec);
+    diskSize = std::filesystem::file_size(filename, ec);
+}
+
+void TextEditor::checkExternalChanges() {
+    if (filename.empty() || readOnly()) return;
+
+    std::error_code ec;
+    auto time = std::filesystem::last_write_time(filename, ec);
+    if (ec) return;
+    uintmax_t size = std::filesystem::file_size(filename, ec);
+    if (ec || (time == diskTime && size == diskSize)) return;
+
+    // Remember the new state first so a declined reload is not asked again
+    diskTime = time;
+    diskSize = size;
+
+    if (isModified &&
+        MessageBoxW(hwnd, L"The file has been changed on disk. Reload it and lose your changes?",
+                    L"File Changed", MB_YESNO | MB_ICONQUESTION) != IDYES) {
+        return;
+    }
+    reloadFromDisk();
+}
+
+void TextEditor::reloadFromDisk() {
+    std::vector<std::string> lines;
+    LineIndex fresh;
+    if (!fresh.identify(filename) || !TextFile::readLines(filename, lines, &fresh)) return;
+    index = std::move(fresh);
+    indexValid = true;
+
+    // Apply only the changed hunks so carets and scroll stay with their
+    // text, as one undoable step
+    std::vector<std::string> scratch;
+    std::vector<std::string_view> newLines(lines.begin(), lines.end());
+    applyHunks(newLines, LineDiff::compute(buffer.flatLines(scratch), newLines));
+    isModified = false;
+    updateScrollInfo();
+    InvalidateRect(hwnd, NULL, TRUE);
+}
+
+void TextEditor::applyHunks(const std::vector<std::string_view>& lines, const std::vector<DiffHunk>& hunks) {
+    if (hunks.empty()) return;
+    size_t topLine = folds.rowToLine(charHeight > 0 ? scrollY / charHeight : 0);
+    size_t newTop = LineDiff::mapLine(hunks, topLine);
+
+    CursorSet before = cursors;
+    std::vector<TextEdit> undoEdits;
+    buffer.apply(buffer.diffEdits(lines, hunks), &undoEdits);
+    history.record(std::move(undoEdits), before);
+
+    std::vector<Selection> moved;
+    moved.reserve(cursors.count());
+    for (const auto& selection : cursors.all()) {
+        TextPos caret = buffer.clamp({ LineDiff::mapLine(hunks, selection.caret.line), selection.caret.col });
+        moved.push_back({ caret, caret });
+    }
+    cursors.set(std::move(moved), cursors.primaryPosition());
+    blockSelecting = false;
+    scrollY = static_cast<long long>(folds.lineToRow(std::min(newTop, buffer.lineCount() - 1))) * charHeight;
+}
+
+void TextEditor::transformLines(LineTransform::Kind kind) {
+    if (readOnly()) return;
+    LineTransform::Spec spec;
+    spec.kind = kind;
+    if (kind == LineTransform::KeepMatching || kind == LineTransform::DropMatching) {
+        const Selection& selection = cursors.primary();
+        spec.pattern = buffer.text(selection.start(), selection.end());
+        if (spec.pattern.empty() || spec.pattern.find('\n') != std::string::npos) {
+            MessageBoxW(hwnd, L"Select the text to look for, within one line, first.", L"Filter Lines",
+                        MB_OK | MB_ICONINFORMATION);
+            return;
+        }
+    } else if (kind == LineTransform::SortByField) {
+        // The field the caret is in, split the way the columns are shown
+        const TextPos& caret = cursors.primary().caret;
+        const TextLine& line = buffer.line(caret.line);
+        spec.delimiter = csv.enabled() ? csv.delimiter() : CsvLayout::detectDelimiter(buffer.line(0).scannable());
+        if (!spec.delimiter || line.chunked()) {
+            MessageBoxW(hwnd, L"Put the caret in a column of delimited text first.", L"Sort by Column",
+                        MB_OK | MB_ICONINFORMATION);
+            return;
+        }
+        std::vector<size_t> starts = CsvLayout::fieldStarts(line.scannable(), spec.delimiter);
+        spec.field = std::upper_bound(starts.begin(), starts.end(), caret.col) - starts.begin() - 1;
     }
+    transforms.start(spec, buffer);
+}
+
+void TextEditor::takeTransformedLines() {
+    if (!transforms.finished()) return;
+    LineTransform::Result result = transforms.take();
+    if (result.hunks.empty()) return;
+    applyHunks(result.lines, result.hunks);
+    isModified = true;
+    updateScrollInfo();
+    InvalidateRect(hwnd, NULL, TRUE);
+}
+
+void TextEditor::commitEdit(const CursorSet& before, std::vector<TextEdit>&& undoEdits) {
+    blockSelecting = false;
+    if (undoEdits.empty()) return;
+    history.record(std::move(undoEdits), before);
+    isModified = true;
+}
+
+void TextEditor::replaceSelections(const std::string& text) {
+    if (readOnly()) return;
+    CursorSet before = cursors;
+    commitEdit(before, cursors.replaceSelections(buffer, text));
 }
 
 void TextEditor::handleChar(WPARAM wParam) {
     if (wParam >= 32 && wParam <= 126) { // Printable characters
-        insertChar(static_cast<char>(wParam));
+        replaceSelections(std::string(1, static_cast<char>(wParam)));
         ensureCursorVisible();
         InvalidateRect(hwnd, NULL, TRUE);
     }
 }
 
-void TextEditor::handleKeyDown(WPARAM wParam) {
-    Settings& settings = Settings::getInstance();
-    switch (wParam) {
+TextPos TextEditor::movePosition(TextPos pos, WPARAM key) const {
+    // Moving between lines steps over folded ones
+    size_t row = folds.lineToRow(pos.line);
+    size_t rows = folds.visibleCount(buffer.lineCount());
+    switch (key) {
         case VK_LEFT:
-            if (cursorX > 0) cursorX--;
+            if (pos.col > 0) {
+                pos.col--;
+            } else if (row > 0) {
+                pos.line = folds.rowToLine(row - 1);
+                pos.col = buffer.line(pos.line).length();
+            }
             break;
         case VK_RIGHT:
-            if (cursorX < buffer[cursorY].length()) cursorX++;
+            if (pos.col < buffer.line(pos.line).length()) {
+                pos.col++;
+            } else if (row + 1 < rows) {
+                pos.line = folds.rowToLine(row + 1);
+                pos.col = 0;
+            }
             break;
         case VK_UP:
-            if (cursorY > 0) {
-                cursorY--;
-                cursorX = std::min(cursorX, buffer[cursorY].length());
+        case VK_DOWN:
+            // Keep the caret at the same x, which with a proportional font or
+            // tabs is not the same column
+            if (key == VK_UP ? row > 0 : row + 1 < rows) {
+                long long x = layout.x(pos.line, pos.col);
+                pos.line = folds.rowToLine(key == VK_UP ? row - 1 : row + 1);
+                pos.col = layout.hitTest(pos.line, x);
             }
             break;
+        case VK_HOME:
+            pos.col = 0;
+            break;
+        case VK_END:
+            pos.col = buffer.line(pos.line).length();
+            break;
+    }
+    return pos;
+}
+
+void TextEditor::handleKeyDown(WPARAM wParam) {
+    Settings& settings = Settings::getInstance();
+    bool shift = GetKeyState(VK_SHIFT) < 0;
+    bool ctrl = GetKeyState(VK_CONTROL) < 0;
+    bool alt = GetKeyState(VK_MENU) < 0;
+
+    if (ctrl) {
+        switch (wParam) {
+            case 'A': selectAll(); return;
+            case 'C': copy(); return;
+            case 'X': cut(); return;
+            case 'V': paste(); return;
+            case 'Z': undo(); return;
+            case 'Y': redo(); return;
+            case 'L':
+                if (shift) selectAllOccurrences();
+                return;
+            case VK_OEM_4: // Ctrl+Shift+[
+                if (shift) foldAtCaret();
+                return;
+            case VK_OEM_6: // Ctrl+Shift+]
+                if (shift) unfoldAtCaret();
+                return;
+            case VK_OEM_5: // Ctrl+Shift+backslash
+                if (shift) jumpToBracket();
+                return;
+            case VK_UP:
+            case VK_DOWN:
+                if (alt) {
+                    addCaretVertically(wParam == VK_UP ? -1 : 1);
+                    return;
+                }
+                break;
+        }
+    }
+
+    CursorSet before = cursors;
+    switch (wParam) {
+        case VK_LEFT:
+        case VK_RIGHT:
+        case VK_UP:
         case VK_DOWN:
-            if (cursorY < buffer.size() - 1) {
-                cursorY++;
-                cursorX = std::min(cursorX, buffer[cursorY].length());
-            }
+        case VK_HOME:
+        case VK_END:
+            cursors.moveCarets([&](TextPos pos) { return movePosition(pos, wParam); }, shift);
+            blockSelecting = false;
             break;
         case VK_RETURN:
-            insertChar('\n');
+            replaceSelections("\n");
             break;
         case VK_TAB:
-            for (int i = 0; i < settings.tabSize; i++) {
-                insertChar(' ');
-            }
+            replaceSelections(std::string(settings.tabSize, ' '));
             break;
         case VK_BACK:
-            if (cursorX > 0) {
-                buffer[cursorY].erase(cursorX - 1, 1);
-                cursorX--;
-                isModified = true;
-            } else if (cursorY > 0) {
-                cursorX = buffer[cursorY - 1].length();
-                buffer[cursorY - 1] += buffer[cursorY];
-                buffer.erase(buffer.begin() + cursorY);
-                cursorY--;
-                isModified = true;
-            }
+            if (!readOnly()) commitEdit(before, cursors.deleteBackward(buffer));
+            break;
+        case VK_DELETE:
+            if (!readOnly()) commitEdit(before, cursors.deleteForward(buffer));
             break;
+        case VK_ESCAPE:
+            transforms.cancel();
+            cursors.keepPrimary();
+            blockSelecting = false;
+            break;
+        default:
+            return;
+    }
+    ensureCursorVisible();
+    InvalidateRect(hwnd, NULL, TRUE);
+}
+
+void TextEditor::handleMouseDown(int x, int y, bool shift) {
+    Settings& settings = Settings::getInstance();
+    int xOffset = settings.showLineNumbers ? lineNumberWidth : 0;
+
+    // A click on the minimap brings the line under it to the middle
+    int pixels = minimapPixels();
+    if (x >= clientWidth - minimapWidth() && pixels > 0) {
+        size_t line = static_cast<size_t>(static_cast<double>(std::min(y, pixels - 1)) * buffer.lineCount() / pixels);
+        long long top = static_cast<long long>(folds.lineToRow(line)) * charHeight - clientHeight / 2;
+        scrollY = std::max(0LL, std::min(top, maxScrollY));
+        updateScrollInfo();
+        InvalidateRect(hwnd, NULL, TRUE);
+        return;
     }
+
+    // The row under the click, then the column boundary nearest to it
+    size_t rows = folds.visibleCount(buffer.lineCount());
+    long long row = std::max(0LL, (y + scrollY) / std::max(charHeight, 1));
+    size_t line = folds.rowToLine(std::min(static_cast<size_t>(row), rows - 1));
+    TextPos pos = { line, layout.hitTest(line, x - xOffset + scrollX) };
+
+    TextPos anchor = shift ? cursors.primary().anchor : pos;
+    cursors.set(Selection{ anchor, pos });
+    blockSelecting = false;
     ensureCursorVisible();
     InvalidateRect(hwnd, NULL, TRUE);
 }
 
-void TextEditor::insertChar(char ch) {
-    if (ch == '\n') {
-        std::string rest = buffer[cursorY].substr(cursorX);
-        buffer[cursorY].erase(cursorX);
-        buffer.insert(buffer.begin() + cursorY + 1, rest);
-        cursorX = 0;
-        cursorY++;
+bool TextEditor::handleSysKeyDown(WPARAM wParam) {
+    // Shift+Alt+arrows grow a column selection and Alt+Left/Right step
+    // between aligned fields; everything else goes to the system so menu
+    // accelerators keep working
+    bool shift = GetKeyState(VK_SHIFT) < 0;
+    if (!shift && csv.enabled() && (wParam == VK_LEFT || wParam == VK_RIGHT)) {
+        jumpToField(wParam == VK_LEFT ? -1 : 1);
+        return true;
+    }
+    if (!shift || (wParam != VK_LEFT && wParam != VK_RIGHT && wParam != VK_UP && wParam != VK_DOWN)) {
+        return false;
+    }
+
+    if (!blockSelecting) {
+        blockAnchor = blockCaret = cursors.primary().caret;
+        blockSelecting = true;
+    }
+    switch (wParam) {
+        case VK_LEFT:
+            if (blockCaret.col > 0) blockCaret.col--;
+            break;
+        case VK_RIGHT:
+            blockCaret.col++;
+            break;
+        case VK_UP:
+        case VK_DOWN:
+            blockCaret.line = movePosition(blockCaret, wParam).line;
+            break;
+    }
+
+    // One selection per visible line, each clipped to its own line's length
+    size_t anchorRow = folds.lineToRow(blockAnchor.line);
+    size_t caretRow = folds.lineToRow(blockCaret.line);
+    size_t top = std::min(anchorRow, caretRow);
+    size_t bottom = std::max(anchorRow, caretRow);
+    std::vector<Selection> block;
+    block.reserve(bottom - top + 1);
+    for (size_t row = top; row <= bottom; row++) {
+        size_t i = folds.rowToLine(row);
+        size_t length = buffer.line(i).length();
+        block.push_back({ { i, std::min(blockAnchor.col, length) }, { i, std::min(blockCaret.col, length) } });
+    }
+    cursors.set(std::move(block), caretRow - top);
+
+    ensureCursorVisible();
+    InvalidateRect(hwnd, NULL, TRUE);
+    return true;
+}
+
+void TextEditor::jumpToField(int direction) {
+    // To the start of the previous or next field, or the ends of the line
+    TextPos caret = cursors.primary().caret;
+    const TextLine& line = buffer.line(caret.line);
+    if (line.chunked()) return;
+    std::vector<size_t> starts = CsvLayout::fieldStarts(line.scannable(), csv.delimiter());
+    size_t col;
+    if (direction < 0) {
+        auto it = std::lower_bound(starts.begin(), starts.end(), caret.col);
+        col = it == starts.begin() ? 0 : *(it - 1);
     } else {
-        buffer[cursorY].insert(cursorX, 1, ch);
-        cursorX++;
+        auto it = std::upper_bound(starts.begin(), starts.end(), caret.col);
+        col = it == starts.end() ? line.length() : *it;
     }
-    isModified = true;
+    cursors.set({ { caret.line, col }, { caret.line, col } });
+    blockSelecting = false;
+    ensureCursorVisible();
+    InvalidateRect(hwnd, NULL, TRUE);
 }
 
-void TextEditor::render(HDC hdc) {
-    Settings& settings = Settings::getInstance();
-    Theme& theme = settings.currentTheme;
+void TextEditor::alignColumns(bool align) {
+    if (align == csv.enabled()) return;
+    if (align) {
+        char delimiter = CsvLayout::delimiterFor(filename);
+        if (!delimiter) delimiter = CsvLayout::detectDelimiter(buffer.line(0).scannable());
+        if (!delimiter) {
+            MessageBoxW(hwnd, L"The first line has no commas, tabs, semicolons or bars to align.",
+                        L"Align Columns", MB_OK | MB_ICONINFORMATION);
+            return;
+        }
+        startColumns(delimiter);
+    } else {
+        csv.disable();
+        layout.setColumns(csv.stops());
+        KillTimer(hwnd, COLUMN_TIMER);
+    }
+    updateScrollInfo();
+    InvalidateRect(hwnd, NULL, TRUE);
+}
 
-    // Clear background
-    RECT rect;
-    GetClientRect(hwnd, &rect);
-    HBRUSH hBrush = CreateSolidBrush(theme.background);
-    FillRect(memDC, &rect, hBrush);
-    DeleteObject(hBrush);
+void TextEditor::startColumns(char delimiter) {
+    // Sampled widths show at once; the timer refines them from every line
+    csv.enable(delimiter, buffer, layout.glyphTable());
+    layout.setColumns(csv.stops());
+    SetTimer(hwnd, COLUMN_TIMER, COLUMN_TIMER_MS, NULL);
+}
 
-    // Draw line numbers if enabled
-    if (settings.showLineNumbers) {
-        drawLineNumbers(memDC);
+void TextEditor::refineColumns() {
+    // New stops drop every measured line, so they are taken at most every
+    // COLUMN_APPLY_MS while the scan lasts
+    csv.refine(buffer, layout.glyphTable(), std::chrono::milliseconds(COLUMN_SLICE_MS));
+    auto now = std::chrono::steady_clock::now();
+    if (layout.columnStops() != csv.stops() &&
+        (!csv.scanning() || now - columnsApplied >= std::chrono::milliseconds(COLUMN_APPLY_MS))) {
+        layout.setColumns(csv.stops());
+        columnsApplied = now;
+        InvalidateRect(hwnd, NULL, FALSE);
     }
+    if (!csv.scanning()) {
+        KillTimer(hwnd, COLUMN_TIMER);
+        updateScrollInfo();
+    }
+}
 
-    // Draw text
-    drawText(memDC);
-    drawStatusBar(memDC);
+void TextEditor::addCaretVertically(int direction) {
+    TextPos caret = cursors.primary().caret;
+    TextPos moved = movePosition(caret, direction < 0 ? VK_UP : VK_DOWN);
+    if (moved.line == caret.line) return;
+    cursors.add({ moved, moved });
+    blockSelecting = false;
+    ensureCursorVisible();
+    InvalidateRect(hwnd, NULL, TRUE);
+}
 
-    // Copy to screen
-    BitBlt(hdc, 0, 0, clientWidth, clientHeight, memDC, 0, 0, SRCCOPY);
+static bool isWordChar(char c) {
+    return isalnum(static_cast<unsigned char>(c)) || c == '_';
 }
 
-void TextEditor::drawLineNumbers(HDC hdc) {
-    Settings& settings = Settings::getInstance();
-    Theme& theme = settings.currentTheme;
+void TextEditor::selectAllOccurrences() {
+    // Search for the primary selection, or the word under the caret
+    const Selection& primary = cursors.primary();
+    TextPos start = primary.start();
+    TextPos end = primary.end();
+    if (start.line != end.line) return;
+    const TextLine& current = buffer.line(start.line);
+    if (primary.empty()) {
+        while (start.col > 0 && isWordChar(current.at(start.col - 1))) start.col--;
+        while (end.col < current.length() && isWordChar(current.at(end.col))) end.col++;
+    }
+    if (start == end) return;
+    std::string needle = current.substr(start.col, end.col - start.col);
 
-    SetBkMode(hdc, TRANSPARENT);
-    SetTextColor(hdc, theme.lineNumber);
-    SelectObject(hdc, hFont);
+    std::vector<Selection> found;
+    size_t primaryIndex = 0;
+    for (size_t i = 0; i < buffer.lineCount(); i++) {
+        const TextLine& line = buffer.line(i);
+        for (size_t pos = line.find(needle); pos != std::string::npos;
+             pos = line.find(needle, pos + needle.length())) {
+            if (i == start.line && pos == start.col) primaryIndex = found.size();
+            found.push_back({ { i, pos }, { i, pos + needle.length() } });
+        }
+    }
+    cursors.set(std::move(found), primaryIndex);
+    blockSelecting = false;
 
-    for (size_t i = 0; i < buffer.size(); i++) {
-        POINT pos = getCharPosition(i, 0);
-        std::string lineNum = std::to_string(i + 1);
-        TextOutA(hdc, 5, pos.y, lineNum.c_str(), static_cast<int>(lineNum.length()));
+    // Open any folds hiding a match
+    for (const auto& selection : cursors.all()) {
+        while (folds.isHidden(selection.caret.line)) folds.unfold(selection.caret.line);
     }
+    updateScrollInfo();
+    InvalidateRect(hwnd, NULL, TRUE);
+}
+
+void TextEditor::foldAtCaret() {
+    size_t line = cursors.primary().caret.line;
 
-    // Draw separator line
-    RECT rect = { lineNumberWidth - 2, 0, lineNumberWidth - 1, clientHeight };
-    HBRUSH hBrush = CreateSolidBrush(theme.lineNumber);
-    FillRect(hdc, &rect, hBrush);
-    DeleteObject(hBrush);
+    // Fold the innermost region around the caret that is still open
+    size_t from = line;
+    size_t header, end;
+    for (;;) {
+        if (!regions.enclosing(line, from, header, end)) return;
+        if (!folds.isFolded(header)) break;
+        if (header == 0) return;
+        from = header - 1;
+    }
+    if (!folds.fold(header, end)) return;
+
+    // Carets that are now hidden move to the end of the header line
+    TextPos headerEnd = { header, buffer.line(header).length() };
+    cursors.moveCarets([&](TextPos pos) { return folds.isHidden(pos.line) ? headerEnd : pos; }, true);
+    updateScrollInfo();
+    ensureCursorVisible();
+    InvalidateRect(hwnd, NULL, TRUE);
 }
 
-void TextEditor::drawText(HDC hdc) {
-    Settings& settings = Settings::getInstance();
-    Theme& theme = settings.currentTheme;
+void TextEditor::unfoldAtCaret() {
+    if (!folds.unfold(cursors.primary().caret.line)) return;
+    updateScrollInfo();
+    ensureCursorVisible();
+    InvalidateRect(hwnd, NULL, TRUE);
+}
 
-    SelectObject(hdc, hFont);
-    SetBkMode(hdc, TRANSPARENT);
-    SetTextColor(hdc, theme.text);
+void TextEditor::jumpToBracket() {
+    // To the partner of the bracket at the caret, or else to the start of
+    // the pair around it
+    TextPos caret = cursors.primary().caret;
+    TextPos open, close, target;
+    if (brackets.matchingPair(caret, open, close)) {
+        target = caret.line == open.line && (caret.col == open.col || caret.col == open.col + 1) ? close : open;
+    } else if (brackets.enclosingPair(caret, open, close)) {
+        target = open;
+    } else {
+        return;
+    }
+    while (folds.isHidden(target.line)) folds.unfold(target.line);
+    cursors.set({ target, target });
+    blockSelecting = false;
+    updateScrollInfo();
+    ensureCursorVisible();
+    InvalidateRect(hwnd, NULL, TRUE);
+}
 
-    int xOffset = settings.showLineNumbers ? lineNumberWidth : 0;
+void TextEditor::foldAll() {
+    // Only the outermost regions; nested ones open up with them
+    folds.clear();
+    for (size_t i = 0; i < buffer.lineCount(); i++) {
+        size_t end;
+        if (regions.find(i, end) && folds.fold(i, end)) {
+            i = end;
+        }
+    }
+    cursors.moveCarets([&](TextPos pos) {
+        size_t header, end;
+        return folds.find(pos.line, header, end) && pos.line > header
+            ? TextPos{ header, buffer.line(header).length() }
+            : pos;
+    }, false);
+    updateScrollInfo();
+    ensureCursorVisible();
+    InvalidateRect(hwnd, NULL, TRUE);
+}
+
+void TextEditor::unfoldAll() {
+    folds.clear();
+    updateScrollInfo();
+    ensureCursorVisible();
+    InvalidateRect(hwnd, NULL, TRUE);
+}
 
-    for (size_t i = 0; i < buffer.size(); i++) {
-        POINT pos = getCharPosition(i, 0);
-        TextOutA(hdc, pos.x + xOffset, pos.y, buffer[i].c_str(), static_cast<int>(buffer[i].length()));
+void TextEditor::undo() {
+    if (readOnly() || !history.undo(buffer, cursors)) return;
+    blockSelecting = false;
+    isModified = true;
+    ensureCursorVisible();
+    InvalidateRect(hwnd, NULL, TRUE);
+}
+
+void TextEditor::redo() {
+    if (readOnly() || !history.redo(buffer, cursors)) return;
+    blockSelecting = false;
+    isModified = true;
+    ensureCursorVisible();
+    InvalidateRect(hwnd, NULL, TRUE);
+}
+
+void TextEditor::insertText(const char* text, size_t length) {
+    replaceSelections(std::string(text, length));
+}
+
+bool TextEditor::hasSelection() const {
+    const auto& selections = cursors.all();
+    return std::any_of(selections.begin(), selections.end(),
+                       [](const Selection& s) { return !s.empty(); });
+}
+
+void TextEditor::selectAll() {
+    cursors.set({ TextPos(), buffer.end() });
+    blockSelecting = false;
+    ensureCursorVisible();
+    InvalidateRect(hwnd, NULL, TRUE);
+}
+
+void TextEditor::copyToClipboard(HWND owner, size_t length, const std::function<void(char*)>& fill) {
+    HGLOBAL hMem = GlobalAlloc(GMEM_MOVEABLE, length + 1);
+    if (!hMem) return;
+    char* data = static_cast<char*>(GlobalLock(hMem));
+    fill(data);
+    data[length] = '\0';
+    GlobalUnlock(hMem);
+    if (OpenClipboard(owner)) {
+        EmptyClipboard();
+        if (SetClipboardData(CF_TEXT, hMem)) {
+            hMem = nullptr; // Owned by the clipboard now
+        }
+        CloseClipboard();
     }
+    if (hMem) GlobalFree(hMem);
+}
 
-    // Draw cursor
-    POINT cursorPos = getCharPosition(cursorY, cursorX);
-    cursorPos.x += xOffset;
-    RECT cursorRect = {
-        cursorPos.x, cursorPos.y,
-        cursorPos.x + 2, cursorPos.y + charHeight
-    };
-    HBRUSH hBrush = CreateSolidBrush(theme.cursor);
-    FillRect(hdc, &cursorRect, hBrush);
-    DeleteObject(hBrush);
+void TextEditor::copyToClipboard(HWND owner, const std::string& text) {
+    copyToClipboard(owner, text.length(), [&](char* data) { memcpy(data, text.data(), text.length()); });
 }
 
-void TextEditor::drawStatusBar(HDC hdc) {
-    Settings& settings = Settings::getInstance();
-    Theme& theme = settings.currentTheme;
+void TextEditor::copy() {
+    if (!hasSelection()) return;
+
+    // Every non-empty selection, one per line, sized exactly up front and
+    // copied straight into the clipboard block
+    std::vector<const Selection*> copied;
+    size_t length = 0;
+    for (const auto& selection : cursors.all()) {
+        if (selection.empty()) continue;
+        if (!copied.empty()) length += 2;
+        length += buffer.textLength(selection.start(), selection.end(), 2);
+        copied.push_back(&selection);
+    }
+    copyToClipboard(hwnd, length, [&](char* data) {
+        for (size_t i = 0; i < copied.size(); i++) {
+            if (i > 0) {
+                *data++ = '\r';
+                *data++ = '\n';
+            }
+            data = buffer.copyText(copied[i]->start(), copied[i]->end(), data, "\r\n");
+        }
+    });
+}
+
+void TextEditor::cut() {
+    if (!hasSelection()) return;
+    copy();
+    replaceSelections(std::string());
+    ensureCursorVisible();
+    InvalidateRect(hwnd, NULL, TRUE);
+}
+
+static std::vector<std::string> splitLines(const std::string& text) {
+    std::vector<std::string> lines;
+    size_t start = 0;
+    while (true) {
+        size_t newline = text.find('\n', start);
+        size_t end = newline == std::string::npos ? text.length() : newline;
+        size_t trimmed = end > start && text[end - 1] == '\r' ? end - 1 : end;
+        lines.push_back(text.substr(start, trimmed - start));
+        if (newline == std::string::npos) break;
+        start = newline + 1;
+    }
+    // A trailing line break does not start another line of clipboard text
+    if (lines.size() > 1 && lines.back().empty()) lines.pop_back();
+    return lines;
+}
+
+void TextEditor::paste() {
+    if (readOnly() || !IsClipboardFormatAvailable(CF_TEXT) || !OpenClipboard(hwnd)) return;
+
+    HGLOBAL hData = static_cast<HGLOBAL>(GetClipboardData(CF_TEXT));
+    const char* data = hData ? static_cast<const char*>(GlobalLock(hData)) : nullptr;
+    std::string text;
+    if (data) {
+        text.assign(data, strnlen(data, GlobalSize(hData)));
+        GlobalUnlock(hData);
+    }
+    CloseClipboard();
+    if (text.empty()) return;
+
+    // One clipboard line per caret when the counts agree (as written by a
+    // multi-selection copy), otherwise the whole text at every caret.
+    // Either way it is a single batch and a single undo step.
+    CursorSet before = cursors;
+    std::vector<std::string> lines;
+    if (cursors.count() > 1 && (lines = splitLines(text)).size() == cursors.count()) {
+        commitEdit(before, cursors.replaceSelections(buffer, lines));
+    } else {
+        commitEdit(before, cursors.replaceSelections(buffer, text));
+    }
+
+    ensureCursorVisible();
+    InvalidateRect(hwnd, NULL, TRUE);
+}
+
+void TextEditor::render(HDC hdc) {
+    // Rows coming on screen widen aligned columns before they are laid out
+    if (csv.enabled()) {
+        size_t first, last;
+        getVisibleRows(first, last);
+        bool grew = false;
+        for (size_t row = first; row < last; row++) {
+            grew |= csv.include(buffer.line(folds.rowToLine(row)), layout.glyphTable());
+        }
+        if (grew) layout.setColumns(csv.stops());
+    }
+
+    // Layout happens on the frame builder's thread; painting only asks for a
+    // frame of the current state and draws the newest one it has finished
+    FrameRequest request = snapshot();
+    if (!(request == lastRequest)) {
+        lastRequest = request;
+        frames.request(std::move(request));
+    }
+    if (std::unique_ptr<Frame> frame = frames.take()) {
+        currentFrame = std::move(frame);
+    }
 
+    size_t created = gdi.creations();
+    HDC memDC = gdi.backBuffer(hwnd, clientWidth, clientHeight);
+
+    // Clear background
     RECT rect;
     GetClientRect(hwnd, &rect);
-    rect.top = rect.bottom - charHeight;
+    COLORREF background = currentFrame ? currentFrame->background : Settings::getInstance().currentTheme.background;
+    FillRect(memDC, &rect, gdi.brush(background));
+
+    if (currentFrame) {
+        SelectObject(memDC, hFont);
+        SetBkMode(memDC, TRANSPARENT);
+        for (const FrameItem& item : currentFrame->items) {
+            switch (item.kind) {
+                case FrameItem::Fill:
+                    FillRect(memDC, &item.rect, gdi.brush(item.color));
+                    break;
+                case FrameItem::Outline:
+                    FrameRect(memDC, &item.rect, gdi.brush(item.color));
+                    break;
+                case FrameItem::Text:
+                    SetTextColor(memDC, item.color);
+                    ExtTextOutA(memDC, item.rect.left, item.rect.top, 0, NULL, item.text.data(),
+                                static_cast<UINT>(item.text.length()),
+                                item.advances.empty() ? NULL : item.advances.data());
+                    break;
+            }
+        }
+    }
 
-    HBRUSH hBrush = CreateSolidBrush(theme.statusBar);
-    FillRect(hdc, &rect, hBrush);
-    DeleteObject(hBrush);
+    // Copy to screen
+    BitBlt(hdc, 0, 0, clientWidth, clientHeight, memDC, 0, 0, SRCCOPY);
 
-    SetBkMode(hdc, TRANSPARENT);
-    SetTextColor(hdc, theme.statusText);
+#ifndef NDEBUG
+    // Only a new theme, font or larger window should cost GDI objects
+    if (gdi.creations() != created) {
+        std::string note = "render: " + std::to_string(gdi.creations() - created) + " GDI objects created\n";
+        OutputDebugStringA(note.c_str());
+    }
+#endif
+}
 
-    std::string status = " File: " + (filename.empty() ? "Untitled" : filename) +
-                        " | Line: " + std::to_string(cursorY + 1) +
-                        "/" + std::to_string(buffer.size()) +
-                        " | Col: " + std::to_string(cursorX + 1) +
-                        " | " + (isModified ? "Modified" : "Saved");
+FrameRequest TextEditor::snapshot() const {
+    Settings& settings = Settings::getInstance();
+    FrameRequest request;
+    request.clientWidth = clientWidth;
+    request.clientHeight = clientHeight;
+    request.charWidth = charWidth;
+    request.charHeight = charHeight;
+    request.gutterWidth = settings.showLineNumbers ? lineNumberWidth : 0;
+    request.scrollX = scrollX;
+    request.scrollY = scrollY;
+    request.theme = settings.currentTheme;
+    request.glyphs = layout.glyphTable();
+    request.columns = layout.columnStops();
+
+    // Minimap rows stand for lines of the buffer, folded or not
+    request.minimapWidth = minimapWidth();
+    int pixels = minimapPixels();
+    if (pixels > 0) {
+        request.minimap = minimap.rows(pixels);
+        double perLine = static_cast<double>(pixels) / buffer.lineCount();
+        size_t firstRow, lastRow;
+        getVisibleRows(firstRow, lastRow);
+        size_t rows = folds.visibleCount(buffer.lineCount());
+        size_t lastLine = lastRow < rows ? folds.rowToLine(lastRow) : buffer.lineCount();
+        request.minimapViewTop = static_cast<int>(folds.rowToLine(firstRow) * perLine);
+        request.minimapViewBottom = std::max(static_cast<int>(lastLine * perLine), request.minimapViewTop + 1);
+        request.minimapCaret = static_cast<int>(cursors.primary().caret.line * perLine);
+    }
+
+    // The bracket pair at the primary caret gets outlined
+    TextPos open, close;
+    bool matched = brackets.matchingPair(cursors.primary().caret, open, close);
+
+    size_t first, last;
+    getVisibleRows(first, last);
+    request.rows.reserve(last - first);
+    for (size_t row = first; row < last; row++) {
+        size_t i = folds.rowToLine(row);
+        const TextLine& line = buffer.line(i);
+        request.rows.emplace_back();
+        RowSnapshot& snap = request.rows.back();
+        snap.line = i;
+        snap.row = row;
+        snap.length = line.length();
+        snap.chunked = line.chunked();
+        if (snap.chunked) {
+            // Laid out at a fixed advance, so the columns on screen are known here
+            int advance = request.glyphs.average;
+            snap.firstCol = std::min(static_cast<size_t>(scrollX / advance), line.length());
+            line.appendTo(snap.text, snap.firstCol, static_cast<size_t>(clientWidth / advance) + 2);
+        } else {
+            snap.text = line.scannable();
+        }
+        snap.folded = folds.isFolded(i);
+        snap.foldable = settings.showLineNumbers && !snap.folded && regions.isHeader(i);
+
+        size_t begin, end;
+        cursors.selectionsInLines(i, i + 1, begin, end);
+        for (size_t s = begin; s < end; s++) {
+            const Selection& selection = cursors.all()[s];
+            if (selection.caret.line == i) snap.carets.push_back(selection.caret.col);
+            if (selection.empty()) continue;
+            TextPos start = selection.start();
+            TextPos stop = selection.end();
+            snap.selections.push_back({ i == start.line ? start.col : 0,
+                                        i == stop.line ? stop.col : line.length(), i != stop.line });
+        }
+        if (matched && open.line == i) snap.brackets.push_back(open.col);
+        if (matched && close.line == i) snap.brackets.push_back(close.col);
+    }
 
-    TextOutA(hdc, rect.left, rect.top, status.c_str(), static_cast<int>(status.length()));
+    const TextPos& caret = cursors.primary().caret;
+    request.status = " File: " + (filename.empty() ? "Untitled" : filename) +
+                     " | Line: " + std::to_string(caret.line + 1) +
+                     "/" + std::to_string(buffer.lineCount()) +
+                     " | Col: " + std::to_string(caret.col + 1);
+    if (cursors.count() > 1) {
+        request.status += " | " + std::to_string(cursors.count()) + " cursors";
+    }
+    request.status += std::string(" | ") + (isModified ? "Modified" : "Saved");
+    return request;
 }
 
 POINT TextEditor::getCharPosition(size_t line, size_t col) const {
     Settings& settings = Settings::getInstance();
+    // Far off-screen positions in very long lines are clamped to fit a LONG
+    long long x = layout.x(line, col) - scrollX;
+    long long y = static_cast<long long>(folds.lineToRow(line)) * charHeight - scrollY;
     return {
-        static_cast<LONG>((col * charWidth) - scrollX),
-        static_cast<LONG>((line * charHeight) - scrollY)
+        static_cast<LONG>(std::max<long long>(std::min<long long>(x, LONG_MAX / 2), LONG_MIN / 2)),
+        static_cast<LONG>(std::max<long long>(std::min<long long>(y, LONG_MAX / 2), LONG_MIN / 2))
     };
 }
 
+void TextEditor::getVisibleRows(size_t& first, size_t& last) const {
+    int height = std::max(charHeight, 1);
+    size_t rows = folds.visibleCount(buffer.lineCount());
+    first = std::min(static_cast<size_t>(scrollY / height), rows);
+    last = std::min(static_cast<size_t>((scrollY + clientHeight) / height + 1), rows);
+}
+
+MemoryStats TextEditor::memoryStats() const {
+    MemoryStats stats;
+    stats.set(MemoryStats::Text, buffer.memoryUsage());
+    stats.set(MemoryStats::LineOffsets, index.memoryUsage());
+    stats.set(MemoryStats::Undo, history.memoryUsage());
+    stats.set(MemoryStats::Layout, layout.memoryUsage());
+    stats.set(MemoryStats::Brackets, brackets.memoryUsage());
+    stats.set(MemoryStats::Folds, folds.memoryUsage() + regions.memoryUsage());
+    stats.set(MemoryStats::Minimap, minimap.memoryUsage());
+    stats.set(MemoryStats::Columns, csv.memoryUsage());
+    stats.set(MemoryStats::Frames, frames.memoryUsage());
+    stats.set(MemoryStats::BackBuffer, gdi.backBufferBytes());
+    return stats;
+}
+
+int TextEditor::minimapWidth() const {
+    return Settings::getInstance().showMinimap ? MINIMAP_CHARS * charWidth : 0;
+}
+
+int TextEditor::minimapPixels() const {
+    // Short files get a few pixels a line rather than being stretched
+    if (minimapWidth() == 0) return 0;
+    long long pixels = std::min<long long>(clientHeight - charHeight,
+                                           static_cast<long long>(buffer.lineCount()) * MINIMAP_LINE_PIXELS);
+    return static_cast<int>(std::max(pixels, 0LL));
+}
+
 void TextEditor::updateScrollInfo() {
     Settings& settings = Settings::getInstance();
     
-    // Calculate maximum scroll values
-    size_t maxLineLength = 0;
-    for (const auto& line : buffer) {
-        maxLineLength = std::max(maxLineLength, line.length());
+    // Calculate maximum scroll values. While a file loads this runs for
+    // every block read, so only the lines read so far are looked at.
+    long long maxLineWidth = std::max(loadingWidth, csv.width());
+    if (!loader.loading()) {
+        for (size_t i = 0; i < buffer.lineCount(); i++) {
+            maxLineWidth = std::max(maxLineWidth, layout.width(i));
+        }
     }
 
     int xOffset = settings.showLineNumbers ? lineNumberWidth : 0;
-    maxScrollX = static_cast<int>(maxLineLength * charWidth - clientWidth + xOffset + 20);
-    maxScrollY = static_cast<int>(buffer.size() * charHeight - clientHeight + charHeight + 20);
+    int textWidth = clientWidth - minimapWidth();
+    maxScrollX = maxLineWidth - textWidth + xOffset + 20;
+    size_t rows = folds.visibleCount(buffer.lineCount());
+    maxScrollY = static_cast<long long>(rows) * charHeight - clientHeight + charHeight + 20;
 
-    maxScrollX = std::max(0, maxScrollX);
-    maxScrollY = std::max(0, maxScrollY);
+    maxScrollX = std::max(0LL, maxScrollX);
+    maxScrollY = std::max(0LL, maxScrollY);
+    scrollX = std::min(scrollX, maxScrollX);
+    scrollY = std::min(scrollY, maxScrollY);
+
+    setScrollBar(SB_HORZ, maxScrollX, textWidth, scrollX);
+    setScrollBar(SB_VERT, maxScrollY, clientHeight, scrollY);
+}
+
+void TextEditor::setScrollBar(int bar, long long max, int page, long long pos) {
+    // Scroll bars only take an int, so scale down ranges a huge line overflows
+    int shift = 0;
+    while ((max >> shift) > INT_MAX) shift++;
 
-    // Update scroll bars
     SCROLLINFO si = { sizeof(SCROLLINFO) };
     si.fMask = SIF_RANGE | SIF_PAGE | SIF_POS;
     si.nMin = 0;
-
-    si.nMax = maxScrollX;
-    si.nPage = clientWidth;
-    si.nPos = scrollX;
-    SetScrollInfo(hwnd, SB_HORZ, &si, TRUE);
-
-    si.nMax = maxScrollY;
-    si.nPage = clientHeight;
-    si.nPos = scrollY;
-    SetScrollInfo(hwnd, SB_VERT, &si, TRUE);
+    si.nMax = static_cast<int>(max >> shift);
+    si.nPage = std::max(page >> shift, 1);
+    si.nPos = static_cast<int>(pos >> shift);
+    SetScrollInfo(hwnd, bar, &si, TRUE);
 }
 
 void TextEditor::ensureCursorVisible() {
     Settings& settings = Settings::getInstance();
-    POINT cursorPos = getCharPosition(cursorY, cursorX);
+    const TextPos& caret = cursors.primary().caret;
+    POINT cursorPos = getCharPosition(caret.line, caret.col);
     int xOffset = settings.showLineNumbers ? lineNumberWidth : 0;
+    int textWidth = clientWidth - minimapWidth();
     
     // Horizontal scrolling
     if (cursorPos.x < xOffset) {
         scrollX += (cursorPos.x - xOffset);
-    } else if (cursorPos.x >= clientWidth - charWidth) {
-        scrollX += (cursorPos.x - clientWidth + charWidth);
+    } else if (cursorPos.x >= textWidth - charWidth) {
+        scrollX += (cursorPos.x - textWidth + charWidth);
     }
 
     // Vertical scrolling
@@ -327,15 +1132,18 @@ void TextEditor::ensureCursorVisible() {
         scrollY += (cursorPos.y - clientHeight + charHeight * 2);
     }
 
-    scrollX = std::max(0, std::min(scrollX, maxScrollX));
-    scrollY = std::max(0, std::min(scrollY, maxScrollY));
+    scrollX = std::max(0LL, std::min(scrollX, maxScrollX));
+    scrollY = std::max(0LL, std::min(scrollY, maxScrollY));
 
     updateScrollInfo();
 }
 
-void TextEditor::applySettings() {
-    createFont();
-    updateScrollInfo();
+void TextEditor::applySettings(unsigned changed) {
+    // A new theme only needs a repaint; fonts, tabs and the gutter change layout
+    if (changed & (Settings::FONT_CHANGED | Settings::EDITOR_CHANGED)) {
+        createFont();
+        updateScrollInfo();
+    }
     InvalidateRect(hwnd, NULL, TRUE);
 }
 
@@ -3,58 +3,179 @@
 #include <string>
 #include <windows.h>
 #include <memory>
+#include <functional>
+#include <filesystem>
 #include "Settings.hpp"
+#include "TextBuffer.hpp"
+#include "CursorSet.hpp"
+#include "UndoHistory.hpp"
+#include "FoldMap.hpp"
+#include "BracketIndex.hpp"
+#include "LayoutCache.hpp"
+#include "CsvLayout.hpp"
+#include "MinimapSummary.hpp"
+#include "MemoryStats.hpp"
+#include "GdiCache.hpp"
+#include "FrameBuilder.hpp"
+#include "FileLoader.hpp"
+#include "TransformRunner.hpp"
+#include "Session.hpp"
 
 class TextEditor {
 public:
+    // Set on the editor's window while aligned columns are being refined
+    static constexpr UINT_PTR COLUMN_TIMER = 2;
+
     TextEditor(HWND hwnd);
     ~TextEditor();
 
-    void loadFile(const std::string& fname);
+    // `view`, if given, is put back once the file has been read
+    void loadFile(const std::string& fname, const ViewState* view = nullptr);
+    // Waits briefly for the first lines of a file being opened, so the
+    // first paint already shows them
+    void awaitFirstLines();
+    void takeLoadedLines();
+    const std::string& fileName() const { return filename; }
+    bool loading() const { return loader.loading(); }
+    // A copy of every line, for work that outlives the current text
+    std::vector<std::string> documentLines() const;
+    ViewState viewState() const;
     void saveFile();
+    void checkExternalChanges();
     void handleChar(WPARAM wParam);
     void handleKeyDown(WPARAM wParam);
+    bool handleSysKeyDown(WPARAM wParam);
+    void handleMouseDown(int x, int y, bool shift);
     void render(HDC hdc);
     void resize(int width, int height);
     bool queryClose();
-    void applySettings();
+    void applySettings(unsigned changed);
+    void cut();
+    void copy();
+    void paste();
+    // Puts text on the clipboard as CF_TEXT. `fill` writes exactly `length`
+    // bytes straight into the clipboard's block.
+    static void copyToClipboard(HWND owner, size_t length, const std::function<void(char*)>& fill);
+    static void copyToClipboard(HWND owner, const std::string& text);
+    void selectAll();
+    void undo();
+    void redo();
+    void foldAtCaret();
+    void unfoldAtCaret();
+    void foldAll();
+    void unfoldAll();
+    void jumpToBracket();
+    // Sorts, dedupes or filters every line in the background; filters look
+    // for the selected text and a sort by field uses the caret's column
+    void transformLines(LineTransform::Kind kind);
+    void takeTransformedLines();
+    // Percent done, or -1 when no transform is running
+    int transformProgress() const { return transforms.running() ? transforms.percent() : -1; }
+    // Lines delimited text up in columns; the delimiter comes from the
+    // file name or else the first line
+    void alignColumns(bool align);
+    bool aligningColumns() const { return csv.enabled(); }
+    void refineColumns();
+    // Bytes held by each part of the document; walks every line, so only
+    // for when someone asks
+    MemoryStats memoryStats() const;
 
 private:
-    void createBuffers();
-    void destroyBuffers();
     void updateScrollInfo();
+    void setScrollBar(int bar, long long max, int page, long long pos);
     void ensureCursorVisible();
-    void insertChar(char ch);
-    void drawText(HDC hdc);
-    void drawLineNumbers(HDC hdc);
-    void drawStatusBar(HDC hdc);
+    void insertText(const char* text, size_t length);
+    void replaceSelections(const std::string& text);
+    void commitEdit(const CursorSet& before, std::vector<TextEdit>&& undoEdits);
+    TextPos movePosition(TextPos pos, WPARAM key) const;
+    void addCaretVertically(int direction);
+    void selectAllOccurrences();
+    bool hasSelection() const;
+    void getVisibleRows(size_t& first, size_t& last) const;
+    FrameRequest snapshot() const;
     POINT getCharPosition(size_t line, size_t col) const;
     void createFont();
+    void reloadFromDisk();
+    void applyHunks(const std::vector<std::string_view>& lines, const std::vector<DiffHunk>& hunks);
+    bool readOnly() const { return loader.loading() || transforms.running(); }
+    void rememberDiskState();
+    void saveLineIndex();
+    void restoreView();
+    void startColumns(char delimiter);
+    void jumpToField(int direction);
+    int minimapWidth() const;
+    int minimapPixels() const;
 
     HWND hwnd;
-    std::vector<std::string> buffer;
-    size_t cursorX = 0;
-    size_t cursorY = 0;
+    TextBuffer buffer;
+    CursorSet cursors;
+    UndoHistory history;
+    FoldMap folds;
+    // Where folds could go, kept up to date by edits
+    FoldRegions regions;
+    BracketIndex brackets;
+    // Filled in lazily by const lookups such as getCharPosition
+    mutable LayoutCache layout;
+    // Kept up to date by edits, so the minimap never reads the whole buffer
+    MinimapSummary minimap;
+    static constexpr int MINIMAP_CHARS = 12;
+    static constexpr int MINIMAP_LINE_PIXELS = 2;
+
+    // Corners of the column selection while Shift+Alt+arrows grow it
+    bool blockSelecting = false;
+    TextPos blockAnchor;
+    TextPos blockCaret;
     std::string filename;
     bool isModified = false;
 
-    // Triple buffering
-    HDC memDC = nullptr;
-    HBITMAP memBitmap = nullptr;
-    HBITMAP oldBitmap = nullptr;
-    
-    // Font and metrics
+    // Reads files in the background; the document is read-only meanwhile
+    static constexpr int FIRST_LINES_WAIT_MS = 200;
+    FileLoader loader;
+    // The widest line read so far, standing in for a full scan while loading
+    long long loadingWidth = 0;
+    // The view to put back once loading is done, and the caret it starts
+    // at meanwhile, to tell whether the user has moved since
+    ViewState pendingView;
+    TextPos loadCaret;
+    // Whole-document line commands, which also keep the document read-only
+    TransformRunner transforms;
+    // Column stops while delimited text is aligned, refined in slices of
+    // idle time since the buffer belongs to this thread
+    CsvLayout csv;
+    static constexpr int COLUMN_SLICE_MS = 8;
+    static constexpr UINT COLUMN_TIMER_MS = 30;
+    static constexpr int COLUMN_APPLY_MS = 500;
+    std::chrono::steady_clock::time_point columnsApplied;
+    // Line count, longest line and checkpoints of the file on disk, kept
+    // beside it for the next time it is opened
+    LineIndex index;
+    bool indexValid = false;
+
+    // File state as last loaded or saved, for spotting external changes
+    std::filesystem::file_time_type diskTime;
+    uintmax_t diskSize = 0;
+
+    // Brushes, fonts and the back buffer, kept across frames
+    GdiCache gdi;
+
+    // The last state sent for layout and the newest frame laid out from it
+    FrameBuilder frames;
+    FrameRequest lastRequest;
+    std::unique_ptr<Frame> currentFrame;
+
+    // Font and metrics; the font belongs to gdi
     HFONT hFont = nullptr;
+    int layoutTabSize = 0;
     int charWidth = 0;
     int charHeight = 0;
     int clientWidth = 0;
     int clientHeight = 0;
 
     // Scroll info
-    int scrollX = 0;
-    int scrollY = 0;
-    int maxScrollX = 0;
-    int maxScrollY = 0;
+    long long scrollX = 0;
+    long long scrollY = 0;
+    long long maxScrollX = 0;
+    long long maxScrollY = 0;
 
     // Line numbers
     int lineNumberWidth = 0;
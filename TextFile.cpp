@@ -0,0 +1,81 @@
+#include "TextFile.hpp"
+#include <cstring>
+#include <iterator>
+
+bool TextFile::streamLines(FileReader& reader, const std::function<bool(std::vector<std::string>&&)>& sink,
+                           LineIndex* index) {
+    // `data` holds the unfinished last line in front of each new block;
+    // only the new part needs searching for line breaks. `consumed` is
+    // where in the file it starts.
+    std::string data;
+    bool anyLines = false;
+    size_t searched = 0;
+    uint64_t consumed = 0;
+    bool offsets = reader.compression() == Compression::None;
+    while (reader.read(data)) {
+        std::vector<std::string> lines;
+        const char* start = data.data();
+        const char* end = start + data.size();
+        const char* pos = start;
+        const char* search = start + searched;
+        while (const char* next = static_cast<const char*>(memchr(search, '\n', end - search))) {
+            const char* lineEnd = next;
+#ifdef _WIN32
+            if (lineEnd > pos && lineEnd[-1] == '\r') lineEnd--;
+#endif
+            lines.emplace_back(pos, lineEnd);
+            if (index) index->addLine(lineEnd - pos, offsets ? consumed + (pos - start) : UINT64_MAX);
+            pos = search = next + 1;
+        }
+        consumed += pos - start;
+        data.erase(0, pos - start);
+        searched = data.size();
+        if (lines.empty()) continue;
+        anyLines = true;
+        if (!sink(std::move(lines))) return false;
+    }
+    if (reader.failed()) return false;
+
+    // A final line break does not start another line, but an empty file
+    // still has one
+    if (data.empty() && anyLines) return true;
+    if (index) index->addLine(data.size(), offsets ? consumed : UINT64_MAX);
+    std::vector<std::string> last;
+    last.push_back(std::move(data));
+    return sink(std::move(last));
+}
+
+bool TextFile::readLines(const std::string& path, std::vector<std::string>& lines, LineIndex* index) {
+    std::unique_ptr<FileReader> reader = FileReader::open(path);
+    if (!reader) return false;
+    return streamLines(*reader, [&](std::vector<std::string>&& more) {
+        if (lines.empty()) {
+            lines = std::move(more);
+        } else {
+            lines.insert(lines.end(), std::make_move_iterator(more.begin()), std::make_move_iterator(more.end()));
+        }
+        return true;
+    }, index);
+}
+
+bool TextFile::writeLines(const std::string& path, const TextBuffer& buffer, LineIndex* index) {
+    Compression compression = FileWriter::compressionFor(path);
+    FileWriter file(path, compression);
+    if (!file.isOpen()) return false;
+#ifdef _WIN32
+    static const char newline[] = "\r\n";
+#else
+    static const char newline[] = "\n";
+#endif
+    uint64_t written = 0;
+    for (size_t i = 0; i < buffer.lineCount(); i++) {
+        size_t length = buffer.line(i).length();
+        if (index) index->addLine(length, compression == Compression::None ? written : UINT64_MAX);
+        written += length + sizeof(newline) - 1;
+        buffer.line(i).forEachPiece(0, std::string::npos, [&](const char* data, size_t length) {
+            file.write(data, length);
+        });
+        file.write(newline, sizeof(newline) - 1);
+    }
+    return file.finish();
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <functional>
+#include <vector>
+#include <string>
+#include "TextBuffer.hpp"
+#include "CompressedFile.hpp"
+#include "LineIndex.hpp"
+
+// Reading and writing documents as lines; shared by the editor and the
+// batch tool so both see files the same way. gzip and zstd files are read
+// and written transparently.
+class TextFile {
+public:
+    // Splits what `reader` yields into lines and hands them to `sink` a
+    // block at a time as they are read. As with a text-mode stream on
+    // Windows, a CR before each line break is dropped there. False if the
+    // data was damaged or `sink` asked to stop by returning false.
+    // `index`, if given, counts the lines as they go by.
+    static bool streamLines(FileReader& reader, const std::function<bool(std::vector<std::string>&&)>& sink,
+                            LineIndex* index = nullptr);
+    static bool readLines(const std::string& path, std::vector<std::string>& lines, LineIndex* index = nullptr);
+    static bool writeLines(const std::string& path, const TextBuffer& buffer, LineIndex* index = nullptr);
+};
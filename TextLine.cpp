@@ -0,0 +1,197 @@
+#include "TextLine.hpp"
+#include "MemoryStats.hpp"
+#include <cstring>
+
+TextLine::TextLine(std::string line) {
+    if (line.length() > LONG_LINE) {
+        splitIntoChunks(std::move(line));
+    } else {
+        text = std::move(line);
+    }
+}
+
+TextLine::TextLine(const TextLine& other)
+    : text(other.text), chunks(other.chunks ? std::make_unique<Chunks>(*other.chunks) : nullptr) {
+}
+
+TextLine& TextLine::operator=(const TextLine& other) {
+    if (this != &other) {
+        text = other.text;
+        chunks = other.chunks ? std::make_unique<Chunks>(*other.chunks) : nullptr;
+    }
+    return *this;
+}
+
+char TextLine::at(size_t col) const {
+    if (!chunks) return text[col];
+    size_t piece, offset;
+    locate(col, piece, offset);
+    return chunks->pieces[piece][offset];
+}
+
+std::string TextLine::substr(size_t col, size_t count) const {
+    std::string result;
+    appendTo(result, col, count);
+    return result;
+}
+
+void TextLine::appendTo(std::string& out, size_t col, size_t count) const {
+    forEachPiece(col, count, [&](const char* data, size_t length) { out.append(data, length); });
+}
+
+char* TextLine::copyTo(char* out, size_t col, size_t count) const {
+    forEachPiece(col, count, [&](const char* data, size_t length) {
+        memcpy(out, data, length);
+        out += length;
+    });
+    return out;
+}
+
+size_t TextLine::find(const std::string& needle, size_t from) const {
+    if (!chunks) return text.find(needle, from);
+    if (needle.empty() || from >= chunks->total) return needle.empty() ? std::min(from, chunks->total) : std::string::npos;
+
+    // Inside each piece first, then across its boundary with what follows
+    size_t piece, offset;
+    locate(from, piece, offset);
+    size_t pieceStart = from - offset;
+    for (; piece < chunks->pieces.size(); piece++, offset = 0) {
+        const std::string& part = chunks->pieces[piece];
+        size_t found = part.find(needle, offset);
+        if (found != std::string::npos) return pieceStart + found;
+
+        size_t tail = std::max(offset, part.length() >= needle.length() ? part.length() - needle.length() + 1 : 0);
+        if (tail < part.length()) {
+            std::string boundary = substr(pieceStart + tail, part.length() - tail + needle.length() - 1);
+            found = boundary.find(needle);
+            if (found != std::string::npos) return pieceStart + tail + found;
+        }
+        pieceStart += part.length();
+    }
+    return std::string::npos;
+}
+
+void TextLine::replace(size_t col, size_t count, const char* data, size_t dataLength) {
+    col = std::min(col, length());
+    count = std::min(count, length() - col);
+    if (!chunks) {
+        text.replace(col, count, data, dataLength);
+        if (text.length() > LONG_LINE) splitIntoChunks(std::move(text));
+        return;
+    }
+
+    size_t first, firstOffset, last, lastOffset;
+    locate(col, first, firstOffset);
+    locate(col + count, last, lastOffset);
+    auto& pieces = chunks->pieces;
+    chunks->total = chunks->total - count + dataLength;
+    if (first == last) {
+        // Typing and small deletes stay inside one piece
+        size_t oldLength = pieces[first].length();
+        pieces[first].replace(firstOffset, count, data, dataLength);
+        grow(first, oldLength);
+    } else {
+        // Join what is left of the end pieces around the new text
+        std::string& head = pieces[first];
+        head.erase(firstOffset);
+        head.append(data, dataLength);
+        head.append(pieces[last], lastOffset, std::string::npos);
+        pieces.erase(pieces.begin() + first + 1, pieces.begin() + last + 1);
+        rebuildTree();
+        reshape(first);
+    }
+
+    // Short enough again to be a plain string
+    if (chunks->total < CHUNK_SIZE) {
+        std::string whole = str();
+        chunks.reset();
+        text = std::move(whole);
+    }
+}
+
+size_t TextLine::memoryUsage() const {
+    size_t bytes = MemoryStats::heapBytes(text);
+    if (chunks) {
+        bytes += sizeof(Chunks) + MemoryStats::heapBytes(chunks->pieces) + MemoryStats::heapBytes(chunks->tree);
+        for (const auto& piece : chunks->pieces) bytes += MemoryStats::heapBytes(piece);
+    }
+    return bytes;
+}
+
+void TextLine::locate(size_t col, size_t& piece, size_t& offset) const {
+    const auto& tree = chunks->tree;
+    size_t count = chunks->pieces.size();
+    size_t step = 1;
+    while (step * 2 <= count) step *= 2;
+
+    size_t pos = 0;
+    for (; step > 0; step /= 2) {
+        if (pos + step <= count && tree[pos + step] <= col) {
+            pos += step;
+            col -= tree[pos];
+        }
+    }
+    if (pos == count) {
+        piece = count - 1;
+        offset = chunks->pieces[piece].length();
+    } else {
+        piece = pos;
+        offset = col;
+    }
+}
+
+void TextLine::grow(size_t piece, size_t oldLength) {
+    size_t length = chunks->pieces[piece].length();
+    if (length == 0 || length > 2 * CHUNK_SIZE) {
+        rebuildTree();
+        reshape(piece);
+        return;
+    }
+    // Unsigned wrap-around makes a shrink add correctly as well
+    size_t delta = length - oldLength;
+    for (size_t i = piece + 1; i < chunks->tree.size(); i += i & (0 - i)) {
+        chunks->tree[i] += delta;
+    }
+}
+
+void TextLine::reshape(size_t piece) {
+    auto& pieces = chunks->pieces;
+    std::string& part = pieces[piece];
+    if (part.empty() && pieces.size() > 1) {
+        pieces.erase(pieces.begin() + piece);
+    } else if (part.length() > 2 * CHUNK_SIZE) {
+        std::vector<std::string> split;
+        for (size_t pos = 0; pos < part.length(); pos += CHUNK_SIZE) {
+            split.emplace_back(part, pos, CHUNK_SIZE);
+        }
+        pieces.erase(pieces.begin() + piece);
+        pieces.insert(pieces.begin() + piece, std::make_move_iterator(split.begin()),
+                      std::make_move_iterator(split.end()));
+    } else {
+        return;
+    }
+    rebuildTree();
+}
+
+void TextLine::rebuildTree() {
+    const auto& pieces = chunks->pieces;
+    auto& tree = chunks->tree;
+    tree.assign(pieces.size() + 1, 0);
+    for (size_t i = 1; i <= pieces.size(); i++) {
+        tree[i] += pieces[i - 1].length();
+        size_t parent = i + (i & (0 - i));
+        if (parent <= pieces.size()) tree[parent] += tree[i];
+    }
+}
+
+void TextLine::splitIntoChunks(std::string&& whole) {
+    chunks = std::make_unique<Chunks>();
+    chunks->total = whole.length();
+    for (size_t pos = 0; pos < whole.length(); pos += CHUNK_SIZE) {
+        chunks->pieces.emplace_back(whole, pos, CHUNK_SIZE);
+    }
+    if (chunks->pieces.empty()) chunks->pieces.emplace_back();
+    rebuildTree();
+    std::string().swap(text);
+    whole.clear();
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstddef>
+
+// One line of the buffer. Ordinary lines are a plain string. Lines longer
+// than LONG_LINE bytes (minified files, one-line logs) are split into
+// chunks with a Fenwick tree over their lengths, so an edit only moves
+// the chunk it lands in and finding a column is O(log n).
+class TextLine {
+public:
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+    static constexpr size_t LONG_LINE = 4 * CHUNK_SIZE;
+
+    TextLine() = default;
+    TextLine(std::string line);
+    TextLine(const TextLine& other);
+    TextLine& operator=(const TextLine& other);
+    TextLine(TextLine&& other) noexcept = default;
+    TextLine& operator=(TextLine&& other) noexcept = default;
+
+    size_t length() const { return chunks ? chunks->total : text.length(); }
+    bool chunked() const { return chunks != nullptr; }
+
+    // The text for scanners that run over whole lines on every edit
+    // (brackets, folding). Chunked lines are too long for that and come
+    // back empty, the way editors stop tokenizing very long lines.
+    const std::string& scannable() const { return text; }
+
+    char at(size_t col) const;
+    std::string substr(size_t col, size_t count) const;
+    void appendTo(std::string& out, size_t col, size_t count) const;
+    char* copyTo(char* out, size_t col, size_t count) const;
+    size_t find(const std::string& needle, size_t from = 0) const;
+    std::string str() const { return substr(0, std::string::npos); }
+
+    void replace(size_t col, size_t count, const char* data, size_t dataLength);
+
+    // Heap bytes behind the line, not counting the TextLine itself
+    size_t memoryUsage() const;
+
+    // Calls visit(data, length) for each contiguous piece of [col, col + count)
+    template <typename Visit>
+    void forEachPiece(size_t col, size_t count, Visit visit) const {
+        col = std::min(col, length());
+        count = std::min(count, length() - col);
+        if (!chunks) {
+            if (count > 0) visit(text.data() + col, count);
+            return;
+        }
+        size_t piece, offset;
+        locate(col, piece, offset);
+        for (; count > 0 && piece < chunks->pieces.size(); piece++, offset = 0) {
+            const std::string& part = chunks->pieces[piece];
+            size_t take = std::min(count, part.length() - offset);
+            if (take > 0) visit(part.data() + offset, take);
+            count -= take;
+        }
+    }
+
+private:
+    struct Chunks {
+        std::vector<std::string> pieces; // Never empty, and no empty piece unless it is the only one
+        std::vector<size_t> tree;        // Fenwick tree of piece lengths, 1-based
+        size_t total = 0;
+    };
+
+    // The piece holding `col`; the end of the line is the end of the last piece
+    void locate(size_t col, size_t& piece, size_t& offset) const;
+    void grow(size_t piece, size_t oldLength);
+    void reshape(size_t piece);
+    void rebuildTree();
+    void splitIntoChunks(std::string&& whole);
+
+    std::string text;
+    std::unique_ptr<Chunks> chunks;
+};
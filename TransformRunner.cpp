@@ -0,0 +1,47 @@
+#include "TransformRunner.hpp"
+#include <algorithm>
+
+TransformRunner::TransformRunner(HWND hwnd) : hwnd(hwnd) {
+}
+
+TransformRunner::~TransformRunner() {
+    cancel();
+}
+
+void TransformRunner::start(const LineTransform::Spec& spec, const TextBuffer& buffer) {
+    cancel();
+    lines = buffer.flatLines(scratch);
+    progress = std::make_unique<TransformProgress>();
+    HWND target = hwnd;
+    progress->report = [target](int percent) { PostMessage(target, WM_TRANSFORM_PROGRESS, percent, 0); };
+    busy = true;
+    worker = std::thread([this, spec] {
+        unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+        if (!LineTransform::run(spec, lines, threads, result, progress.get())) return;
+        complete = true;
+        PostMessage(hwnd, WM_TRANSFORM_PROGRESS, 100, 0);
+    });
+}
+
+void TransformRunner::cancel() {
+    if (progress) progress->cancelled = true;
+    if (worker.joinable()) worker.join();
+    bool wasBusy = busy;
+    busy = false;
+    complete = false;
+    progress.reset();
+    result = LineTransform::Result();
+    lines.clear();
+    scratch.clear();
+    // So the window stops showing progress
+    if (wasBusy) PostMessage(hwnd, WM_TRANSFORM_PROGRESS, 0, 0);
+}
+
+LineTransform::Result TransformRunner::take() {
+    if (!complete) return LineTransform::Result();
+    worker.join();
+    busy = false;
+    complete = false;
+    lines.clear();
+    return std::move(result);
+}
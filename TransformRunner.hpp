@@ -0,0 +1,48 @@
+#pragma once
+#include <windows.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "LineTransform.hpp"
+#include "TextBuffer.hpp"
+
+// Posted to the editor window with the percent done in wParam as a line
+// transform gets further, and once more when it finishes or is cancelled
+constexpr UINT WM_TRANSFORM_PROGRESS = WM_APP + 3;
+
+// Runs a LineTransform over the whole buffer on a background thread. The
+// buffer must not change until the result has been taken, so the editor
+// stays read-only meanwhile.
+class TransformRunner {
+public:
+    explicit TransformRunner(HWND hwnd);
+    ~TransformRunner();
+    TransformRunner(const TransformRunner&) = delete;
+    TransformRunner& operator=(const TransformRunner&) = delete;
+
+    void start(const LineTransform::Spec& spec, const TextBuffer& buffer);
+    void cancel();
+    // Until the result has been taken
+    bool running() const { return busy; }
+    bool finished() const { return complete; }
+    int percent() const { return progress ? progress->percent.load() : 0; }
+    // Once finished. Its lines stay good until the buffer changes or the
+    // next start.
+    LineTransform::Result take();
+
+private:
+    HWND hwnd;
+    std::thread worker;
+    bool busy = false;
+    std::atomic<bool> complete{ false };
+    std::unique_ptr<TransformProgress> progress;
+
+    // The buffer's lines as the worker sees them; long lines are copied
+    // into `scratch`
+    std::vector<std::string> scratch;
+    std::vector<std::string_view> lines;
+    LineTransform::Result result;
+};
@@ -0,0 +1,60 @@
+#include "UndoHistory.hpp"
+#include "MemoryStats.hpp"
+
+void UndoHistory::record(std::vector<TextEdit>&& undoEdits, const CursorSet& before) {
+    if (undoEdits.empty()) return;
+    MemoryStats::Scope scope(MemoryStats::Undo);
+
+    UndoStep step;
+    step.edits = std::move(undoEdits);
+    step.selections = before.all();
+    step.primary = before.primaryPosition();
+    undoSteps.push_back(std::move(step));
+    if (undoSteps.size() > MAX_STEPS) {
+        undoSteps.erase(undoSteps.begin());
+    }
+    redoSteps.clear();
+}
+
+size_t UndoHistory::memoryUsage() const {
+    size_t bytes = MemoryStats::heapBytes(undoSteps) + MemoryStats::heapBytes(redoSteps);
+    for (const auto* steps : { &undoSteps, &redoSteps }) {
+        for (const UndoStep& step : *steps) {
+            bytes += MemoryStats::heapBytes(step.edits) + MemoryStats::heapBytes(step.selections);
+            for (const TextEdit& edit : step.edits) bytes += MemoryStats::heapBytes(edit.text);
+        }
+    }
+    return bytes;
+}
+
+bool UndoHistory::undo(TextBuffer& buffer, CursorSet& cursors) {
+    return replay(undoSteps, redoSteps, buffer, cursors);
+}
+
+bool UndoHistory::redo(TextBuffer& buffer, CursorSet& cursors) {
+    return replay(redoSteps, undoSteps, buffer, cursors);
+}
+
+void UndoHistory::clear() {
+    undoSteps.clear();
+    redoSteps.clear();
+}
+
+bool UndoHistory::replay(std::vector<UndoStep>& from, std::vector<UndoStep>& to,
+                         TextBuffer& buffer, CursorSet& cursors) {
+    if (from.empty()) return false;
+
+    UndoStep step = std::move(from.back());
+    from.pop_back();
+
+    // Applying a step yields the edits that reverse it, which become the
+    // step on the other stack
+    UndoStep reverse;
+    reverse.selections = cursors.all();
+    reverse.primary = cursors.primaryPosition();
+    buffer.apply(step.edits, &reverse.edits);
+    to.push_back(std::move(reverse));
+
+    cursors.set(std::move(step.selections), step.primary);
+    return true;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <vector>
+#include "TextBuffer.hpp"
+#include "CursorSet.hpp"
+
+// One undoable change: the edits that restore the previous text and the
+// selections to restore with it
+struct UndoStep {
+    std::vector<TextEdit> edits;
+    std::vector<Selection> selections;
+    size_t primary = 0;
+};
+
+class UndoHistory {
+public:
+    // Records a batch applied to the buffer; `before` is the cursor state
+    // from just before it. Clears anything that could have been redone.
+    void record(std::vector<TextEdit>&& undoEdits, const CursorSet& before);
+
+    bool undo(TextBuffer& buffer, CursorSet& cursors);
+    bool redo(TextBuffer& buffer, CursorSet& cursors);
+    void clear();
+
+    bool canUndo() const { return !undoSteps.empty(); }
+    bool canRedo() const { return !redoSteps.empty(); }
+    size_t memoryUsage() const;
+
+private:
+    static bool replay(std::vector<UndoStep>& from, std::vector<UndoStep>& to,
+                       TextBuffer& buffer, CursorSet& cursors);
+
+    static constexpr size_t MAX_STEPS = 1000;
+
+    std::vector<UndoStep> undoSteps;
+    std::vector<UndoStep> redoSteps;
+};
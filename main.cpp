@@ -1,5 +1,6 @@
 #include "EditorWindow.hpp"
 #include <windows.h>
+#include <string>
 
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow) {
     EditorWindow* window = EditorWindow::Create(hInstance, nCmdShow);
@@ -7,6 +8,18 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         return 0;
     }
 
+    // Open a file passed on the command line,
+    std::string path = lpCmdLine;
+    if (path.size() >= 2 && path.front() == '"' && path.back() == '"') {
+        path = path.substr(1, path.size() - 2);
+    }
+    // or else whatever was open last time
+    if (!path.empty()) {
+        window->OpenFile(path);
+    } else {
+        window->RestoreSession();
+    }
+
     // Main message loop
     while (window->ProcessMessages()) {
         // Additional processing can be done here
@@ -20,3 +20,16 @@
 #define IDM_EDIT_COPY                    40009
 #define IDM_EDIT_PASTE                   40010
 #define IDM_VIEW_SETTINGS                40011
+#define IDM_VIEW_FOLD_ALL                40012
+#define IDM_VIEW_UNFOLD_ALL              40013
+#define IDM_EDIT_SORT_LINES              40014
+#define IDM_EDIT_REMOVE_DUPLICATES       40015
+#define IDM_EDIT_KEEP_MATCHING           40016
+#define IDM_EDIT_DROP_MATCHING           40017
+#define IDM_VIEW_COMPARE_SAVED           40018
+#define IDM_VIEW_COMPARE_FILE            40019
+#define IDM_VIEW_ALIGN_COLUMNS           40020
+#define IDM_EDIT_SORT_BY_COLUMN          40021
+#define IDM_FILE_OPEN_HEX                40022
+#define IDM_VIEW_MINIMAP                 40023
+#define IDM_VIEW_MEMORY_USAGE            40024
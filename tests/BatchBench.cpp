@@ -0,0 +1,81 @@
+#include "Check.hpp"
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/wait.h>
+
+// hoodrd-batch against `sed -i` doing the same replacement over the same
+// generated file set, the job it is meant to beat. The tool's path is the
+// test's argument.
+
+static constexpr int FILES = 200;
+static constexpr size_t LINES_PER_FILE = 20000;
+
+static std::string readFile(const std::filesystem::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+static bool run(const std::string& command) {
+    int status = std::system(command.c_str());
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) return 2;
+    if (!run("sed --version > /dev/null 2>&1")) {
+        std::printf("sed not found, nothing to compare with\n");
+        return 0;
+    }
+    auto dir = std::filesystem::temp_directory_path() / ("hoodrd-batchbench-" + std::to_string(std::random_device()()));
+    std::filesystem::create_directories(dir / "batch");
+    std::filesystem::create_directories(dir / "sed");
+
+    std::mt19937 rng(37);
+    std::string files;
+    size_t bytes = 0;
+    for (int i = 0; i < FILES; i++) {
+        std::string text;
+        for (size_t line = 0; line < LINES_PER_FILE; line++) {
+            text += "    value_" + std::to_string(rng() % 1000) + " = compute(" + std::to_string(rng()) + ");";
+            if (rng() % 8 == 0) text += " // oldName";
+            text += '\n';
+        }
+        std::string name = "file" + std::to_string(i) + ".cpp";
+        std::ofstream(dir / "batch" / name, std::ios::binary) << text;
+        std::ofstream(dir / "sed" / name, std::ios::binary) << text;
+        files += " " + name;
+        bytes += text.size();
+    }
+    std::ofstream(dir / "script.txt") << "replace /oldName/newName/\n";
+    std::printf("%d files, %.1f MB\n", FILES, bytes / 1048576.0);
+
+    std::string quiet = " > /dev/null";
+    bool batchOk = false, sedOk = false;
+    double batch = millis([&] {
+        batchOk = run("cd \"" + (dir / "batch").string() + "\" && \"" + argv[1] + "\" ../script.txt" + files + quiet);
+    });
+    double sed = millis([&] {
+        sedOk = run("cd \"" + (dir / "sed").string() + "\" && sed -i 's/oldName/newName/g'" + files);
+    });
+    CHECK(batchOk && sedOk);
+    for (int i = 0; i < FILES; i++) {
+        std::string name = "file" + std::to_string(i) + ".cpp";
+        CHECK(readFile(dir / "batch" / name) == readFile(dir / "sed" / name));
+    }
+
+    std::printf("%-48s %10.2f ms\n", "sed -i", sed);
+    // Files go to a core each, so with more than one core it should win
+    // outright; on one it has only to keep up
+    double allowed = std::thread::hardware_concurrency() > 1 ? sed : sed * 1.5;
+    checkBudget("hoodrd-batch", batch, allowed);
+
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+    return checkFailures();
+}
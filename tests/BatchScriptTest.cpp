@@ -0,0 +1,187 @@
+#include "BatchScript.hpp"
+#include "Check.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+#include <sys/wait.h>
+
+// The script language on its own, then hoodrd-batch over several files,
+// whose path the test is given as its argument.
+
+static bool parses(const std::string& text, std::string* error = nullptr) {
+    BatchScript script;
+    std::string message;
+    bool ok = script.parse(text, message);
+    if (error) *error = message;
+    return ok;
+}
+
+static std::vector<std::string> lines(const TextBuffer& buffer) {
+    std::vector<std::string> out;
+    for (size_t i = 0; i < buffer.lineCount(); i++) out.push_back(buffer.line(i).str());
+    return out;
+}
+
+// Runs `text` over `before` and returns the lines after
+static std::vector<std::string> runOn(const std::string& text, std::vector<std::string> before,
+                                      BatchResult* result = nullptr, unsigned threads = 1) {
+    BatchScript script;
+    std::string error;
+    CHECK(script.parse(text, error));
+    TextBuffer buffer;
+    buffer.assign(std::move(before));
+    BatchResult got = script.run(buffer, threads);
+    if (result) *result = got;
+    return lines(buffer);
+}
+
+static void testParse() {
+    CHECK(parses(""));
+    CHECK(parses("# only a comment\n\n   \t\n"));
+    CHECK(parses("replace /a/b/\r\nfind |x|\nkeep ,y,\ndrop /z/\ninsert 1 text\ninsert $\ndelete 2\ndelete 2 9\n"
+                 "delete 3 $\nsort\nunique\n"));
+
+    std::string error;
+    CHECK(!parses("find /a/\nfrobnicate\n", &error));
+    CHECK(error.find("line 2") != std::string::npos && error.find("frobnicate") != std::string::npos);
+    CHECK(!parses("replace /a/b"));      // Unterminated
+    CHECK(!parses("replace /a/"));       // No replacement
+    CHECK(!parses("replace /a/b/ junk")); // Trailing words
+    CHECK(!parses("find //"));           // Empty pattern
+    CHECK(!parses("find /a\\nb/"));      // Spans lines
+    CHECK(!parses("find"));
+    CHECK(!parses("insert"));
+    CHECK(!parses("insert 0 text"));
+    CHECK(!parses("insert x text"));
+    CHECK(!parses("delete"));
+    CHECK(!parses("delete 0"));
+    CHECK(!parses("delete 5 3"));
+    CHECK(!parses("delete 1 2 3"));
+    CHECK(!parses("sort everything"));
+    CHECK(!parses("unique please"));
+}
+
+static void testReplace() {
+    BatchResult result;
+    // Matches do not overlap and a replacement is not searched again
+    CHECK(runOn("replace /aa/a/", { "aaaaa", "xaax", "none" }, &result) ==
+          std::vector<std::string>({ "aaa", "xax", "none" }));
+    CHECK(result.replaced == 3 && result.changed);
+
+    CHECK(runOn("replace /a/aa/", { "aba" }) == std::vector<std::string>({ "aabaa" }));
+    // Escapes: delimiter, backslash, tab, and a newline splitting the line
+    CHECK(runOn("replace /x\\/y/1\\\\2/", { "x/y" }) == std::vector<std::string>({ "1\\2" }));
+    CHECK(runOn("replace |;|;\\n|", { "a;b;" }) == std::vector<std::string>({ "a;", "b;", "" }));
+    CHECK(runOn("replace /,/\\t/", { "a,b" }) == std::vector<std::string>({ "a\tb" }));
+    // Commands run in order, each on what the last one left
+    CHECK(runOn("replace /a/b/\nreplace /b/c/", { "ab" }) == std::vector<std::string>({ "cc" }));
+
+    CHECK(runOn("replace /q/r/", { "abc" }, &result) == std::vector<std::string>({ "abc" }));
+    CHECK(result.replaced == 0 && !result.changed);
+    CHECK(runOn("find /ab/\nfind /b/", { "abab", "b" }, &result) == std::vector<std::string>({ "abab", "b" }));
+    CHECK(result.found == 5 && !result.changed);
+}
+
+static void testLines() {
+    std::vector<std::string> five = { "1", "2", "3", "4", "5" };
+    CHECK(runOn("insert 1 top", five) == std::vector<std::string>({ "top", "1", "2", "3", "4", "5" }));
+    CHECK(runOn("insert 3 mid", five) == std::vector<std::string>({ "1", "2", "mid", "3", "4", "5" }));
+    CHECK(runOn("insert $ end", five) == std::vector<std::string>({ "1", "2", "3", "4", "5", "end" }));
+    CHECK(runOn("insert 99 end", five) == std::vector<std::string>({ "1", "2", "3", "4", "5", "end" }));
+    CHECK(runOn("delete 2", five) == std::vector<std::string>({ "1", "3", "4", "5" }));
+    CHECK(runOn("delete 2 4", five) == std::vector<std::string>({ "1", "5" }));
+    CHECK(runOn("delete 4 $", five) == std::vector<std::string>({ "1", "2", "3" }));
+    CHECK(runOn("delete $", five) == std::vector<std::string>({ "1", "2", "3", "4" }));
+    CHECK(runOn("delete 1 $", five) == std::vector<std::string>({ "" }));
+    CHECK(runOn("delete 3 99", five) == std::vector<std::string>({ "1", "2" }));
+    BatchResult result;
+    CHECK(runOn("delete 6", five, &result) == five);
+    CHECK(!result.changed);
+
+    std::vector<std::string> mixed = { "b", "a", "b", "c x", "a" };
+    for (unsigned threads : { 1u, 4u }) {
+        CHECK(runOn("sort", mixed, nullptr, threads) == std::vector<std::string>({ "a", "a", "b", "b", "c x" }));
+        CHECK(runOn("unique", mixed, nullptr, threads) == std::vector<std::string>({ "b", "a", "c x" }));
+        CHECK(runOn("keep /x/", mixed, nullptr, threads) == std::vector<std::string>({ "c x" }));
+        CHECK(runOn("drop /b/", mixed, nullptr, threads) == std::vector<std::string>({ "a", "c x", "a" }));
+    }
+    CHECK(runOn("sort", { "a", "b" }, &result) == std::vector<std::string>({ "a", "b" }));
+    CHECK(!result.changed);
+}
+
+static std::string readFile(const std::filesystem::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+static void writeFile(const std::filesystem::path& path, const std::string& text) {
+    std::ofstream(path, std::ios::binary) << text;
+}
+
+// Runs hoodrd-batch and returns its exit code, with what it printed in `output`
+static int runBatch(const std::string& tool, const std::string& arguments, const std::filesystem::path& dir,
+                    std::string& output) {
+    std::filesystem::path out = dir / "output.txt";
+    std::string command = "\"" + tool + "\" " + arguments + " > \"" + out.string() + "\"";
+    int status = std::system(command.c_str());
+    output = readFile(out);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+static void testFiles(const std::string& tool) {
+    auto dir = std::filesystem::temp_directory_path() / ("hoodrd-batch-" + std::to_string(std::random_device()()));
+    std::filesystem::create_directories(dir);
+    writeFile(dir / "script.txt", "# rename\nreplace /old/new/\nfind /keep/\n");
+    std::vector<std::filesystem::path> files;
+    for (int i = 0; i < 12; i++) {
+        files.push_back(dir / ("file" + std::to_string(i) + ".txt"));
+        writeFile(files.back(), i % 3 == 0 ? "keep this\nnothing here\n" : "old\nkeep old and old\n");
+    }
+    auto untouched = std::filesystem::last_write_time(files[0]);
+
+    std::string arguments = "-j 4 \"" + (dir / "script.txt").string() + "\"";
+    for (const auto& file : files) arguments += " \"" + file.string() + "\"";
+    std::string output;
+    CHECK(runBatch(tool, arguments, dir, output) == 0);
+    for (size_t i = 0; i < files.size(); i++) {
+        bool matched = i % 3 != 0;
+        CHECK(readFile(files[i]) == (matched ? "new\nkeep new and new\n" : "keep this\nnothing here\n"));
+        std::string report = files[i].string() + (matched ? ": 3 replaced, 1 found" : ": 0 replaced, 1 found");
+        CHECK(output.find(report) != std::string::npos);
+    }
+    // Files the script did not change are not written
+    CHECK(std::filesystem::last_write_time(files[0]) == untouched);
+    CHECK(output.find("12 files, 0 failed") != std::string::npos);
+
+    // A dry run saves nothing; a missing file fails on its own
+    writeFile(files[1], "old\n");
+    std::string missing = (dir / "missing.txt").string();
+    CHECK(runBatch(tool, "-n \"" + (dir / "script.txt").string() + "\" \"" + files[1].string() + "\" \"" + missing + "\"",
+                   dir, output) == 1);
+    CHECK(readFile(files[1]) == "old\n");
+    CHECK(output.find(files[1].string() + ": 1 replaced") != std::string::npos);
+    CHECK(output.find(missing + ": cannot read or write") != std::string::npos);
+    CHECK(output.find("2 files, 1 failed") != std::string::npos);
+
+    // A bad script stops before any file is touched
+    writeFile(dir / "bad.txt", "replace /old/\n");
+    CHECK(runBatch(tool, "\"" + (dir / "bad.txt").string() + "\" \"" + files[1].string() + "\" 2>/dev/null", dir,
+                   output) == 2);
+    CHECK(readFile(files[1]) == "old\n");
+
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+}
+
+int main(int argc, char** argv) {
+    testParse();
+    testReplace();
+    testLines();
+    if (argc > 1) testFiles(argv[1]);
+    return checkFailures();
+}
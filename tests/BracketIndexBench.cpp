@@ -0,0 +1,44 @@
+#include "BracketIndex.hpp"
+#include "Check.hpp"
+#include "TextBuffer.hpp"
+#include <random>
+#include <string>
+#include <vector>
+
+// Bracket matching in a 1M-line JSON-like file: building the index,
+// matching at random carets, editing, and finding the pair around a caret
+
+int main() {
+    std::mt19937 rng(5);
+    std::vector<std::string> lines;
+    for (size_t i = 0; i < 1000000; i++)
+        lines.push_back(i % 1000 == 0 ? "{" : i % 1000 == 999 ? "}" : "  \"key\": [1, 2, {\"a\": 3}],");
+    TextBuffer buffer;
+    buffer.assign(std::move(lines));
+
+    checkBudget("index 1M lines", millis([&] { BracketIndex index(buffer); }), 500);
+    BracketIndex index(buffer);
+    buffer.addListener(&index);
+
+    size_t matched = 0;
+    double ms = millis([&] {
+        TextPos open, close;
+        for (int i = 0; i < 100000; i++) matched += index.matchingPair({ (rng() % 1000) * 1000, 0 }, open, close);
+    });
+    CHECK(matched == 100000);
+    checkBudget("100K matches across 1000 lines", ms, 2000);
+
+    ms = millis([&] {
+        for (int i = 0; i < 1000; i++) buffer.insert({ rng() % 1000000, 0 }, "(");
+    });
+    checkBudget("1000 edits", ms, 500);
+
+    size_t enclosed = 0;
+    ms = millis([&] {
+        TextPos open, close;
+        for (int i = 0; i < 10000; i++) enclosed += index.enclosingPair({ rng() % buffer.lineCount(), 3 }, open, close);
+    });
+    CHECK(enclosed > 0);
+    checkBudget("10K enclosing pairs", ms, 1500);
+    return checkFailures();
+}
@@ -0,0 +1,162 @@
+#include "BracketIndex.hpp"
+#include "Check.hpp"
+#include "TextBuffer.hpp"
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+// Matches found by walking the whole text a character at a time, to check
+// the chunked index against
+
+static const std::string OPENS = "([{";
+static const std::string CLOSES = ")]}";
+
+struct Char {
+    TextPos pos;
+    char c;
+};
+
+static std::vector<Char> flatten(const TextBuffer& buffer) {
+    std::vector<Char> all;
+    for (size_t line = 0; line < buffer.lineCount(); line++) {
+        const std::string& text = buffer.line(line).scannable();
+        for (size_t col = 0; col < text.size(); col++) all.push_back({ { line, col }, text[col] });
+    }
+    return all;
+}
+
+// Index of the first character at or after `pos`
+static size_t indexOf(const std::vector<Char>& all, TextPos pos) {
+    return std::lower_bound(all.begin(), all.end(), pos, [](const Char& c, TextPos p) { return c.pos < p; }) -
+           all.begin();
+}
+
+static bool closeAfter(const std::vector<Char>& all, size_t from, int kind, TextPos& close) {
+    int need = 1;
+    for (size_t i = from; i < all.size(); i++) {
+        if (all[i].c == OPENS[kind]) {
+            need++;
+        } else if (all[i].c == CLOSES[kind] && --need == 0) {
+            close = all[i].pos;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool openBefore(const std::vector<Char>& all, size_t before, int kind, TextPos& open) {
+    int need = 1;
+    for (size_t i = before; i-- > 0;) {
+        if (all[i].c == CLOSES[kind]) {
+            need++;
+        } else if (all[i].c == OPENS[kind] && --need == 0) {
+            open = all[i].pos;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool referenceMatching(const std::vector<Char>& all, TextPos pos, TextPos& open, TextPos& close) {
+    // The character after the caret first, then the one before it
+    size_t at = indexOf(all, pos);
+    size_t candidates[] = { at, at - 1 };
+    for (int k = 0; k < 2; k++) {
+        size_t i = candidates[k];
+        if (k == 1 && (at == 0 || all[i].pos.line != pos.line || all[i].pos.col + 1 != pos.col)) continue;
+        if (k == 0 && (i >= all.size() || !(all[i].pos == pos))) continue;
+        size_t kind = OPENS.find(all[i].c);
+        if (kind != std::string::npos) {
+            if (closeAfter(all, i + 1, static_cast<int>(kind), close)) {
+                open = all[i].pos;
+                return true;
+            }
+            continue;
+        }
+        kind = CLOSES.find(all[i].c);
+        if (kind != std::string::npos && openBefore(all, i, static_cast<int>(kind), open)) {
+            close = all[i].pos;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool referenceEnclosing(const std::vector<Char>& all, TextPos pos, TextPos& open, TextPos& close) {
+    size_t at = indexOf(all, pos);
+    bool found = false;
+    for (int kind = 0; kind < 3; kind++) {
+        TextPos kindOpen, kindClose;
+        if (openBefore(all, at, kind, kindOpen) && (!found || open < kindOpen) &&
+            closeAfter(all, at, kind, kindClose)) {
+            open = kindOpen;
+            close = kindClose;
+            found = true;
+        }
+    }
+    return found;
+}
+
+static std::mt19937 rng(5);
+
+static std::string randomText(size_t length, int newlineEvery) {
+    static const char alphabet[] = "()[]{}ab";
+    std::string text;
+    for (size_t i = 0; i < length; i++)
+        text += rng() % newlineEvery == 0 ? '\n' : alphabet[rng() % (sizeof(alphabet) - 1)];
+    return text;
+}
+
+static void compare(const TextBuffer& buffer, const BracketIndex& index) {
+    std::vector<Char> all = flatten(buffer);
+    for (int query = 0; query < 40; query++) {
+        size_t line = rng() % buffer.lineCount();
+        TextPos pos = buffer.clamp({ line, rng() % (buffer.line(line).length() + 2) });
+        TextPos open, close, expectedOpen, expectedClose;
+        bool found = index.matchingPair(pos, open, close);
+        bool expected = referenceMatching(all, pos, expectedOpen, expectedClose);
+        CHECK(found == expected);
+        if (found && expected) CHECK(open == expectedOpen && close == expectedClose);
+
+        found = index.enclosingPair(pos, open, close);
+        expected = referenceEnclosing(all, pos, expectedOpen, expectedClose);
+        CHECK(found == expected);
+        if (found && expected) CHECK(open == expectedOpen && close == expectedClose);
+    }
+}
+
+// Random edit batches on documents of a few chunks: short edits within
+// lines, line breaks, and long inserts and deletes that cross chunk
+// boundaries and reshape the chunks around them
+int main() {
+    for (int document = 0; document < 300 && !checkFailures(); document++) {
+        TextBuffer buffer;
+        std::vector<std::string> lines;
+        for (size_t i = rng() % 400 + 1; i > 0; i--) lines.push_back(randomText(rng() % 6, 1000));
+        buffer.assign(std::move(lines));
+        BracketIndex index(buffer);
+        buffer.addListener(&index);
+        compare(buffer, index);
+
+        for (int round = 0; round < 40 && !checkFailures(); round++) {
+            std::vector<TextPos> ends;
+            size_t count = 2 * (rng() % 3 + 1);
+            for (size_t i = 0; i < count; i++) {
+                size_t line = rng() % buffer.lineCount();
+                ends.push_back(buffer.clamp({ line, rng() % 6 }));
+            }
+            std::sort(ends.begin(), ends.end());
+            std::vector<TextEdit> edits;
+            for (size_t i = 0; i < count; i += 2) {
+                if (!edits.empty() && !(edits.back().to < ends[i])) continue;
+                size_t length = rng() % 3 == 0 ? 40 + rng() % 400 : rng() % 4;
+                edits.push_back({ ends[i], ends[i + 1], randomText(length, rng() % 2 ? 7 : 50) });
+            }
+            buffer.apply(edits);
+            compare(buffer, index);
+        }
+        buffer.removeListener(&index);
+    }
+    return checkFailures();
+}
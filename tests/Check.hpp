@@ -0,0 +1,37 @@
+#pragma once
+#include <chrono>
+#include <cstdio>
+
+// Just enough for the headless tests: a failed CHECK prints where and
+// carries on, and main returns checkFailures() so ctest sees the result
+
+inline int& checkFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(condition)                                                                   \
+    do {                                                                                   \
+        if (!(condition)) {                                                                \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            checkFailures()++;                                                             \
+        }                                                                                  \
+    } while (0)
+
+// Wall time of f() in milliseconds
+template <typename F>
+double millis(F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Benchmarks print their timings and fail only well over budget, so a
+// slow machine still passes but a quadratic slip does not
+inline void checkBudget(const char* what, double ms, double budgetMs) {
+    std::printf("%-48s %10.2f ms  (budget %.0f)\n", what, ms, budgetMs);
+    if (ms > budgetMs) {
+        std::fprintf(stderr, "%s: %.2f ms is over its %.0f ms budget\n", what, ms, budgetMs);
+        checkFailures()++;
+    }
+}
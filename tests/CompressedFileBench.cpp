@@ -0,0 +1,86 @@
+#include "Check.hpp"
+#include "CompressedFile.hpp"
+#include "TextFile.hpp"
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+// Opening .gz and .zst files streams their lines as they are
+// decompressed. Compared here with decompressing to a plain file first and
+// opening that, along with what saving compressed costs.
+
+static constexpr size_t LINES = 400000;
+
+// Milliseconds until the first block of lines arrives, and until all have
+static bool stream(const std::string& path, size_t& lines, double& firstMs, double& allMs) {
+    lines = 0;
+    firstMs = -1;
+    bool ok = false;
+    allMs = millis([&] {
+        auto start = std::chrono::steady_clock::now();
+        auto reader = FileReader::open(path);
+        if (!reader) return;
+        ok = TextFile::streamLines(*reader, [&](std::vector<std::string>&& more) {
+            if (firstMs < 0)
+                firstMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            lines += more.size();
+            return true;
+        });
+    });
+    return ok;
+}
+
+static bool decompressTo(const std::string& from, const std::string& to) {
+    auto reader = FileReader::open(from);
+    if (!reader) return false;
+    FileWriter writer(to, Compression::None);
+    std::string block;
+    while (reader->read(block)) {
+        writer.write(block.data(), block.size());
+        block.clear();
+    }
+    return !reader->failed() && writer.finish();
+}
+
+int main() {
+    auto dir = std::filesystem::temp_directory_path() / ("hoodrd-compressed-" + std::to_string(std::random_device()()));
+    std::filesystem::create_directories(dir);
+
+    std::mt19937 rng(3);
+    std::vector<std::string> lines;
+    for (size_t i = 0; i < LINES; i++) {
+        lines.push_back("2024-05-01T12:" + std::to_string(i % 60) + " INFO worker-" + std::to_string(rng() % 16) +
+                        " request " + std::to_string(rng()) + " took " + std::to_string(rng() % 1000) + " ms");
+    }
+    TextBuffer buffer;
+    buffer.assign(std::vector<std::string>(lines));
+
+    for (const char* extension : { ".gz", ".zst" }) {
+        std::string path = (dir / (std::string("log.txt") + extension)).string();
+        std::string name = std::string("log") + extension;
+
+        bool saved = false;
+        double ms = millis([&] { saved = TextFile::writeLines(path, buffer); });
+        CHECK(saved);
+        checkBudget(("save " + name).c_str(), ms, 5000);
+
+        size_t count;
+        double firstMs, allMs;
+        CHECK(stream(path, count, firstMs, allMs));
+        CHECK(count == LINES);
+        checkBudget(("open " + name + ": first lines").c_str(), firstMs, 100);
+        checkBudget(("open " + name + ": all lines").c_str(), allMs, 2000);
+
+        // What opening cost before: decompress to disk, then read the plain file
+        std::string plain = (dir / "log.txt").string();
+        std::vector<std::string> read;
+        ms = millis([&] { CHECK(decompressTo(path, plain) && TextFile::readLines(plain, read)); });
+        CHECK(read == lines);
+        std::printf("%-48s %10.2f ms\n", ("decompress " + name + ", then open").c_str(), ms);
+    }
+
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+    return checkFailures();
+}
@@ -0,0 +1,166 @@
+#include "Check.hpp"
+#include "CsvLayout.hpp"
+#include "FixedMetrics.hpp"
+#include "LayoutCache.hpp"
+#include "TextBuffer.hpp"
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Every glyph 8 pixels and tabs every 4 spaces, so a comma column is its
+// widest field plus 24 (the comma and two spaces) and a tab column its
+// widest field plus 48 (a tab stop and two spaces)
+static const int GLYPH = 8;
+static const int COMMA_GAP = 3 * GLYPH;
+static const int TAB_GAP = 6 * GLYPH;
+
+static void testHelpers() {
+    CHECK(CsvLayout::delimiterFor("data.csv") == ',');
+    CHECK(CsvLayout::delimiterFor("DATA.CSV") == ',');
+    CHECK(CsvLayout::delimiterFor("data.tsv") == '\t');
+    CHECK(CsvLayout::delimiterFor("data.tab") == '\t');
+    CHECK(CsvLayout::delimiterFor("data.txt") == 0);
+    CHECK(CsvLayout::delimiterFor("csv") == 0);
+
+    CHECK(CsvLayout::detectDelimiter("a;b;c,d") == ';');
+    CHECK(CsvLayout::detectDelimiter("a|b|c\td") == '|');
+    CHECK(CsvLayout::detectDelimiter("plain text") == 0);
+
+    CHECK((CsvLayout::fieldStarts("a,\"b,c\",d", ',') == std::vector<size_t>{ 0, 2, 8 }));
+    CHECK((CsvLayout::fieldStarts("\"a,\"\"b\",c", ',') == std::vector<size_t>{ 0, 8 }));
+    CHECK((CsvLayout::fieldStarts(",,", ',') == std::vector<size_t>{ 0, 1, 2 }));
+    CHECK((CsvLayout::fieldStarts("a,b", ';') == std::vector<size_t>{ 0 }));
+}
+
+// A delimiter inside quotes belongs to the field, both when measuring
+// widths and when the layout stretches delimiters out to the stops
+static void testQuotedDelimiters() {
+    TextBuffer buffer;
+    buffer.assign({ "id,name,note", "1,\"Smith, J\",x" });
+    LayoutCache layout(buffer);
+    buffer.addListener(&layout);
+    layout.reset(FixedMetrics(GLYPH), 4);
+
+    CsvLayout csv;
+    csv.enable(',', buffer, layout.glyphTable());
+    CHECK(csv.enabled());
+    CHECK(csv.delimiter() == ',');
+    std::vector<int32_t> starts = { 0, 2 * GLYPH + COMMA_GAP, 2 * GLYPH + 10 * GLYPH + 2 * COMMA_GAP };
+    CHECK(csv.stops().starts == starts);
+    CHECK(csv.width() == starts[2] + 4 * GLYPH);
+
+    layout.setColumns(csv.stops());
+    CHECK(layout.x(0, 3) == starts[1]);
+    CHECK(layout.x(1, 2) == starts[1]);
+    // The quoted comma is text, so only the one after the quotes moves on
+    CHECK(layout.x(1, 9) == starts[1] + 7 * GLYPH);
+    CHECK(layout.x(1, 13) == starts[2]);
+
+    // An unbalanced quote runs to the end of the line as one field
+    CHECK(csv.include(TextLine("\"a,b,c,d,e,f,g"), layout.glyphTable()));
+    CHECK((csv.stops().starts == std::vector<int32_t>{ 0, 14 * GLYPH + COMMA_GAP, 24 * GLYPH + 2 * COMMA_GAP }));
+}
+
+static void testTabs() {
+    TextBuffer buffer;
+    buffer.assign({ "ab\tc", "a\tlonger" });
+    LayoutCache layout(buffer);
+    buffer.addListener(&layout);
+    layout.reset(FixedMetrics(GLYPH), 4);
+
+    CsvLayout csv;
+    csv.enable('\t', buffer, layout.glyphTable());
+    CHECK((csv.stops().starts == std::vector<int32_t>{ 0, 2 * GLYPH + TAB_GAP }));
+    CHECK(csv.width() == 2 * GLYPH + TAB_GAP + 6 * GLYPH);
+
+    csv.disable();
+    CHECK(!csv.enabled());
+    CHECK(csv.stops().starts.empty());
+    CHECK(csv.width() == 0);
+}
+
+static void testColumnCap() {
+    TextBuffer buffer;
+    buffer.assign({ std::string(59, 'a') + ",b", "c,d" });
+    LayoutCache layout(buffer);
+    buffer.addListener(&layout);
+    layout.reset(FixedMetrics(GLYPH), 4);
+    const GlyphTable& glyphs = layout.glyphTable();
+
+    CsvLayout csv;
+    csv.enable(',', buffer, glyphs);
+    CHECK(csv.stops().starts[1] == 59 * GLYPH + COMMA_GAP);
+    CHECK(csv.include(TextLine(std::string(60, 'a') + ",b"), glyphs));
+    CHECK(csv.stops().starts[1] == 60 * GLYPH + COMMA_GAP);
+
+    // Longer fields overflow into the next column instead
+    CHECK(!csv.include(TextLine(std::string(61, 'a') + ",b"), glyphs));
+    CHECK(!csv.include(TextLine(std::string(1000, 'a') + ",b"), glyphs));
+    CHECK(csv.stops().starts[1] == 60 * GLYPH + COMMA_GAP);
+
+    // A chunked line is never measured
+    std::string huge(TextLine::LONG_LINE + 1, ',');
+    TextLine chunked(huge);
+    CHECK(chunked.chunked());
+    CHECK(!csv.include(chunked, glyphs));
+    CHECK(csv.stops().starts.size() == 2);
+}
+
+// Widths come from a sample at first, then grow as rows come on screen
+// and the scan reaches them, and never shrink
+static void testGrowth() {
+    const size_t LINES = 100000;
+    std::vector<std::string> lines(LINES, "a,b");
+    lines[50] = std::string(10, 'w') + ",b";
+    lines[70] = std::string(20, 'w') + ",b";
+    lines[LINES - 1] = "a,b,c";
+    TextBuffer buffer;
+    buffer.assign(std::move(lines));
+    LayoutCache layout(buffer);
+    buffer.addListener(&layout);
+    layout.reset(FixedMetrics(GLYPH), 4);
+    const GlyphTable& glyphs = layout.glyphTable();
+
+    // One line in every hundred is sampled, which misses lines 50 and 70
+    // and the last one with its third field
+    CsvLayout csv;
+    csv.enable(',', buffer, glyphs);
+    CHECK((csv.stops().starts == std::vector<int32_t>{ 0, GLYPH + COMMA_GAP }));
+    CHECK(csv.scanning());
+
+    // A visible row widens its column at once
+    CHECK(csv.include(buffer.line(50), glyphs));
+    CHECK(csv.stops().starts[1] == 10 * GLYPH + COMMA_GAP);
+    CHECK(!csv.include(buffer.line(0), glyphs));
+
+    // Out of time, a slice still gets one step done
+    csv.refine(buffer, glyphs, std::chrono::milliseconds(0));
+    CHECK(csv.scanning());
+    CHECK(csv.stops().starts[1] == 20 * GLYPH + COMMA_GAP);
+
+    csv.refine(buffer, glyphs, std::chrono::hours(1));
+    CHECK(!csv.scanning());
+    CHECK((csv.stops().starts == std::vector<int32_t>{ 0, 20 * GLYPH + COMMA_GAP, 21 * GLYPH + 2 * COMMA_GAP }));
+    CHECK(csv.width() == 21 * GLYPH + 2 * COMMA_GAP + GLYPH);
+
+    // Narrowing the widest field leaves the column where it is
+    ColumnStops before = csv.stops();
+    buffer.setLines(70, { "a,b" });
+    csv.rescan(buffer);
+    CHECK(csv.scanning());
+    csv.refine(buffer, glyphs, std::chrono::hours(1));
+    CHECK(csv.stops() == before);
+
+    // Enabling again starts over from the sample
+    csv.enable(',', buffer, glyphs);
+    CHECK((csv.stops().starts == std::vector<int32_t>{ 0, GLYPH + COMMA_GAP }));
+}
+
+int main() {
+    testHelpers();
+    testQuotedDelimiters();
+    testTabs();
+    testColumnCap();
+    testGrowth();
+    return checkFailures();
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include "LayoutCache.hpp"
+
+// Every byte `width` pixels wide, standing in for a GDI font
+class FixedMetrics : public GlyphMetrics {
+public:
+    explicit FixedMetrics(int width = 8) : width(width) {}
+
+    void advances(int* widths) const override {
+        for (int c = 0; c < 256; c++) widths[c] = width;
+    }
+
+private:
+    int width;
+};
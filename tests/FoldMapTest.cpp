@@ -0,0 +1,199 @@
+#include "Check.hpp"
+#include "FoldMap.hpp"
+#include <algorithm>
+#include <random>
+#include <vector>
+
+// The fold treap against a plain list of collapsed folds, through random
+// folds, unfolds and line changes, then timed with many folds to show
+// each operation stays logarithmic.
+
+static std::mt19937 rng(29);
+
+// Outermost folds in order, each with its inner ones relative to it, the
+// same shape collapsed() returns
+struct Model {
+    std::vector<FoldRange> folds;
+    size_t lines = 0;
+
+    // The fold hiding `line`, or folds.size()
+    size_t hiding(size_t line) const {
+        for (size_t i = 0; i < folds.size(); i++) {
+            if (folds[i].header < line && line <= folds[i].end) return i;
+        }
+        return folds.size();
+    }
+
+    bool fold(size_t header, size_t end) {
+        if (end <= header || hiding(header) < folds.size()) return false;
+        auto first = std::find_if(folds.begin(), folds.end(), [&](const FoldRange& f) { return f.header >= header; });
+        auto last = std::find_if(first, folds.end(), [&](const FoldRange& f) { return f.header > end; });
+        if (last != first && (last - 1)->end > end) return false;
+        if (last - first == 1 && first->header == header && first->end == end) return false;
+        FoldRange range{ header, end, {} };
+        for (auto it = first; it != last; ++it) {
+            FoldRange inner = *it;
+            inner.header -= header;
+            inner.end -= header;
+            range.inner.push_back(std::move(inner));
+        }
+        folds.insert(folds.erase(first, last), std::move(range));
+        return true;
+    }
+
+    bool unfold(size_t line) {
+        for (size_t i = 0; i < folds.size(); i++) {
+            if (folds[i].header <= line && line <= folds[i].end) {
+                FoldRange range = std::move(folds[i]);
+                folds.erase(folds.begin() + i);
+                for (FoldRange& inner : range.inner) {
+                    inner.header += range.header;
+                    inner.end += range.header;
+                }
+                folds.insert(folds.begin() + i, range.inner.begin(), range.inner.end());
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void change(const LineChange& change) {
+        lines = lines - change.removed + change.inserted;
+        if (change.removed == 0 && change.inserted == 0) {
+            while (hiding(change.first) < folds.size()) unfold(change.first);
+            return;
+        }
+        std::vector<FoldRange> kept;
+        for (FoldRange& f : folds) {
+            bool reached = (f.header < change.first && change.first <= f.end) ||
+                           (f.header >= change.first && f.header <= change.first + change.removed);
+            if (reached) continue;
+            if (f.header > change.first + change.removed) {
+                f.header = f.header - change.removed + change.inserted;
+                f.end = f.end - change.removed + change.inserted;
+            }
+            kept.push_back(std::move(f));
+        }
+        folds = std::move(kept);
+    }
+};
+
+static bool same(const std::vector<FoldRange>& a, const std::vector<FoldRange>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].header != b[i].header || a[i].end != b[i].end || !same(a[i].inner, b[i].inner)) return false;
+    }
+    return true;
+}
+
+static void compare(const FoldMap& map, const Model& model) {
+    CHECK(same(map.collapsed(), model.folds));
+    std::vector<size_t> visible;
+    size_t row = 0;
+    for (size_t line = 0; line < model.lines; line++) {
+        size_t by = model.hiding(line);
+        bool hidden = by < model.folds.size();
+        CHECK(map.isHidden(line) == hidden);
+        bool header = std::any_of(model.folds.begin(), model.folds.end(),
+                                  [&](const FoldRange& f) { return f.header == line; });
+        CHECK(map.isFolded(line) == header);
+        size_t foundHeader, foundEnd;
+        bool found = map.find(line, foundHeader, foundEnd);
+        CHECK(found == (hidden || header));
+        if (found && hidden) CHECK(foundHeader == model.folds[by].header && foundEnd == model.folds[by].end);
+        if (hidden) {
+            CHECK(map.lineToRow(line) == row - 1);
+        } else {
+            CHECK(map.lineToRow(line) == row);
+            visible.push_back(line);
+            row++;
+        }
+    }
+    CHECK(map.visibleCount(model.lines) == visible.size());
+    for (size_t r = 0; r < visible.size(); r++) CHECK(map.rowToLine(r) == visible[r]);
+}
+
+static void testAgainstModel() {
+    for (int round = 0; round < 20; round++) {
+        FoldMap map;
+        Model model;
+        model.lines = 50 + rng() % 400;
+        for (int step = 0; step < 300; step++) {
+            size_t line = rng() % model.lines;
+            switch (rng() % 6) {
+            case 0: case 1: case 2: {
+                // Short folds, so they nest and cross each other often
+                size_t end = std::min(model.lines - 1, line + rng() % (rng() % 4 == 0 ? 60 : 8));
+                CHECK(map.fold(line, end) == model.fold(line, end));
+                break;
+            }
+            case 3:
+                CHECK(map.unfold(line) == model.unfold(line));
+                break;
+            default: {
+                // A batch of changes, each numbered after the ones before
+                std::vector<LineChange> changes;
+                Model after = model;
+                for (size_t n = 1 + rng() % 3; n > 0; n--) {
+                    LineChange change;
+                    change.first = rng() % after.lines;
+                    if (rng() % 3) change.removed = std::min<size_t>(after.lines - 1 - change.first, rng() % 10);
+                    if (rng() % 3) change.inserted = rng() % 10;
+                    after.change(change);
+                    changes.push_back(change);
+                }
+                map.linesChanged(changes);
+                model = std::move(after);
+                break;
+            }
+            }
+            compare(map, model);
+        }
+        map.clear();
+        CHECK(map.collapsed().empty() && map.visibleCount(model.lines) == model.lines);
+    }
+}
+
+static void testCost() {
+    // 100K folds over 1M lines; anything linear per operation would take
+    // minutes here
+    const size_t LINES = 1000000;
+    FoldMap map;
+    double ms = millis([&] {
+        for (size_t header = 0; header + 8 < LINES; header += 10) map.fold(header, header + 8);
+    });
+    checkBudget("100K folds", ms, 300);
+    CHECK(map.visibleCount(LINES) == LINES / 10 * 2);
+
+    size_t sum = 0;
+    ms = millis([&] {
+        for (size_t i = 0; i < LINES; i++) sum += map.rowToLine(map.lineToRow((i * 7919) % LINES));
+    });
+    CHECK(sum > 0);
+    checkBudget("1M row and line lookups", ms, 2000);
+
+    // A line added and removed again in the gap after each fold in turn,
+    // moving every fold below it and back
+    ms = millis([&] {
+        for (size_t i = 0; i < 100000; i++) {
+            size_t gap = (i * 104729) % (LINES / 10) * 10 + 9;
+            map.linesChanged({ { gap, 0, 1 } });
+            map.linesChanged({ { gap, 1, 0 } });
+        }
+    });
+    checkBudget("200K line changes among 100K folds", ms, 1000);
+    CHECK(map.visibleCount(LINES) == LINES / 10 * 2);
+    CHECK(map.isFolded(LINES - 10) && map.isHidden(LINES - 2));
+
+    ms = millis([&] {
+        for (size_t line = 0; line < LINES; line += 10) map.unfold(line);
+    });
+    checkBudget("unfolding 100K folds", ms, 300);
+    CHECK(map.visibleCount(LINES) == LINES);
+}
+
+int main() {
+    testAgainstModel();
+    testCost();
+    return checkFailures();
+}
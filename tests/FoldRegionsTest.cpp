@@ -0,0 +1,209 @@
+#include "Check.hpp"
+#include "FoldMap.hpp"
+#include "TextBuffer.hpp"
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+// The regions as first written, scanning the text on every query, kept as
+// the reference the indexed version has to agree with
+
+static bool indentOf(const std::string& text, size_t tabSize, size_t& indent) {
+    indent = 0;
+    for (char c : text) {
+        if (c == ' ') {
+            indent++;
+        } else if (c == '\t') {
+            indent += tabSize - indent % tabSize;
+        } else {
+            return true;
+        }
+    }
+    return false;
+}
+
+static size_t openBraces(const std::string& text) {
+    size_t open = 0;
+    for (char c : text) {
+        if (c == '{') {
+            open++;
+        } else if (c == '}' && open > 0) {
+            open--;
+        }
+    }
+    return open;
+}
+
+static bool referenceFind(const TextBuffer& buffer, size_t line, size_t tabSize, size_t& end) {
+    const std::string& text = buffer.line(line).scannable();
+    size_t depth = openBraces(text);
+    for (size_t i = line + 1; depth > 0 && i < buffer.lineCount(); i++) {
+        for (char c : buffer.line(i).scannable()) {
+            if (c == '{') {
+                depth++;
+            } else if (c == '}' && --depth == 0) {
+                break;
+            }
+        }
+        if (depth == 0 && i - 1 > line) {
+            end = i - 1;
+            return true;
+        }
+    }
+
+    size_t indent, next;
+    if (!indentOf(text, tabSize, indent)) return false;
+    end = line;
+    for (size_t i = line + 1; i < buffer.lineCount(); i++) {
+        if (!indentOf(buffer.line(i).scannable(), tabSize, next)) continue;
+        if (next <= indent) break;
+        end = i;
+    }
+    return end > line;
+}
+
+static bool referenceEnclosing(const TextBuffer& buffer, size_t line, size_t from, size_t tabSize,
+                               size_t& header, size_t& end) {
+    for (size_t i = std::min(from, line) + 1; i-- > 0;) {
+        if (referenceFind(buffer, i, tabSize, end) && end >= line) {
+            header = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static std::mt19937 rng(11);
+
+static std::string randomLine() {
+    static const char* pieces[] = { "x", "{", "}", " ", "\t", "y = 1;", "} else {" };
+    std::string line(rng() % 3 == 0 ? 0 : 4 * (rng() % 4), ' ');
+    if (rng() % 8 == 0) line = "\t" + line;
+    for (size_t i = rng() % 3; i > 0; i--) line += pieces[rng() % 7];
+    return line;
+}
+
+static void compare(const TextBuffer& buffer, const FoldRegions& regions, size_t tabSize) {
+    for (size_t line = 0; line < buffer.lineCount(); line++) {
+        size_t end = 0, expectedEnd = 0;
+        bool found = regions.find(line, end);
+        bool expected = referenceFind(buffer, line, tabSize, expectedEnd);
+        CHECK(found == expected);
+        if (found && expected) CHECK(end == expectedEnd);
+        CHECK(regions.isHeader(line) == expected);
+
+        size_t from = rng() % 2 ? line : rng() % buffer.lineCount();
+        size_t header = 0, expectedHeader = 0;
+        found = regions.enclosing(line, from, header, end);
+        expected = referenceEnclosing(buffer, line, from, tabSize, expectedHeader, expectedEnd);
+        CHECK(found == expected);
+        if (found && expected) CHECK(header == expectedHeader && end == expectedEnd);
+        if (checkFailures()) return;
+    }
+}
+
+// Random edit batches, small enough to fit in a block and large enough to
+// split and join them, checked line by line against the reference
+static void testAgainstReference() {
+    for (int document = 0; document < 40 && !checkFailures(); document++) {
+        TextBuffer buffer;
+        std::vector<std::string> lines;
+        for (size_t i = rng() % 400 + 1; i > 0; i--) lines.push_back(randomLine());
+        buffer.assign(std::move(lines));
+        FoldRegions regions(buffer);
+        buffer.addListener(&regions);
+        size_t tabSize = 4;
+
+        for (int round = 0; round < 30 && !checkFailures(); round++) {
+            if (rng() % 10 == 0) {
+                tabSize = 1 + rng() % 8;
+                regions.setTabSize(tabSize);
+            }
+            std::vector<TextPos> ends;
+            for (size_t i = 2 * (1 + rng() % 6); i > 0; i--) {
+                size_t line = rng() % buffer.lineCount();
+                ends.push_back({ line, rng() % (buffer.line(line).length() + 1) });
+            }
+            std::sort(ends.begin(), ends.end());
+            std::vector<TextEdit> edits;
+            for (size_t i = 0; i < ends.size(); i += 2) {
+                if (!edits.empty() && !(edits.back().to < ends[i])) continue;
+                std::string text;
+                for (size_t n = rng() % 200 == 0 ? 300 : rng() % 4; n > 0; n--) text += randomLine() + "\n";
+                text += randomLine();
+                edits.push_back({ ends[i], ends[i + 1], text });
+            }
+            buffer.apply(edits);
+            compare(buffer, regions, tabSize);
+        }
+        buffer.removeListener(&regions);
+    }
+}
+
+// Times the listener it stands in for
+class TimedListener : public TextBufferListener {
+public:
+    explicit TimedListener(TextBufferListener& inner) : inner(inner) {}
+    void linesChanged(const std::vector<LineChange>& changes) override {
+        ms += millis([&] { inner.linesChanged(changes); });
+    }
+    double ms = 0;
+
+private:
+    TextBufferListener& inner;
+};
+
+// Fold All and fold-at-caret used to rescan the text for every line they
+// looked at, which took seconds on a few tens of thousands of lines
+static void testLookupCost() {
+    static const char* unit[] = { "void f() {", "    x();", "    if (y) {", "        z();", "    }", "}", "",
+                                  "def g():", "    a", "        b", "    c", "" };
+    std::vector<std::string> lines;
+    for (size_t i = 0; i < 200000; i++) {
+        if (i < 100000) {
+            lines.push_back(unit[i % 12]);
+        } else {
+            // Deep nesting, and braces opened that never close
+            size_t depth = i % 200 < 100 ? i % 200 : 200 - i % 200;
+            lines.push_back(std::string(depth, ' ') + (i % 7 == 0 ? "if (x) {" : "call();"));
+        }
+    }
+    TextBuffer buffer;
+    buffer.assign(std::move(lines));
+    FoldRegions regions(buffer);
+    TimedListener timed(regions);
+    buffer.addListener(&timed);
+
+    size_t folded = 0;
+    double ms = millis([&] {
+        for (size_t i = 0; i < buffer.lineCount(); i++) {
+            size_t end;
+            if (regions.find(i, end)) {
+                folded++;
+                i = end;
+            }
+        }
+    });
+    CHECK(folded >= 100000 / 12 * 2);
+    checkBudget("Fold All over 200K lines", ms, 500);
+
+    size_t found = 0;
+    ms = millis([&] {
+        for (size_t i = 0; i < buffer.lineCount(); i += 20) {
+            size_t header, end;
+            found += regions.enclosing(i, i, header, end);
+        }
+    });
+    CHECK(found > 0);
+    checkBudget("10K folds at the caret", ms, 500);
+
+    for (int i = 0; i < 1000; i++) buffer.insert({ 100000, 0 }, i % 2 ? "{" : "}\n");
+    checkBudget("keeping up with 1000 edits", timed.ms, 100);
+}
+
+int main() {
+    testAgainstReference();
+    testLookupCost();
+    return checkFailures();
+}
@@ -0,0 +1,87 @@
+#include "Check.hpp"
+#include "FontCatalog.hpp"
+#include <chrono>
+#include <thread>
+
+// Odd-numbered runs list fonts forever and only end when the catalog
+// stops them; even-numbered ones list 300 faces, each once per character
+// set, as GDI does
+class FakeFontSource : public FontSource {
+public:
+    void enumerate(const std::function<bool(const std::wstring&)>& found) override {
+        int run = ++runs;
+        if (run % 2 == 1) {
+            for (size_t i = 0;; i++) {
+                if (!found(L"Endless " + std::to_wstring(i))) return;
+            }
+        }
+        for (int charset = 0; charset < 3; charset++) {
+            for (int i = 0; i < 300; i++) {
+                if (!found(L"Face " + std::to_wstring(i))) return;
+            }
+        }
+    }
+
+    std::atomic<int> runs{ 0 };
+};
+
+// Reads until the catalog says it is complete
+static FontCatalog::Update readAll(FontCatalog& catalog, FontCatalog::Cursor& cursor) {
+    FontCatalog::Update all;
+    for (;;) {
+        FontCatalog::Update update = catalog.fetch(cursor);
+        if (update.restarted) {
+            all.restarted = true;
+            all.added.clear();
+        }
+        all.added.insert(all.added.end(), update.added.begin(), update.added.end());
+        if (update.complete) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    all.complete = true;
+    return all;
+}
+
+int main() {
+    auto owned = std::make_unique<FakeFontSource>();
+    FakeFontSource& source = *owned;
+    FontCatalog catalog(std::move(owned));
+
+    // Nothing is enumerated until asked for
+    FontCatalog::Cursor cursor;
+    FontCatalog::Update update = catalog.fetch(cursor);
+    CHECK(!update.restarted && !update.complete && update.added.empty());
+    CHECK(source.runs == 0);
+
+    // A refresh abandons the endless run, and readers start over
+    catalog.refresh();
+    bool restarted = false;
+    do {
+        update = catalog.fetch(cursor);
+        restarted |= update.restarted;
+    } while (update.added.empty());
+    CHECK(restarted);
+    CHECK(update.added.front() == L"Endless 0");
+    CHECK(!update.complete);
+
+    catalog.refresh();
+    update = readAll(catalog, cursor);
+    CHECK(source.runs == 2);
+    CHECK(update.restarted);
+    // Each face once, in the order first seen
+    CHECK(update.added.size() == 300);
+    for (size_t i = 0; i < update.added.size() && i < 300; i++) CHECK(update.added[i] == L"Face " + std::to_wstring(i));
+
+    // Caught up: nothing new, and no restart
+    update = catalog.fetch(cursor);
+    CHECK(!update.restarted && update.complete && update.added.empty());
+
+    // A second reader starting late gets everything in one go
+    FontCatalog::Cursor late;
+    update = catalog.fetch(late);
+    CHECK(update.restarted && update.complete && update.added.size() == 300);
+
+    // Destroying the catalog stops a run in progress rather than waiting for it
+    catalog.refresh();
+    return checkFailures();
+}
@@ -0,0 +1,174 @@
+#include "Check.hpp"
+#include "HexDocument.hpp"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vector>
+
+// The SSE2 row encoder against the scalar one, search across the 1 MB
+// blocks it reads in against std::search over a patched copy, and
+// overwrite, undo and save against the bytes they should leave.
+
+static constexpr uint64_t BLOCK = 1024 * 1024; // HexDocument::SEARCH_BLOCK
+
+static void testEncodeRow() {
+    uint8_t bytes[HexDocument::ROW_BYTES];
+    char fast[2 * HexDocument::ROW_BYTES], slow[2 * HexDocument::ROW_BYTES];
+    // Every byte value at every position in the row
+    for (int value = 0; value < 256; value++) {
+        for (size_t i = 0; i < HexDocument::ROW_BYTES; i++) {
+            bytes[i] = static_cast<uint8_t>(value + i * 17);
+        }
+        HexDocument::encodeRow(bytes, fast);
+        HexDocument::encodeRowScalar(bytes, slow);
+        CHECK(memcmp(fast, slow, sizeof(fast)) == 0);
+    }
+    bytes[0] = 0x0f;
+    bytes[1] = 0xa9;
+    HexDocument::encodeRow(bytes, fast);
+    CHECK(std::string(fast, 4) == "0FA9");
+}
+
+static void writeFile(const std::filesystem::path& path, const std::vector<uint8_t>& bytes) {
+    std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+}
+
+static std::vector<uint8_t> readFile(const std::filesystem::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<uint8_t>((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+static void testFind(const std::filesystem::path& dir, std::mt19937& rng) {
+    // Few byte values, so partial matches are everywhere
+    std::vector<uint8_t> bytes(3 * BLOCK + 12345);
+    for (auto& b : bytes) b = static_cast<uint8_t>(rng() % 4);
+    std::string path = (dir / "search.bin").string();
+    writeFile(path, bytes);
+    HexDocument document;
+    CHECK(document.open(path));
+
+    // Patches, many of them on block boundaries, seen by the search
+    std::vector<uint8_t> model = bytes;
+    for (int i = 0; i < 2000; i++) {
+        uint64_t at = rng() % 2 ? rng() % model.size() : (rng() % 3 + 1) * BLOCK + rng() % 64 - 32;
+        uint8_t value = static_cast<uint8_t>(rng() % 6);
+        document.overwrite(at, value);
+        model[at] = value;
+    }
+
+    for (int i = 0; i < 300; i++) {
+        bool forward = rng() % 2 == 0;
+        uint64_t from = rng() % 4 == 0 ? rng() % 8 : rng() % model.size();
+        if (rng() % 8 == 0) from = model.size() - rng() % 8;
+        // A needle taken from across a block edge as this search reads them
+        size_t length = 1 + rng() % 24;
+        uint64_t edge = forward ? from + (rng() % 3) * BLOCK : from - std::min<uint64_t>(from, (rng() % 3) * BLOCK);
+        uint64_t at = edge - std::min<uint64_t>(edge, rng() % length);
+        at = std::min<uint64_t>(at, model.size() - length);
+        std::string needle(model.begin() + at, model.begin() + at + length);
+        if (rng() % 10 == 0) needle += '\x05'; // Not in the file at all, or only in patches
+
+        uint64_t expect = HexDocument::npos;
+        if (forward) {
+            if (from <= model.size()) {
+                auto it = std::search(model.begin() + from, model.end(), needle.begin(), needle.end());
+                if (it != model.end()) expect = it - model.begin();
+            }
+        } else {
+            auto end = model.begin() + std::min<uint64_t>(model.size(), from + needle.length() - 1);
+            auto it = std::find_end(model.begin(), end, needle.begin(), needle.end());
+            if (it != end) expect = it - model.begin();
+        }
+        uint64_t found = document.find(needle, from, forward);
+        if (found != expect) {
+            std::printf("%s find of %zu bytes from %llu: %llu, expected %llu\n", forward ? "forward" : "backward",
+                        needle.length(), static_cast<unsigned long long>(from),
+                        static_cast<unsigned long long>(found), static_cast<unsigned long long>(expect));
+            CHECK(false);
+        }
+    }
+
+    CHECK(document.find("", 0, true) == HexDocument::npos);
+    std::atomic<bool> cancelled{ true };
+    CHECK(document.find(std::string(1, '\x07'), 0, true, &cancelled) == HexDocument::npos);
+}
+
+static void testEditing(const std::filesystem::path& dir, std::mt19937& rng) {
+    std::vector<uint8_t> disk(100000);
+    for (auto& b : disk) b = static_cast<uint8_t>(rng());
+    std::string path = (dir / "edit.bin").string();
+    writeFile(path, disk);
+    HexDocument document;
+    CHECK(document.open(path));
+    CHECK(document.size() == disk.size() && !document.modified());
+
+    // A byte changed and then put back as it was on disk has no patch
+    uint8_t original = disk[10];
+    document.overwrite(10, static_cast<uint8_t>(original + 1));
+    CHECK(document.patched(10) && document.modified());
+    document.overwrite(10, original);
+    CHECK(!document.patched(10) && !document.modified());
+    // Undo walks back through both
+    uint64_t offset = 0;
+    CHECK(document.undo(offset) && offset == 10 && document.patched(10));
+    CHECK(document.undo(offset) && offset == 10 && !document.modified());
+    CHECK(!document.undo(offset));
+    document.overwrite(disk.size(), 1); // Past the end does nothing
+    CHECK(!document.modified());
+
+    // Random overwrites, some undone, against the bytes they should leave
+    std::vector<uint8_t> model = disk;
+    std::vector<std::pair<uint64_t, uint8_t>> history; // Offset and the byte before
+    for (int i = 0; i < 5000; i++) {
+        if (!history.empty() && rng() % 4 == 0) {
+            CHECK(document.undo(offset) && offset == history.back().first);
+            model[offset] = history.back().second;
+            history.pop_back();
+        } else {
+            uint64_t at = rng() % 2 ? rng() % 64 : rng() % model.size();
+            uint8_t value = rng() % 3 == 0 ? disk[at] : static_cast<uint8_t>(rng());
+            history.push_back({ at, model[at] });
+            document.overwrite(at, value);
+            model[at] = value;
+        }
+    }
+    std::vector<uint8_t> shown(model.size());
+    CHECK(document.read(0, shown.size(), shown.data()) == shown.size() && shown == model);
+    for (uint64_t at = 0; at < 64; at++) CHECK(document.patched(at) == (model[at] != disk[at]));
+    CHECK(document.read(model.size() - 3, 10, shown.data()) == 3);
+    CHECK(document.read(model.size(), 10, shown.data()) == 0);
+
+    CHECK(document.save());
+    CHECK(!document.modified() && !document.undo(offset));
+    CHECK(readFile(path) == model);
+    CHECK(document.read(0, shown.size(), shown.data()) == shown.size() && shown == model);
+    CHECK(document.save()); // Nothing to write
+
+    HexDocument reopened;
+    CHECK(reopened.open(path) && reopened.read(0, shown.size(), shown.data()) == shown.size() && shown == model);
+}
+
+static void testLooksBinary(const std::filesystem::path& dir) {
+    writeFile(dir / "text.txt", std::vector<uint8_t>{ 'a', 'b', '\n' });
+    writeFile(dir / "nul.bin", std::vector<uint8_t>{ 'a', 0, 'b' });
+    CHECK(!HexDocument::looksBinary((dir / "text.txt").string()));
+    CHECK(HexDocument::looksBinary((dir / "nul.bin").string()));
+    CHECK(!HexDocument::looksBinary((dir / "missing.bin").string()));
+}
+
+int main() {
+    auto dir = std::filesystem::temp_directory_path() / ("hoodrd-hex-" + std::to_string(std::random_device()()));
+    std::filesystem::create_directories(dir);
+    std::mt19937 rng(44);
+    testEncodeRow();
+    testFind(dir, rng);
+    testEditing(dir, rng);
+    testLooksBinary(dir);
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+    return checkFailures();
+}
@@ -0,0 +1,137 @@
+#include "Check.hpp"
+#include "IniFile.hpp"
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+
+static bool has(const IniFile& ini, const wchar_t* section, const wchar_t* key, const std::wstring& value) {
+    const std::wstring* found = ini.find(section, key);
+    return found && *found == value;
+}
+
+static void testParse() {
+    IniFile ini;
+    ini.parse("; a comment\n"
+              "# another\n"
+              "\n"
+              "orphan=before any section\n"
+              "[Font]\n"
+              "  Name =  Consolas  \n"
+              "Size=12\n"
+              "no equals sign here\n"
+              "=no key\n"
+              "[Editor\n"
+              "TabSize=\"8\"\n"
+              "Empty=\n"
+              "[font]\n"
+              "size=14\n"
+              "Bold=1\n");
+    CHECK(has(ini, L"Font", L"Name", L"Consolas"));
+    // A repeated key or section name, in any case, updates the first
+    CHECK(has(ini, L"FONT", L"size", L"14"));
+    CHECK(has(ini, L"Font", L"Bold", L"1"));
+    // An unterminated section name runs to the end of the line
+    CHECK(has(ini, L"Editor", L"TabSize", L"8"));
+    CHECK(has(ini, L"Editor", L"Empty", L""));
+    CHECK(has(ini, L"Font", L"", L"no key"));
+    CHECK(!ini.find(L"Font", L"orphan"));
+    CHECK(!ini.find(L"Font", L"no equals sign here"));
+    CHECK(!ini.find(L"Missing", L"Name"));
+    CHECK(ini.serialize() == "[Font]\r\nName=Consolas\r\nSize=14\r\n=no key\r\nBold=1\r\n"
+                             "\r\n[Editor]\r\nTabSize=8\r\nEmpty=\r\n");
+}
+
+static void testEncodings() {
+    IniFile crlf;
+    crlf.parse("[A]\r\nk=v\r\n\r\nj = w \r\n");
+    CHECK(has(crlf, L"A", L"k", L"v"));
+    CHECK(has(crlf, L"A", L"j", L"w"));
+
+    IniFile bom;
+    bom.parse("\xEF\xBB\xBF[Font]\nName=Caf\xC3\xA9 \xF0\x9F\x98\x80\n");
+    CHECK(has(bom, L"Font", L"Name", L"Café \U0001F600"));
+
+    // What WritePrivateProfileString leaves behind
+    std::string utf16 = "\xFF\xFE";
+    for (char c : std::string("[A]\r\nk=v\r\n")) {
+        utf16 += c;
+        utf16 += '\0';
+    }
+    IniFile wide;
+    wide.parse(utf16);
+    CHECK(has(wide, L"a", L"K", L"v"));
+
+    IniFile invalid;
+    invalid.parse("[A]\nk=x\xFFy\n");
+    CHECK(has(invalid, L"A", L"k", L"x�y"));
+}
+
+// Unknown sections and keys survive a load and save untouched
+static void testRoundTrip() {
+    auto dir = std::filesystem::temp_directory_path() / ("hoodrd-ini-" + std::to_string(std::random_device()()));
+    auto path = dir / "sub" / "settings.ini";
+
+    IniFile missing;
+    CHECK(missing.load(path));
+    CHECK(missing.serialize().empty());
+
+    IniFile ini;
+    ini.parse("[Font]\nName=Caf\xC3\xA9\nFuture=kept\n[Plugin]\nx=1\n");
+    ini.set(L"Font", L"Size", L"11");
+    ini.set(L"New", L"Key", L"value");
+    CHECK(ini.save(path));
+    CHECK(!std::filesystem::exists(path.string() + ".tmp"));
+
+    IniFile loaded;
+    CHECK(loaded.load(path));
+    CHECK(loaded.serialize() == ini.serialize());
+    CHECK(has(loaded, L"Font", L"Future", L"kept"));
+    CHECK(has(loaded, L"Plugin", L"x", L"1"));
+    CHECK(has(loaded, L"Font", L"Name", L"Café"));
+
+    // Saving again replaces the file rather than appending to it
+    loaded.set(L"Font", L"Size", L"12");
+    CHECK(loaded.save(path));
+    std::ifstream file(path, std::ios::binary);
+    std::string bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    CHECK(bytes == loaded.serialize());
+
+    // Renaming over a directory fails and leaves no temporary file behind
+    auto blocked = dir / "blocked.ini";
+    std::filesystem::create_directories(blocked / "inside");
+    CHECK(!ini.save(blocked));
+    CHECK(!std::filesystem::exists(blocked.string() + ".tmp"));
+
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+}
+
+static void testNumbers() {
+    // How Settings reads TabSize=1..16; a hand edit may say anything
+    CHECK(IniFile::toInt(L"8", 4, 1, 16) == 8);
+    CHECK(IniFile::toInt(L" +12", 4, 1, 16) == 12);
+    CHECK(IniFile::toInt(L"-1", 4, 1, 16) == 1);
+    CHECK(IniFile::toInt(L"0", 4, 1, 16) == 1);
+    CHECK(IniFile::toInt(L"1000", 4, 1, 16) == 16);
+    CHECK(IniFile::toInt(L"99999999999999999999", 4, 1, 16) == 16);
+    CHECK(IniFile::toInt(L"-99999999999999999999", 4, 1, 16) == 1);
+    CHECK(IniFile::toInt(L"6px", 4, 1, 16) == 6);
+    CHECK(IniFile::toInt(L"", 4, 1, 16) == 4);
+    CHECK(IniFile::toInt(L"wide", 4, 1, 16) == 4);
+    CHECK(IniFile::toInt(L"", 100, 6, 72) == 72);
+
+    IniFile ini;
+    ini.parse("[Editor]\nTabSize=-1\n[Font]\nSize=0\n");
+    CHECK(IniFile::toInt(*ini.find(L"Editor", L"TabSize"), 4, 1, 16) == 1);
+    CHECK(IniFile::toInt(*ini.find(L"Font", L"Size"), 14, 6, 72) == 6);
+}
+
+int main() {
+    testParse();
+    testNumbers();
+    testEncodings();
+    testRoundTrip();
+    return checkFailures();
+}
@@ -0,0 +1,191 @@
+#include "Check.hpp"
+#include "FixedMetrics.hpp"
+#include "LayoutCache.hpp"
+#include "TextBuffer.hpp"
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+// 'i' narrow, 'm' wide, everything else in between
+class MixedMetrics : public GlyphMetrics {
+public:
+    void advances(int* widths) const override {
+        for (int c = 0; c < 256; c++) widths[c] = c == 'i' ? 3 : c == 'm' ? 12 : 7;
+    }
+};
+
+static void testLookups() {
+    TextBuffer buffer;
+    buffer.assign({ "mi\tx", "iii", std::string(TextLine::LONG_LINE, 'm') + "x" });
+    LayoutCache layout(buffer);
+    buffer.addListener(&layout);
+    layout.reset(MixedMetrics(), 4); // Tab stops every 4 spaces of 7 pixels
+
+    CHECK(layout.x(0, 0) == 0);
+    CHECK(layout.x(0, 1) == 12);
+    CHECK(layout.x(0, 2) == 15);
+    CHECK(layout.x(0, 3) == 28);
+    CHECK(layout.x(0, 4) == 35);
+    CHECK(layout.x(0, 99) == 35);
+    CHECK(layout.width(0) == 35);
+
+    CHECK(layout.columnAt(0, -5) == 0);
+    CHECK(layout.columnAt(0, 14) == 1);
+    CHECK(layout.columnAt(0, 1000) == 4);
+    CHECK(layout.hitTest(0, 13) == 1);
+    CHECK(layout.hitTest(0, 14) == 2);
+    CHECK(layout.hitTest(0, 1000) == 4);
+    CHECK(layout.x(1, 3) == 9);
+
+    // Too long to measure: laid out at the average advance
+    int average = layout.glyphTable().average;
+    CHECK(buffer.line(2).chunked());
+    CHECK(layout.x(2, 10) == 10 * average);
+    CHECK(layout.columnAt(2, 10 * average + 1) == 10);
+}
+
+static void testTabStops() {
+    TextBuffer buffer;
+    buffer.assign({ "\tx", "abc\tx", "abcd\tx", "\t\t" });
+    LayoutCache layout(buffer);
+    buffer.addListener(&layout);
+    layout.reset(FixedMetrics(8), 4);
+
+    CHECK(layout.x(0, 1) == 32);
+    CHECK(layout.x(1, 4) == 32);
+    CHECK(layout.x(2, 5) == 64);
+    CHECK(layout.x(3, 2) == 64);
+    // Inside a tab the nearer edge wins
+    CHECK(layout.hitTest(0, 15) == 0);
+    CHECK(layout.hitTest(0, 17) == 1);
+
+    layout.reset(FixedMetrics(8), 2);
+    CHECK(layout.x(1, 4) == 32);
+    CHECK(layout.x(2, 5) == 48);
+}
+
+static void testColumnStops() {
+    TextBuffer buffer;
+    buffer.assign({ "a,bb,c", "\"x,y\",z", "aaaaaaaaaaaaaaa,b" });
+    LayoutCache layout(buffer);
+    buffer.addListener(&layout);
+    layout.reset(FixedMetrics(8), 4);
+
+    ColumnStops stops;
+    stops.delimiter = ',';
+    stops.starts = { 0, 40, 100 };
+    layout.setColumns(stops);
+    CHECK(layout.x(0, 2) == 40);
+    CHECK(layout.x(0, 4) == 56);
+    CHECK(layout.x(0, 5) == 100);
+    // A delimiter inside quotes is text
+    CHECK(layout.x(1, 3) == 24);
+    CHECK(layout.x(1, 6) == 48);
+    // A field wider than its column pushes the next one along
+    CHECK(layout.x(2, 16) == 128);
+
+    layout.setColumns(ColumnStops());
+    CHECK(layout.x(0, 2) == 16);
+}
+
+// Random edit batches against a cache that has measured some lines: every
+// line must then lay out the same as in a cache built from scratch
+static void testInvalidation() {
+    std::mt19937 rng(7);
+    const char alphabet[] = "im\tx\n";
+    auto randomText = [&](size_t length) {
+        std::string text;
+        for (size_t i = 0; i < length; i++) text += alphabet[rng() % (sizeof(alphabet) - 1)];
+        return text;
+    };
+
+    TextBuffer buffer;
+    std::vector<std::string> lines;
+    for (int i = 0; i < 200; i++) lines.push_back(randomText(rng() % 12));
+    for (auto& line : lines) line.erase(std::remove(line.begin(), line.end(), '\n'), line.end());
+    buffer.assign(std::move(lines));
+    LayoutCache layout(buffer);
+    buffer.addListener(&layout);
+    layout.reset(MixedMetrics(), 4);
+
+    for (int round = 0; round < 2000; round++) {
+        for (size_t line = 0; line < buffer.lineCount(); line++)
+            if (rng() % 2) layout.x(line, 0);
+
+        // Sorted, non-overlapping ranges; some keep the line count and some do not
+        std::vector<TextPos> ends;
+        size_t count = 2 * (1 + rng() % 8);
+        for (size_t i = 0; i < count; i++) {
+            size_t line = rng() % buffer.lineCount();
+            ends.push_back({ line, rng() % (buffer.line(line).length() + 1) });
+        }
+        std::sort(ends.begin(), ends.end());
+        bool keepLines = rng() % 3 == 0;
+        std::vector<TextEdit> edits;
+        for (size_t i = 0; i < count; i += 2) {
+            if (i > 0 && !(edits.back().to < ends[i])) continue;
+            TextPos to = keepLines ? TextPos{ ends[i].line, std::max(ends[i].col, ends[i + 1].line == ends[i].line ? ends[i + 1].col : ends[i].col) } : ends[i + 1];
+            std::string text = randomText(rng() % 6);
+            if (keepLines) text.erase(std::remove(text.begin(), text.end(), '\n'), text.end());
+            edits.push_back({ ends[i], to, text });
+        }
+        buffer.apply(edits);
+
+        LayoutCache fresh(buffer);
+        fresh.reset(MixedMetrics(), 4);
+        for (size_t line = 0; line < buffer.lineCount(); line++) {
+            size_t length = buffer.line(line).length();
+            CHECK(layout.x(line, length) == fresh.x(line, length));
+            CHECK(layout.x(line, length / 2) == fresh.x(line, length / 2));
+        }
+        if (checkFailures()) return;
+    }
+}
+
+// Edits touching a few lines of a big document must not cost a pass over
+// every line: once per keystroke that was seconds for a 2M-line file
+static void testSpliceCost() {
+    TextBuffer buffer;
+    buffer.assign(std::vector<std::string>(2000000, "some text"));
+    LayoutCache layout(buffer);
+    buffer.addListener(&layout);
+    layout.reset(FixedMetrics(), 4);
+
+    double ms = millis([&] {
+        for (int i = 0; i < 1000; i++) {
+            buffer.insert({ 1000000, 0 }, "x");
+            layout.x(1000000, 1);
+        }
+    });
+    checkBudget("1000 keystrokes on a 2M-line file", ms, 250);
+    CHECK(layout.x(1000000, 1009) == 1009 * 8);
+
+    std::vector<TextEdit> edits;
+    for (size_t line = 0; line < 2000000; line += 200) edits.push_back({ { line, 0 }, { line, 0 }, "x" });
+    ms = 0;
+    for (int i = 0; i < 100 && ms <= 500; i++) ms += millis([&] { buffer.apply(edits); });
+    checkBudget("100 keystrokes at 10K carets", ms, 500);
+
+    TextBuffer loading;
+    LayoutCache progressive(loading);
+    loading.addListener(&progressive);
+    progressive.reset(FixedMetrics(), 4);
+    ms = millis([&] {
+        for (size_t first = 0; first < 2000000; first += 1000) {
+            loading.setLines(first, std::vector<std::string>(1000, "loaded"));
+            progressive.x(first, 1);
+        }
+    });
+    checkBudget("loading 2M lines 1000 at a time", ms, 1000);
+    CHECK(progressive.x(1999999, 6) == 48);
+}
+
+int main() {
+    testLookups();
+    testTabStops();
+    testColumnStops();
+    testInvalidation();
+    testSpliceCost();
+    return checkFailures();
+}
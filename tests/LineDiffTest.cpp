@@ -0,0 +1,54 @@
+#include "Check.hpp"
+#include "LineDiff.hpp"
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Cancelling a diff, the way a compare window closed early does: the
+// worker must give up soon after the flag is set, even on inputs that
+// take the diff seconds, and a flag left unset must not change the result.
+
+static std::vector<std::string> randomLines(std::mt19937& rng, size_t count, unsigned values) {
+    std::vector<std::string> lines;
+    for (size_t i = 0; i < count; i++) lines.push_back(std::to_string(rng() % values));
+    return lines;
+}
+
+int main() {
+    std::mt19937 rng(42);
+
+    // Few distinct lines in different orders are the diff's worst case
+    std::vector<std::string> a = randomLines(rng, 1000000, 4);
+    std::vector<std::string> b = randomLines(rng, 1000000, 4);
+    std::vector<DiffHunk> full;
+    double whole = millis([&] { full = LineDiff::compute(a, b); });
+    CHECK(!full.empty());
+    std::printf("%-48s %10.2f ms\n", "uncancelled diff", whole);
+
+    std::atomic<bool> cancelled{ false };
+    CHECK(LineDiff::compute(a, b, &cancelled).size() == full.size());
+
+    cancelled = true;
+    std::vector<DiffHunk> hunks;
+    checkBudget("diff cancelled before it starts", millis([&] { hunks = LineDiff::compute(a, b, &cancelled); }), 400);
+    CHECK(hunks.empty());
+
+    // Cancelled part way through
+    cancelled = false;
+    std::chrono::steady_clock::time_point set;
+    std::thread canceller([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        set = std::chrono::steady_clock::now();
+        cancelled = true;
+    });
+    hunks = LineDiff::compute(a, b, &cancelled);
+    auto done = std::chrono::steady_clock::now();
+    canceller.join();
+    CHECK(hunks.empty());
+    checkBudget("diff stopping after the flag is set",
+                std::chrono::duration<double, std::milli>(done - set).count(), 50);
+    return checkFailures();
+}
@@ -0,0 +1,147 @@
+#include "Check.hpp"
+#include "LineIndex.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+
+// Sidecars that are good, stale and corrupt. A corrupt one must never
+// get as far as sizing the view from its line count.
+
+// Where SidecarHeader in LineIndex.cpp keeps its fields
+static constexpr size_t MAGIC_AT = 0;
+static constexpr size_t LINE_COUNT_AT = 32;
+static constexpr size_t LONGEST_LINE_AT = 40;
+static constexpr size_t TOP_LINE_AT = 56;
+static constexpr size_t CARET_LINE_AT = 64;
+static constexpr size_t CHECKPOINT_COUNT_AT = 88;
+static constexpr size_t HEADER_SIZE = 96;
+
+static std::string readFile(const std::filesystem::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+static void writeFile(const std::filesystem::path& path, const std::string& bytes) {
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << bytes;
+}
+
+static void setField(std::string& sidecar, size_t at, uint64_t value) {
+    memcpy(&sidecar[at], &value, sizeof(value));
+}
+
+// Indexes `text` the way TextFile does as it reads
+static LineIndex indexOf(const std::string& text) {
+    LineIndex index;
+    size_t start = 0;
+    for (size_t newline; (newline = text.find('\n', start)) != std::string::npos; start = newline + 1) {
+        index.addLine(newline - start, start);
+    }
+    if (start < text.size()) index.addLine(text.size() - start, start);
+    return index;
+}
+
+int main() {
+    auto dir = std::filesystem::temp_directory_path() / ("hoodrd-lineindex-" + std::to_string(std::random_device()()));
+    std::filesystem::create_directories(dir);
+    setenv("XDG_CACHE_HOME", dir.string().c_str(), 1);
+    std::string path = (dir / "doc.txt").string();
+
+    std::string text;
+    for (int i = 0; i < 1000; i++) text += "line " + std::to_string(i) + "\n";
+    writeFile(path, text);
+    LineIndex index = indexOf(text);
+    CHECK(index.lineCount == 1000 && index.checkpoints.size() == 4);
+    CHECK(index.identify(path));
+    index.topLine = 500;
+    index.caretLine = 510;
+    index.caretCol = 3;
+    CHECK(index.save(path));
+
+    LineIndex loaded;
+    CHECK(loaded.load(path));
+    CHECK(loaded.lineCount == 1000 && loaded.topLine == 500 && loaded.caretLine == 510 && loaded.caretCol == 3);
+    CHECK(loaded.checkpoints == index.checkpoints);
+
+    std::filesystem::path sidecar;
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(dir / "hoodrd")) {
+        if (entry.path().extension() == ".idx") sidecar = entry.path();
+    }
+    CHECK(!sidecar.empty());
+    const std::string good = readFile(sidecar);
+    CHECK(good.size() == HEADER_SIZE + 4 * sizeof(uint64_t));
+
+    // Each change to a good sidecar that load must turn down
+    auto rejects = [&](std::string bytes) {
+        writeFile(sidecar, bytes);
+        LineIndex attempt;
+        return !attempt.load(path);
+    };
+    CHECK(!rejects(good));
+    CHECK(rejects(good.substr(0, HEADER_SIZE - 1)));
+    CHECK(rejects(good.substr(0, good.size() - 1)));
+    CHECK(rejects(good + std::string(8, '\0')));
+    std::string bad = good;
+    bad[MAGIC_AT] = 'X';
+    CHECK(rejects(bad));
+
+    // A line count far past what the file could hold, alone and with a
+    // checkpoint count to match
+    bad = good;
+    setField(bad, LINE_COUNT_AT, 4000000000ull);
+    CHECK(rejects(bad));
+    bad = good;
+    setField(bad, LINE_COUNT_AT, 100000);
+    setField(bad, CHECKPOINT_COUNT_AT, 100000 / LineIndex::CHECKPOINT_LINES + 1);
+    bad.resize(HEADER_SIZE + (100000 / LineIndex::CHECKPOINT_LINES + 1) * sizeof(uint64_t));
+    CHECK(rejects(bad));
+    bad = good;
+    setField(bad, LINE_COUNT_AT, 1500);
+    CHECK(rejects(bad));
+
+    for (size_t at : { TOP_LINE_AT, CARET_LINE_AT, LONGEST_LINE_AT }) {
+        bad = good;
+        setField(bad, at, 1000);
+        CHECK(rejects(bad));
+        setField(bad, at, 999);
+        CHECK(!rejects(bad));
+    }
+
+    // Checkpoints out of order or past the end of the file
+    bad = good;
+    setField(bad, HEADER_SIZE + 2 * sizeof(uint64_t), 10);
+    CHECK(rejects(bad));
+    bad = good;
+    setField(bad, HEADER_SIZE + 3 * sizeof(uint64_t), text.size() + 1);
+    CHECK(rejects(bad));
+    bad = good;
+    setField(bad, HEADER_SIZE, 7);
+    CHECK(rejects(bad));
+
+    // Compressed files keep no checkpoints
+    bad = good.substr(0, HEADER_SIZE);
+    setField(bad, CHECKPOINT_COUNT_AT, 0);
+    CHECK(!rejects(bad));
+
+    // Stale: same size and time, different bytes
+    writeFile(sidecar, good);
+    auto time = std::filesystem::last_write_time(path);
+    std::string changed = text;
+    changed[0] = 'L';
+    writeFile(path, changed);
+    std::filesystem::last_write_time(path, time);
+    CHECK(!loaded.load(path));
+    writeFile(path, text);
+    std::filesystem::last_write_time(path, time);
+    CHECK(loaded.load(path));
+    // Or only the time
+    std::filesystem::last_write_time(path, time + std::chrono::seconds(5));
+    CHECK(!loaded.load(path));
+
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+    return checkFailures();
+}
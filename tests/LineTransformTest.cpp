@@ -0,0 +1,139 @@
+#include "Check.hpp"
+#include "LineTransform.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Every transform at 1 to 16 threads against a one-line-at-a-time
+// reference, on random documents big enough to span many blocks and merge
+// rounds but also down to empty and single lines.
+
+static constexpr unsigned MAX_THREADS = 16;
+
+static std::vector<std::string> applyResult(const std::vector<std::string>& lines,
+                                            const LineTransform::Result& result) {
+    std::vector<std::string> out;
+    size_t next = 0;
+    for (const DiffHunk& hunk : result.hunks) {
+        out.insert(out.end(), lines.begin() + next, lines.begin() + hunk.oldStart);
+        for (size_t i = 0; i < hunk.newCount; i++) out.emplace_back(result.lines[hunk.newStart + i]);
+        next = hunk.oldStart + hunk.oldCount;
+    }
+    out.insert(out.end(), lines.begin() + next, lines.end());
+    return out;
+}
+
+static std::vector<std::string> reference(const LineTransform::Spec& spec, const std::vector<std::string>& lines) {
+    std::vector<std::string> out;
+    switch (spec.kind) {
+    case LineTransform::Sort:
+        out = lines;
+        std::sort(out.begin(), out.end());
+        break;
+    case LineTransform::RemoveDuplicates: {
+        std::unordered_set<std::string> seen;
+        for (const auto& line : lines) {
+            if (seen.insert(line).second) out.push_back(line);
+        }
+        break;
+    }
+    case LineTransform::KeepMatching:
+    case LineTransform::DropMatching:
+        for (const auto& line : lines) {
+            bool found = line.find(spec.pattern) != std::string::npos;
+            if (found == (spec.kind == LineTransform::KeepMatching)) out.push_back(line);
+        }
+        break;
+    case LineTransform::SortByField: {
+        if (lines.empty()) break;
+        struct Row {
+            std::string key;
+            bool numeric;
+            double number;
+            std::string line;
+        };
+        std::vector<Row> rows;
+        for (size_t i = 1; i < lines.size(); i++) {
+            Row row{ std::string(LineTransform::field(lines[i], spec.delimiter, spec.field)), false, 0, lines[i] };
+            char* parsed = nullptr;
+            row.number = strtod(row.key.c_str(), &parsed);
+            row.numeric = parsed != row.key.c_str() && *parsed == 0 && row.number == row.number;
+            rows.push_back(std::move(row));
+        }
+        std::stable_sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) {
+            if (a.numeric != b.numeric) return a.numeric;
+            return a.numeric ? a.number < b.number : a.key < b.key;
+        });
+        out.push_back(lines[0]);
+        for (auto& row : rows) out.push_back(std::move(row.line));
+        break;
+    }
+    }
+    return out;
+}
+
+static std::vector<std::string> randomLines(std::mt19937_64& rng, size_t count) {
+    // Few distinct values so sorts see long runs of equal keys and the
+    // dedupe sees many repeats
+    size_t values = count / 3 + 1;
+    std::vector<std::string> lines;
+    for (size_t i = 0; i < count; i++) {
+        std::string line;
+        switch (rng() % 4) {
+        case 0: line = std::to_string(rng() % values) + "," + std::to_string(rng() % 7); break;
+        case 1: line = "\"" + std::to_string(static_cast<double>(rng() % values) / 4) + "\",x" + std::to_string(rng() % 3); break;
+        case 2: line = "name" + std::to_string(rng() % values) + ",-" + std::to_string(rng() % 5); break;
+        default: line = rng() % 10 == 0 ? "" : ",\"a,b\"," + std::to_string(rng() % values); break;
+        }
+        lines.push_back(std::move(line));
+    }
+    return lines;
+}
+
+int main() {
+    std::mt19937_64 rng(41);
+    std::vector<LineTransform::Spec> specs;
+    for (auto kind : { LineTransform::Sort, LineTransform::RemoveDuplicates }) specs.push_back({ kind, "", ',', 0 });
+    specs.push_back({ LineTransform::KeepMatching, "x", ',', 0 });
+    specs.push_back({ LineTransform::DropMatching, "1", ',', 0 });
+    for (size_t field = 0; field < 3; field++) specs.push_back({ LineTransform::SortByField, "", ',', field });
+
+    const size_t sizes[] = { 0, 1, 2, 5, 100, 1000, 4097, 30000, 100000 };
+    for (size_t size : sizes) {
+        std::vector<std::string> lines = randomLines(rng, size);
+        std::vector<std::string_view> views(lines.begin(), lines.end());
+        for (const auto& spec : specs) {
+            std::vector<std::string> expect = reference(spec, lines);
+            for (unsigned threads = 1; threads <= MAX_THREADS; threads++) {
+                LineTransform::Result result;
+                TransformProgress progress;
+                CHECK(LineTransform::run(spec, views, threads, result, &progress));
+                if (applyResult(lines, result) != expect) {
+                    std::printf("kind %d field %zu: %zu lines at %u threads differ from the reference\n",
+                                static_cast<int>(spec.kind), spec.field, size, threads);
+                    CHECK(false);
+                }
+                // Hunks in order and inside the document
+                size_t next = 0;
+                for (const DiffHunk& hunk : result.hunks) {
+                    CHECK(hunk.oldStart >= next && hunk.oldStart + hunk.oldCount <= size);
+                    next = hunk.oldStart + hunk.oldCount;
+                }
+            }
+        }
+    }
+
+    // Cancelled before it starts, any thread count gives up
+    std::vector<std::string> lines = randomLines(rng, 50000);
+    std::vector<std::string_view> views(lines.begin(), lines.end());
+    for (unsigned threads : { 1u, 4u, 16u }) {
+        LineTransform::Result result;
+        TransformProgress progress;
+        progress.cancelled = true;
+        CHECK(!LineTransform::run({ LineTransform::Sort, "", ',', 0 }, views, threads, result, &progress));
+    }
+    return checkFailures();
+}
@@ -0,0 +1,142 @@
+#include "Check.hpp"
+#include "MinimapSummary.hpp"
+#include "TextBuffer.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+// The summary against counting every line again, after each of many random
+// edit batches: small edits that only restate a block, inserts big enough
+// to split blocks, deletes across several blocks that merge them, and
+// batches past MAX_INCREMENTAL_CHANGES that build everything again.
+
+using Counts = std::array<double, MinimapSummary::KIND_COUNT>;
+
+// Running totals of the brute-force counts, one entry per line plus one
+static std::vector<Counts> countLines(const TextBuffer& buffer) {
+    std::vector<Counts> totals(buffer.lineCount() + 1, Counts{});
+    for (size_t i = 0; i < buffer.lineCount(); i++) {
+        Counts counts{};
+        const TextLine& line = buffer.line(i);
+        if (line.chunked()) {
+            counts[MinimapSummary::Words] = static_cast<double>(line.length());
+        } else {
+            for (char c : line.scannable()) {
+                unsigned char u = static_cast<unsigned char>(c);
+                if (u <= ' ' || u == 127) continue;
+                bool word = (u >= 'a' && u <= 'z') || (u >= 'A' && u <= 'Z') || u == '_' || u >= 128;
+                counts[u >= '0' && u <= '9' ? MinimapSummary::Numbers
+                       : word               ? MinimapSummary::Words
+                                            : MinimapSummary::Symbols]++;
+            }
+        }
+        for (int k = 0; k < MinimapSummary::KIND_COUNT; k++) totals[i + 1][k] = totals[i][k] + counts[k];
+    }
+    return totals;
+}
+
+static double charsBetween(const std::vector<Counts>& totals, size_t first, size_t last) {
+    double chars = 0;
+    for (int k = 0; k < MinimapSummary::KIND_COUNT; k++) chars += totals[last][k] - totals[first][k];
+    return chars;
+}
+
+static bool near(double a, double b) { return std::fabs(a - b) <= 1e-6 * std::max(1.0, std::fabs(b)); }
+
+static void compare(const TextBuffer& buffer, const MinimapSummary& summary, std::mt19937& rng) {
+    std::vector<Counts> totals = countLines(buffer);
+    size_t count = buffer.lineCount();
+
+    // The whole buffer is whole blocks, so the tree's sums must be exact
+    MinimapSummary::Totals all = summary.sum(0, static_cast<double>(count));
+    CHECK(near(all.lines, static_cast<double>(count)));
+    CHECK(near(all.chars, charsBetween(totals, 0, count)));
+    for (int k = 0; k < MinimapSummary::KIND_COUNT; k++) CHECK(near(all.kinds[k], totals[count][k]));
+    CHECK(summary.blockCount() * 2 * MinimapSummary::BLOCK_LINES >= count);
+
+    // Elsewhere a block cut part way counts in proportion, so only the two
+    // blocks at the ends may be off, by at most what they hold
+    size_t reach = 2 * MinimapSummary::BLOCK_LINES;
+    for (int i = 0; i < 20; i++) {
+        size_t first = rng() % (count + 1);
+        size_t last = first + rng() % (count - first + 1);
+        MinimapSummary::Totals part = summary.sum(static_cast<double>(first), static_cast<double>(last));
+        CHECK(near(part.lines, static_cast<double>(last - first)));
+        double slack = charsBetween(totals, first - std::min(first, reach), std::min(count, first + reach)) +
+                       charsBetween(totals, last - std::min(last, reach), std::min(count, last + reach));
+        CHECK(std::fabs(part.chars - charsBetween(totals, first, last)) <= slack + 1e-6);
+    }
+
+    int pixels = 1 + static_cast<int>(rng() % 600);
+    std::vector<MinimapSummary::Row> rows = summary.rows(pixels);
+    CHECK(rows.size() == static_cast<size_t>(pixels));
+    for (const auto& row : rows) CHECK(row.density >= 0 && row.density <= 1);
+}
+
+static std::string randomText(std::mt19937& rng) {
+    static const char* const pieces[] = { "word", "1234", "{};", "  ", "\t", "x_y", "\xc3\xa9", "+= 0.5" };
+    std::string text;
+    size_t length = rng() % 6;
+    for (size_t i = 0; i < length; i++) text += pieces[rng() % 8];
+    return text;
+}
+
+// Sorted, non-overlapping edits, each inserting some text and lines
+static std::vector<TextEdit> randomBatch(const TextBuffer& buffer, std::mt19937& rng) {
+    size_t count = buffer.lineCount();
+    size_t edits;
+    switch (rng() % 8) {
+    case 0: edits = MinimapSummary::BLOCK_LINES * 10; break; // Past MAX_INCREMENTAL_CHANGES
+    case 1: edits = 1; break;
+    default: edits = 1 + rng() % 16; break;
+    }
+    bool shrink = count > 60000;
+    std::vector<TextPos> points;
+    for (size_t i = 0; i < 2 * edits; i++) {
+        size_t line = rng() % count;
+        points.push_back({ line, rng() % (buffer.line(line).length() + 1) });
+    }
+    std::sort(points.begin(), points.end());
+    points.erase(std::unique(points.begin(), points.end()), points.end());
+
+    std::vector<TextEdit> batch;
+    for (size_t i = 0; i + 1 < points.size(); i += 2) {
+        TextEdit edit{ points[i], points[i], randomText(rng) };
+        // A few deletes reach across blocks, more so as the buffer grows
+        if (shrink || rng() % 3 == 0) edit.to = points[i + 1];
+        size_t newlines = rng() % 4 == 0 ? rng() % (3 * MinimapSummary::BLOCK_LINES) : rng() % 3;
+        if (shrink) newlines = std::min<size_t>(newlines, 1);
+        for (size_t n = 0; n < newlines; n++) edit.text += (n % 5 == 0 ? "\r\n" : "\n") + randomText(rng);
+        batch.push_back(std::move(edit));
+    }
+    return batch;
+}
+
+int main() {
+    std::mt19937 rng(45);
+    std::vector<std::string> lines;
+    for (size_t i = 0; i < 30000; i++) lines.push_back(i % 7 == 0 ? "" : randomText(rng) + std::to_string(i));
+    lines[100] = std::string(TextLine::LONG_LINE + 10, 'a');
+
+    TextBuffer buffer;
+    MinimapSummary summary(buffer);
+    buffer.addListener(&summary);
+    buffer.assign(std::move(lines));
+    compare(buffer, summary, rng);
+
+    for (int batch = 0; batch < 400; batch++) {
+        buffer.apply(randomBatch(buffer, rng));
+        compare(buffer, summary, rng);
+    }
+
+    // Down to a single line and back up again
+    buffer.erase({ 0, 0 }, buffer.end());
+    compare(buffer, summary, rng);
+    CHECK(summary.blockCount() == 1);
+    buffer.insert({ 0, 0 }, std::string(5000, '\n') + "tail 42");
+    compare(buffer, summary, rng);
+    return checkFailures();
+}
@@ -0,0 +1,71 @@
+#include "Check.hpp"
+#include "LineDiff.hpp"
+#include "TextBuffer.hpp"
+#include <random>
+#include <string>
+#include <vector>
+
+// Reloading a file changed on disk: diff the buffer against the new lines
+// and apply only the hunks, as TextEditor::reloadFromDisk does
+
+static std::vector<std::string> makeLines(size_t count, std::mt19937_64& rng) {
+    std::vector<std::string> lines;
+    lines.reserve(count);
+    for (size_t i = 0; i < count; i++)
+        lines.push_back("line " + std::to_string(i) + " payload " + std::to_string(rng() % 1000));
+    return lines;
+}
+
+// Changes, removes or inserts about `edits` lines at random
+static std::vector<std::string> editLines(const std::vector<std::string>& lines, size_t edits, std::mt19937_64& rng) {
+    std::vector<std::string> out;
+    out.reserve(lines.size() + edits);
+    for (const auto& line : lines) {
+        if (rng() % lines.size() >= edits) {
+            out.push_back(line);
+            continue;
+        }
+        switch (rng() % 3) {
+            case 0: out.push_back(line + " changed"); break;
+            case 1: break;
+            default: out.push_back("inserted " + std::to_string(rng())); out.push_back(line); break;
+        }
+    }
+    return out;
+}
+
+static bool matches(const TextBuffer& buffer, const std::vector<std::string>& lines) {
+    if (buffer.lineCount() != lines.size()) return false;
+    for (size_t i = 0; i < lines.size(); i++)
+        if (buffer.line(i).str() != lines[i]) return false;
+    return true;
+}
+
+static void reload(size_t count, size_t edits, double budgetMs) {
+    std::mt19937_64 rng(count + edits);
+    std::vector<std::string> before = makeLines(count, rng);
+    std::vector<std::string> after = editLines(before, edits, rng);
+
+    TextBuffer buffer;
+    buffer.assign(std::vector<std::string>(before));
+    double ms = millis([&] {
+        std::vector<std::string> scratch;
+        std::vector<std::string_view> newLines(after.begin(), after.end());
+        auto hunks = LineDiff::compute(buffer.flatLines(scratch), newLines);
+        std::vector<TextEdit> undo;
+        buffer.apply(buffer.diffEdits(newLines, hunks), &undo);
+    });
+    CHECK(matches(buffer, after));
+
+    char what[64];
+    std::snprintf(what, sizeof(what), "reload %zu lines, %zu edits", count, edits);
+    checkBudget(what, ms, budgetMs);
+}
+
+int main() {
+    reload(1000000, 0, 500);
+    reload(1000000, 100, 1500);
+    reload(1000000, 10000, 1500);
+    reload(1000000, 100000, 2000);
+    return checkFailures();
+}
@@ -0,0 +1,121 @@
+#include "Check.hpp"
+#include "CompressedFile.hpp"
+#include "FixedMetrics.hpp"
+#include "FoldMap.hpp"
+#include "LayoutCache.hpp"
+#include "LineIndex.hpp"
+#include "Session.hpp"
+#include "TextBuffer.hpp"
+#include "TextFile.hpp"
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Starting up into the last session without a window, the way
+// EditorWindow::RestoreSession and TextEditor::loadFile go about it: read
+// the session, load the file's line index, read the lines around the old
+// top line first and lay out a screenful of them. That is the first
+// frame. Then the whole file streams in and the carets and folds go back.
+
+static constexpr size_t LINES = 1000000;
+static constexpr size_t TOP_LINE = 700000;
+static constexpr size_t SCREEN_LINES = 60;
+// As FileLoader::FOCUS_LINES
+static constexpr size_t FOCUS_LINES = 8 * LineIndex::CHECKPOINT_LINES;
+
+struct Document {
+    TextBuffer buffer;
+    FoldMap folds;
+    FoldRegions regions{ buffer };
+    LayoutCache layout{ buffer };
+
+    Document() {
+        buffer.addListener(&folds);
+        buffer.addListener(&regions);
+        buffer.addListener(&layout);
+        layout.reset(FixedMetrics(), 4);
+    }
+};
+
+int main() {
+    auto dir = std::filesystem::temp_directory_path() / ("hoodrd-session-" + std::to_string(std::random_device()()));
+    std::filesystem::create_directories(dir);
+    // Line index sidecars go under the cache directory
+    setenv("XDG_CACHE_HOME", dir.string().c_str(), 1);
+    std::string file = (dir / "big.cpp").string();
+    auto sessionPath = dir / "session.ini";
+
+    // The previous run: a file read once, its index saved and the session written on exit
+    {
+        std::ofstream out(file, std::ios::binary);
+        for (size_t i = 0; i < LINES; i++) {
+            out << (i % 10 == 0 ? "void f" + std::to_string(i) + "() {\n" : i % 10 == 9 ? "}\n" : "    call(" + std::to_string(i) + ");\n");
+        }
+    }
+    std::vector<std::string> lines;
+    LineIndex index;
+    CHECK(index.identify(file) && TextFile::readLines(file, lines, &index));
+    index.topLine = TOP_LINE;
+    CHECK(index.save(file));
+
+    Session previous;
+    previous.file = file;
+    previous.view.topLine = TOP_LINE;
+    for (size_t i = 0; i < 100; i++) {
+        TextPos caret{ TOP_LINE + 10 + i, 4 };
+        previous.view.selections.push_back({ caret, caret });
+    }
+    for (size_t header = TOP_LINE; header < TOP_LINE + 1000; header += 10) previous.view.folds.push_back({ header, header + 8 });
+    CHECK(previous.save(sessionPath));
+
+    Document document;
+    Session session;
+    LineIndex saved;
+    double firstFrame = millis([&] {
+        CHECK(session.load(sessionPath) && session.file == file);
+        CHECK(saved.load(session.file) && saved.lineCount == LINES);
+        document.buffer.assign(std::vector<std::string>(static_cast<size_t>(saved.lineCount)));
+
+        size_t checkpoint = static_cast<size_t>(saved.topLine / LineIndex::CHECKPOINT_LINES);
+        size_t line = checkpoint * LineIndex::CHECKPOINT_LINES;
+        auto focus = FileReader::open(session.file);
+        CHECK(focus && focus->seek(saved.checkpoints[checkpoint]));
+        size_t focusLine = line;
+        TextFile::streamLines(*focus, [&](std::vector<std::string>&& more) {
+            size_t count = more.size();
+            document.buffer.setLines(line, std::move(more));
+            line += count;
+            return line < focusLine + FOCUS_LINES;
+        });
+        for (size_t row = session.view.topLine; row < session.view.topLine + SCREEN_LINES; row++) {
+            document.layout.x(row, document.buffer.line(row).length());
+            document.regions.isHeader(row);
+        }
+    });
+    CHECK(document.buffer.line(TOP_LINE).str() == lines[TOP_LINE]);
+    checkBudget("session to first frame, 1M-line file", firstFrame, 400);
+
+    double restored = millis([&] {
+        size_t line = 0;
+        auto reader = FileReader::open(session.file);
+        TextFile::streamLines(*reader, [&](std::vector<std::string>&& more) {
+            size_t count = more.size();
+            document.buffer.setLines(line, std::move(more));
+            line += count;
+            return true;
+        });
+        for (const auto& fold : session.view.folds) document.folds.fold(fold.first, fold.second);
+    });
+    CHECK(document.buffer.lineCount() == LINES);
+    CHECK(document.buffer.line(LINES - 1).str() == lines.back());
+    CHECK(document.folds.isFolded(TOP_LINE) && document.folds.isHidden(TOP_LINE + 8));
+    CHECK(session.view.selections.size() == 100);
+    checkBudget("whole file in and view restored", restored, 3000);
+
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+    return checkFailures();
+}
@@ -0,0 +1,49 @@
+#include "Check.hpp"
+#include "TextBuffer.hpp"
+#include "TextLine.hpp"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// Typing into the middle of a 500 MB line, the minified-file case chunked
+// lines are for. Each keystroke has to stay under a millisecond.
+
+static constexpr size_t LINE_BYTES = 500u * 1024 * 1024;
+static constexpr int KEYSTROKES = 500;
+
+int main() {
+    TextBuffer buffer;
+    double load = millis([&] {
+        std::string line(LINE_BYTES, 'x');
+        for (size_t i = 0; i < LINE_BYTES; i += 97) line[i] = ';';
+        std::vector<std::string> lines;
+        lines.push_back(std::move(line));
+        buffer.assign(std::move(lines));
+    });
+    std::printf("%-48s %10.2f ms\n", "loading the 500 MB line", load);
+    CHECK(buffer.line(0).chunked());
+
+    // Typed and then backspaced at the caret, the way TextEditor sends them
+    TextPos caret{ 0, LINE_BYTES / 2 + 12345 };
+    double worstType = 0, worstErase = 0;
+    for (int i = 0; i < KEYSTROKES; i++) {
+        worstType = std::max(worstType, millis([&] { caret = buffer.insert(caret, "a"); }));
+    }
+    for (int i = 0; i < KEYSTROKES / 2; i++) {
+        TextPos before{ caret.line, caret.col - 1 };
+        worstErase = std::max(worstErase, millis([&] { buffer.erase(before, caret); }));
+        caret = before;
+    }
+    CHECK(buffer.line(0).length() == LINE_BYTES + KEYSTROKES / 2);
+    CHECK(buffer.line(0).substr(LINE_BYTES / 2 + 12345, KEYSTROKES / 2) == std::string(KEYSTROKES / 2, 'a'));
+    checkBudget("slowest keystroke typing mid-line", worstType, 1);
+    checkBudget("slowest backspace mid-line", worstErase, 1);
+
+    // Reading back around the caret and finding the next match
+    const TextLine& line = buffer.line(0);
+    double read = millis([&] { CHECK(line.at(caret.col + 3) == 'x' || line.at(caret.col + 3) == ';'); });
+    checkBudget("reading a character mid-line", read, 1);
+    double found = millis([&] { CHECK(line.find(";", caret.col) != std::string::npos); });
+    checkBudget("finding the next match mid-line", found, 1);
+    return checkFailures();
+}
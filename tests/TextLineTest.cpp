@@ -0,0 +1,94 @@
+#include "Check.hpp"
+#include "TextLine.hpp"
+#include <random>
+#include <string>
+
+// Chunked lines against a plain std::string kept alongside, through random
+// edits that land inside a chunk, straddle chunk boundaries, split chunks
+// that grow too big, empty them out, and take the line below LONG_LINE and
+// back over it.
+
+static std::string randomText(std::mt19937& rng, size_t length) {
+    // Few letters, so finds have many near misses
+    std::string text(length, 'a');
+    for (char& c : text) c = static_cast<char>('a' + rng() % 4);
+    return text;
+}
+
+// An edit position biased towards chunk boundaries
+static size_t randomColumn(std::mt19937& rng, size_t length) {
+    if (rng() % 2 == 0 && length >= TextLine::CHUNK_SIZE) {
+        size_t boundary = TextLine::CHUNK_SIZE * (1 + rng() % (length / TextLine::CHUNK_SIZE));
+        size_t col = boundary + rng() % 16 - 8;
+        if (col <= length) return col;
+    }
+    return rng() % (length + 1);
+}
+
+static void compare(const TextLine& line, const std::string& model, std::mt19937& rng) {
+    CHECK(line.length() == model.length());
+    // Chunked from over LONG_LINE until back under CHUNK_SIZE
+    if (model.length() > TextLine::LONG_LINE) CHECK(line.chunked());
+    if (model.length() < TextLine::CHUNK_SIZE) CHECK(!line.chunked());
+    if (model.empty()) return;
+    for (int i = 0; i < 20; i++) {
+        size_t col = randomColumn(rng, model.length() - 1);
+        CHECK(line.at(col) == model[col]);
+        size_t count = rng() % 3 == 0 ? rng() % (3 * TextLine::CHUNK_SIZE) : rng() % 100;
+        CHECK(line.substr(col, count) == model.substr(col, count));
+
+        // Needles taken from the text, often across a boundary, and
+        // searched for from before, at and after where they were taken
+        size_t at = randomColumn(rng, model.length() - 1);
+        std::string needle = model.substr(at, 1 + rng() % 12);
+        size_t from = rng() % 3 == 0 ? 0 : std::min(model.length(), at - std::min<size_t>(at, rng() % 200) + rng() % 3);
+        CHECK(line.find(needle, from) == model.find(needle, from));
+        CHECK(line.find("zz") == std::string::npos);
+    }
+    CHECK(line.find("", 5) == model.find("", 5) || model.length() < 5);
+}
+
+int main() {
+    std::mt19937 rng(31);
+    std::string model = randomText(rng, TextLine::LONG_LINE + 12345);
+    TextLine line(model);
+    CHECK(line.chunked());
+
+    for (int step = 0; step < 3000; step++) {
+        size_t col = randomColumn(rng, model.length());
+        size_t count = 0;
+        std::string text;
+        switch (rng() % 8) {
+        case 0: case 1: case 2: text = randomText(rng, 1); break;                         // Typing
+        case 3: count = 1; break;                                                         // Backspace
+        case 4: count = rng() % 300; text = randomText(rng, rng() % 300); break;          // Paste over
+        case 5: count = rng() % (3 * TextLine::CHUNK_SIZE); break;                        // Across chunks
+        case 6: text = randomText(rng, rng() % (3 * TextLine::CHUNK_SIZE)); break;        // Splits a chunk
+        default:
+            // Back to a short plain line now and then, then over LONG_LINE again
+            if (model.length() > TextLine::LONG_LINE * 2 || rng() % 4 == 0) count = model.length() - 1000;
+            else text = randomText(rng, TextLine::LONG_LINE / 2);
+            col = rng() % 1000;
+            break;
+        }
+        col = std::min(col, model.length());
+        count = std::min(count, model.length() - col);
+        line.replace(col, count, text.data(), text.size());
+        model.replace(col, count, text);
+        compare(line, model, rng);
+        if (step % 100 == 0) {
+            CHECK(line.str() == model);
+            TextLine copy(line);
+            CHECK(copy.str() == model);
+            std::string pieces;
+            line.forEachPiece(0, std::string::npos, [&](const char* data, size_t length) { pieces.append(data, length); });
+            CHECK(pieces == model);
+        }
+    }
+    CHECK(line.str() == model);
+
+    // Deleted all the way and typed into again
+    line.replace(0, line.length(), "", 0);
+    CHECK(line.length() == 0 && !line.chunked() && line.str().empty());
+    return checkFailures();
+}
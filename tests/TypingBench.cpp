@@ -0,0 +1,91 @@
+#include "BracketIndex.hpp"
+#include "Check.hpp"
+#include "CursorSet.hpp"
+#include "FixedMetrics.hpp"
+#include "FoldMap.hpp"
+#include "LayoutCache.hpp"
+#include "MinimapSummary.hpp"
+#include "TextBuffer.hpp"
+#include "UndoHistory.hpp"
+#include <string>
+#include <vector>
+
+// Typing with many carets the way TextEditor does it: one batch per
+// keystroke through CursorSet, recorded for undo, with every per-line
+// listener the editor keeps attached and the lines on screen measured.
+
+static constexpr size_t LINES = 1000000;
+static constexpr size_t CARETS = 10000;
+static constexpr size_t FIRST_CARET = LINES / 2;
+static constexpr size_t SCREEN_LINES = 60;
+
+struct Editor {
+    TextBuffer buffer;
+    CursorSet cursors;
+    UndoHistory history;
+    FoldMap folds;
+    BracketIndex brackets{ buffer };
+    LayoutCache layout{ buffer };
+    MinimapSummary minimap{ buffer };
+
+    Editor() {
+        buffer.addListener(&folds);
+        buffer.addListener(&brackets);
+        buffer.addListener(&layout);
+        buffer.addListener(&minimap);
+        layout.reset(FixedMetrics(), 4);
+    }
+
+    template <typename Edit>
+    void keystroke(Edit edit) {
+        CursorSet before = cursors;
+        history.record(edit(), before);
+        size_t top = cursors.primary().caret.line;
+        for (size_t line = top; line < top + SCREEN_LINES && line < buffer.lineCount(); line++)
+            layout.x(line, buffer.line(line).length());
+    }
+};
+
+// Runs `keys` keystrokes, stopping early once over budget; false if it had to
+template <typename Edit>
+static bool type(Editor& editor, const char* what, int keys, double budgetMs, Edit edit) {
+    double total = 0;
+    int typed = 0;
+    for (; typed < keys && total <= budgetMs; typed++)
+        total += millis([&] { editor.keystroke([&] { return edit(editor); }); });
+    checkBudget(what, total, budgetMs);
+    return typed == keys;
+}
+
+int main() {
+    Editor editor;
+    std::vector<std::string> lines;
+    for (size_t i = 0; i < LINES; i++)
+        lines.push_back(i % 10 == 0 ? "if (x) {" : "    value = call(" + std::to_string(i) + ");");
+    editor.buffer.assign(std::move(lines));
+
+    std::vector<Selection> carets;
+    // A column selection down the middle of the file, as Alt+drag makes
+    for (size_t i = 0; i < CARETS; i++) {
+        TextPos at{ FIRST_CARET + i, 4 };
+        carets.push_back({ at, at });
+    }
+    editor.cursors.set(std::move(carets), 0);
+
+    bool complete = type(editor, "10K carets: type 30 characters", 30, 3000,
+                         [](Editor& e) { return e.cursors.replaceSelections(e.buffer, std::string("x")); });
+    complete &= type(editor, "10K carets: backspace 10 times", 10, 1000,
+                     [](Editor& e) { return e.cursors.deleteBackward(e.buffer); });
+    complete &= type(editor, "10K carets: Enter 10 times", 10, 3000,
+                     [](Editor& e) { return e.cursors.replaceSelections(e.buffer, std::string("\n")); });
+    complete &= type(editor, "10K carets: join lines 10 times", 10, 2000,
+                     [](Editor& e) { return e.cursors.deleteBackward(e.buffer); });
+
+    CHECK(editor.cursors.count() == CARETS);
+    if (complete) {
+        CHECK(editor.buffer.lineCount() == LINES);
+        CHECK(editor.buffer.line(FIRST_CARET + 1).str() == "    " + std::string(20, 'x') + "value = call(" +
+                                                            std::to_string(FIRST_CARET + 1) + ");");
+    }
+    return checkFailures();
+}